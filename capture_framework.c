@@ -34,6 +34,7 @@
 #include <sys/wait.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <zlib.h>
 
 #ifdef HAVE_CAPABILITY
 #include <sys/capability.h>
@@ -55,6 +56,9 @@
 #include "protobuf_c/kismet.pb-c.h"
 #include "protobuf_c/datasource.pb-c.h"
 
+/* Data report batching, implemented alongside cf_send_data */
+static void cf_batch_flush_due(kis_capture_handler_t *caph);
+
 uint32_t adler32_partial_csum(uint8_t *in_buf, size_t in_len,
         uint32_t *s1, uint32_t *s2) {
 	size_t i;
@@ -395,6 +399,26 @@ kis_capture_handler_t *cf_handler_init(const char *in_type) {
 
     pthread_mutex_init(&(ch->handler_lock), &mutexattr);
 
+    /* Batching stays off until Kismet offers it */
+    pthread_mutex_init(&(ch->batch_lock), &mutexattr);
+    ch->batch_max_packets = 0;
+    ch->batch_max_bytes = 0;
+    ch->batch_max_usec = 0;
+    ch->batch_buf = NULL;
+    ch->batch_buf_len = 0;
+    ch->batch_buf_sz = 0;
+    ch->batch_count = 0;
+    ch->batch_last_signal_len = 0;
+    ch->batch_compress_level = 0;
+
+    ch->shm_ring = NULL;
+    pthread_mutex_init(&(ch->shm_lock), NULL);
+
+    ch->slice_snaplen = 0;
+    ch->slice_keep_mgmt = 0;
+    ch->slice_keep_ctrl = 0;
+    ch->slice_num_ethertypes = 0;
+
     ch->listdevices_cb = NULL;
     ch->probe_cb = NULL;
     ch->open_cb = NULL;
@@ -499,8 +523,16 @@ void cf_handler_free(kis_capture_handler_t *caph) {
         caph->hopping_running = 0;
     }
 
+    if (caph->batch_buf != NULL)
+        free(caph->batch_buf);
+
+    if (caph->shm_ring != NULL)
+        kis_shm_ring_free(caph->shm_ring);
+
     pthread_mutex_destroy(&(caph->out_ringbuf_lock));
     pthread_mutex_destroy(&(caph->handler_lock));
+    pthread_mutex_destroy(&(caph->batch_lock));
+    pthread_mutex_destroy(&(caph->shm_lock));
 }
 
 cf_params_interface_t *cf_params_interface_new() {
@@ -565,6 +597,71 @@ void cf_handler_spindown(kis_capture_handler_t *caph) {
     pthread_mutex_unlock(&(caph->handler_lock));
 }
 
+/* Apply the batching limits and compression offered in an open command; a missing
+ * offer (older Kismet servers) or a batch of a single packet turns batching off.
+ * Compression only applies to batches sent over the remote transports. */
+static void cf_configure_batch(kis_capture_handler_t *caph, 
+        KismetDatasource__SubBatchConfig *batch,
+        KismetDatasource__SubCompressConfig *compress) {
+    /* Anything queued under the previous settings goes out first */
+    cf_flush_data_batch(caph);
+
+    pthread_mutex_lock(&(caph->batch_lock));
+
+    caph->batch_max_packets = 0;
+    caph->batch_compress_level = 0;
+
+    if (batch != NULL && batch->has_max_packets && batch->max_packets > 1) {
+        caph->batch_max_packets = batch->max_packets;
+
+        if (batch->has_max_bytes && batch->max_bytes > 0)
+            caph->batch_max_bytes = batch->max_bytes;
+        else
+            caph->batch_max_bytes = 1024 * 64;
+
+        /* Never let a single batch eat a meaningful part of the output buffer */
+        if (caph->batch_max_bytes > CAP_FRAMEWORK_RINGBUF_OUT_SZ / 8)
+            caph->batch_max_bytes = CAP_FRAMEWORK_RINGBUF_OUT_SZ / 8;
+
+        if (batch->has_max_usec && batch->max_usec > 0)
+            caph->batch_max_usec = batch->max_usec;
+        else
+            caph->batch_max_usec = 50000;
+    }
+
+    if (caph->batch_max_packets > 0 && compress != NULL && compress->level > 0 &&
+            (caph->use_tcp || caph->use_ws)) {
+        caph->batch_compress_level = compress->level > 9 ? 9 : (int) compress->level;
+    }
+
+    pthread_mutex_unlock(&(caph->batch_lock));
+}
+
+/* Apply the slicing policy offered in an open command; a missing offer sends whole
+ * frames */
+static void cf_configure_slice(kis_capture_handler_t *caph, 
+        KismetDatasource__SubSlicePolicy *slice) {
+    size_t i;
+
+    caph->slice_snaplen = 0;
+    caph->slice_keep_mgmt = 0;
+    caph->slice_keep_ctrl = 0;
+    caph->slice_num_ethertypes = 0;
+
+    if (slice == NULL || slice->snaplen == 0)
+        return;
+
+    caph->slice_snaplen = slice->snaplen;
+    caph->slice_keep_mgmt = slice->has_keep_mgmt && slice->keep_mgmt;
+    caph->slice_keep_ctrl = slice->has_keep_ctrl && slice->keep_ctrl;
+
+    for (i = 0; i < slice->n_keep_ethertypes && 
+            caph->slice_num_ethertypes < CAP_FRAMEWORK_SLICE_ETHERTYPES; i++) {
+        caph->slice_keep_ethertypes[caph->slice_num_ethertypes++] = 
+            (uint16_t) slice->keep_ethertypes[i];
+    }
+}
+
 void cf_handler_assign_hop_channels(kis_capture_handler_t *caph, char **stringchans,
         void **privchans, size_t chan_sz, double rate, int shuffle, int shuffle_spacing, 
         int offset) {
@@ -1647,6 +1744,30 @@ int cf_handle_rx_content(kis_capture_handler_t *caph, const uint8_t *buffer, siz
                 goto finish;
             }
             
+            /* Kismet only offers batching when it understands KDSDATABATCH, and
+             * compression when it understands KDSDATABATCHZ */
+            cf_configure_batch(caph, open_cmd->batch, open_cmd->compress);
+
+            /* Kismet may ask for only the headers of 802.11 data frames */
+            cf_configure_slice(caph, open_cmd->slice);
+
+            /* Local helpers may be offered a shared memory ring for frames; the
+             * descriptors were inherited when Kismet launched us */
+            if (open_cmd->shm != NULL && caph->use_ipc) {
+                pthread_mutex_lock(&(caph->shm_lock));
+
+                if (caph->shm_ring == NULL) {
+                    caph->shm_ring = kis_shm_ring_attach(open_cmd->shm->shm_fd,
+                            open_cmd->shm->notify_fd);
+
+                    if (caph->shm_ring == NULL && caph->verbose)
+                        fprintf(stderr, "WARNING: Could not map the shared memory frame "
+                                "ring, sending frames over IPC\n");
+                }
+
+                pthread_mutex_unlock(&(caph->shm_lock));
+            }
+
             msgstr[0] = 0;
             cbret = (*(caph->open_cb))(caph,
                     kds_cmd->seqno, open_cmd->definition,
@@ -2339,6 +2460,13 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
 
             pthread_mutex_unlock(&(caph->handler_lock));
 
+            /* Push out batched data which has waited long enough, or everything
+             * when we're winding down */
+            if (spindown)
+                cf_flush_data_batch(caph);
+            else
+                cf_batch_flush_due(caph);
+
             max_fd = 0;
 
             /* Only set read sets if we're not spinning down */
@@ -2366,6 +2494,12 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
             tm.tv_sec = 0;
             tm.tv_usec = 500000;
 
+            /* Wake up often enough to honor the batch latency */
+            pthread_mutex_lock(&(caph->batch_lock));
+            if (caph->batch_max_packets != 0 && caph->batch_max_usec < 500000)
+                tm.tv_usec = caph->batch_max_usec;
+            pthread_mutex_unlock(&(caph->batch_lock));
+
             if ((ret = select(max_fd + 1, &rset, &wset, NULL, &tm)) < 0) {
                 if (errno != EINTR && errno != EAGAIN) {
                     fprintf(stderr, "FATAL:  Error during select(): %s\n", strerror(errno));
@@ -2501,8 +2635,10 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
 
         ret = 0;
 
-        while (ret >= 0 && !caph->shutdown)
+        while (ret >= 0 && !caph->shutdown) {
             lws_service(caph->lwscontext, 0);
+            cf_batch_flush_due(caph);
+        }
 
         fprintf(stderr, "FATAL:  Datasource exiting libwebsocket loop\n");
 #endif
@@ -2742,6 +2878,10 @@ int cf_send_packet(kis_capture_handler_t *caph, const char *packtype, uint8_t *d
 
     kismet_external__command__init(&cmd);
 
+    /* Keep control and status frames ordered behind any data already batched */
+    if (strcmp(packtype, "KDSDATABATCH") != 0 && strcmp(packtype, "KDSDATABATCHZ") != 0)
+        cf_flush_data_batch(caph);
+
     /* Lock the handler and get the next sequence number */
     pthread_mutex_lock(&(caph->handler_lock));
     if (++caph->seqno == 0)
@@ -2815,6 +2955,29 @@ int cf_send_warning(kis_capture_handler_t *caph, const char *warning) {
     return cf_send_packet(caph, "KDSWARNINGREPORT", buf, len);
 }
 
+int cf_send_stats(kis_capture_handler_t *caph, uint64_t packets, uint64_t dropped) {
+    KismetDatasource__StatsReport kestats;
+    uint8_t *buf;
+    size_t len;
+
+    kismet_datasource__stats_report__init(&kestats);
+
+    kestats.has_packets = true;
+    kestats.packets = packets;
+    kestats.has_dropped = true;
+    kestats.dropped = dropped;
+
+    len = kismet_datasource__stats_report__get_packed_size(&kestats);
+    buf = (uint8_t *) malloc(len);
+
+    if (buf == NULL)
+        return -1;
+
+    kismet_datasource__stats_report__pack(&kestats, buf);
+
+    return cf_send_packet(caph, "KDSSTATSREPORT", buf, len);
+}
+
 int cf_send_error(kis_capture_handler_t *caph, uint32_t in_seqno, const char *msg) {
     KismetDatasource__ErrorReport keerror;
     KismetDatasource__SubSuccess kesuccess;
@@ -3192,6 +3355,520 @@ int cf_send_openresp(kis_capture_handler_t *caph, uint32_t seq, unsigned int suc
     return cf_send_packet(caph, "KDSOPENSOURCEREPORT", buf, buf_len);
 }
 
+/* DataBatchReport is assembled directly in its wire format:  every report is
+ * packed in place behind its field tag and length, and the fixed GPS, when there
+ * is one, is appended once at flush time. */
+#define CF_BATCH_TAG_GPS        0x0a
+#define CF_BATCH_TAG_REPORT     0x12
+
+/* Returned by cf_batch_report when the report should be sent on its own */
+#define CF_BATCH_INACTIVE       -2
+
+static size_t cf_batch_put_varint(uint8_t *buf, size_t val) {
+    size_t n = 0;
+
+    while (val >= 0x80) {
+        buf[n++] = (uint8_t) (val | 0x80);
+        val >>= 7;
+    }
+
+    buf[n++] = (uint8_t) val;
+
+    return n;
+}
+
+/* Make room for len more bytes of batch content; must hold batch_lock */
+static int cf_batch_reserve(kis_capture_handler_t *caph, size_t len) {
+    uint8_t *nbuf;
+    size_t nsz;
+
+    if (caph->batch_buf != NULL && caph->batch_buf_len + len <= caph->batch_buf_sz)
+        return 1;
+
+    nsz = caph->batch_max_bytes + 1024;
+
+    if (nsz < caph->batch_buf_len + len)
+        nsz = caph->batch_buf_len + len;
+
+    nbuf = (uint8_t *) realloc(caph->batch_buf, nsz);
+
+    if (nbuf == NULL)
+        return -1;
+
+    caph->batch_buf = nbuf;
+    caph->batch_buf_sz = nsz;
+
+    return 1;
+}
+
+/* Has the batch hit any of its limits; must hold batch_lock */
+static int cf_batch_full(kis_capture_handler_t *caph) {
+    struct timeval now;
+    long age;
+
+    if (caph->batch_count >= caph->batch_max_packets ||
+            caph->batch_buf_len >= caph->batch_max_bytes)
+        return 1;
+
+    gettimeofday(&now, NULL);
+
+    age = (now.tv_sec - caph->batch_start.tv_sec) * 1000000L + 
+        (now.tv_usec - caph->batch_start.tv_usec);
+
+    return age < 0 || (unsigned long) age >= caph->batch_max_usec;
+}
+
+/* How much the output side can accept right now */
+static size_t cf_batch_output_space(kis_capture_handler_t *caph) {
+    size_t avail = 0;
+
+    pthread_mutex_lock(&(caph->out_ringbuf_lock));
+
+    if (caph->use_tcp || caph->use_ipc) {
+        if (caph->out_ringbuf != NULL)
+            avail = kis_simple_ringbuf_available(caph->out_ringbuf);
+#ifdef HAVE_LIBWEBSOCKETS
+    } else if (caph->use_ws) {
+        /* Websocket frames are allocated per message, we only need a free slot */
+        if (caph->lwsring != NULL && lws_ring_get_count_free_elements(caph->lwsring) > 0)
+            avail = (size_t) -1;
+#endif
+    }
+
+    pthread_mutex_unlock(&(caph->out_ringbuf_lock));
+
+    return avail;
+}
+
+/* Compress a packed DataBatchReport and send it as KDSDATABATCHZ; batches which do
+ * not shrink are sent as they are.  Takes ownership of buf, like cf_send_packet. */
+static int cf_send_compressed_batch(kis_capture_handler_t *caph, 
+        uint8_t *buf, size_t buf_len, int level) {
+    KismetDatasource__CompressedDataBatch kezbatch;
+    uint8_t *zbuf, *out;
+    uLongf zbuf_len;
+    size_t out_len;
+
+    zbuf_len = compressBound(buf_len);
+    zbuf = (uint8_t *) malloc(zbuf_len);
+
+    if (zbuf == NULL)
+        return cf_send_packet(caph, "KDSDATABATCH", buf, buf_len);
+
+    if (compress2(zbuf, &zbuf_len, buf, buf_len, level) != Z_OK || 
+            zbuf_len + 16 >= buf_len) {
+        free(zbuf);
+        return cf_send_packet(caph, "KDSDATABATCH", buf, buf_len);
+    }
+
+    kismet_datasource__compressed_data_batch__init(&kezbatch);
+
+    kezbatch.uncompressed_sz = buf_len;
+    kezbatch.data.len = zbuf_len;
+    kezbatch.data.data = zbuf;
+
+    out_len = kismet_datasource__compressed_data_batch__get_packed_size(&kezbatch);
+    out = (uint8_t *) malloc(out_len);
+
+    if (out == NULL) {
+        free(zbuf);
+        return cf_send_packet(caph, "KDSDATABATCH", buf, buf_len);
+    }
+
+    kismet_datasource__compressed_data_batch__pack(&kezbatch, out);
+
+    free(zbuf);
+    free(buf);
+
+    return cf_send_packet(caph, "KDSDATABATCHZ", out, out_len);
+}
+
+int cf_flush_data_batch(kis_capture_handler_t *caph) {
+    KismetDatasource__SubGps kegps;
+    size_t gps_len = 0;
+    uint8_t *buf;
+    size_t buf_len;
+    int level;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+
+    if (caph->batch_count == 0) {
+        pthread_mutex_unlock(&(caph->batch_lock));
+        return 1;
+    }
+
+    /* Fixed GPS is sent once per batch instead of in every report */
+    kismet_datasource__sub_gps__init(&kegps);
+
+    if (caph->gps_fixed_lat != 0) {
+        struct timeval tv;
+
+        kegps.lat = caph->gps_fixed_lat;
+        kegps.lon = caph->gps_fixed_lon;
+        kegps.alt = caph->gps_fixed_alt;
+        kegps.fix = 3;
+
+        gettimeofday(&tv, NULL);
+        kegps.time_sec = tv.tv_sec;
+        kegps.time_usec = tv.tv_usec;
+
+        kegps.type = (char *) "remote-fixed";
+
+        if (caph->gps_name != NULL)
+            kegps.name = caph->gps_name;
+        else
+            kegps.name = (char *) "remote-fixed";
+
+        gps_len = kismet_datasource__sub_gps__get_packed_size(&kegps);
+    }
+
+    /* Sending consumes the buffer even when it fails, so only let go of the batch
+     * when there is room for it plus the command wrapper */
+    if (cf_batch_output_space(caph) < caph->batch_buf_len + gps_len + 128) {
+        pthread_mutex_unlock(&(caph->batch_lock));
+        return 0;
+    }
+
+    if (gps_len > 0) {
+        if (cf_batch_reserve(caph, gps_len + 11) < 0) {
+            pthread_mutex_unlock(&(caph->batch_lock));
+            return -1;
+        }
+
+        caph->batch_buf[caph->batch_buf_len++] = CF_BATCH_TAG_GPS;
+        caph->batch_buf_len += 
+            cf_batch_put_varint(caph->batch_buf + caph->batch_buf_len, gps_len);
+        kismet_datasource__sub_gps__pack(&kegps, caph->batch_buf + caph->batch_buf_len);
+        caph->batch_buf_len += gps_len;
+    }
+
+    buf = caph->batch_buf;
+    buf_len = caph->batch_buf_len;
+
+    caph->batch_buf = NULL;
+    caph->batch_buf_len = 0;
+    caph->batch_buf_sz = 0;
+    caph->batch_count = 0;
+    caph->batch_last_signal_len = 0;
+
+    level = caph->batch_compress_level;
+
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    /* Sent outside of the batch lock; cf_send_packet takes the handler lock, which
+     * the control path holds while it calls back into us */
+    if (level > 0)
+        return cf_send_compressed_batch(caph, buf, buf_len, level);
+
+    return cf_send_packet(caph, "KDSDATABATCH", buf, buf_len);
+}
+
+static void cf_batch_flush_due(kis_capture_handler_t *caph) {
+    int due;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+    due = caph->batch_count > 0 && cf_batch_full(caph);
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    if (due)
+        cf_flush_data_batch(caph);
+}
+
+/* Add a data report to the current batch, flushing when a limit is reached.
+ *
+ * Returns:
+ * CF_BATCH_INACTIVE    Batching is off, send the report directly
+ * -1                   An error occurred
+ *  0                   Batch is full and could not be flushed, try again
+ *  1                   Success
+ */
+static int cf_batch_report(kis_capture_handler_t *caph, 
+        KismetDatasource__DataReport *kedata) {
+    uint8_t sigbuf[CAP_FRAMEWORK_BATCH_SIGNAL_SZ];
+    size_t sig_len;
+    size_t rep_len;
+    int full;
+    int r;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+
+    if (caph->batch_max_packets == 0) {
+        pthread_mutex_unlock(&(caph->batch_lock));
+        return CF_BATCH_INACTIVE;
+    }
+
+    full = caph->batch_count > 0 && cf_batch_full(caph);
+
+    if (full) {
+        pthread_mutex_unlock(&(caph->batch_lock));
+
+        if ((r = cf_flush_data_batch(caph)) < 0)
+            return -1;
+
+        pthread_mutex_lock(&(caph->batch_lock));
+
+        if (caph->batch_max_packets == 0) {
+            pthread_mutex_unlock(&(caph->batch_lock));
+            return CF_BATCH_INACTIVE;
+        }
+
+        /* Push back on the caller rather than growing the batch without bound; a
+         * batch which is merely old keeps accepting reports */
+        if (r == 0 && (caph->batch_count >= caph->batch_max_packets ||
+                    caph->batch_buf_len >= caph->batch_max_bytes)) {
+            pthread_mutex_unlock(&(caph->batch_lock));
+            return 0;
+        }
+    }
+
+    /* A signal identical to the previous report's is replaced by repeat_signal */
+    if (kedata->signal != NULL && 
+            (sig_len = kismet_datasource__sub_signal__get_packed_size(kedata->signal)) <= 
+            sizeof(sigbuf)) {
+        kismet_datasource__sub_signal__pack(kedata->signal, sigbuf);
+
+        if (caph->batch_count > 0 && sig_len == caph->batch_last_signal_len &&
+                memcmp(sigbuf, caph->batch_last_signal, sig_len) == 0) {
+            kedata->signal = NULL;
+            kedata->has_repeat_signal = 1;
+            kedata->repeat_signal = 1;
+        } else {
+            memcpy(caph->batch_last_signal, sigbuf, sig_len);
+            caph->batch_last_signal_len = sig_len;
+        }
+    } else {
+        caph->batch_last_signal_len = 0;
+    }
+
+    rep_len = kismet_datasource__data_report__get_packed_size(kedata);
+
+    if (cf_batch_reserve(caph, rep_len + 11) < 0) {
+        pthread_mutex_unlock(&(caph->batch_lock));
+        return -1;
+    }
+
+    if (caph->batch_count == 0)
+        gettimeofday(&(caph->batch_start), NULL);
+
+    caph->batch_buf[caph->batch_buf_len++] = CF_BATCH_TAG_REPORT;
+    caph->batch_buf_len += 
+        cf_batch_put_varint(caph->batch_buf + caph->batch_buf_len, rep_len);
+    kismet_datasource__data_report__pack(kedata, caph->batch_buf + caph->batch_buf_len);
+    caph->batch_buf_len += rep_len;
+    caph->batch_count++;
+
+    full = cf_batch_full(caph);
+
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    if (full && cf_flush_data_batch(caph) < 0)
+        return -1;
+
+    return 1;
+}
+
+/* The framework doesn't pull in pcap, so name the link types we slice locally */
+#ifndef DLT_IEEE802_11
+#define DLT_IEEE802_11              105
+#endif
+#ifndef DLT_PRISM_HEADER
+#define DLT_PRISM_HEADER            119
+#endif
+#ifndef DLT_IEEE802_11_RADIO
+#define DLT_IEEE802_11_RADIO        127
+#endif
+#ifndef DLT_IEEE802_11_RADIO_AVS
+#define DLT_IEEE802_11_RADIO_AVS    163
+#endif
+#ifndef DLT_PPI
+#define DLT_PPI                     192
+#endif
+
+/* Offset of the 802.11 header behind the capture header of a DLT, or -1 when the
+ * DLT does not carry 802.11 frames we know how to slice */
+static long cf_slice_80211_offset(uint32_t dlt, uint32_t packet_sz, const uint8_t *pack) {
+    uint32_t hdr_len;
+
+    switch (dlt) {
+        case DLT_IEEE802_11:
+            /* Raw 802.11 */
+            return 0;
+        case DLT_IEEE802_11_RADIO:
+            /* Radiotap, little-endian it_len */
+            if (packet_sz < 4)
+                return -1;
+            return pack[2] | (pack[3] << 8);
+        case DLT_PPI:
+            /* PPI, little-endian length, and only when it wraps raw 802.11 */
+            if (packet_sz < 8)
+                return -1;
+            if ((pack[4] | (pack[5] << 8) | (pack[6] << 16) | ((uint32_t) pack[7] << 24)) != DLT_IEEE802_11)
+                return -1;
+            return pack[2] | (pack[3] << 8);
+        case DLT_PRISM_HEADER:
+            /* Prism, which some drivers fill with an AVS header instead */
+            if (packet_sz < 8)
+                return -1;
+            if (((uint32_t) pack[0] << 24 | pack[1] << 16 | pack[2] << 8 | pack[3]) != 0x80211001)
+                return 144;
+            /* fallthrough */
+        case DLT_IEEE802_11_RADIO_AVS:
+            /* AVS, big-endian length */
+            if (packet_sz < 8)
+                return -1;
+            hdr_len = (uint32_t) pack[4] << 24 | pack[5] << 16 | pack[6] << 8 | pack[7];
+            return hdr_len;
+        default:
+            return -1;
+    }
+}
+
+/* How much of a frame to send under the slicing policy; management, control, and
+ * EAPOL-style frames are kept whole as configured, data frames are cut to the
+ * snaplen but never inside the 802.11 header and LLC/SNAP */
+static uint32_t cf_slice_len(kis_capture_handler_t *caph, uint32_t dlt,
+        uint32_t packet_sz, const uint8_t *pack) {
+    const uint8_t *dot11;
+    long offt;
+    uint32_t dot11_sz, hdr_len, keep;
+    uint8_t fc0, fc1;
+    uint16_t ethertype;
+    size_t i;
+
+    if (caph->slice_snaplen == 0)
+        return packet_sz;
+
+    if ((offt = cf_slice_80211_offset(dlt, packet_sz, pack)) < 0 || 
+            (uint32_t) offt + 2 > packet_sz)
+        return packet_sz;
+
+    dot11 = pack + offt;
+    dot11_sz = packet_sz - offt;
+
+    fc0 = dot11[0];
+    fc1 = dot11[1];
+
+    switch ((fc0 >> 2) & 0x3) {
+        case 0:
+            if (caph->slice_keep_mgmt)
+                return packet_sz;
+            hdr_len = 24;
+            break;
+        case 1:
+            if (caph->slice_keep_ctrl)
+                return packet_sz;
+            hdr_len = 10;
+            break;
+        case 2:
+            hdr_len = 24;
+
+            /* To and from DS carries a fourth address */
+            if ((fc1 & 0x3) == 0x3)
+                hdr_len += 6;
+
+            /* QoS control, and HT control when the order bit is set on QoS */
+            if (fc0 & 0x80) {
+                hdr_len += 2;
+                if (fc1 & 0x80)
+                    hdr_len += 4;
+            }
+
+            /* Unprotected LLC/SNAP frames of a kept ethertype go whole */
+            if (!(fc1 & 0x40) && dot11_sz >= hdr_len + 8 &&
+                    dot11[hdr_len] == 0xAA && dot11[hdr_len + 1] == 0xAA && 
+                    dot11[hdr_len + 2] == 0x03) {
+                ethertype = (dot11[hdr_len + 6] << 8) | dot11[hdr_len + 7];
+
+                for (i = 0; i < caph->slice_num_ethertypes; i++) {
+                    if (caph->slice_keep_ethertypes[i] == ethertype)
+                        return packet_sz;
+                }
+            }
+
+            /* Keep the LLC/SNAP header so the payload type survives */
+            hdr_len += 8;
+            break;
+        default:
+            /* Extension frames are rare and small */
+            return packet_sz;
+    }
+
+    keep = caph->slice_snaplen > hdr_len ? caph->slice_snaplen : hdr_len;
+
+    if (keep >= dot11_sz)
+        return packet_sz;
+
+    return (uint32_t) offt + keep;
+}
+
+/* Write a plain frame into the shared memory ring.  Frames with messages or GPS,
+ * and frames the ring can't take right now, go over the normal protocol instead.
+ *
+ * Returns 1 when the frame was queued in the ring, 0 otherwise.
+ */
+static int cf_send_shm_data(kis_capture_handler_t *caph,
+        KismetDatasource__SubSignal *kv_signal, struct timeval ts, uint32_t dlt,
+        uint32_t packet_sz, uint32_t orig_sz, uint8_t *pack) {
+    kis_shm_record_t rec;
+    int r;
+
+    memset(&rec, 0, sizeof(kis_shm_record_t));
+
+    rec.ts_sec = ts.tv_sec;
+    rec.ts_usec = ts.tv_usec;
+    rec.dlt = dlt;
+
+    if (orig_sz > packet_sz)
+        rec.orig_sz = orig_sz;
+
+    if (kv_signal != NULL) {
+        if (kv_signal->has_signal_dbm) {
+            rec.fields |= KIS_SHM_FIELD_SIGNAL_DBM;
+            rec.signal_dbm = kv_signal->signal_dbm;
+        }
+
+        if (kv_signal->has_noise_dbm) {
+            rec.fields |= KIS_SHM_FIELD_NOISE_DBM;
+            rec.noise_dbm = kv_signal->noise_dbm;
+        }
+
+        if (kv_signal->has_signal_rssi) {
+            rec.fields |= KIS_SHM_FIELD_SIGNAL_RSSI;
+            rec.signal_rssi = kv_signal->signal_rssi;
+        }
+
+        if (kv_signal->has_noise_rssi) {
+            rec.fields |= KIS_SHM_FIELD_NOISE_RSSI;
+            rec.noise_rssi = kv_signal->noise_rssi;
+        }
+
+        if (kv_signal->has_freq_khz) {
+            rec.fields |= KIS_SHM_FIELD_FREQ_KHZ;
+            rec.freq_khz = kv_signal->freq_khz;
+        }
+
+        if (kv_signal->has_datarate) {
+            rec.fields |= KIS_SHM_FIELD_DATARATE;
+            rec.datarate = kv_signal->datarate;
+        }
+
+        if (kv_signal->channel != NULL) {
+            /* Channels which don't fit the record go the long way */
+            if (strlen(kv_signal->channel) >= KIS_SHM_CHANNEL_LEN)
+                return 0;
+
+            rec.fields |= KIS_SHM_FIELD_CHANNEL;
+            snprintf(rec.channel, KIS_SHM_CHANNEL_LEN, "%s", kv_signal->channel);
+        }
+    }
+
+    pthread_mutex_lock(&(caph->shm_lock));
+    r = kis_shm_ring_write(caph->shm_ring, &rec, pack, packet_sz);
+    pthread_mutex_unlock(&(caph->shm_lock));
+
+    return r > 0;
+}
+
 int cf_send_data(kis_capture_handler_t *caph,
         KismetExternal__MsgbusMessage *kv_message,
         KismetDatasource__SubSignal *kv_signal,
@@ -3201,6 +3878,19 @@ int cf_send_data(kis_capture_handler_t *caph,
     KismetDatasource__DataReport kedata;
     KismetDatasource__SubPacket kepkt;
     KismetDatasource__SubGps kegps;
+    uint32_t slice_sz = packet_sz;
+    int r;
+
+    /* Sliced frames report their original length in the packet size */
+    if (packet_sz > 0 && pack != NULL)
+        slice_sz = cf_slice_len(caph, dlt, packet_sz, pack);
+
+    /* The ring is only mapped once Kismet offers it, so it can be checked without
+     * the lock; a full ring falls back to the pipe */
+    if (caph->shm_ring != NULL && kv_message == NULL && kv_gps == NULL &&
+            caph->gps_fixed_lat == 0 && packet_sz > 0 && pack != NULL &&
+            cf_send_shm_data(caph, kv_signal, ts, dlt, slice_sz, packet_sz, pack))
+        return 1;
 
     kismet_datasource__data_report__init(&kedata);
     kismet_datasource__sub_packet__init(&kepkt);
@@ -3209,9 +3899,25 @@ int cf_send_data(kis_capture_handler_t *caph,
     kedata.signal = kv_signal;
     kedata.message = kv_message;
 
-    if (kv_gps != NULL) {
+    if (packet_sz > 0 && pack != NULL) {
+        kepkt.time_sec = ts.tv_sec;
+        kepkt.time_usec = ts.tv_usec;
+        kepkt.dlt = dlt;
+        kepkt.size = packet_sz;
+        kepkt.data.len = slice_sz;
+        kepkt.data.data = pack;
+
+        kedata.packet = &kepkt;
+    }
+
+    if (kv_gps != NULL)
         kedata.gps = kv_gps;
-    } else if (caph->gps_fixed_lat != 0) {
+
+    /* Batched reports pick up the fixed GPS once per batch */
+    if ((r = cf_batch_report(caph, &kedata)) != CF_BATCH_INACTIVE)
+        return r;
+
+    if (kv_gps == NULL && caph->gps_fixed_lat != 0) {
         struct timeval tv;
 
         kegps.lat = caph->gps_fixed_lat;
@@ -3233,17 +3939,6 @@ int cf_send_data(kis_capture_handler_t *caph,
         kedata.gps = &kegps;
     }
 
-    if (packet_sz > 0 && pack != NULL) {
-        kepkt.time_sec = ts.tv_sec;
-        kepkt.time_usec = ts.tv_usec;
-        kepkt.dlt = dlt;
-        kepkt.size = packet_sz;
-        kepkt.data.len = packet_sz;
-        kepkt.data.data = pack;
-
-        kedata.packet = &kepkt;
-    }
-
     uint8_t *buf;
     size_t buf_len;
 
@@ -3264,6 +3959,25 @@ int cf_send_data(kis_capture_handler_t *caph,
     return cf_send_packet(caph, "KDSDATAREPORT", buf, buf_len);
 }
 
+int cf_send_data_block(kis_capture_handler_t *caph, uint32_t dlt,
+        const cf_data_frame_t *frames, size_t nframes) {
+    size_t i;
+    int r;
+
+    for (i = 0; i < nframes; i++) {
+        r = cf_send_data(caph, NULL, NULL, NULL, frames[i].ts, dlt,
+                frames[i].packet_sz, frames[i].pack);
+
+        if (r < 0)
+            return -1;
+
+        if (r == 0)
+            break;
+    }
+
+    return (int) i;
+}
+
 int cf_send_json(kis_capture_handler_t *caph,
         KismetExternal__MsgbusMessage *kv_message,
         KismetDatasource__SubSignal *kv_signal,
@@ -3273,6 +3987,7 @@ int cf_send_json(kis_capture_handler_t *caph,
     KismetDatasource__DataReport kedata;
     KismetDatasource__SubJson kejson;
     KismetDatasource__SubGps kegps;
+    int r;
 
     kismet_datasource__data_report__init(&kedata);
     kismet_datasource__sub_json__init(&kejson);
@@ -3281,9 +3996,23 @@ int cf_send_json(kis_capture_handler_t *caph,
     kedata.signal = kv_signal;
     kedata.message = kv_message;
 
-    if (kv_gps != NULL) {
+    if (type != NULL && json  != NULL) {
+        kejson.time_sec = ts.tv_sec;
+        kejson.time_usec = ts.tv_usec;
+        kejson.type = type;
+        kejson.json = json;
+
+        kedata.json = &kejson;
+    }
+
+    if (kv_gps != NULL)
         kedata.gps = kv_gps;
-    } else if (caph->gps_fixed_lat != 0) {
+
+    /* Batched reports pick up the fixed GPS once per batch */
+    if ((r = cf_batch_report(caph, &kedata)) != CF_BATCH_INACTIVE)
+        return r;
+
+    if (kv_gps == NULL && caph->gps_fixed_lat != 0) {
         struct timeval tv;
 
         kegps.lat = caph->gps_fixed_lat;
@@ -3305,15 +4034,6 @@ int cf_send_json(kis_capture_handler_t *caph,
         kedata.gps = &kegps;
     }
 
-    if (type != NULL && json  != NULL) {
-        kejson.time_sec = ts.tv_sec;
-        kejson.time_usec = ts.tv_usec;
-        kejson.type = type;
-        kejson.json = json;
-
-        kedata.json = &kejson;
-    }
-
     uint8_t *buf;
     size_t buf_len;
 
@@ -58,6 +58,7 @@
 #endif
 
 #include "simple_ringbuf_c.h"
+#include "shm_ring_c.h"
 
 #include "protobuf_c/kismet.pb-c.h"
 #include "protobuf_c/datasource.pb-c.h"
@@ -85,6 +86,12 @@ struct cf_ws_msg {
 #define CAP_FRAMEWORK_RINGBUF_OUT_SZ    (1024 * 1024 * 4)
 #define CAP_FRAMEWORK_WS_BUF_SZ         (1024 * 4)
 
+/* Largest packed signal record we de-duplicate inside a batch */
+#define CAP_FRAMEWORK_BATCH_SIGNAL_SZ   256
+
+/* Most ethertypes a slicing policy can keep whole */
+#define CAP_FRAMEWORK_SLICE_ETHERTYPES  8
+
 /* List devices callback
  * Called to list devices available
  *
@@ -397,6 +404,41 @@ struct kis_capture_handler {
     /* Fixed GPS location from command line */
     double gps_fixed_lat, gps_fixed_lon, gps_fixed_alt;
 
+    /* Data report batching, offered by Kismet in KDSOPENSOURCE; when batch_max_packets
+     * is 0 every report is sent as its own KDSDATAREPORT */
+    pthread_mutex_t batch_lock;
+    unsigned int batch_max_packets;
+    size_t batch_max_bytes;
+    unsigned long batch_max_usec;
+
+    /* Pre-packed DataBatchReport content; handed off to the output buffer as a whole */
+    uint8_t *batch_buf;
+    size_t batch_buf_len;
+    size_t batch_buf_sz;
+    unsigned int batch_count;
+    struct timeval batch_start;
+
+    /* Packed signal of the last report in the batch, for repeat_signal */
+    uint8_t batch_last_signal[CAP_FRAMEWORK_BATCH_SIGNAL_SZ];
+    size_t batch_last_signal_len;
+
+    /* zlib level for batches, offered by Kismet to remote helpers; 0 sends batches
+     * uncompressed */
+    int batch_compress_level;
+
+    /* Shared memory frame ring offered by Kismet to local helpers; frames which fit
+     * the ring skip the IPC pipe entirely.  The lock keeps the ring single-producer. */
+    kis_shm_ring_t *shm_ring;
+    pthread_mutex_t shm_lock;
+
+    /* 802.11 slicing policy offered by Kismet; a snaplen of 0 sends whole frames.
+     * Set when the source is opened, before capture starts. */
+    unsigned int slice_snaplen;
+    int slice_keep_mgmt;
+    int slice_keep_ctrl;
+    uint16_t slice_keep_ethertypes[CAP_FRAMEWORK_SLICE_ETHERTYPES];
+    size_t slice_num_ethertypes;
+
     /* Fixed GPS name */
     char *gps_name;
 
@@ -769,6 +811,17 @@ int cf_send_message(kis_capture_handler_t *caph, const char *message,
  */
 int cf_send_warning(kis_capture_handler_t *caph, const char *warning);
 
+/* Send a STATSREPORT with capture counters accumulated since the last report,
+ * such as kernel drops
+ * Can be called from any thread
+ *
+ * Returns:
+ * -1   An error occurred writing the frame
+ *  0   Insufficient space in buffer
+ *  1   Success
+ */
+int cf_send_stats(kis_capture_handler_t *caph, uint64_t packets, uint64_t dropped);
+
 /* Send an ERROR
  * Can be called from any thread
  *
@@ -839,6 +892,37 @@ int cf_send_data(kis_capture_handler_t *caph,
         KismetDatasource__SubGps *kv_gps,
         struct timeval ts, uint32_t dlt, uint32_t packet_sz, uint8_t *pack);
 
+/* A captured frame without signal, GPS, or message data, for cf_send_data_block */
+typedef struct {
+    struct timeval ts;
+    uint32_t packet_sz;
+    uint8_t *pack;
+} cf_data_frame_t;
+
+/* Send a block of frames sharing a DLT, such as one retired kernel capture block,
+ * through the same path as cf_send_data.  The frames are copied, so the block can
+ * be released as soon as this returns.
+ * Can be called from any thread
+ *
+ * Returns:
+ * -1   An error occurred
+ * Otherwise the number of frames sent; fewer than nframes means the buffer is
+ * full and the remaining frames should be resent once it drains
+ */
+int cf_send_data_block(kis_capture_handler_t *caph, uint32_t dlt,
+        const cf_data_frame_t *frames, size_t nframes);
+
+/* Flush any batched data reports as a single KDSDATABATCH frame, or a
+ * KDSDATABATCHZ frame when Kismet asked for compression
+ * Can be called from any thread
+ *
+ * Returns:
+ * -1   An error occurred
+ *  0   Insufficient space in buffer, batch retained
+ *  1   Success, or nothing to flush
+ */
+int cf_flush_data_batch(kis_capture_handler_t *caph);
+
 /* Send a DATA frame with JSON non-packet data
  * Can be called from any thread
  *
@@ -74,6 +74,11 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include <poll.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
 #include "../config.h"
 
 #include "nl80211.h"
@@ -147,8 +152,42 @@ typedef struct {
     unsigned long channel_set_ns_avg;
     unsigned int channel_set_ns_count;
 
+    /* Capture through a native AF_PACKET TPACKET_V3 block ring instead of pcap;
+     * pcap is then only used to compile filters */
+    int use_tpacket;
+    int tpacket_fd;
+    uint8_t *tpacket_map;
+    size_t tpacket_map_sz;
+    unsigned int tpacket_block_sz;
+    unsigned int tpacket_block_nr;
+    unsigned int tpacket_frames;
+    unsigned int tpacket_fanout;
+    unsigned int tpacket_fanout_mode;
+
+    /* Frames of the block being sent */
+    cf_data_frame_t *tpacket_block_frames;
+    unsigned int tpacket_block_frames_sz;
+
+    /* Kernel drops since the last warning, and when we last warned */
+    unsigned long tpacket_drops;
+    time_t tpacket_last_warning;
+
+    /* Kernel counters read but not yet reported to the server */
+    uint64_t tpacket_report_packets;
+    uint64_t tpacket_report_drops;
+
 } local_wifi_t;
 
+/* Default TPACKET_V3 ring; 1MB blocks, room for at least 2048 full-size frames */
+#define TPACKET_DEFAULT_BLOCK_KB    1024
+#define TPACKET_DEFAULT_FRAMES      2048
+
+/* How long the kernel holds a partially filled block before handing it to us */
+#define TPACKET_BLOCK_TIMEOUT_MS    64
+
+/* Minimum seconds between kernel drop warnings */
+#define TPACKET_WARNING_INTERVAL    10
+
 /* Linux Wi-Fi Channels:
  *
  * Wi-Fi can use multiple channel widths and encodings which need to be
@@ -1236,6 +1275,245 @@ int build_explicit_filters(char **stringmacs, int num_macs, char **filter) {
     return num_macs;
 }
 
+/* Parse an unsigned numeric source option
+ *
+ * Returns:
+ * -1   Option present but not a number
+ *  0   Option not present, ret is unchanged
+ *  1   Success
+ */
+int find_uint_flag(unsigned int *ret, const char *flag, char *definition) {
+    char *placeholder = NULL;
+    int placeholder_len;
+    char *numstr;
+    int r;
+
+    if ((placeholder_len = cf_find_flag(&placeholder, flag, definition)) <= 0)
+        return 0;
+
+    numstr = strndup(placeholder, placeholder_len);
+    r = sscanf(numstr, "%u", ret);
+    free(numstr);
+
+    if (r != 1)
+        return -1;
+
+    return 1;
+}
+
+/* Release the TPACKET_V3 ring and its socket, which also leaves any fanout group */
+void tpacket_close(local_wifi_t *local_wifi) {
+    if (local_wifi->tpacket_map != NULL) {
+        munmap(local_wifi->tpacket_map, local_wifi->tpacket_map_sz);
+        local_wifi->tpacket_map = NULL;
+        local_wifi->tpacket_map_sz = 0;
+    }
+
+    if (local_wifi->tpacket_fd >= 0) {
+        close(local_wifi->tpacket_fd);
+        local_wifi->tpacket_fd = -1;
+    }
+
+    if (local_wifi->tpacket_block_frames != NULL) {
+        free(local_wifi->tpacket_block_frames);
+        local_wifi->tpacket_block_frames = NULL;
+        local_wifi->tpacket_block_frames_sz = 0;
+    }
+
+    local_wifi->tpacket_drops = 0;
+    local_wifi->tpacket_report_packets = 0;
+    local_wifi->tpacket_report_drops = 0;
+}
+
+/* Set up the ring for tpacket_open; anything partially set up is left for
+ * tpacket_close
+ *
+ * Returns:
+ * -1   Error, msg filled in
+ *  1   Success
+ */
+int tpacket_open_ring(local_wifi_t *local_wifi, char *msg) {
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    unsigned int frame_sz, frames_per_block;
+    int version = TPACKET_V3;
+    int fanout;
+    int dlt;
+
+    if ((local_wifi->tpacket_fd = socket(AF_PACKET, SOCK_RAW, 0)) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not create packet socket for '%s': %s",
+                local_wifi->name, local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    fcntl(local_wifi->tpacket_fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&ifr, 0, sizeof(struct ifreq));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", local_wifi->cap_interface);
+
+    if (ioctl(local_wifi->tpacket_fd, SIOCGIFHWADDR, &ifr) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not get the link type of '%s': %s",
+                local_wifi->name, local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    /* Map the link type the same way libpcap does for wireless interfaces */
+    switch (ifr.ifr_hwaddr.sa_family) {
+        case ARPHRD_IEEE80211_RADIOTAP:
+            dlt = DLT_IEEE802_11_RADIO;
+            break;
+        case ARPHRD_IEEE80211_PRISM:
+            dlt = DLT_PRISM_HEADER;
+            break;
+        case ARPHRD_IEEE80211:
+            dlt = DLT_IEEE802_11;
+            break;
+        default:
+            snprintf(msg, STATUS_MAX, "%s interface '%s' does not appear to be in "
+                    "monitor mode (link type %d) and can not be captured with use_tpacket",
+                    local_wifi->name, local_wifi->cap_interface, ifr.ifr_hwaddr.sa_family);
+            return -1;
+    }
+
+    if (ioctl(local_wifi->tpacket_fd, SIOCGIFINDEX, &ifr) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not get the interface index of '%s': %s",
+                local_wifi->name, local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_VERSION,
+                &version, sizeof(int)) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not enable TPACKET_V3 on '%s', the kernel "
+                "may be too old: %s", local_wifi->name, local_wifi->cap_interface,
+                strerror(errno));
+        return -1;
+    }
+
+    /* V3 packs frames into blocks by their real size; the frame size only bounds the
+     * largest frame, and the frame count sizes the ring so it can hold at least that
+     * many frames of the maximum size */
+    frame_sz = TPACKET_ALIGN(TPACKET3_HDRLEN + MAX_PACKET_LEN);
+    frames_per_block = local_wifi->tpacket_block_sz / frame_sz;
+
+    if (frames_per_block == 0) {
+        snprintf(msg, STATUS_MAX, "%s tpacket_block_kb must be at least %uKB to hold "
+                "a full sized frame", local_wifi->name, (frame_sz / 1024) + 1);
+        return -1;
+    }
+
+    local_wifi->tpacket_block_nr =
+        (local_wifi->tpacket_frames + frames_per_block - 1) / frames_per_block;
+
+    memset(&req, 0, sizeof(struct tpacket_req3));
+    req.tp_block_size = local_wifi->tpacket_block_sz;
+    req.tp_block_nr = local_wifi->tpacket_block_nr;
+    req.tp_frame_size = frame_sz;
+    req.tp_frame_nr = frames_per_block * local_wifi->tpacket_block_nr;
+    req.tp_retire_blk_tov = TPACKET_BLOCK_TIMEOUT_MS;
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_RX_RING,
+                &req, sizeof(struct tpacket_req3)) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not allocate a %u x %uKB packet ring on '%s': %s",
+                local_wifi->name, req.tp_block_nr, req.tp_block_size / 1024,
+                local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    local_wifi->tpacket_map = (uint8_t *) mmap(NULL,
+            (size_t) req.tp_block_size * req.tp_block_nr,
+            PROT_READ | PROT_WRITE, MAP_SHARED, local_wifi->tpacket_fd, 0);
+
+    if (local_wifi->tpacket_map == MAP_FAILED) {
+        local_wifi->tpacket_map = NULL;
+        snprintf(msg, STATUS_MAX, "%s could not map the packet ring for '%s': %s",
+                local_wifi->name, local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    local_wifi->tpacket_map_sz = (size_t) req.tp_block_size * req.tp_block_nr;
+
+    /* Start receiving only once the ring exists */
+    memset(&sll, 0, sizeof(struct sockaddr_ll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifr.ifr_ifindex;
+
+    if (bind(local_wifi->tpacket_fd, (struct sockaddr *) &sll, sizeof(struct sockaddr_ll)) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not bind packet socket to '%s': %s",
+                local_wifi->name, local_wifi->cap_interface, strerror(errno));
+        return -1;
+    }
+
+    if (local_wifi->tpacket_fanout > 0) {
+        fanout = local_wifi->tpacket_fanout | (local_wifi->tpacket_fanout_mode << 16);
+
+        if (setsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_FANOUT,
+                    &fanout, sizeof(int)) < 0) {
+            snprintf(msg, STATUS_MAX, "%s could not join packet fanout group %u on '%s': %s",
+                    local_wifi->name, local_wifi->tpacket_fanout,
+                    local_wifi->cap_interface, strerror(errno));
+            return -1;
+        }
+    }
+
+    local_wifi->pd = pcap_open_dead(dlt, MAX_PACKET_LEN);
+
+    if (local_wifi->pd == NULL) {
+        snprintf(msg, STATUS_MAX, "%s could not allocate pcap filter handle for '%s'",
+                local_wifi->name, local_wifi->cap_interface);
+        return -1;
+    }
+
+    return 1;
+}
+
+/* Open a TPACKET_V3 block ring on the capture interface, and a dead pcap handle
+ * of the matching DLT which we use to compile filters
+ *
+ * Returns:
+ * -1   Error, msg filled in
+ *  1   Success
+ */
+int tpacket_open(local_wifi_t *local_wifi, char *msg) {
+    if (tpacket_open_ring(local_wifi, msg) < 0) {
+        tpacket_close(local_wifi);
+        return -1;
+    }
+
+    return 1;
+}
+
+/* Apply a compiled filter to whichever capture we're using
+ *
+ * Returns:
+ * -1   Error, errstr filled in
+ *  1   Success
+ */
+int local_setfilter(local_wifi_t *local_wifi, struct bpf_program *bpf, char *errstr) {
+    struct sock_fprog fprog;
+
+    if (!local_wifi->use_tpacket) {
+        if (pcap_setfilter(local_wifi->pd, bpf) < 0) {
+            snprintf(errstr, PCAP_ERRBUF_SIZE, "%s", pcap_geterr(local_wifi->pd));
+            return -1;
+        }
+
+        return 1;
+    }
+
+    /* pcap and the kernel share the classic BPF instruction layout */
+    fprog.len = bpf->bf_len;
+    fprog.filter = (struct sock_filter *) bpf->bf_insns;
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_SOCKET, SO_ATTACH_FILTER,
+                &fprog, sizeof(struct sock_fprog)) < 0) {
+        snprintf(errstr, PCAP_ERRBUF_SIZE, "%s", strerror(errno));
+        return -1;
+    }
+
+    return 1;
+}
 
 int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         char *msg, uint32_t *dlt, char **uuid, KismetExternal__Command *frame,
@@ -1337,6 +1615,15 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         local_wifi->pd = NULL;
     }
 
+    tpacket_close(local_wifi);
+
+    /* The ring options only apply if this definition asks for them */
+    local_wifi->use_tpacket = 0;
+    local_wifi->tpacket_block_sz = TPACKET_DEFAULT_BLOCK_KB * 1024;
+    local_wifi->tpacket_frames = TPACKET_DEFAULT_FRAMES;
+    local_wifi->tpacket_fanout = 0;
+    local_wifi->tpacket_fanout_mode = PACKET_FANOUT_HASH;
+
     /* Start processing the open */
 
     if ((placeholder_len = cf_parse_interface(&placeholder, definition)) <= 0) {
@@ -1383,6 +1670,58 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         }
     }
 
+    /* Capture through a TPACKET_V3 block ring instead of pcap? */
+    if ((placeholder_len =
+                cf_find_flag(&placeholder, "use_tpacket", definition)) > 0) {
+        if (strncasecmp(placeholder, "false", placeholder_len) == 0) {
+            local_wifi->use_tpacket = 0;
+        } else if (strncasecmp(placeholder, "true", placeholder_len) == 0) {
+            local_wifi->use_tpacket = 1;
+        }
+    }
+
+    if (local_wifi->use_tpacket) {
+        unsigned int block_kb = TPACKET_DEFAULT_BLOCK_KB;
+
+        if (find_uint_flag(&block_kb, "tpacket_block_kb", definition) < 0 ||
+                block_kb == 0 || (block_kb * 1024) % getpagesize() != 0) {
+            snprintf(msg, STATUS_MAX, "%s tpacket_block_kb must be a multiple of the "
+                    "system page size (%dKB)", local_wifi->name, getpagesize() / 1024);
+            return -1;
+        }
+
+        local_wifi->tpacket_block_sz = block_kb * 1024;
+
+        if (find_uint_flag(&local_wifi->tpacket_frames, "tpacket_frames", definition) < 0 ||
+                local_wifi->tpacket_frames == 0) {
+            snprintf(msg, STATUS_MAX, "%s tpacket_frames must be a number of frames",
+                    local_wifi->name);
+            return -1;
+        }
+
+        if (find_uint_flag(&local_wifi->tpacket_fanout, "tpacket_fanout_group", definition) < 0 ||
+                local_wifi->tpacket_fanout > 0xFFFF) {
+            snprintf(msg, STATUS_MAX, "%s tpacket_fanout_group must be a group ID from "
+                    "1 to 65535", local_wifi->name);
+            return -1;
+        }
+
+        if ((placeholder_len =
+                    cf_find_flag(&placeholder, "tpacket_fanout_mode", definition)) > 0) {
+            if (strncasecmp(placeholder, "hash", placeholder_len) == 0) {
+                local_wifi->tpacket_fanout_mode = PACKET_FANOUT_HASH;
+            } else if (strncasecmp(placeholder, "lb", placeholder_len) == 0) {
+                local_wifi->tpacket_fanout_mode = PACKET_FANOUT_LB;
+            } else if (strncasecmp(placeholder, "cpu", placeholder_len) == 0) {
+                local_wifi->tpacket_fanout_mode = PACKET_FANOUT_CPU;
+            } else {
+                snprintf(msg, STATUS_MAX, "%s tpacket_fanout_mode must be one of hash, "
+                        "lb, or cpu", local_wifi->name);
+                return -1;
+            }
+        }
+    }
+
     if ((num_filter_interfaces = 
                 cf_count_flag("filter_interface", definition)) > 0) {
         if (filter_locals) {
@@ -2307,9 +2646,19 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
 
     (*ret_interface)->hardware = strdup(driver);
 
-    /* Open the pcap */
-    local_wifi->pd = pcap_open_live(local_wifi->cap_interface, 
-            MAX_PACKET_LEN, 1, 1000, pcap_errstr);
+    /* Open the ring or the pcap */
+    if (local_wifi->use_tpacket) {
+        if (tpacket_open(local_wifi, msg) < 0)
+            return -1;
+
+        snprintf(errstr, STATUS_MAX, "%s capturing from '%s' with a %u x %uKB TPACKET_V3 ring",
+                local_wifi->name, local_wifi->cap_interface, local_wifi->tpacket_block_nr,
+                local_wifi->tpacket_block_sz / 1024);
+        cf_send_message(caph, errstr, MSGFLAG_INFO);
+    } else {
+        local_wifi->pd = pcap_open_live(local_wifi->cap_interface, 
+                MAX_PACKET_LEN, 1, 1000, pcap_errstr);
+    }
 
     if (local_wifi->pd == NULL || strlen(pcap_errstr) != 0) {
         snprintf(msg, STATUS_MAX, "%s could not open capture interface '%s' on '%s' "
@@ -2333,10 +2682,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (local_setfilter(local_wifi, &bpf, pcap_errstr) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude other "
                             "local interfaces: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, pcap_errstr);
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2351,10 +2700,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (local_setfilter(local_wifi, &bpf, pcap_errstr) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude "
                             "local interfaces: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, pcap_errstr);
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2376,10 +2725,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (local_setfilter(local_wifi, &bpf, pcap_errstr) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude "
                             "specific addresses: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, pcap_errstr);
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2591,20 +2940,201 @@ void pcap_dispatch_cb(u_char *user, const struct pcap_pkthdr *header,
     }
 }
 
+/* Report kernel ring statistics, and warn if the kernel is dropping frames */
+void tpacket_report_stats(kis_capture_handler_t *caph) {
+    local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
+    struct tpacket_stats_v3 stats;
+    socklen_t stats_len = sizeof(struct tpacket_stats_v3);
+    char errstr[STATUS_MAX];
+    time_t now;
+
+    /* Reading the statistics resets them, so these count since the last read;
+     * tp_packets includes the dropped frames */
+    if (getsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_STATISTICS,
+                &stats, &stats_len) < 0)
+        return;
+
+    local_wifi->tpacket_report_packets += stats.tp_packets;
+    local_wifi->tpacket_report_drops += stats.tp_drops;
+
+    /* Only intervals with drops are reported */
+    if (local_wifi->tpacket_report_drops == 0) {
+        local_wifi->tpacket_report_packets = 0;
+        return;
+    }
+
+    /* Keep the counts for the next report if the write buffer is full */
+    if (cf_send_stats(caph, local_wifi->tpacket_report_packets,
+                local_wifi->tpacket_report_drops) > 0) {
+        local_wifi->tpacket_report_packets = 0;
+        local_wifi->tpacket_report_drops = 0;
+    }
+
+    local_wifi->tpacket_drops += stats.tp_drops;
+
+    if (local_wifi->tpacket_drops == 0)
+        return;
+
+    now = time(0);
+
+    if (now - local_wifi->tpacket_last_warning < TPACKET_WARNING_INTERVAL)
+        return;
+
+    snprintf(errstr, STATUS_MAX, "%s kernel dropped %lu packets on '%s' since the last "
+            "warning; the capture ring may be too small (tpacket_block_kb, tpacket_frames) "
+            "or the system may be overloaded", local_wifi->name, local_wifi->tpacket_drops,
+            local_wifi->cap_interface);
+    cf_send_warning(caph, errstr);
+
+    local_wifi->tpacket_drops = 0;
+    local_wifi->tpacket_last_warning = now;
+}
+
+/* Walk the TPACKET_V3 ring, sending the frames of each block the kernel has retired
+ * through cf_send_data_block (and so into the batched data reports, when the server
+ * negotiated them) and handing the block back once its frames have been copied out
+ *
+ * Returns:
+ * -1   Capture error, errstr filled in
+ *  0   Capture spun down
+ */
+int tpacket_capture_loop(kis_capture_handler_t *caph, char *errstr) {
+    local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *hdr;
+    struct pollfd pfd;
+    unsigned int block_num = 0;
+    unsigned int num_pkts, i;
+    unsigned int sent;
+    time_t last_stats = time(0), now;
+    int sockerr;
+    socklen_t sockerr_len;
+    int r;
+
+    pfd.fd = local_wifi->tpacket_fd;
+    pfd.events = POLLIN | POLLERR;
+
+    while (!caph->spindown) {
+        /* Check the drop counters once a second even when the ring stays busy */
+        now = time(0);
+        if (now != last_stats) {
+            tpacket_report_stats(caph);
+            last_stats = now;
+        }
+
+        block = (struct tpacket_block_desc *) (local_wifi->tpacket_map +
+                (size_t) block_num * local_wifi->tpacket_block_sz);
+
+        if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+                    TP_STATUS_USER) == 0) {
+            pfd.revents = 0;
+
+            r = poll(&pfd, 1, 1000);
+
+            if (r < 0 && errno == EINTR)
+                continue;
+
+            if (r < 0) {
+                snprintf(errstr, PCAP_ERRBUF_SIZE, "%s", strerror(errno));
+                return -1;
+            }
+
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                sockerr = 0;
+                sockerr_len = sizeof(int);
+                getsockopt(local_wifi->tpacket_fd, SOL_SOCKET, SO_ERROR, &sockerr, &sockerr_len);
+                snprintf(errstr, PCAP_ERRBUF_SIZE, "%s",
+                        sockerr == 0 ? "packet socket closed" : strerror(sockerr));
+                return -1;
+            }
+
+            continue;
+        }
+
+        num_pkts = block->hdr.bh1.num_pkts;
+
+        if (num_pkts > local_wifi->tpacket_block_frames_sz) {
+            free(local_wifi->tpacket_block_frames);
+
+            local_wifi->tpacket_block_frames =
+                (cf_data_frame_t *) malloc(sizeof(cf_data_frame_t) * num_pkts);
+
+            if (local_wifi->tpacket_block_frames == NULL) {
+                local_wifi->tpacket_block_frames_sz = 0;
+                snprintf(errstr, PCAP_ERRBUF_SIZE, "out of memory");
+                return -1;
+            }
+
+            local_wifi->tpacket_block_frames_sz = num_pkts;
+        }
+
+        hdr = (struct tpacket3_hdr *) ((uint8_t *) block + block->hdr.bh1.offset_to_first_pkt);
+
+        for (i = 0; i < num_pkts; i++) {
+            cf_data_frame_t *frame = &(local_wifi->tpacket_block_frames[i]);
+
+            frame->ts.tv_sec = hdr->tp_sec;
+            frame->ts.tv_usec = hdr->tp_nsec / 1000;
+            frame->packet_sz = hdr->tp_snaplen > MAX_PACKET_LEN ? MAX_PACKET_LEN : hdr->tp_snaplen;
+            frame->pack = (uint8_t *) hdr + hdr->tp_mac;
+
+            hdr = (struct tpacket3_hdr *) ((uint8_t *) hdr + hdr->tp_next_offset);
+        }
+
+        /* Try repeatedly to send the block; go into a thread wait state if the write
+         * buffer is full & we'll be woken up as soon as it flushes data out in the
+         * main select() loop */
+        sent = 0;
+        while (sent < num_pkts) {
+            if ((r = cf_send_data_block(caph, local_wifi->datalink_type,
+                            local_wifi->tpacket_block_frames + sent, num_pkts - sent)) < 0) {
+                snprintf(errstr, PCAP_ERRBUF_SIZE, "could not send packets to Kismet server");
+                return -1;
+            }
+
+            sent += r;
+
+            if (sent < num_pkts) {
+                if (caph->spindown)
+                    return 0;
+
+                cf_handler_wait_ringbuffer(caph);
+            }
+        }
+
+        /* Everything was copied out, give the block back to the kernel */
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+        block_num = (block_num + 1) % local_wifi->tpacket_block_nr;
+    }
+
+    return 0;
+}
+
 void capture_thread(kis_capture_handler_t *caph) {
     local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
     char errstr[PCAP_ERRBUF_SIZE];
+    char tperrstr[PCAP_ERRBUF_SIZE] = "";
     char *pcap_errstr;
     char iferrstr[STATUS_MAX];
     int ifflags = 0, ifret;
 
     /* Simple capture thread: since we don't care about blocking and 
      * channel control is managed by the channel hopping thread, all we have
-     * to do is enter a blocking pcap loop */
+     * to do is enter a blocking pcap loop, or walk the kernel ring */
+
+    if (local_wifi->use_tpacket) {
+        if (tpacket_capture_loop(caph, tperrstr) == 0) {
+            cf_handler_spindown(caph);
+            return;
+        }
 
-    pcap_loop(local_wifi->pd, -1, pcap_dispatch_cb, (u_char *) caph);
+        pcap_errstr = tperrstr;
+    } else {
+        pcap_loop(local_wifi->pd, -1, pcap_dispatch_cb, (u_char *) caph);
 
-    pcap_errstr = pcap_geterr(local_wifi->pd);
+        pcap_errstr = pcap_geterr(local_wifi->pd);
+    }
 
     snprintf(errstr, PCAP_ERRBUF_SIZE, "%s interface '%s' closed: %s", 
             local_wifi->name, local_wifi->cap_interface, 
@@ -2648,6 +3178,21 @@ int main(int argc, char *argv[]) {
         .verbose_statistics = 0,
         .channel_set_ns_avg = 0,
         .channel_set_ns_count = 0,
+        .use_tpacket = 0,
+        .tpacket_fd = -1,
+        .tpacket_map = NULL,
+        .tpacket_map_sz = 0,
+        .tpacket_block_sz = TPACKET_DEFAULT_BLOCK_KB * 1024,
+        .tpacket_block_nr = 0,
+        .tpacket_frames = TPACKET_DEFAULT_FRAMES,
+        .tpacket_fanout = 0,
+        .tpacket_fanout_mode = PACKET_FANOUT_HASH,
+        .tpacket_block_frames = NULL,
+        .tpacket_block_frames_sz = 0,
+        .tpacket_drops = 0,
+        .tpacket_last_warning = 0,
+        .tpacket_report_packets = 0,
+        .tpacket_report_drops = 0,
     };
 
 #ifdef HAVE_LIBNM
@@ -43,7 +43,7 @@ channel_tracker_v2::channel_tracker_v2() :
         Globalreg::fetch_mandatory_global_as<entry_tracker>();
 
 
-    packetchain->register_handler(&packet_chain_handler, this, CHAINPOS_LOGGING, 0);
+    packetchain->register_handler(&packet_chain_handler, this, CHAINPOS_LOGGING, 0, "channel tracker");
 
 	pack_comp_device = packetchain->register_packet_component("DEVICE");
 	pack_comp_common = packetchain->register_packet_component("COMMON");
@@ -474,6 +474,19 @@ void datasource_tracker::trigger_deferred_startup() {
 
     config_defaults->set_remote_cap_timestamp(Globalreg::globalreg->kismet_config->fetch_opt_bool("override_remote_timestamp", true));
 
+    config_defaults->set_batch_packets(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_batch_packets", 0));
+    config_defaults->set_batch_bytes(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_batch_bytes", 65536));
+    config_defaults->set_batch_msec(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_batch_msec", 50));
+
+    config_defaults->set_remote_batch_packets(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_remote_batch_packets", 64));
+    config_defaults->set_remote_batch_msec(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_remote_batch_msec", 250));
+    config_defaults->set_remote_compress(Globalreg::globalreg->kismet_config->fetch_opt_bool("datasource_remote_compress", false));
+    config_defaults->set_remote_compress_level(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_remote_compress_level", 6));
+    config_defaults->set_remote_snaplen(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_remote_snaplen", 0));
+
+    config_defaults->set_shm_ring(Globalreg::globalreg->kismet_config->fetch_opt_bool("datasource_shm_ring", false));
+    config_defaults->set_shm_ring_kb(Globalreg::globalreg->kismet_config->fetch_opt_uint("datasource_shm_ring_kb", 4096));
+
     // Register js module for UI
     std::shared_ptr<kis_httpd_registry> httpregistry = 
         Globalreg::fetch_mandatory_global_as<kis_httpd_registry>("WEBREGISTRY");
@@ -919,7 +932,9 @@ void datasource_tracker::trigger_deferred_startup() {
                             nullptr, nullptr,
                             1024*512);
 
-                    con->clear_timeout();
+                    if (!con->start_stream())
+                        return;
+
                     con->set_target_file("kismet-all-packets.pcapng");
                     con->set_closure_cb([pcapng]() { pcapng->stop_stream("http connection lost"); });
 
@@ -962,7 +977,9 @@ void datasource_tracker::trigger_deferred_startup() {
                             nullptr,
                             1024*512);
 
-                    con->clear_timeout();
+                    if (!con->start_stream())
+                        return;
+
                     con->set_target_file(fmt::format("kismet-datasource-{}-{}.pcapng", 
                                 ds->get_source_name(), dsuuid));
                     con->set_closure_cb([pcapng]() { pcapng->stop_stream("http connection lost"); });
@@ -240,6 +240,18 @@ public:
 
     __Proxy(remote_cap_timestamp, uint8_t, bool, bool, remote_cap_timestamp);
 
+    __Proxy(batch_packets, uint32_t, unsigned int, unsigned int, batch_packets);
+    __Proxy(batch_bytes, uint32_t, unsigned int, unsigned int, batch_bytes);
+    __Proxy(batch_msec, uint32_t, unsigned int, unsigned int, batch_msec);
+    __Proxy(remote_batch_packets, uint32_t, unsigned int, unsigned int, remote_batch_packets);
+    __Proxy(remote_batch_msec, uint32_t, unsigned int, unsigned int, remote_batch_msec);
+    __Proxy(remote_compress, uint8_t, bool, bool, remote_compress);
+    __Proxy(remote_compress_level, uint32_t, unsigned int, unsigned int, remote_compress_level);
+    __Proxy(remote_snaplen, uint32_t, unsigned int, unsigned int, remote_snaplen);
+
+    __Proxy(shm_ring, uint8_t, bool, bool, shm_ring);
+    __Proxy(shm_ring_kb, uint32_t, unsigned int, unsigned int, shm_ring_kb);
+
 protected:
     virtual void register_fields() override {
         tracker_component::register_fields();
@@ -267,6 +279,38 @@ protected:
         register_field("kismet.datasourcetracker.default.remote_cap_timestamp",
                 "overwrite remote capture timestamp with server timestamp",
                 &remote_cap_timestamp);
+
+        register_field("kismet.datasourcetracker.default.batch_packets",
+                "maximum packets per batched data report, 0 to disable batching",
+                &batch_packets);
+        register_field("kismet.datasourcetracker.default.batch_bytes",
+                "maximum size of a batched data report",
+                &batch_bytes);
+        register_field("kismet.datasourcetracker.default.batch_msec",
+                "maximum time a packet is held in a batched data report",
+                &batch_msec);
+        register_field("kismet.datasourcetracker.default.remote_batch_packets",
+                "maximum packets per batched data report from a remote source, 0 to disable batching",
+                &remote_batch_packets);
+        register_field("kismet.datasourcetracker.default.remote_batch_msec",
+                "maximum time a packet is held in a batched data report from a remote source",
+                &remote_batch_msec);
+        register_field("kismet.datasourcetracker.default.remote_compress",
+                "offer remote sources compression of batched data reports",
+                &remote_compress);
+        register_field("kismet.datasourcetracker.default.remote_compress_level",
+                "zlib compression level for remote sources",
+                &remote_compress_level);
+        register_field("kismet.datasourcetracker.default.remote_snaplen",
+                "bytes of 802.11 data frames sent by remote sources, 0 for whole frames",
+                &remote_snaplen);
+
+        register_field("kismet.datasourcetracker.default.shm_ring",
+                "offer local capture helpers a shared memory frame ring",
+                &shm_ring);
+        register_field("kismet.datasourcetracker.default.shm_ring_kb",
+                "size of the shared memory frame ring, in kilobytes",
+                &shm_ring_kb);
     }
 
     // Double hoprate per second
@@ -289,6 +333,22 @@ protected:
     std::shared_ptr<tracker_element_uint32> remote_cap_port;
     std::shared_ptr<tracker_element_uint8> remote_cap_timestamp;
 
+    // Data report batching offered to capture helpers
+    std::shared_ptr<tracker_element_uint32> batch_packets;
+    std::shared_ptr<tracker_element_uint32> batch_bytes;
+    std::shared_ptr<tracker_element_uint32> batch_msec;
+
+    // Batching and compression for remote sources, which are often on slow links
+    std::shared_ptr<tracker_element_uint32> remote_batch_packets;
+    std::shared_ptr<tracker_element_uint32> remote_batch_msec;
+    std::shared_ptr<tracker_element_uint8> remote_compress;
+    std::shared_ptr<tracker_element_uint32> remote_compress_level;
+    std::shared_ptr<tracker_element_uint32> remote_snaplen;
+
+    // Shared memory frame ring for local helpers
+    std::shared_ptr<tracker_element_uint8> shm_ring;
+    std::shared_ptr<tracker_element_uint32> shm_ring_kb;
+
 };
 
 class datasource_tracker_remote_server;
@@ -88,6 +88,14 @@ device_tracker::device_tracker() :
         entrytracker->register_field("kismet.device.base", 
                 tracker_element_factory<kis_tracked_device_base>(),
                 "core device record");
+
+    // Device type and phy name strings are shared by every device of that type
+    device_type_pool =
+        tracker_string_pool::get_field_pool(entrytracker->register_field("kismet.device.base.type",
+                    tracker_element_factory<tracker_element_string>(), "printable device type"));
+    device_phy_name_pool =
+        tracker_string_pool::get_field_pool(entrytracker->register_field("kismet.device.base.phyname",
+                    tracker_element_factory<tracker_element_string>(), "phy name"));
     device_list_base_id =
         entrytracker->register_field("kismet.device.list",
                 tracker_element_factory<tracker_element_vector>(),
@@ -159,7 +167,7 @@ device_tracker::device_tracker() :
 
 	// Common tracker, very early in the tracker chain
 	packetchain->register_handler(&Devicetracker_packethook_commontracker,
-											this, CHAINPOS_TRACKER, -100);
+											this, CHAINPOS_TRACKER, -100, "device tracker");
 
     // Post any events related to the device generated during tracking mode
     // (like a new device being created) at the very END of tracking, so that
@@ -171,7 +179,7 @@ device_tracker::device_tracker() :
             for (const auto& e : in_packet->process_complete_events)
                 eventbus->publish(e);
             return 1;
-        }, CHAINPOS_TRACKER, 0x7FFF'FFFF);
+        }, CHAINPOS_TRACKER, 0x7FFF'FFFF, "device tracker events");
 
     if (!Globalreg::globalreg->kismet_config->fetch_opt_bool("track_device_rrds", true)) {
         _MSG("Not tracking historical packet data to save RAM", MSGFLAG_INFO);
@@ -251,6 +259,35 @@ device_tracker::device_tracker() :
     tracked_vec.reserve(preload_sz);
     immutable_tracked_vec->reserve(preload_sz);
 
+    // Read-only searches of the device list are split across a small pool of threads
+    auto view_threads = 
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("tracker_view_threads",
+                std::min(std::thread::hardware_concurrency(), 8U));
+
+    if (view_threads > 1)
+        view_work_pool = 
+            std::make_shared<kis_worker_pool>("device view", view_threads, view_threads * 2);
+
+    search_index_enabled =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("tracker_search_index", false);
+
+    search_index_fields = 
+        Globalreg::globalreg->kismet_config->fetch_opt_vec("tracker_search_index_field");
+
+    if (search_index_fields.size() == 0) {
+        search_index_fields = {
+            "kismet.device.base.commonname",
+            "kismet.device.base.name",
+            "kismet.device.base.macaddr",
+            "kismet.device.base.manuf",
+            "kismet.device.base.type",
+            "kismet.device.base.phyname",
+            "kismet.device.base.crypt",
+            "kismet.device.base.channel",
+            "dot11.device/dot11.device.last_beaconed_ssid_record/dot11.advertisedssid.ssid",
+        };
+    }
+
     // Set up the device timeout
     device_idle_expiration =
         Globalreg::globalreg->kismet_config->fetch_opt_int("tracker_device_timeout", 0);
@@ -328,7 +365,7 @@ device_tracker::device_tracker() :
                     return multikey_endp_handler(con, true);
                 }, get_devicelist_mutex()));
 
-    httpd->register_route("/devices/all_devices", {"GET", "POST"}, httpd->RO_ROLE, {"ekjson", "itjson"},
+    httpd->register_route("/devices/all_devices", {"GET", "POST"}, httpd->RO_ROLE, {"ekjson", "itjson", "msgpack"},
             std::make_shared<kis_net_web_tracked_endpoint>(
                 [this](shared_con con) -> std::shared_ptr<tracker_element> {
                     auto device_ro = std::make_shared<tracker_element_vector>();
@@ -385,14 +422,7 @@ device_tracker::device_tracker() :
                         ts = tv;
                     }
 
-                    auto ts_worker = device_tracker_view_function_worker(
-                        [ts](std::shared_ptr<kis_tracked_device_base> d) -> bool {
-                            if (d->get_last_time() <= ts)
-                                return false;
-                            return true;
-                        });
-
-                    return do_readonly_device_work(ts_worker);
+                    return last_time_index.devices_after(ts);
                 }, get_devicelist_mutex()));
 
     httpd->register_route("/devices/by-key/:key/set_name", {"POST"}, httpd->LOGON_ROLE, {"cmd"},
@@ -466,7 +496,9 @@ device_tracker::device_tracker() :
                             nullptr,
                             1024*512);
         
-                    con->clear_timeout();
+                    if (!con->start_stream())
+                        return;
+
                     con->set_target_file(fmt::format("kismet-device-{}.pcapng", devkey));
                     con->set_closure_cb([pcapng]() { pcapng->stop_stream("http connection lost"); });
 
@@ -868,6 +900,9 @@ device_tracker::~device_tracker() {
         eventbus->remove_listener(new_device_evt_id);
     }
 
+    if (view_work_pool != nullptr)
+        view_work_pool->shutdown();
+
     Globalreg::globalreg->devicetracker = NULL;
     Globalreg::globalreg->remove_global(global_name());
 
@@ -899,6 +934,11 @@ device_tracker::~device_tracker() {
     tracked_vec.clear();
     immutable_tracked_vec->clear();
     tracked_mac_multimap.clear();
+    last_time_index.clear();
+    mod_time_index.clear();
+
+    if (search_index != nullptr)
+        search_index->clear();
 }
 
 void device_tracker::macdevice_timer_event() {
@@ -1208,6 +1248,7 @@ std::shared_ptr<kis_tracked_device_base>
 
     // Update the mod data
     device->update_modtime();
+    mod_time_index.update(device, device->get_mod_time());
 
     // Raise alerts for new devices or devices which have been
     // idle and re-appeared
@@ -1240,8 +1281,10 @@ std::shared_ptr<kis_tracked_device_base>
 
     }
 
-    if (device->get_last_time() < in_pack->ts.tv_sec)
+    if (device->get_last_time() < in_pack->ts.tv_sec) {
         device->set_last_time(in_pack->ts.tv_sec);
+        last_time_index.update(device, device->get_last_time());
+    }
 
     if (in_flags & UCD_UPDATE_PACKETS) {
         device->inc_packets();
@@ -1386,6 +1429,36 @@ std::shared_ptr<tracker_element_vector> device_tracker::do_readonly_device_work(
     return all_view->do_readonly_device_work(worker, vec);
 }
 
+bool device_tracker::search_index_candidates(const std::string& in_query, 
+        const std::vector<std::vector<int>>& in_paths,
+        robin_hood::unordered_flat_set<uint64_t>& ret) {
+    if (!search_index_enabled)
+        return false;
+
+    kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "device_tracker search_index_candidates");
+
+    if (search_index == nullptr) {
+        std::vector<std::vector<int>> paths;
+
+        for (const auto& f : search_index_fields) {
+            auto path = tracker_element_summary(f).resolved_path;
+
+            // Skip fields which aren't known, such as those of phys which aren't loaded
+            if (path.size() > 0 && std::find(path.begin(), path.end(), -1) == path.end())
+                paths.push_back(path);
+        }
+
+        search_index.reset(new device_search_index(paths));
+    }
+
+    if (!search_index->covers(in_paths))
+        return false;
+
+    search_index->refresh(tracked_vec, mod_time_index, time(0));
+
+    return search_index->candidates(in_query, ret);
+}
+
 std::shared_ptr<tracker_element_vector> device_tracker::do_device_work(device_tracker_view_worker& worker) {
     return all_view->do_device_work(worker);
 }
@@ -1433,6 +1506,12 @@ void device_tracker::timetracker_event(int eventid) {
                         // Forget it from any views
                         remove_view_device(d);
 
+                        last_time_index.remove(d);
+                        mod_time_index.remove(d);
+
+                        if (search_index != nullptr)
+                            search_index->remove_device(d);
+
                         // Forget it from the immutable vec, but keep its 
                         // position; we need to have vecpos = devid
                         auto iti = immutable_tracked_vec->begin() + d->get_kis_internal_id();
@@ -1487,6 +1566,12 @@ void device_tracker::timetracker_event(int eventid) {
                         }
                     }
 
+                    last_time_index.remove(d);
+                    mod_time_index.remove(d);
+
+                    if (search_index != nullptr)
+                        search_index->remove_device(d);
+
                     // Forget it from the immutable vec, but keep its 
                     // position; we need to have vecpos = devid
                     auto iti = immutable_tracked_vec->begin() + d->get_kis_internal_id();
@@ -1607,6 +1692,9 @@ void device_tracker::add_device(std::shared_ptr<kis_tracked_device_base> device)
     tracked_vec.push_back(device);
     immutable_tracked_vec->push_back(device);
 
+    last_time_index.update(device, device->get_last_time());
+    mod_time_index.update(device, device->get_mod_time());
+
     auto mm_pair = std::make_pair(device->get_macaddr(), device);
     tracked_mac_multimap.emplace(mm_pair);
 }
@@ -1685,18 +1773,25 @@ void device_tracker::databaselog_write_devices() {
     if (dbf == nullptr)
         return;
 
-    device_tracker_view_function_worker worker([this, dbf](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
-            if (dev->get_mod_time() >= last_database_logged) {
-                dbf->log_device(dev);
-            }
-
-            return false;
-        });
-
     // Remember the time BEFORE we spend time looking at all the devices
     auto log_time = time(0);
 
-    do_readonly_device_work(worker);
+    // Only collect the devices changed since the last pass under the devicelist lock;
+    // each device is serialized on its own by log_device, so the tracker is never 
+    // held for the whole pass
+    std::vector<std::shared_ptr<kis_tracked_device_base>> dirty_devices;
+
+    {
+        kis_lock_guard<kis_mutex> lk(get_devicelist_mutex(), "device_tracker databaselog_write_devices");
+
+        mod_time_index.for_each_after(last_database_logged - 1, 
+                [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                    dirty_devices.push_back(dev);
+                });
+    }
+
+    for (const auto& dev : dirty_devices)
+        dbf->log_device(dev);
 
     // Then update the log; we might catch a few high-change devices twice, but this is
     // safer by far
@@ -1822,6 +1917,10 @@ void device_tracker::set_device_user_name(std::shared_ptr<kis_tracked_device_bas
 
     in_dev->set_username(in_username);
 
+    // Renaming changes the common name, mark it modified so sorted views pick it up
+    in_dev->update_modtime();
+    mod_time_index.update(in_dev, in_dev->get_mod_time());
+
     if (!database_valid()) {
         _MSG("Unable to store device name to permanent storage, the database connection "
                 "is not available", MSGFLAG_ERROR);
@@ -1967,30 +2066,10 @@ void device_tracker::handle_new_device_event(std::shared_ptr<eventbus_event> evt
 }
 
 std::shared_ptr<tracker_element_string> device_tracker::get_cached_devicetype(const std::string& type) {
-    kis_lock_guard<kis_mutex> lk(device_type_cache_mutex, "device_tracker get_cached_devicetype");
-
-    auto k = device_type_cache.find(type);
-
-    if (k == device_type_cache.end()) {
-        auto r = std::make_shared<tracker_element_string>(type);
-        device_type_cache[type] = r;
-        return r;
-    }
-
-    return k->second;
+    return device_type_pool->intern(type);
 }
 
 std::shared_ptr<tracker_element_string> device_tracker::get_cached_phyname(const std::string& phyname) {
-    kis_lock_guard<kis_mutex> lk(device_phy_name_cache_mutex, "device_tracker get_cached_phyname");
-
-    auto k = device_phy_name_cache.find(phyname);
-
-    if (k == device_phy_name_cache.end()) {
-        auto r = std::make_shared<tracker_element_string>(phyname);
-        device_phy_name_cache[phyname] = r;
-        return r;
-    }
-
-    return k->second;
+    return device_phy_name_pool->intern(phyname);
 }
 
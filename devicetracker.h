@@ -39,6 +39,7 @@
 
 #include "globalregistry.h"
 #include "kis_mutex.h"
+#include "kis_worker_pool.h"
 #include "trackedelement.h"
 #include "entrytracker.h"
 #include "packetchain.h"
@@ -53,6 +54,8 @@
 #include "kis_net_beast_httpd.h"
 #include "devicetracker_view.h"
 #include "devicetracker_view_workers.h"
+#include "devicetracker_time_index.h"
+#include "devicetracker_search_index.h"
 #include "kis_database.h"
 #include "eventbus.h"
 #include "robin_hood.h"
@@ -137,6 +140,30 @@ public:
     std::shared_ptr<tracker_element_vector> do_readonly_device_work(device_tracker_view_worker& worker, 
             std::shared_ptr<tracker_element_vector> source_vec);
 
+    // Pool used to split read-only device work across threads, or nullptr if it
+    // runs in the caller
+    std::shared_ptr<kis_worker_pool> get_view_work_pool() {
+        return view_work_pool;
+    }
+
+    // Collect the internal ids of devices which may match a text search of a set of fields,
+    // from the search index; returns false if the search index is disabled or can't answer 
+    // the search, and the devices must be scanned.  Takes the devicelist mutex itself, so
+    // callers do not need to hold it
+    bool search_index_candidates(const std::string& in_query, 
+            const std::vector<std::vector<int>>& in_paths,
+            robin_hood::unordered_flat_set<uint64_t>& ret);
+
+    // Devices ordered by last time seen; must be used under the devicelist mutex
+    const device_time_index& get_last_time_index() const {
+        return last_time_index;
+    }
+
+    // Devices ordered by last modification; must be used under the devicelist mutex
+    const device_time_index& get_mod_time_index() const {
+        return mod_time_index;
+    }
+
     using device_map_t = robin_hood::unordered_node_map<device_key, std::shared_ptr<kis_tracked_device_base>>;
     using device_itr = device_map_t::iterator;
     using const_device_itr = device_map_t::const_iterator;
@@ -347,6 +374,19 @@ protected:
     // device ID.
     std::shared_ptr<tracker_element_vector> immutable_tracked_vec;
 
+    // Devices ordered by last time seen and by last modification, so time-limited
+    // queries and database logging only look at devices which have changed
+    device_time_index last_time_index;
+    device_time_index mod_time_index;
+
+    std::shared_ptr<kis_worker_pool> view_work_pool;
+
+    // Optional text search index, created on first search so that phy fields are
+    // registered before the field names are resolved
+    bool search_index_enabled;
+    std::vector<std::string> search_index_fields;
+    std::unique_ptr<device_search_index> search_index;
+
     // List of views using new API as we transition the rest to the new API
     std::shared_ptr<tracker_element_vector> view_vec;
 
@@ -395,13 +435,9 @@ protected:
     // Load stored tags
     void load_stored_tags(std::shared_ptr<kis_tracked_device_base> in_dev);
 
-    // Cached device type map
-    std::map<std::string, std::shared_ptr<tracker_element_string>> device_type_cache;
-    kis_mutex device_type_cache_mutex;
-
-    // Cached phyname map
-    std::map<std::string, std::shared_ptr<tracker_element_string>> device_phy_name_cache;
-    kis_mutex device_phy_name_cache_mutex;
+    // Pooled device type and phyname strings
+    std::shared_ptr<tracker_string_pool> device_type_pool;
+    std::shared_ptr<tracker_string_pool> device_phy_name_pool;
 };
 
 class devicelist_scope_locker {
@@ -357,36 +357,36 @@ public:
 
         __ImportField(commonname, p);
         __ImportField(type_string, p);
-        __ImportField(basic_type_set,p );
+        __ImportInline(basic_type_set, p);
         __ImportField(crypt_string, p);
-        __ImportField(basic_crypt_set, p);
-        __ImportField(first_time, p);
-        __ImportField(last_time, p);
-        __ImportField(mod_time, p);
+        __ImportInline(basic_crypt_set, p);
+        __ImportInline(first_time, p);
+        __ImportInline(last_time, p);
+        __ImportInline(mod_time, p);
 
-        __ImportField(packets, p);
-        __ImportField(tx_packets, p);
-        __ImportField(rx_packets, p);
-        __ImportField(llc_packets, p);
-        __ImportField(error_packets, p);
-        __ImportField(data_packets, p);
-        __ImportField(crypt_packets, p);
-        __ImportField(filter_packets, p);
+        __ImportInline(packets, p);
+        __ImportInline(tx_packets, p);
+        __ImportInline(rx_packets, p);
+        __ImportInline(llc_packets, p);
+        __ImportInline(error_packets, p);
+        __ImportInline(data_packets, p);
+        __ImportInline(crypt_packets, p);
+        __ImportInline(filter_packets, p);
 
 
-        __ImportField(datasize, p);
+        __ImportInline(datasize, p);
 
         __ImportId(packets_rrd_id, p);
         __ImportId(data_rrd_id, p);
 
         __ImportField(channel, p);
-        __ImportField(frequency, p);
+        __ImportInline(frequency, p);
 
         __ImportId(signal_data_id, p);
 
         __ImportField(freq_khz_map, p);
         __ImportField(manuf, p);
-        __ImportField(alert, p);
+        __ImportInline(alert, p);
 
         __ImportId(tag_map_id, p);
         __ImportId(tag_entry_id, p);
@@ -419,6 +419,8 @@ public:
         return std::move(dup);
     }
 
+    __InlineLayout
+
 
     __Proxy(key, device_key, device_key, device_key, key);
 
@@ -497,7 +499,7 @@ public:
             set_tracker_type_string(in_type());
     }
 
-    __Proxy(crypt_string, std::string, std::string, std::string, crypt_string);
+    __ProxyInterned(crypt_string, crypt_string);
 
     __Proxy(basic_crypt_set, uint64_t, uint64_t, uint64_t, basic_crypt_set);
     void add_basic_crypt(uint64_t in) { (*basic_crypt_set) |= in; }
@@ -617,7 +619,7 @@ protected:
     std::shared_ptr<tracker_element_string> type_string;
 
     // Basic phy-neutral type for sorting and classification
-    std::shared_ptr<tracker_element_uint64> basic_type_set;
+    tracker_inline<tracker_element_uint64> basic_type_set;
 
     // Printable crypt string, which is set by the phy and is the best printable
     // representation of the phy crypt options.  This should be empty if the phy
@@ -625,24 +627,24 @@ protected:
     std::shared_ptr<tracker_element_string> crypt_string;
 
     // Bitset of basic phy-neutral crypt options
-    std::shared_ptr<tracker_element_uint64> basic_crypt_set;
+    tracker_inline<tracker_element_uint64> basic_crypt_set;
 
     // First and last seen
-    std::shared_ptr<tracker_element_uint64> first_time;
-    std::shared_ptr<tracker_element_uint64> last_time;
-    std::shared_ptr<tracker_element_uint64> mod_time;
+    tracker_inline<tracker_element_uint64> first_time;
+    tracker_inline<tracker_element_uint64> last_time;
+    tracker_inline<tracker_element_uint64> mod_time;
 
     // Packet counts
-    std::shared_ptr<tracker_element_uint64> packets;
-    std::shared_ptr<tracker_element_uint64> tx_packets;
-    std::shared_ptr<tracker_element_uint64> rx_packets;
-    std::shared_ptr<tracker_element_uint64> llc_packets;
-    std::shared_ptr<tracker_element_uint64> error_packets;
-    std::shared_ptr<tracker_element_uint64> data_packets;
-    std::shared_ptr<tracker_element_uint64> crypt_packets;
-    std::shared_ptr<tracker_element_uint64> filter_packets;
+    tracker_inline<tracker_element_uint64> packets;
+    tracker_inline<tracker_element_uint64> tx_packets;
+    tracker_inline<tracker_element_uint64> rx_packets;
+    tracker_inline<tracker_element_uint64> llc_packets;
+    tracker_inline<tracker_element_uint64> error_packets;
+    tracker_inline<tracker_element_uint64> data_packets;
+    tracker_inline<tracker_element_uint64> crypt_packets;
+    tracker_inline<tracker_element_uint64> filter_packets;
 
-    std::shared_ptr<tracker_element_uint64> datasize;
+    tracker_inline<tracker_element_uint64> datasize;
 
     // Packets and data RRDs
     int packets_rrd_id;
@@ -653,7 +655,7 @@ protected:
 
 	// Channel and frequency as per PHY type
     std::shared_ptr<tracker_element_string> channel;
-    std::shared_ptr<tracker_element_double> frequency;
+    tracker_inline<tracker_element_double> frequency;
 
     // Signal data
     int signal_data_id;
@@ -667,7 +669,7 @@ protected:
     std::shared_ptr<tracker_element_string> manuf;
 
     // Alerts triggered on this device
-    std::shared_ptr<tracker_element_uint32> alert;
+    tracker_inline<tracker_element_uint32> alert;
 
     // Stringmap of tags
     std::shared_ptr<tracker_element_string_map> tag_map;
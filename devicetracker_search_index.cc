@@ -0,0 +1,292 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <ctype.h>
+
+#include "devicetracker_search_index.h"
+#include "entrytracker.h"
+#include "globalregistry.h"
+#include "macaddr.h"
+
+static void append_lower(std::string& out, const std::string& in) {
+    for (auto c : in)
+        out.push_back(tolower((unsigned char) c));
+}
+
+static void append_hex(std::string& out, uint64_t in_val, unsigned int in_bytes) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (unsigned int b = 0; b < in_bytes; b++) {
+        auto byte = (in_val >> ((in_bytes - b - 1) * 8)) & 0xFF;
+        out.push_back(hex[byte >> 4]);
+        out.push_back(hex[byte & 0x0F]);
+    }
+}
+
+device_search_index::device_search_index(const std::vector<std::vector<int>>& in_paths) :
+    paths{in_paths},
+    indexes_mac{false},
+    last_rebuild{0},
+    last_refresh{0} { }
+
+bool device_search_index::covers(const std::vector<std::vector<int>>& in_paths) const {
+    for (const auto& p : in_paths) {
+        if (p.size() == 0)
+            continue;
+
+        if (std::find(paths.begin(), paths.end(), p) != paths.end())
+            continue;
+
+        if (Globalreg::globalreg->entrytracker->is_text_searchable(p.back()))
+            return false;
+    }
+
+    return true;
+}
+
+std::string device_search_index::device_text(const std::shared_ptr<kis_tracked_device_base>& device) {
+    std::string text;
+    std::string xform;
+
+    for (const auto& p : paths) {
+        auto e = get_tracker_element_path(p, device);
+
+        if (e == nullptr)
+            continue;
+
+        switch (e->get_type()) {
+            case tracker_type::tracker_string:
+                append_lower(text, std::static_pointer_cast<tracker_element_string>(e)->get());
+                break;
+            case tracker_type::tracker_byte_array:
+                append_lower(text, std::static_pointer_cast<tracker_element_byte_array>(e)->get());
+                break;
+            case tracker_type::tracker_mac_addr:
+                indexes_mac = true;
+                append_hex(text, std::static_pointer_cast<tracker_element_mac_addr>(e)->get().longmac,
+                        MAC_LEN_MAX);
+                break;
+            default:
+                if (!Globalreg::globalreg->entrytracker->search_xform(e, xform))
+                    continue;
+                append_lower(text, xform);
+                break;
+        }
+
+        // Keep trigrams from spanning fields
+        text.push_back('\0');
+    }
+
+    return text;
+}
+
+std::vector<uint32_t> device_search_index::trigrams(const std::string& in_text) {
+    std::vector<uint32_t> ret;
+
+    if (in_text.length() < 3)
+        return ret;
+
+    ret.reserve(in_text.length() - 2);
+
+    for (size_t i = 0; i + 2 < in_text.length(); i++) {
+        ret.push_back(((uint32_t) (uint8_t) in_text[i] << 16) | 
+                ((uint32_t) (uint8_t) in_text[i + 1] << 8) |
+                (uint32_t) (uint8_t) in_text[i + 2]);
+    }
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+
+    return ret;
+}
+
+void device_search_index::update_device(const std::shared_ptr<kis_tracked_device_base>& device) {
+    auto id = device->get_kis_internal_id();
+    auto text = device_text(device);
+
+    std::vector<uint32_t> old_trigrams;
+
+    auto ti = texts.find(id);
+    if (ti != texts.end()) {
+        if (ti->second == text)
+            return;
+
+        old_trigrams = trigrams(ti->second);
+    }
+
+    auto new_trigrams = trigrams(text);
+
+    std::vector<uint32_t> removed;
+    std::set_difference(old_trigrams.begin(), old_trigrams.end(), 
+            new_trigrams.begin(), new_trigrams.end(), std::back_inserter(removed));
+
+    std::vector<uint32_t> added;
+    std::set_difference(new_trigrams.begin(), new_trigrams.end(),
+            old_trigrams.begin(), old_trigrams.end(), std::back_inserter(added));
+
+    for (auto t : removed) {
+        auto pi = postings.find(t);
+
+        if (pi == postings.end())
+            continue;
+
+        pi->second.erase(id);
+
+        if (pi->second.empty())
+            postings.erase(pi);
+    }
+
+    for (auto t : added)
+        postings[t].insert(id);
+
+    if (text.length() == 0) {
+        if (ti != texts.end())
+            texts.erase(ti);
+    } else if (ti != texts.end()) {
+        ti->second = std::move(text);
+    } else {
+        texts[id] = std::move(text);
+    }
+}
+
+void device_search_index::refresh(const std::vector<std::shared_ptr<kis_tracked_device_base>>& devices,
+        const device_time_index& mod_index, time_t now) {
+
+    if (now - last_rebuild > rebuild_interval || now < last_rebuild) {
+        for (const auto& d : devices)
+            update_device(d);
+
+        last_rebuild = now;
+        last_refresh = now;
+        return;
+    }
+
+    // Modification times are in seconds, so re-check anything modified during the
+    // second of the last refresh
+    mod_index.for_each_after(last_refresh - 1, 
+            [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                update_device(dev);
+            });
+
+    last_refresh = now;
+}
+
+void device_search_index::remove_device(const std::shared_ptr<kis_tracked_device_base>& device) {
+    auto ti = texts.find(device->get_kis_internal_id());
+
+    if (ti == texts.end())
+        return;
+
+    for (auto t : trigrams(ti->second)) {
+        auto pi = postings.find(t);
+
+        if (pi == postings.end())
+            continue;
+
+        pi->second.erase(ti->first);
+
+        if (pi->second.empty())
+            postings.erase(pi);
+    }
+
+    texts.erase(ti);
+}
+
+void device_search_index::clear() {
+    texts.clear();
+    postings.clear();
+    last_rebuild = 0;
+    last_refresh = 0;
+}
+
+bool device_search_index::text_candidates(const std::string& in_query,
+        robin_hood::unordered_flat_set<uint64_t>& ret) const {
+    auto query_trigrams = trigrams(in_query);
+
+    if (query_trigrams.size() == 0)
+        return false;
+
+    // Walk the smallest posting list and check the others
+    std::vector<const robin_hood::unordered_flat_set<uint64_t> *> lists;
+
+    for (auto t : query_trigrams) {
+        auto pi = postings.find(t);
+
+        // No device has this trigram, so nothing can match
+        if (pi == postings.end())
+            return true;
+
+        lists.push_back(&pi->second);
+    }
+
+    std::sort(lists.begin(), lists.end(), 
+            [](const robin_hood::unordered_flat_set<uint64_t> *a, 
+                const robin_hood::unordered_flat_set<uint64_t> *b) {
+                return a->size() < b->size();
+            });
+
+    for (auto id : *lists[0]) {
+        bool present = true;
+
+        for (size_t l = 1; l < lists.size() && present; l++)
+            present = lists[l]->find(id) != lists[l]->end();
+
+        if (!present)
+            continue;
+
+        // Trigrams can match out of order, confirm the whole query
+        auto ti = texts.find(id);
+        if (ti != texts.end() && ti->second.find(in_query) != std::string::npos)
+            ret.insert(id);
+    }
+
+    return true;
+}
+
+bool device_search_index::candidates(const std::string& in_query,
+        robin_hood::unordered_flat_set<uint64_t>& ret) const {
+    if (in_query.length() < 3)
+        return false;
+
+    std::string lower_query;
+    append_lower(lower_query, in_query);
+
+    if (!text_candidates(lower_query, ret))
+        return false;
+
+    if (!indexes_mac)
+        return true;
+
+    // Queries which parse as part of a MAC address also match MAC fields, by whole bytes
+    uint64_t mac_term;
+    unsigned int mac_term_len;
+
+    mac_addr::prepare_search_term(in_query, mac_term, mac_term_len);
+
+    if (mac_term_len == 0)
+        return true;
+
+    std::string mac_query;
+    append_hex(mac_query, mac_term, mac_term_len);
+
+    return text_candidates(mac_query, ret);
+}
+
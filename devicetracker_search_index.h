@@ -0,0 +1,110 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_SEARCH_INDEX_H__
+#define __DEVICETRACKER_SEARCH_INDEX_H__
+
+#include "config.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <time.h>
+
+#include "devicetracker_component.h"
+#include "devicetracker_time_index.h"
+#include "robin_hood.h"
+
+// Trigram index of searchable device fields
+//
+// Text searches from the UI match a substring against a set of fields of every device;
+// resolving the fields and searching them for every device dominates the cost of a 
+// search over a large device list.  The search index keeps the lower-case text of a 
+// configured set of fields for each device, and a map of every 3-character sequence to
+// the devices whose text contains it.  A search only needs to look at the devices
+// containing every trigram of the query, and confirms them against the stored text.
+//
+// The index returns candidates; callers still match the candidates with the search 
+// worker, so the results are exactly the same as a full scan.  The index can only 
+// answer searches of at least 3 characters, over fields which are all indexed.
+//
+// MAC address fields are indexed as hex without separators, matching the partial MAC
+// search used by the string match workers.
+//
+// Devices which changed since the last search are re-indexed before searching, found
+// through the device modification time index; the whole device list is re-checked when
+// the index is older than the rebuild interval, to catch fields which changed without
+// the device being modified.
+//
+// The search index is maintained and used under the devicelist mutex.
+class device_search_index {
+public:
+    device_search_index(const std::vector<std::vector<int>>& in_paths);
+
+    // Can the index answer a search of these fields; fields which could never match a
+    // text search are ignored
+    bool covers(const std::vector<std::vector<int>>& in_paths) const;
+
+    // Bring the index up to date
+    void refresh(const std::vector<std::shared_ptr<kis_tracked_device_base>>& devices,
+            const device_time_index& mod_index, time_t now);
+
+    void remove_device(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    void clear();
+
+    // Collect the internal ids of every device which may match a search; returns false
+    // if the index can't answer the query and the devices must be scanned
+    bool candidates(const std::string& in_query, robin_hood::unordered_flat_set<uint64_t>& ret) const;
+
+    size_t get_devices() const {
+        return texts.size();
+    }
+
+    size_t get_trigrams() const {
+        return postings.size();
+    }
+
+    static constexpr time_t rebuild_interval = 300;
+
+protected:
+    // Index the current text of a device
+    void update_device(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    std::string device_text(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    static std::vector<uint32_t> trigrams(const std::string& in_text);
+
+    bool text_candidates(const std::string& in_query, 
+            robin_hood::unordered_flat_set<uint64_t>& ret) const;
+
+    std::vector<std::vector<int>> paths;
+    bool indexes_mac;
+
+    // Indexed text, by device internal id
+    robin_hood::unordered_node_map<uint64_t, std::string> texts;
+
+    // Devices containing each trigram
+    robin_hood::unordered_node_map<uint32_t, robin_hood::unordered_flat_set<uint64_t>> postings;
+
+    time_t last_rebuild;
+    time_t last_refresh;
+};
+
+#endif
+
@@ -0,0 +1,100 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include "devicetracker_time_index.h"
+
+device_time_index::device_time_index() :
+    num_devices{0} { }
+
+void device_time_index::update(const std::shared_ptr<kis_tracked_device_base>& device, time_t in_ts) {
+    auto id = device->get_kis_internal_id();
+
+    if (id >= entries.size())
+        entries.resize(id + 1);
+
+    auto& entry = entries[id];
+
+    if (entry.indexed) {
+        if (entry.ts == in_ts)
+            return;
+
+        remove_entry(entry);
+    }
+
+    auto& bucket = buckets[in_ts];
+
+    entry.ts = in_ts;
+    entry.pos = bucket.size();
+    entry.indexed = true;
+
+    bucket.push_back(device);
+    num_devices++;
+}
+
+void device_time_index::remove(const std::shared_ptr<kis_tracked_device_base>& device) {
+    auto id = device->get_kis_internal_id();
+
+    if (id >= entries.size())
+        return;
+
+    auto& entry = entries[id];
+
+    if (entry.indexed)
+        remove_entry(entry);
+}
+
+void device_time_index::remove_entry(index_entry& entry) {
+    auto bi = buckets.find(entry.ts);
+
+    if (bi != buckets.end()) {
+        auto& bucket = bi->second;
+
+        // Swap the last device in the bucket into the removed slot
+        if (entry.pos != bucket.size() - 1) {
+            bucket[entry.pos] = std::move(bucket.back());
+            entries[bucket[entry.pos]->get_kis_internal_id()].pos = entry.pos;
+        }
+
+        bucket.pop_back();
+
+        if (bucket.empty())
+            buckets.erase(bi);
+    }
+
+    entry.indexed = false;
+    num_devices--;
+}
+
+void device_time_index::clear() {
+    buckets.clear();
+    entries.clear();
+    num_devices = 0;
+}
+
+std::shared_ptr<tracker_element_vector> device_time_index::devices_after(time_t in_ts) const {
+    auto ret = std::make_shared<tracker_element_vector>();
+
+    for_each_after(in_ts, [&](const std::shared_ptr<kis_tracked_device_base>& d) {
+            ret->push_back(d);
+            });
+
+    return ret;
+}
+
@@ -0,0 +1,96 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_TIME_INDEX_H__
+#define __DEVICETRACKER_TIME_INDEX_H__
+
+#include "config.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <time.h>
+
+#include "devicetracker_component.h"
+
+// Time-ordered index of devices
+//
+// Devices are kept in one bucket per second of their indexed time, so finding every 
+// device seen after a timestamp only walks the buckets after that timestamp instead of
+// every device.  Devices are identified by their internal id, which finds a device's
+// place in its bucket directly, so moving a device between buckets costs two bucket
+// lookups, logarithmic in the number of distinct seconds indexed, plus a constant-time
+// removal from the old bucket.  Updating a device within the same second it was last
+// indexed at is a single comparison, which is the common case for busy devices.
+//
+// The buckets stay ordered over the whole lifetime of the index rather than a fixed
+// window, since queries may ask for any time since the devices were first seen.
+//
+// The index is not locked; it is maintained and queried under the devicelist mutex.
+class device_time_index {
+public:
+    device_time_index();
+
+    // Index a device at a time, moving it if it was already indexed
+    void update(const std::shared_ptr<kis_tracked_device_base>& device, time_t in_ts);
+
+    // Remove a device from the index
+    void remove(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    void clear();
+
+    // Call fn for every device indexed strictly after in_ts, oldest first
+    template<typename F>
+    void for_each_after(time_t in_ts, F fn) const {
+        for (auto bi = buckets.upper_bound(in_ts); bi != buckets.end(); ++bi) {
+            for (const auto& d : bi->second)
+                fn(d);
+        }
+    }
+
+    // Vector of every device indexed strictly after in_ts
+    std::shared_ptr<tracker_element_vector> devices_after(time_t in_ts) const;
+
+    size_t size() const {
+        return num_devices;
+    }
+
+protected:
+    struct index_entry {
+        index_entry() :
+            ts{0},
+            pos{0},
+            indexed{false} { }
+
+        time_t ts;
+        size_t pos;
+        bool indexed;
+    };
+
+    void remove_entry(index_entry& entry);
+
+    std::map<time_t, std::vector<std::shared_ptr<kis_tracked_device_base>>> buckets;
+
+    // Bucket positions, indexed by device internal id
+    std::vector<index_entry> entries;
+
+    size_t num_devices;
+};
+
+#endif
+
@@ -18,6 +18,9 @@
 
 #include "config.h"
 
+#include <condition_variable>
+#include <mutex>
+
 #include "devicetracker_view.h"
 #include "devicetracker.h"
 #include "devicetracker_component.h"
@@ -26,6 +29,31 @@
 #include "kis_mutex.h"
 #include "kismet_algorithm.h"
 
+// Order of two devices in a sorted page request.  Datatables "asc" sets an 
+// in_order_direction of 1, which has always sorted largest first; devices missing 
+// the field come first in direction 0 and last in direction 1.  The maintained sort
+// indexes have to produce the same order.
+static bool device_view_order_less(const std::vector<int>& order_field, 
+        unsigned int in_order_direction, const shared_tracker_element& a, 
+        const shared_tracker_element& b) {
+    auto fa = get_tracker_element_path(order_field, a);
+    auto fb = get_tracker_element_path(order_field, b);
+
+    if (fa == nullptr && fb == nullptr)
+        return false;
+
+    if (fa == nullptr) 
+        return in_order_direction == 0;
+
+    if (fb == nullptr)
+        return in_order_direction != 0;
+
+    if (in_order_direction == 0)
+        return fast_sort_tracker_element_less(fa, fb);
+
+    return fast_sort_tracker_element_less(fb, fa);
+}
+
 device_tracker_view::device_tracker_view(const std::string& in_id, const std::string& in_description, 
         new_device_cb in_new_cb, updated_device_cb in_update_cb) :
     tracker_component{},
@@ -37,6 +65,11 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
     register_fields();
     reserve_fields(nullptr);
 
+    max_sort_indexes = 
+        Globalreg::globalreg->kismet_config->fetch_opt_as<size_t>("view_sort_indexes", 4);
+    check_sort_indexes =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("view_sort_index_check", false);
+
     view_id->set(in_id);
     view_description->set(in_description);
 
@@ -72,6 +105,11 @@ device_tracker_view::device_tracker_view(const std::string& in_id, const std::st
     register_fields();
     reserve_fields(nullptr);
 
+    max_sort_indexes = 
+        Globalreg::globalreg->kismet_config->fetch_opt_as<size_t>("view_sort_indexes", 4);
+    check_sort_indexes =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("view_sort_index_check", false);
+
     view_id->set(in_id);
     view_description->set(in_description);
 
@@ -314,39 +352,106 @@ std::shared_ptr<tracker_element_vector> device_tracker_view::do_device_work(devi
 std::shared_ptr<tracker_element_vector> device_tracker_view::do_readonly_device_work(device_tracker_view_worker& worker,
         std::shared_ptr<tracker_element_vector> devices) {
 
-    // read-only workers are currently disabled because it may not be reasonable to solve conflicts
-    // at the per-device level, use the locked worker.
+    // Only workers which keep no state of their own can be split, anything else runs
+    // serially under the locked worker
+    auto pool = devicetracker->get_view_work_pool();
+
+    if (pool == nullptr || !worker.parallel_safe() || 
+            devices->size() < 2 * parallel_min_partition)
+        return do_device_work(worker, devices);
+
+    auto n_partitions = 
+        std::min<size_t>(pool->max_threads(), devices->size() / parallel_min_partition);
+    auto partition_sz = (devices->size() + n_partitions - 1) / n_partitions;
+
+    // Partition state is shared with the pool jobs so that a job which is cancelled
+    // late by a pool shutdown never outlives it
+    struct partition_state {
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t remaining;
+        std::vector<std::vector<std::shared_ptr<kis_tracked_device_base>>> results;
+        std::vector<bool> completed;
+    };
+
+    auto state = std::make_shared<partition_state>();
+    state->remaining = n_partitions;
+    state->results.resize(n_partitions);
+    state->completed.resize(n_partitions, false);
+
+    auto match_partition = [devices, partition_sz, &worker](size_t p, 
+            std::vector<std::shared_ptr<kis_tracked_device_base>>& matched) {
+        auto start = p * partition_sz;
+        auto end = std::min(start + partition_sz, devices->size());
+
+        for (auto i = start; i < end; i++) {
+            auto val = devices->at(i);
 
-    return do_device_work(worker, devices);
+            if (val == nullptr)
+                continue;
 
-#if 0
-    auto ret = std::make_shared<tracker_element_vector>();
-    ret->reserve(devices->size());
+            auto dev = std::static_pointer_cast<kis_tracked_device_base>(val);
+
+            if (worker.match_device(dev))
+                matched.push_back(dev);
+        }
+    };
 
-    kis_lock_guard<kis_mutex> ul_devlist(devicetracker->get_devicelist_mutex(), 
+    // Devices are still modified under the devicelist lock, so hold it while the partitions
+    // run; the lock is held for the duration of the slowest partition instead of the 
+    // entire list
+    kis_lock_guard<kis_mutex> dev_lg(devicetracker->get_devicelist_mutex(), 
             "device_tracker_view do_readonly_device_work");
 
-    std::for_each(devices->begin(), devices->end(),
-            [&](shared_tracker_element val) {
+    for (size_t p = 0; p < n_partitions; p++) {
+        auto submitted = pool->submit([state, p, match_partition](bool run) {
+                std::vector<std::shared_ptr<kis_tracked_device_base>> matched;
 
-            if (val == nullptr)
-                return;
+                if (run)
+                    match_partition(p, matched);
 
-            auto dev = std::static_pointer_cast<kis_tracked_device_base>(val);
+                std::lock_guard<std::mutex> lk(state->mutex);
+                state->results[p] = std::move(matched);
+                state->completed[p] = run;
+                state->remaining--;
+                state->cv.notify_all();
+            });
 
-            auto m = worker.match_device(dev);
+        if (!submitted) {
+            std::lock_guard<std::mutex> lk(state->mutex);
+            state->remaining--;
+        }
+    }
 
-            if (m) 
-                ret->push_back(dev);
+    {
+        std::unique_lock<std::mutex> lk(state->mutex);
+        state->cv.wait(lk, [state]() { return state->remaining == 0; });
+    }
 
-        });
+    // Anything the pool couldn't take is matched here
+    for (size_t p = 0; p < n_partitions; p++) {
+        if (!state->completed[p])
+            match_partition(p, state->results[p]);
+    }
+
+    auto ret = std::make_shared<tracker_element_vector>();
+
+    size_t n_matched = 0;
+    for (const auto& r : state->results)
+        n_matched += r.size();
+
+    ret->reserve(n_matched);
+
+    for (const auto& r : state->results) {
+        for (const auto& d : r)
+            ret->push_back(d);
+    }
 
     worker.set_matched_devices(ret);
 
     worker.finalize();
 
     return ret;
-#endif
 }
 
 std::shared_ptr<kis_tracked_device_base> device_tracker_view::fetch_device(device_key in_key) {
@@ -371,6 +476,7 @@ void device_tracker_view::new_device(std::shared_ptr<kis_tracked_device_base> de
             if (dpmi == device_presence_map.end()) {
                 device_presence_map[device->get_key()] = true;
                 device_list->push_back(device);
+                sort_index_add(device);
             }
 
             list_sz->set(device_list->size());
@@ -395,6 +501,7 @@ void device_tracker_view::update_device(std::shared_ptr<kis_tracked_device_base>
     if (retain && dpmi == device_presence_map.end()) {
         device_list->push_back(device);
         device_presence_map[device->get_key()] = true;
+        sort_index_add(device);
         list_sz->set(device_list->size());
         return;
     }
@@ -409,6 +516,7 @@ void device_tracker_view::update_device(std::shared_ptr<kis_tracked_device_base>
             }
         }
         device_presence_map.erase(dpmi);
+        sort_index_remove(device);
         list_sz->set(device_list->size());
         return;
     }
@@ -422,6 +530,7 @@ void device_tracker_view::remove_device(std::shared_ptr<kis_tracked_device_base>
 
     if (di != device_presence_map.end()) {
         device_presence_map.erase(di);
+        sort_index_remove(device);
 
         for (auto vi = device_list->begin(); vi != device_list->end(); ++vi) {
             if (*vi == device) {
@@ -444,10 +553,80 @@ void device_tracker_view::add_device_direct(std::shared_ptr<kis_tracked_device_b
 
     device_presence_map[device->get_key()] = true;
     device_list->push_back(device);
+    sort_index_add(device);
 
     list_sz->set(device_list->size());
 }
 
+device_tracker_view_sort_index *device_tracker_view::fetch_sort_index(const std::vector<int>& in_path) {
+    if (max_sort_indexes == 0)
+        return nullptr;
+
+    auto now = time(0);
+
+    device_tracker_view_sort_index *index = nullptr;
+
+    for (const auto& si : sort_indexes) {
+        if (si->get_path() == in_path) {
+            index = si.get();
+            break;
+        }
+    }
+
+    if (index == nullptr) {
+        if (sort_indexes.size() >= max_sort_indexes) {
+            auto lru = std::min_element(sort_indexes.begin(), sort_indexes.end(),
+                    [](const std::unique_ptr<device_tracker_view_sort_index>& a,
+                        const std::unique_ptr<device_tracker_view_sort_index>& b) {
+                        return a->get_last_used() < b->get_last_used();
+                    });
+            sort_indexes.erase(lru);
+        }
+
+        sort_indexes.push_back(std::unique_ptr<device_tracker_view_sort_index>(new device_tracker_view_sort_index(in_path)));
+        index = sort_indexes.back().get();
+    }
+
+    // Fields can drift between rebuilds; checking needs a current order
+    if (check_sort_indexes)
+        index->invalidate();
+
+    index->refresh(device_list, devicetracker->get_mod_time_index(), now);
+
+    if (!index->is_usable())
+        return nullptr;
+
+    return index;
+}
+
+bool device_tracker_view::check_sort_index(device_tracker_view_sort_index *index, 
+        const std::vector<int>& in_path, unsigned int in_order_direction) {
+    if (index->size() != device_list->size())
+        return false;
+
+    shared_tracker_element prev;
+    bool sorted = true;
+
+    index->for_each_window(in_order_direction == 0, 0, 0,
+            [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                if (prev != nullptr && device_view_order_less(in_path, in_order_direction, dev, prev))
+                    sorted = false;
+                prev = dev;
+            });
+
+    return sorted;
+}
+
+void device_tracker_view::sort_index_add(const std::shared_ptr<kis_tracked_device_base>& device) {
+    for (const auto& si : sort_indexes)
+        si->add_device(device);
+}
+
+void device_tracker_view::sort_index_remove(const std::shared_ptr<kis_tracked_device_base>& device) {
+    for (const auto& si : sort_indexes)
+        si->remove_device(device);
+}
+
 void device_tracker_view::remove_device_direct(std::shared_ptr<kis_tracked_device_base> device) {
     kis_lock_guard<kis_mutex> lk(devicetracker->get_devicelist_mutex());
 
@@ -455,6 +634,7 @@ void device_tracker_view::remove_device_direct(std::shared_ptr<kis_tracked_devic
 
     if (di != device_presence_map.end()) {
         device_presence_map.erase(di);
+        sort_index_remove(device);
 
         for (auto vi = device_list->begin(); vi != device_list->end(); ++vi) {
             if (*vi == device) {
@@ -481,15 +661,17 @@ device_tracker_view::device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_co
         ts = tv;
     }
 
-    auto worker = 
-        device_tracker_view_function_worker([&](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
-                if (dev->get_last_time() < ts)
-                    return false;
+    // Walk only the devices seen since the timestamp and keep the ones in this view
+    kis_lock_guard<kis_mutex> lk(devicetracker->get_devicelist_mutex(), "device_tracker_view device_time_endpoint");
 
-                return true;
-                });
+    devicetracker->get_last_time_index().for_each_after(ts - 1,
+            [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                auto pk = device_presence_map.find(dev->get_key());
+                if (pk != device_presence_map.end() && pk->second)
+                    ret->push_back(dev);
+            });
 
-    return do_device_work(worker);
+    return ret;
 }
 
 void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
@@ -656,12 +838,60 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
         os << "Invalid request: " << e.what() << "\n";
     }
 
+    // Use the maintained sort order for the column if we can
+    device_tracker_view_sort_index *sort_index = nullptr;
+    if (in_order_column_num.length() && order_field.size() > 0) {
+        sort_index = fetch_sort_index(order_field);
+
+        if (sort_index != nullptr && check_sort_indexes && 
+                !check_sort_index(sort_index, order_field, in_order_direction)) {
+            _MSG_ERROR("Device view {} sort index for column {} does not match the per-request "
+                    "sort order; sorting the request instead.", get_view_id(), in_order_column_num);
+            sort_index = nullptr;
+        }
+    }
+
+    // Without any filtering, the page comes straight from the sort order
+    if (sort_index != nullptr && timestamp_min <= 0 && search_term.length() == 0 && regex.isNull()) {
+        total_sz_elem->set(sort_index->size());
+        filtered_sz_elem->set(sort_index->size());
+
+        if (in_window_start >= sort_index->size())
+            in_window_start = 0;
+
+        start_elem->set(in_window_start);
+
+        sort_index->for_each_window(in_order_direction == 0, in_window_start, in_window_len,
+                [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                    output_devices_elem->push_back(summarize_tracker_element(dev, summary_vec, rename_map));
+                });
+
+        length_elem->set(output_devices_elem->size());
+
+        if (transmit == nullptr)
+            transmit = output_devices_elem;
+
+        Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), os, transmit, rename_map);
+
+        return;
+    }
+
     // Next vector we do work on
     auto next_work_vec = std::make_shared<tracker_element_vector>();
 
     // Copy the entire vector list, under lock, to the next work vector; this makes it an independent copy
-    // we can sort and manipulate
-    next_work_vec->set(device_list->begin(), device_list->end());
+    // we can sort and manipulate; when we have a sort order for the column, copy in that order
+    // and the filters below keep it
+    if (sort_index != nullptr) {
+        next_work_vec->reserve(sort_index->size());
+        sort_index->for_each_window(in_order_direction == 0, 0, 0,
+                [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                    next_work_vec->push_back(dev);
+                });
+    } else {
+        next_work_vec->set(device_list->begin(), device_list->end());
+    }
+
     total_sz_elem->set(next_work_vec->size());
 
     // If we have a time filter, apply that first, it's the fastest.
@@ -682,8 +912,26 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
     if (search_term.length() > 0 && search_paths.size() > 0) {
         auto worker =
             device_tracker_view_icasestringmatch_worker(search_term, search_paths);
-        auto s_vec = do_readonly_device_work(worker, next_work_vec);
-        next_work_vec->set(s_vec->begin(), s_vec->end());
+
+        // Only match the devices the search index finds, if it can answer this search
+        auto candidates = robin_hood::unordered_flat_set<uint64_t>{};
+
+        if (devicetracker->search_index_candidates(search_term, search_paths, candidates)) {
+            auto s_vec = std::make_shared<tracker_element_vector>();
+
+            for (const auto& v : *next_work_vec) {
+                auto dev = std::static_pointer_cast<kis_tracked_device_base>(v);
+
+                if (candidates.find(dev->get_kis_internal_id()) != candidates.end() &&
+                        worker.match_device(dev))
+                    s_vec->push_back(dev);
+            }
+
+            next_work_vec = s_vec;
+        } else {
+            auto s_vec = do_readonly_device_work(worker, next_work_vec);
+            next_work_vec->set(s_vec->begin(), s_vec->end());
+        }
     }
 
     // Apply a regex filter
@@ -721,26 +969,11 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
     // Update the end
     length_elem->set(ei - si);
 
-    if (in_order_column_num.length() && order_field.size() > 0) {
+    if (sort_index == nullptr && in_order_column_num.length() && order_field.size() > 0) {
         std::stable_sort(next_work_vec->begin(), next_work_vec->end(),
-                [&](shared_tracker_element a, shared_tracker_element b) -> bool {
-                shared_tracker_element fa;
-                shared_tracker_element fb;
-
-                fa = get_tracker_element_path(order_field, a);
-                fb = get_tracker_element_path(order_field, b);
-
-                if (fa == nullptr) 
-                    return in_order_direction == 0;
-
-                if (fb == nullptr)
-                    return in_order_direction != 0;
-
-                if (in_order_direction == 0)
-                    return fast_sort_tracker_element_less(fa, fb);
-
-                return fast_sort_tracker_element_less(fb, fa);
-            });
+                [&](const shared_tracker_element& a, const shared_tracker_element& b) -> bool {
+                    return device_view_order_less(order_field, in_order_direction, a, b);
+                });
     }
 
     // Summarize into the output element
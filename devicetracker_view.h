@@ -29,6 +29,7 @@
 #include "trackedcomponent.h"
 #include "devicetracker_component.h"
 #include "devicetracker_view_workers.h"
+#include "devicetracker_view_sort.h"
 #include "kis_net_beast_httpd.h"
 
 // Common view holder mechanism which handles view endpoints, view filtering, and so on.
@@ -141,6 +142,27 @@ protected:
     // Map of device presence in our list for fast reference during updates
     std::unordered_map<device_key, bool> device_presence_map;
 
+    // Sort orders for paged requests, created on demand for each field requested as 
+    // the sort column; the least recently used is discarded past the maximum
+    std::vector<std::unique_ptr<device_tracker_view_sort_index>> sort_indexes;
+    size_t max_sort_indexes;
+
+    // Compare every indexed page against the per-request sort order
+    bool check_sort_indexes;
+
+    // Smallest number of devices worth handing to another thread in read-only work
+    static constexpr size_t parallel_min_partition = 4096;
+
+    // Get a current sort index for a field, or nullptr if it can't be indexed
+    device_tracker_view_sort_index *fetch_sort_index(const std::vector<int>& in_path);
+
+    // True if the index is in the order the per-request sort would produce
+    bool check_sort_index(device_tracker_view_sort_index *index, const std::vector<int>& in_path, 
+            unsigned int in_order_direction);
+
+    void sort_index_add(const std::shared_ptr<kis_tracked_device_base>& device);
+    void sort_index_remove(const std::shared_ptr<kis_tracked_device_base>& device);
+
     void device_endpoint_handler(std::shared_ptr<kis_net_beast_httpd_connection> con);
     std::shared_ptr<tracker_element> device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con);
 
@@ -0,0 +1,255 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include "alphanum.hpp"
+#include "devicetracker_view_sort.h"
+
+bool device_tracker_view_sort_index::sort_key::operator==(const sort_key& rhs) const {
+    if (kind != rhs.kind)
+        return false;
+
+    switch (kind) {
+        case key_kind::missing:
+            return true;
+        case key_kind::sint:
+            return i == rhs.i;
+        case key_kind::uint:
+            return u == rhs.u;
+        case key_kind::dbl:
+            return d == rhs.d;
+        case key_kind::str:
+            return s == rhs.s;
+    }
+
+    return false;
+}
+
+bool device_tracker_view_sort_index::sort_key::operator<(const sort_key& rhs) const {
+    // Missing fields sort first
+    if (rhs.kind == key_kind::missing)
+        return false;
+    if (kind == key_kind::missing)
+        return true;
+
+    // One field always produces the same kind of key, this only keeps the ordering
+    // strict if it somehow doesn't
+    if (kind != rhs.kind)
+        return kind < rhs.kind;
+
+    switch (kind) {
+        case key_kind::sint:
+            return i < rhs.i;
+        case key_kind::uint:
+            return u < rhs.u;
+        case key_kind::dbl:
+            return d < rhs.d;
+        case key_kind::str:
+            return doj::alphanum_comp(s, rhs.s) < 0;
+        default:
+            return false;
+    }
+}
+
+device_tracker_view_sort_index::device_tracker_view_sort_index(const std::vector<int>& in_path) :
+    path{in_path},
+    usable{true},
+    last_rebuild{0},
+    last_refresh{0},
+    last_used{0} { }
+
+bool device_tracker_view_sort_index::make_key(const std::shared_ptr<kis_tracked_device_base>& device,
+        sort_key& key) {
+    auto e = get_tracker_element_path(path, device);
+
+    key.s.clear();
+
+    if (e == nullptr) {
+        key.kind = sort_key::key_kind::missing;
+        key.u = 0;
+        return true;
+    }
+
+    switch (e->get_type()) {
+        case tracker_type::tracker_string:
+            key.kind = sort_key::key_kind::str;
+            key.u = 0;
+            key.s = std::static_pointer_cast<tracker_element_string>(e)->get();
+            return true;
+        case tracker_type::tracker_int8:
+            key.kind = sort_key::key_kind::sint;
+            key.i = std::static_pointer_cast<tracker_element_int8>(e)->get();
+            return true;
+        case tracker_type::tracker_int16:
+            key.kind = sort_key::key_kind::sint;
+            key.i = std::static_pointer_cast<tracker_element_int16>(e)->get();
+            return true;
+        case tracker_type::tracker_int32:
+            key.kind = sort_key::key_kind::sint;
+            key.i = std::static_pointer_cast<tracker_element_int32>(e)->get();
+            return true;
+        case tracker_type::tracker_int64:
+            key.kind = sort_key::key_kind::sint;
+            key.i = std::static_pointer_cast<tracker_element_int64>(e)->get();
+            return true;
+        case tracker_type::tracker_uint8:
+            key.kind = sort_key::key_kind::uint;
+            key.u = std::static_pointer_cast<tracker_element_uint8>(e)->get();
+            return true;
+        case tracker_type::tracker_uint16:
+            key.kind = sort_key::key_kind::uint;
+            key.u = std::static_pointer_cast<tracker_element_uint16>(e)->get();
+            return true;
+        case tracker_type::tracker_uint32:
+            key.kind = sort_key::key_kind::uint;
+            key.u = std::static_pointer_cast<tracker_element_uint32>(e)->get();
+            return true;
+        case tracker_type::tracker_uint64:
+            key.kind = sort_key::key_kind::uint;
+            key.u = std::static_pointer_cast<tracker_element_uint64>(e)->get();
+            return true;
+        case tracker_type::tracker_float:
+            key.kind = sort_key::key_kind::dbl;
+            key.d = std::static_pointer_cast<tracker_element_float>(e)->get();
+            return true;
+        case tracker_type::tracker_double:
+            key.kind = sort_key::key_kind::dbl;
+            key.d = std::static_pointer_cast<tracker_element_double>(e)->get();
+            return true;
+        default:
+            return false;
+    }
+}
+
+void device_tracker_view_sort_index::insert_device(const std::shared_ptr<kis_tracked_device_base>& device) {
+    sort_entry entry;
+
+    if (!make_key(device, entry.key)) {
+        usable = false;
+        return;
+    }
+
+    auto id = device->get_kis_internal_id();
+
+    entry.id = id;
+    entry.device = device;
+
+    positions[id] = order.insert(std::move(entry)).first;
+}
+
+void device_tracker_view_sort_index::rebuild(const std::shared_ptr<tracker_element_vector>& devices,
+        time_t now) {
+    order.clear();
+    positions.clear();
+
+    positions.reserve(devices->size());
+
+    for (const auto& d : *devices) {
+        if (d == nullptr)
+            continue;
+
+        insert_device(std::static_pointer_cast<kis_tracked_device_base>(d));
+
+        if (!usable)
+            break;
+    }
+
+    if (!usable) {
+        order.clear();
+        positions.clear();
+    }
+
+    last_rebuild = now;
+    last_refresh = now;
+}
+
+void device_tracker_view_sort_index::refresh(const std::shared_ptr<tracker_element_vector>& devices,
+        const device_time_index& mod_index, time_t now) {
+    if (!usable)
+        return;
+
+    last_used = now;
+
+    if (now - last_rebuild > rebuild_interval || now < last_rebuild) {
+        rebuild(devices, now);
+        return;
+    }
+
+    // Modification times are in seconds, so re-check anything modified during the
+    // second of the last refresh
+    sort_key key;
+
+    mod_index.for_each_after(last_refresh - 1, 
+            [&](const std::shared_ptr<kis_tracked_device_base>& dev) {
+                if (!usable)
+                    return;
+
+                auto pi = positions.find(dev->get_kis_internal_id());
+
+                // Not in this view
+                if (pi == positions.end())
+                    return;
+
+                if (!make_key(dev, key)) {
+                    usable = false;
+                    return;
+                }
+
+                if (key == pi->second->key)
+                    return;
+
+                order.erase(pi->second);
+                positions.erase(pi);
+
+                insert_device(dev);
+            });
+
+    if (!usable) {
+        order.clear();
+        positions.clear();
+    }
+
+    last_refresh = now;
+}
+
+void device_tracker_view_sort_index::add_device(const std::shared_ptr<kis_tracked_device_base>& device) {
+    if (!usable || last_rebuild == 0)
+        return;
+
+    if (positions.find(device->get_kis_internal_id()) != positions.end())
+        return;
+
+    insert_device(device);
+
+    if (!usable) {
+        order.clear();
+        positions.clear();
+    }
+}
+
+void device_tracker_view_sort_index::remove_device(const std::shared_ptr<kis_tracked_device_base>& device) {
+    auto pi = positions.find(device->get_kis_internal_id());
+
+    if (pi == positions.end())
+        return;
+
+    order.erase(pi->second);
+    positions.erase(pi);
+}
+
@@ -0,0 +1,168 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICETRACKER_VIEW_SORT_H__
+#define __DEVICETRACKER_VIEW_SORT_H__
+
+#include "config.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <time.h>
+
+#include "devicetracker_component.h"
+#include "devicetracker_time_index.h"
+#include "robin_hood.h"
+
+// Maintained sort order of the devices in a view, by one field
+//
+// Paged device requests sort the view by one column and return a small window of it;
+// sorting the entire view for every page is the majority of the cost of serving a 
+// large view.  A sort index keeps the devices of the view ordered by a snapshot of the
+// sort field, and only re-keys the devices which have changed since the last request,
+// found through the device modification time index.
+//
+// Fields which change without the device being modified would drift, so the index
+// is rebuilt entirely when it is older than the rebuild interval.
+//
+// Only string and numeric fields can be indexed; other field types are sorted per
+// request as before.
+//
+// Sort indexes are maintained and used under the devicelist mutex.
+class device_tracker_view_sort_index {
+public:
+    device_tracker_view_sort_index(const std::vector<int>& in_path);
+
+    const std::vector<int>& get_path() const {
+        return path;
+    }
+
+    // False if the field can't be indexed, and should be sorted per request
+    bool is_usable() const {
+        return usable;
+    }
+
+    // Bring the order up to date; the full device list of the view is only used when
+    // the index needs to be rebuilt
+    void refresh(const std::shared_ptr<tracker_element_vector>& devices, 
+            const device_time_index& mod_index, time_t now);
+
+    // Track view membership changes
+    void add_device(const std::shared_ptr<kis_tracked_device_base>& device);
+    void remove_device(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    // Call fn for up to in_len devices in sort order after skipping in_start devices;
+    // an in_len of 0 continues to the end of the list.  Ascending order has devices
+    // missing the field first, descending has them last.
+    template<typename F>
+    void for_each_window(bool ascending, size_t in_start, size_t in_len, F fn) const {
+        if (ascending)
+            window(order.begin(), order.end(), in_start, in_len, fn);
+        else
+            window(order.rbegin(), order.rend(), in_start, in_len, fn);
+    }
+
+    size_t size() const {
+        return order.size();
+    }
+
+    time_t get_last_used() const {
+        return last_used;
+    }
+
+    // Re-key every device on the next refresh
+    void invalidate() {
+        last_rebuild = 0;
+    }
+
+    static constexpr time_t rebuild_interval = 60;
+
+protected:
+    // Snapshot of the sort field; devices missing the field sort before all others
+    struct sort_key {
+        enum class key_kind : uint8_t {
+            missing, sint, uint, dbl, str
+        };
+
+        sort_key() :
+            kind{key_kind::missing},
+            u{0} { }
+
+        bool operator==(const sort_key& rhs) const;
+        bool operator<(const sort_key& rhs) const;
+
+        key_kind kind;
+
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+        };
+
+        std::string s;
+    };
+
+    struct sort_entry {
+        sort_key key;
+        uint64_t id;
+        std::shared_ptr<kis_tracked_device_base> device;
+
+        bool operator<(const sort_entry& rhs) const {
+            if (key < rhs.key)
+                return true;
+            if (rhs.key < key)
+                return false;
+            return id < rhs.id;
+        }
+    };
+
+    using order_set = std::set<sort_entry>;
+
+    template<typename I, typename F>
+    static void window(I begin, I end, size_t in_start, size_t in_len, F fn) {
+        auto i = begin;
+
+        for (size_t n = 0; n < in_start && i != end; n++)
+            ++i;
+
+        for (size_t n = 0; i != end && (in_len == 0 || n < in_len); ++i, n++)
+            fn(i->device);
+    }
+
+    // Fills in the key; returns false if the field is a type we can't index
+    bool make_key(const std::shared_ptr<kis_tracked_device_base>& device, sort_key& key);
+
+    void insert_device(const std::shared_ptr<kis_tracked_device_base>& device);
+
+    void rebuild(const std::shared_ptr<tracker_element_vector>& devices, time_t now);
+
+    std::vector<int> path;
+    bool usable;
+
+    order_set order;
+    robin_hood::unordered_node_map<uint64_t, order_set::iterator> positions;
+
+    time_t last_rebuild;
+    time_t last_refresh;
+    time_t last_used;
+};
+
+#endif
+
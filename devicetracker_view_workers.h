@@ -41,6 +41,13 @@ public:
     virtual ~device_tracker_view_worker() { }
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) = 0;
+
+    // Workers which only read the device and keep no state of their own in match_device
+    // may be run across several threads by read-only device work
+    virtual bool parallel_safe() const {
+        return false;
+    }
+
     virtual std::shared_ptr<tracker_element_vector> getMatchedDevices() {
         return matched;
     }
@@ -109,6 +116,10 @@ public:
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) override;
 
+    virtual bool parallel_safe() const override {
+        return true;
+    }
+
 protected:
     std::vector<std::shared_ptr<device_tracker_view_regex_worker::pcre_filter>> filter_vec;
 
@@ -133,6 +144,10 @@ public:
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) override;
 
+    virtual bool parallel_safe() const override {
+        return true;
+    }
+
 protected:
     std::string query;
     std::vector<std::vector<int>> fieldpaths;
@@ -160,6 +175,10 @@ public:
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) override;
 
+    virtual bool parallel_safe() const override {
+        return true;
+    }
+
 protected:
     std::string query;
     std::vector<std::vector<int>> fieldpaths;
@@ -35,3 +35,77 @@ void dot11_ie::dot11_ie_tag::parse(std::shared_ptr<kaitai::kstream> p_io) {
     m_tag_data_stream.reset(new kaitai::kstream(m_tag_data));
 }
 
+dot11_ie_view::dot11_ie_view(const uint8_t *in_data, size_t in_len) :
+    m_data{in_data},
+    m_end{in_data},
+    m_valid{true} {
+
+    const uint8_t *limit = in_data + in_len;
+
+    while (m_end < limit) {
+        if (limit - m_end < 2 || limit - m_end < 2 + m_end[1]) {
+            m_valid = false;
+            break;
+        }
+
+        m_end += 2 + m_end[1];
+    }
+}
+
+namespace {
+    // Read-only streambuf over the packet bytes so the kaitai parsers can run 
+    // against the original buffer without a copy
+    struct dot11_ie_view_buf : public std::streambuf {
+        dot11_ie_view_buf(const uint8_t *data, size_t len) {
+            char *begin = (char *) data;
+            setg(begin, begin, begin + len);
+        }
+
+        virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                std::ios_base::openmode which = std::ios_base::in) override {
+            char *target;
+
+            if (dir == std::ios_base::cur)
+                target = gptr() + off;
+            else if (dir == std::ios_base::end)
+                target = egptr() + off;
+            else
+                target = eback() + off;
+
+            if (target < eback() || target > egptr())
+                return pos_type(off_type(-1));
+
+            setg(eback(), target, egptr());
+
+            return pos_type(target - eback());
+        }
+
+        virtual pos_type seekpos(pos_type pos, 
+                std::ios_base::openmode which = std::ios_base::in) override {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    // The buffer, istream, and kaitai stream live in one allocation; the
+    // returned stream pointer aliases the holder
+    struct dot11_ie_view_stream {
+        dot11_ie_view_stream(const uint8_t *data, size_t len) :
+            buf{data, len},
+            istream{&buf},
+            stream{&istream} { }
+
+        dot11_ie_view_buf buf;
+        std::istream istream;
+        kaitai::kstream stream;
+    };
+}
+
+std::shared_ptr<kaitai::kstream> dot11_ie_view::dot11_ie_view_tag::tag_data_stream() const {
+    if (m_tag_data_stream == nullptr) {
+        auto holder = std::make_shared<dot11_ie_view_stream>(tag_bytes(), tag_len());
+        m_tag_data_stream = std::shared_ptr<kaitai::kstream>(holder, &holder->stream);
+    }
+
+    return m_tag_data_stream;
+}
+
@@ -33,6 +33,7 @@
 #include <vector>
 #include <kaitai/kaitaistream.h>
 #include "multi_constexpr.h"
+#include "string_view.hpp"
 
 class dot11_ie {
 public:
@@ -72,7 +73,7 @@ public:
             return m_tag_len;
         }
 
-        std::string tag_data() const {
+        const std::string& tag_data() const {
             return m_tag_data;
         }
 
@@ -89,6 +90,95 @@ public:
 
 };
 
+/* Zero-copy view of an IE tag block.
+ *
+ * The view walks the tag headers in place in the original packet buffer;
+ * no tag data is copied and nothing is allocated unless a tag-specific
+ * parser needs a kaitai stream, which is then built directly over the 
+ * packet bytes.  The buffer must outlive the view and any streams taken
+ * from it.
+ *
+ * Iteration only covers complete tags; valid() reports if the block ended
+ * with a truncated tag, which the kaitai parser would have thrown on.
+ */
+class dot11_ie_view {
+public:
+    class dot11_ie_view_tag {
+    public:
+        dot11_ie_view_tag(const uint8_t *in_tag) :
+            m_tag{in_tag} { }
+
+        constexpr17 uint8_t tag_num() const {
+            return m_tag[0];
+        }
+
+        constexpr17 uint8_t tag_len() const {
+            return m_tag[1];
+        }
+
+        const uint8_t *tag_bytes() const {
+            return m_tag + 2;
+        }
+
+        nonstd::string_view tag_data() const {
+            return nonstd::string_view((const char *) m_tag + 2, m_tag[1]);
+        }
+
+        // Kaitai stream over the tag payload, for the parsers in dot11_parsers/;
+        // built on first use and shared by later calls on the same tag
+        std::shared_ptr<kaitai::kstream> tag_data_stream() const;
+
+    protected:
+        const uint8_t *m_tag;
+        mutable std::shared_ptr<kaitai::kstream> m_tag_data_stream;
+    };
+
+    class iterator {
+    public:
+        iterator(const uint8_t *in_pos) :
+            m_pos{in_pos} { }
+
+        dot11_ie_view_tag operator*() const {
+            return dot11_ie_view_tag(m_pos);
+        }
+
+        iterator& operator++() {
+            m_pos += 2 + m_pos[1];
+            return *this;
+        }
+
+        bool operator==(const iterator& i) const {
+            return m_pos == i.m_pos;
+        }
+
+        bool operator!=(const iterator& i) const {
+            return m_pos != i.m_pos;
+        }
+
+    protected:
+        const uint8_t *m_pos;
+    };
+
+    dot11_ie_view(const uint8_t *in_data, size_t in_len);
+
+    bool valid() const {
+        return m_valid;
+    }
+
+    iterator begin() const {
+        return iterator(m_data);
+    }
+
+    iterator end() const {
+        return iterator(m_end);
+    }
+
+protected:
+    const uint8_t *m_data;
+    const uint8_t *m_end;
+    bool m_valid;
+};
+
 
 #endif
 
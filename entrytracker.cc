@@ -186,6 +186,25 @@ std::string entry_tracker::get_field_description(int in_id) {
     return iter->second->field_description;
 }
 
+void entry_tracker::get_field_names(std::vector<std::string>& names, 
+        std::vector<std::string>& descriptions) {
+    kis_lock_guard<kis_mutex> lk(entry_mutex, "entry_tracker get_field_names");
+
+    names.clear();
+    descriptions.clear();
+
+    names.resize(next_field_num, "field.unknown.not.registered");
+    descriptions.resize(next_field_num, "untracked field, description not available");
+
+    for (const auto& f : field_id_map) {
+        if (f.first < 0 || f.first >= next_field_num)
+            continue;
+
+        names[f.first] = f.second->field_name;
+        descriptions[f.first] = f.second->field_description;
+    }
+}
+
 std::shared_ptr<tracker_element> entry_tracker::get_shared_instance(int in_id) {
     kis_unique_lock<kis_mutex> lock(entry_mutex, std::defer_lock, "entry_tracker get_shared_instance id");
 
@@ -304,6 +323,27 @@ void entry_tracker::remove_search_xform(int in_field_id) {
     return;
 }
 
+bool entry_tracker::is_text_searchable(int in_field_id) {
+    kis_lock_guard<kis_mutex> lk(entry_mutex, "entry_tracker is_text_searchable");
+
+    if (search_xform_map.find(in_field_id) != search_xform_map.end())
+        return true;
+
+    auto iter = field_id_map.find(in_field_id);
+
+    if (iter == field_id_map.end())
+        return true;
+
+    switch (iter->second->builder->get_type()) {
+        case tracker_type::tracker_string:
+        case tracker_type::tracker_byte_array:
+        case tracker_type::tracker_mac_addr:
+            return true;
+        default:
+            return false;
+    }
+}
+
 bool entry_tracker::search_xform(std::shared_ptr<tracker_element> elem, std::string& mapped_str) {
     kis_unique_lock<kis_mutex> lk(entry_mutex, std::defer_lock, "entry_tracker search_xform");
 
@@ -92,6 +92,10 @@ public:
     std::string get_field_name(int in_id);
     std::string get_field_description(int in_id);
 
+    // Copy every field name and description, indexed by field id, in a single lock; used by
+    // serializers to build their own lock-free name tables
+    void get_field_names(std::vector<std::string>& names, std::vector<std::string>& descriptions);
+
     // Generate a shared field instance, using the builder
     template<class T> std::shared_ptr<T> get_shared_instance_as(const std::string& in_name) {
         return std::static_pointer_cast<T>(get_shared_instance(in_name));
@@ -122,6 +126,9 @@ public:
     // Apply a search transform to a field, returning 'true' if the field was transformable, 
     // and placing the results in mapped_str
     bool search_xform(std::shared_ptr<tracker_element> elem, std::string& mapped_str);
+    // Returns 'true' if a field could match a text search; string, binary, and MAC address
+    // fields, and any field with a search transform.  Unknown fields are assumed searchable.
+    bool is_text_searchable(int in_field_id);
 
 protected:
     kis_mutex entry_mutex;
@@ -54,7 +54,7 @@ gps_tracker::gps_tracker() :
 
     // Register the packet chain hook
     Globalreg::globalreg->packetchain->register_handler(&kis_gpspack_hook, this,
-            CHAINPOS_POSTCAP, -100);
+            CHAINPOS_POSTCAP, -100, "gps");
 
     gps_prototypes_vec = std::make_shared<tracker_element_vector>();
     gps_instances_vec = std::make_shared<tracker_element_vector>();
@@ -395,6 +395,17 @@ std::shared_ptr<kis_gps> gps_tracker::find_gps(uuid in_uuid) {
 }
 
 kis_gps_packinfo *gps_tracker::get_best_location() {
+    auto pi = new kis_gps_packinfo();
+
+    if (!get_best_location(pi)) {
+        delete pi;
+        return NULL;
+    }
+
+    return pi;
+}
+
+bool gps_tracker::get_best_location(kis_gps_packinfo *in_pi) {
     kis_lock_guard<kis_mutex> lk(gpsmanager_mutex, "get_best_location");
 
     // Iterate 
@@ -405,16 +416,16 @@ kis_gps_packinfo *gps_tracker::get_best_location() {
             continue;
 
         if (gps->get_location_valid()) {
-            kis_gps_packinfo *pi = new kis_gps_packinfo(gps->get_location().get());
+            in_pi->copy_location(gps->get_location().get());
 
-            pi->gpsuuid = gps->get_gps_uuid();
-            pi->gpsname  = gps->get_gps_name();
+            in_pi->gpsuuid = gps->get_gps_uuid();
+            in_pi->gpsname  = gps->get_gps_name();
 
-            return pi;
+            return true;
         }
     }
 
-    return NULL;
+    return false;
 }
 
 int gps_tracker::kis_gpspack_hook(CHAINCALL_PARMS) {
@@ -431,10 +442,12 @@ int gps_tracker::kis_gpspack_hook(CHAINCALL_PARMS) {
     if (in_pack->fetch(gpstracker->pack_comp_no_gps) != NULL)
         return 1;
 
-    kis_gps_packinfo *gpsloc = gpstracker->get_best_location();
+    auto gpsloc = packet_component_pool<kis_gps_packinfo>::acquire();
 
-    if (gpsloc == NULL)
+    if (!gpstracker->get_best_location(gpsloc)) {
+        release_packet_component(gpsloc);
         return 0;
+    }
 
     // Insert into chain; we were given a new location
     in_pack->insert(gpstracker->pack_comp_gps, gpsloc);
@@ -49,7 +49,18 @@ class kis_gps_packinfo : public packet_component {
 public:
     kis_gps_packinfo() {
         self_destruct = 1;
+        reset();
+    }
+
+    kis_gps_packinfo(kis_gps_packinfo *src) {
+        if (src != NULL) {
+            self_destruct = src->self_destruct;
+            copy_location(src);
+        }
+    }
 
+    // Return to the freshly constructed state for reuse by a packet_component_pool
+    void reset() {
         merge_partial = false;
         merge_flags = 0;
 
@@ -61,27 +72,26 @@ public:
         error_x = 0;
         error_y = 0;
         error_v = 0;
-    }
 
-    kis_gps_packinfo(kis_gps_packinfo *src) {
-        if (src != NULL) {
-            self_destruct = src->self_destruct;
+        gpsuuid = uuid();
+        gpsname.clear();
+    }
 
-            merge_partial = src->merge_partial;
-            merge_flags = src->merge_flags;
-
-            lat = src->lat;
-            lon = src->lon;
-            alt = src->alt;
-            speed = src->speed;
-            heading = src->heading;
-            precision = src->precision;
-            fix = src->fix;
-            tv.tv_sec = src->tv.tv_sec;
-            tv.tv_usec = src->tv.tv_usec;
-            gpsuuid = src->gpsuuid;
-            gpsname = src->gpsname;
-        }
+    void copy_location(const kis_gps_packinfo *src) {
+        merge_partial = src->merge_partial;
+        merge_flags = src->merge_flags;
+
+        lat = src->lat;
+        lon = src->lon;
+        alt = src->alt;
+        speed = src->speed;
+        heading = src->heading;
+        precision = src->precision;
+        fix = src->fix;
+        tv.tv_sec = src->tv.tv_sec;
+        tv.tv_usec = src->tv.tv_usec;
+        gpsuuid = src->gpsuuid;
+        gpsname = src->gpsname;
     }
 
     std::shared_ptr<kis_tracked_location_full> as_tracked_full() {
@@ -179,6 +189,10 @@ public:
     // responsible for deleting.
     kis_gps_packinfo *get_best_location();
 
+    // Copy the 'best' location into an existing record; returns false if no GPS
+    // has a valid location
+    bool get_best_location(kis_gps_packinfo *in_pi);
+
     // Populate packets that don't have a GPS location
     static int kis_gpspack_hook(CHAINCALL_PARMS);
 
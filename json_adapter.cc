@@ -27,6 +27,7 @@
 #include <string>
 #include <math.h>
 #include <cmath>
+#include <mutex>
 
 #include "globalregistry.h"
 #include "trackedelement.h"
@@ -35,6 +36,7 @@
 #include "uuid.h"
 #include "devicetracker_component.h"
 #include "json_adapter.h"
+#include "endian_magic.h"
 
 /* sanitize_extra_space and sanitize_string taken from nlohmann's jsonhpp library,
    Copyright 2013-2015 Niels Lohmann. and under the MIT license */
@@ -162,517 +164,716 @@ std::string json_adapter::sanitize_string(const std::string& s) noexcept {
     return result;
 }
 
-void json_adapter::pack(std::ostream &stream, shared_tracker_element e, 
-        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
-        bool prettyprint, unsigned int depth,
-        std::function<std::string (const std::string&)> name_permuter) {
+namespace {
 
-    std::string indent;
-    std::string ppendl;
+// Field names, ELK-style names, and descriptions indexed by field id.  Names and descriptions
+// are pre-escaped for JSON; the raw names are kept for custom name permuters.  The table is
+// rebuilt from the entrytracker when a field newer than the table is serialized.
+struct json_field_table {
+    std::vector<std::string> raw_names;
+    std::vector<std::string> names;
+    std::vector<std::string> ek_names;
+    std::vector<std::string> descriptions;
+};
 
-    if (e == nullptr) {
-        return;
-    }
-    
-    if (prettyprint) {
-        indent = std::string(depth, ' ');
-        ppendl = "\r\n";
-    }
+std::shared_ptr<const json_field_table> field_table;
+std::mutex field_table_mutex;
 
-    serializer_scope s(e, name_map);
-    
-    uuid euuid;
+std::shared_ptr<const json_field_table> get_field_table(int min_id) {
+    auto table = std::atomic_load(&field_table);
 
-    std::string tname;
+    if (table != nullptr && min_id < (int) table->names.size())
+        return table;
 
-    bool prepend_comma = false;
+    std::lock_guard<std::mutex> lk(field_table_mutex);
 
-    bool as_vector, as_key_vector;
+    table = std::atomic_load(&field_table);
+    if (table != nullptr && min_id < (int) table->names.size())
+        return table;
 
-    float_numerical_string<double> dblstr;
+    auto new_table = std::make_shared<json_field_table>();
+    std::vector<std::string> raw_descriptions;
 
-    // If we're serializing an alias, remap as the aliased element
-    if (e->get_type() == tracker_type::tracker_alias) {
-        e = std::static_pointer_cast<tracker_element_alias>(e)->get();
+    Globalreg::globalreg->entrytracker->get_field_names(new_table->raw_names, raw_descriptions);
 
-        if (e == nullptr) {
-            return;
-        }
-    }
+    new_table->names.reserve(new_table->raw_names.size());
+    new_table->ek_names.reserve(new_table->raw_names.size());
+    new_table->descriptions.reserve(raw_descriptions.size());
 
-    if (e->is_stringable()) {
-        if (e->needs_quotes())
-            stream << "\"" << sanitize_string(e->as_string()) << "\"";
-        else
-            stream << sanitize_string(e->as_string());
-    } else {
-        switch (e->get_type()) {
-            case tracker_type::tracker_vector:
-                stream << ppendl << indent << "[" << ppendl;
+    for (const auto& n : new_table->raw_names) {
+        new_table->names.push_back(json_adapter::sanitize_string(n));
 
-                prepend_comma = false;
+        auto ek = n;
+        std::replace(ek.begin(), ek.end(), '.', '_');
+        new_table->ek_names.push_back(json_adapter::sanitize_string(ek));
+    }
 
-                for (auto i : *(std::static_pointer_cast<tracker_element_vector>(e))) {
-                    if (i == NULL)
-                        continue;
+    for (const auto& d : raw_descriptions)
+        new_table->descriptions.push_back(json_adapter::sanitize_string(d));
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+    std::atomic_store(&field_table, std::shared_ptr<const json_field_table>(new_table));
 
-                    if (prettyprint)
-                        stream << indent;
+    return new_table;
+}
 
-                    json_adapter::pack(stream, i, name_map, prettyprint, depth + 1, name_permuter);
-                }
-                stream << ppendl << indent << "]";
-                break;
-            case tracker_type::tracker_vector_double:
-                stream << ppendl << indent << "[" << ppendl;
+// Output is formatted into a memory buffer and handed to the stream in large blocks
+const size_t pack_flush_size = 65536;
+
+enum class pack_names {
+    plain, ek, permuted
+};
+
+struct pack_context {
+    pack_context(std::ostream& stream, 
+            std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+            bool prettyprint, pack_names name_mode, 
+            const std::function<std::string (const std::string&)> *name_permuter) :
+        stream{stream},
+        name_map{name_map},
+        prettyprint{prettyprint},
+        name_mode{name_mode},
+        name_permuter{name_permuter},
+        fields{get_field_table(0)} { }
+
+    ~pack_context() {
+        flush();
+    }
 
-                prepend_comma = false;
+    void flush() {
+        if (buf.size() == 0)
+            return;
 
-                for (auto i : *(std::static_pointer_cast<tracker_element_vector_double>(e))) {
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+        stream.write(buf.data(), buf.size());
+        buf.resize(0);
+    }
 
-                    if (prettyprint)
-                        stream << indent;
+    std::ostream& stream;
+    fmt::memory_buffer buf;
 
-                    if (std::isnan(i) || std::isinf(i))
-                        stream << "0";
+    std::shared_ptr<tracker_element_serializer::rename_map> name_map;
+    bool prettyprint;
+    pack_names name_mode;
+    const std::function<std::string (const std::string&)> *name_permuter;
 
-                    if (floor(i) == i)
-                        stream << fmt::format("{}", (long long) i);
-                    else
-                        stream << fmt::format("{:f}", i);
-                }
-                stream << ppendl << indent << "]";
-                break;
-            case tracker_type::tracker_vector_string:
-                stream << ppendl << indent << "[" << ppendl;
+    std::shared_ptr<const json_field_table> fields;
+};
 
-                prepend_comma = false;
+template<size_t N>
+inline void append(fmt::memory_buffer& buf, const char (&s)[N]) {
+    buf.append(s, s + N - 1);
+}
 
-                for (auto i : *(std::static_pointer_cast<tracker_element_vector_string>(e))) {
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+inline void append(fmt::memory_buffer& buf, const std::string& s) {
+    buf.append(s.data(), s.data() + s.length());
+}
 
-                    if (prettyprint)
-                        stream << indent;
+inline void append_endl(pack_context& ctx) {
+    if (ctx.prettyprint)
+        append(ctx.buf, "\r\n");
+}
 
-                    stream << i;
-                }
-                stream << ppendl << indent << "]";
-                break;
-            case tracker_type::tracker_map:
-                as_vector = std::static_pointer_cast<tracker_element_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_map>(e)->as_key_vector();
+inline void append_indent(pack_context& ctx, unsigned int depth) {
+    if (!ctx.prettyprint)
+        return;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+    for (unsigned int i = 0; i < depth; i++)
+        ctx.buf.push_back(' ');
+}
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_map>(e))) {
-                    bool named = false;
+// Escape a string directly into the output; strings with nothing to escape, which is nearly
+// all of them, are copied in one pass
+void append_sanitized(fmt::memory_buffer& buf, const char *s, size_t len) {
+    size_t start = 0;
 
-                    if (i.second == NULL)
-                        continue;
+    for (size_t i = 0; i < len; i++) {
+        const char c = s[i];
 
-                    if (prepend_comma) {
-                        stream << "," << ppendl;
+        if (c != '"' && c != '\\' && !(c >= 0x00 && c <= 0x1f))
+            continue;
 
-                        if (prettyprint)
-                            stream << ppendl;
-                    }
+        buf.append(s + start, s + i);
+        start = i + 1;
+
+        switch (c) {
+            case '"':
+                append(buf, "\\\"");
+                break;
+            case '\\':
+                append(buf, "\\\\");
+                break;
+            case '\b':
+                append(buf, "\\b");
+                break;
+            case '\f':
+                append(buf, "\\f");
+                break;
+            case '\n':
+                append(buf, "\\n");
+                break;
+            case '\r':
+                append(buf, "\\r");
+                break;
+            case '\t':
+                append(buf, "\\t");
+                break;
+            default:
+                fmt::format_to(buf, "\\u{:04x}", int(c));
+                break;
+        }
+    }
 
-                    prepend_comma = true;
+    buf.append(s + start, s + len);
+}
 
-                    if (!as_vector) {
-                        if (name_map != NULL) {
-                            tracker_element_serializer::rename_map::iterator nmi = name_map->find(i.second);
-                            if (nmi != name_map->end() && nmi->second->rename.length() != 0) {
-                                tname = nmi->second->rename;
-                                named = true;
-                            }
-                        }
+inline void append_sanitized(fmt::memory_buffer& buf, const std::string& s) {
+    append_sanitized(buf, s.data(), s.length());
+}
 
-                        if (!named) {
-                            if (i.second == NULL) {
-                                tname = Globalreg::globalreg->entrytracker->get_field_name(i.first);
-                            } else {
-                                if (i.second->get_type() == tracker_type::tracker_placeholder_missing) {
-                                    tname = std::static_pointer_cast<tracker_element_placeholder>(i.second)->get_name();
-                                } else if (i.second->get_type() == tracker_type::tracker_alias) {
-                                    tname = std::static_pointer_cast<tracker_element_alias>(i.second)->get_alias_name();
-                                } else {
-                                    tname = Globalreg::globalreg->entrytracker->get_field_name(i.first);
-                                }
-
-                                // Default to the defined name if we got a blank
-                                if (tname == "")
-                                    tname = Globalreg::globalreg->entrytracker->get_field_name(i.first);
-                            }
-                        }
+// Matches float_numerical_string
+template<typename N>
+void append_float(fmt::memory_buffer& buf, N v) {
+    if (std::isnan(v) || std::isinf(v)) {
+        append(buf, "0");
+        return;
+    }
 
-                        tname = json_adapter::sanitize_string(name_permuter(tname));
-
-                        if (prettyprint) {
-                            stream << indent << "\"description." << tname << "\": ";
-                            stream << "\"";
-                            if (i.second != nullptr) {
-                                stream << sanitize_string(i.second->get_type_as_string());
-                                stream << ", ";
-                            }
-                            stream << sanitize_string(Globalreg::globalreg->entrytracker->get_field_description(i.first));
-                            stream << "\"," << ppendl;
-                        }
+    if (floor(v) == v)
+        fmt::format_to(buf, "{}", (long long) v);
+    else
+        fmt::format_to(buf, "{:f}", v);
+}
 
-                        stream << indent << "\"" << tname << "\": ";
-                    }
+// Matches std::fixed stream output for map keys
+template<typename N>
+typename std::enable_if<std::is_floating_point<N>::value>::type
+append_fixed(fmt::memory_buffer& buf, N v) {
+    fmt::format_to(buf, "{:f}", v);
+}
 
-                    json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+template<typename N>
+typename std::enable_if<!std::is_floating_point<N>::value>::type
+append_fixed(fmt::memory_buffer& buf, N v) {
+    fmt::format_to(buf, "{}", v);
+}
 
-                }
+// Matches the stream output of device_key
+inline void append_device_key(fmt::memory_buffer& buf, const device_key& k) {
+    fmt::format_to(buf, "{:02X}_{:X}", kis_hton64(k.get_spkey()), kis_hton64(k.get_dkey()));
+}
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+template<typename T>
+inline auto scalar_value(const shared_tracker_element& e) -> decltype(static_cast<T *>(e.get())->get()) {
+    return static_cast<T *>(e.get())->get();
+}
 
-                break;
-            case tracker_type::tracker_int_map:
-                as_vector = std::static_pointer_cast<tracker_element_int_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_int_map>(e)->as_key_vector();
+void pack_scalar(pack_context& ctx, const shared_tracker_element& e) {
+    auto& buf = ctx.buf;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+    switch (e->get_type()) {
+        case tracker_type::tracker_string:
+            buf.push_back('"');
+            append_sanitized(buf, scalar_value<tracker_element_string>(e));
+            buf.push_back('"');
+            return;
+        case tracker_type::tracker_int8:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_int8>(e));
+            return;
+        case tracker_type::tracker_uint8:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_uint8>(e));
+            return;
+        case tracker_type::tracker_int16:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_int16>(e));
+            return;
+        case tracker_type::tracker_uint16:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_uint16>(e));
+            return;
+        case tracker_type::tracker_int32:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_int32>(e));
+            return;
+        case tracker_type::tracker_uint32:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_uint32>(e));
+            return;
+        case tracker_type::tracker_int64:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_int64>(e));
+            return;
+        case tracker_type::tracker_uint64:
+            fmt::format_to(buf, "{}", scalar_value<tracker_element_uint64>(e));
+            return;
+        case tracker_type::tracker_float:
+            append_float(buf, scalar_value<tracker_element_float>(e));
+            return;
+        case tracker_type::tracker_double:
+            append_float(buf, scalar_value<tracker_element_double>(e));
+            return;
+        case tracker_type::tracker_key:
+            buf.push_back('"');
+            append_device_key(buf, scalar_value<tracker_element_device_key>(e));
+            buf.push_back('"');
+            return;
+        default:
+            break;
+    }
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_int_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+    if (e->needs_quotes()) {
+        buf.push_back('"');
+        append_sanitized(buf, e->as_string());
+        buf.push_back('"');
+    } else {
+        append_sanitized(buf, e->as_string());
+    }
+}
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+void pack_element(pack_context& ctx, shared_tracker_element e, unsigned int depth);
 
-                    if (!as_vector) {
-                        // Integer dictionary keys in json are still quoted as strings
-                        stream << indent << "\"" << i.first << "\"";
+void pack_field_name(pack_context& ctx, int id, const shared_tracker_element& e, unsigned int depth) {
+    auto& buf = ctx.buf;
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+    std::string tname;
+    const std::string *name = nullptr;
+    bool named = false;
+
+    if (ctx.name_map != nullptr) {
+        auto nmi = ctx.name_map->find(e);
+        if (nmi != ctx.name_map->end() && nmi->second->rename.length() != 0) {
+            tname = nmi->second->rename;
+            named = true;
+        }
+    }
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
-                }
+    if (!named) {
+        if (e->get_type() == tracker_type::tracker_placeholder_missing) {
+            tname = std::static_pointer_cast<tracker_element_placeholder>(e)->get_name();
+            named = tname.length() != 0;
+        } else if (e->get_type() == tracker_type::tracker_alias) {
+            tname = std::static_pointer_cast<tracker_element_alias>(e)->get_alias_name();
+            named = tname.length() != 0;
+        }
+    }
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+    if (!named) {
+        // Registered field name from the table
+        if (id < 0)
+            tname = Globalreg::globalreg->entrytracker->get_field_name(id);
+        else if (id >= (int) ctx.fields->names.size())
+            ctx.fields = get_field_table(id);
+
+        if (id >= 0 && id < (int) ctx.fields->names.size()) {
+            switch (ctx.name_mode) {
+                case pack_names::plain:
+                    name = &ctx.fields->names[id];
+                    break;
+                case pack_names::ek:
+                    name = &ctx.fields->ek_names[id];
+                    break;
+                case pack_names::permuted:
+                    tname = ctx.fields->raw_names[id];
+                    break;
+            }
+        } else if (id >= 0) {
+            tname = Globalreg::globalreg->entrytracker->get_field_name(id);
+        }
+    }
 
+    if (name == nullptr) {
+        switch (ctx.name_mode) {
+            case pack_names::plain:
+                break;
+            case pack_names::ek:
+                std::replace(tname.begin(), tname.end(), '.', '_');
                 break;
-            case tracker_type::tracker_mac_map:
-                as_vector = std::static_pointer_cast<tracker_element_mac_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_mac_map>(e)->as_key_vector();
+            case pack_names::permuted:
+                tname = (*ctx.name_permuter)(tname);
+                break;
+        }
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+        tname = json_adapter::sanitize_string(tname);
+        name = &tname;
+    }
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_mac_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+    if (ctx.prettyprint) {
+        append_indent(ctx, depth);
+        append(buf, "\"description.");
+        append(buf, *name);
+        append(buf, "\": \"");
+        append_sanitized(buf, e->get_type_as_string());
+        append(buf, ", ");
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+        if (id >= 0 && id < (int) ctx.fields->descriptions.size())
+            append(buf, ctx.fields->descriptions[id]);
+        else
+            append_sanitized(buf, Globalreg::globalreg->entrytracker->get_field_description(id));
 
-                    if (!as_vector) {
-                        // Mac keys are strings and we push only the mac not the mask */
-                        stream << indent << "\"" << i.first << "\"";
+        append(buf, "\",");
+        append_endl(ctx);
+    }
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+    append_indent(ctx, depth);
+    buf.push_back('"');
+    append(buf, *name);
+    append(buf, "\": ");
+}
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
-                }
+inline void open_map(pack_context& ctx, unsigned int depth, bool as_list) {
+    append_endl(ctx);
+    append_indent(ctx, depth);
+    ctx.buf.push_back(as_list ? '[' : '{');
+    append_endl(ctx);
+}
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+inline void close_map(pack_context& ctx, unsigned int depth, bool as_list) {
+    append_endl(ctx);
+    append_indent(ctx, depth);
+    ctx.buf.push_back(as_list ? ']' : '}');
+}
 
-                break;
-            case tracker_type::tracker_uuid_map:
-                as_vector = std::static_pointer_cast<tracker_element_uuid_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_uuid_map>(e)->as_key_vector();
+// Maps keyed by something other than a field; key_writer formats the quoted key
+template<typename M, typename KF>
+void pack_keyed_map(pack_context& ctx, const std::shared_ptr<M>& m, unsigned int depth, 
+        KF key_writer) {
+    auto as_vector = m->as_vector();
+    auto as_key_vector = m->as_key_vector();
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+    open_map(ctx, depth, as_vector || as_key_vector);
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_uuid_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+    bool prepend_comma = false;
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+    for (const auto& i : *m) {
+        if (i.second == nullptr && !as_key_vector)
+            continue;
 
-                    if (!as_vector) {
-                        // Mac keys are strings and we push only the mac not the mask */
-                        stream << indent << "\"" << i.first << "\"";
+        if (prepend_comma) {
+            ctx.buf.push_back(',');
+            append_endl(ctx);
+        }
+        prepend_comma = true;
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+        if (!as_vector) {
+            append_indent(ctx, depth);
+            key_writer(i.first);
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
-                }
+            if (!as_key_vector)
+                append(ctx.buf, ": ");
+        }
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+        if (!as_key_vector)
+            pack_element(ctx, i.second, depth + 1);
+    }
+}
 
-                break;
-            case tracker_type::tracker_string_map:
-                as_vector = std::static_pointer_cast<tracker_element_string_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_string_map>(e)->as_key_vector();
+void pack_element(pack_context& ctx, shared_tracker_element e, unsigned int depth) {
+    if (e == nullptr)
+        return;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+    auto& buf = ctx.buf;
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_string_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+    serializer_scope s(e, ctx.name_map);
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+    // If we're serializing an alias, remap as the aliased element
+    if (e->get_type() == tracker_type::tracker_alias) {
+        e = std::static_pointer_cast<tracker_element_alias>(e)->get();
 
-                    if (!as_vector) {
-                        stream << indent << "\"" << json_adapter::sanitize_string(i.first) << "\"";
+        if (e == nullptr)
+            return;
+    }
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+    if (e->is_stringable()) {
+        pack_scalar(ctx, e);
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
-                }
+        if (buf.size() >= pack_flush_size)
+            ctx.flush();
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+        return;
+    }
 
-                break;
-            case tracker_type::tracker_double_map:
-                as_vector = std::static_pointer_cast<tracker_element_double_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_double_map>(e)->as_key_vector();
+    bool prepend_comma = false;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+    switch (e->get_type()) {
+        case tracker_type::tracker_vector:
+            open_map(ctx, depth, true);
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_double_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+            for (const auto& i : *(std::static_pointer_cast<tracker_element_vector>(e))) {
+                if (i == nullptr)
+                    continue;
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+                if (prepend_comma) {
+                    buf.push_back(',');
+                    append_endl(ctx);
+                }
+                prepend_comma = true;
 
-                    if (!as_vector) {
-                        // Double keys are handled as strings in json
-                        if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
-                        } else if (floor(i.first) == i.first)  {
-                            auto prec = stream.precision(0);
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
-                            stream.precision(prec);
-                        } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
-                        }
+                append_indent(ctx, depth);
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+                pack_element(ctx, i, depth + 1);
+            }
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
+            close_map(ctx, depth, true);
+            break;
+
+        case tracker_type::tracker_vector_double:
+            open_map(ctx, depth, true);
+
+            for (const auto& i : *(std::static_pointer_cast<tracker_element_vector_double>(e))) {
+                if (prepend_comma) {
+                    buf.push_back(',');
+                    append_endl(ctx);
                 }
+                prepend_comma = true;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << indent << "}";
+                append_indent(ctx, depth);
 
-                break;
-            case tracker_type::tracker_hashkey_map:
-                as_vector = std::static_pointer_cast<tracker_element_hashkey_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_hashkey_map>(e)->as_key_vector();
+                if (std::isnan(i) || std::isinf(i))
+                    append(buf, "0");
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                if (floor(i) == i)
+                    fmt::format_to(buf, "{}", (long long) i);
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    fmt::format_to(buf, "{:f}", i);
+            }
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_hashkey_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+            close_map(ctx, depth, true);
+            break;
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+        case tracker_type::tracker_vector_string:
+            open_map(ctx, depth, true);
 
-                    if (!as_vector) {
-                        // Double keys are handled as strings in json
-                        if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
-                        } else if (floor(i.first) == i.first)  {
-                            stream << indent << "\"" << (long) i.first << "\"";
-                        } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
-                        }
+            for (const auto& i : *(std::static_pointer_cast<tracker_element_vector_string>(e))) {
+                if (prepend_comma) {
+                    buf.push_back(',');
+                    append_endl(ctx);
+                }
+                prepend_comma = true;
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+                append_indent(ctx, depth);
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
+                append(buf, i);
+            }
+
+            close_map(ctx, depth, true);
+            break;
+
+        case tracker_type::tracker_map: {
+            auto m = std::static_pointer_cast<tracker_element_map>(e);
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            open_map(ctx, depth, as_vector || as_key_vector);
+
+            auto pack_field = [&](int id, const shared_tracker_element& f) {
+                if (prepend_comma) {
+                    buf.push_back(',');
+                    append_endl(ctx);
+                    append_endl(ctx);
                 }
+                prepend_comma = true;
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+                if (!as_vector)
+                    pack_field_name(ctx, id, f, depth);
 
-                break;
-            case tracker_type::tracker_double_map_double:
-                as_vector = std::static_pointer_cast<tracker_element_double_map_double>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_double_map_double>(e)->as_key_vector();
+                pack_element(ctx, f, depth + 1);
+            };
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
+            for (const auto& i : *m) {
+                if (i.second == nullptr)
+                    continue;
+
+                pack_field(i.first, i.second);
+            }
 
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_double_map_double>(e))) {
-                    if (prepend_comma)
-                        stream << "," << ppendl;
+            m->for_each_unmapped([&](const shared_tracker_element& f) {
+                    pack_field(f->get_id(), f);
+                });
 
-                    prepend_comma = true;
+            close_map(ctx, depth, as_vector || as_key_vector);
+            break;
+        }
 
-                    if (!as_vector) {
+        case tracker_type::tracker_int_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_int_map>(e), depth,
+                    [&buf](int k) {
+                        // Integer dictionary keys in json are still quoted as strings
+                        fmt::format_to(buf, "\"{}\"", k);
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_int_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_int_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_mac_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_mac_map>(e), depth,
+                    [&buf](const mac_addr& k) {
+                        // Mac keys are strings and we push only the mac not the mask
+                        buf.push_back('"');
+                        append(buf, k.mac_to_string());
+                        buf.push_back('"');
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_mac_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_mac_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_uuid_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_uuid_map>(e), depth,
+                    [&buf](const uuid& k) {
+                        buf.push_back('"');
+                        append(buf, k.uuid_to_string());
+                        buf.push_back('"');
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_uuid_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_uuid_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_string_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_string_map>(e), depth,
+                    [&buf](const std::string& k) {
+                        buf.push_back('"');
+                        append_sanitized(buf, k);
+                        buf.push_back('"');
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_string_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_string_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_double_map: {
+            auto m = std::static_pointer_cast<tracker_element_double_map>(e);
+
+            pack_keyed_map(ctx, m, depth,
+                    [&buf](double k) {
                         // Double keys are handled as strings in json
-                        if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
-                        } else if (floor(i.first) == i.first)  {
-                            stream << indent << "\"" << (long) i.first << "\"";
+                        if (std::isnan(k) || std::isinf(k))
+                            append(buf, "\"0\"");
+                        else if (floor(k) == k)
+                            fmt::format_to(buf, "\"{:.0f}\"", k);
+                        else
+                            fmt::format_to(buf, "\"{:f}\"", k);
+                    });
+
+            // Double maps have always closed without the trailing newline
+            if (m->as_vector() || m->as_key_vector()) {
+                close_map(ctx, depth, true);
+            } else {
+                append_indent(ctx, depth);
+                buf.push_back('}');
+            }
+
+            break;
+        }
+
+        case tracker_type::tracker_hashkey_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_hashkey_map>(e), depth,
+                    [&buf](size_t k) {
+                        if (std::isnan(k) || std::isinf(k)) {
+                            append(buf, "\"0\"");
+                        } else if (floor(k) == k) {
+                            fmt::format_to(buf, "\"{}\"", (long) k);
                         } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
+                            buf.push_back('"');
+                            append_fixed(buf, k);
+                            buf.push_back('"');
                         }
-
-                        if (!as_key_vector)
-                            stream << ": ";
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_hashkey_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_hashkey_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_double_map_double: {
+            auto m = std::static_pointer_cast<tracker_element_double_map_double>(e);
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            open_map(ctx, depth, as_vector || as_key_vector);
+
+            for (const auto& i : *m) {
+                if (prepend_comma) {
+                    buf.push_back(',');
+                    append_endl(ctx);
+                }
+                prepend_comma = true;
+
+                if (!as_vector) {
+                    // Double keys are handled as strings in json
+                    append_indent(ctx, depth);
+
+                    if (std::isnan(i.first) || std::isinf(i.first)) {
+                        append(buf, "\"0\"");
+                    } else if (floor(i.first) == i.first) {
+                        fmt::format_to(buf, "\"{}\"", (long) i.first);
+                    } else {
+                        fmt::format_to(buf, "\"{:f}\"", i.first);
                     }
 
-                    if (!as_key_vector) {
-                        if (std::isnan(i.second) || std::isinf(i.second))
-                            stream << "0";
-
-                        if (floor(i.second) == i.second)
-                            stream << fmt::format("{}", (long long) i.second);
-                        else
-                            stream << fmt::format("{:f}", i.second);
-                    }
+                    if (!as_key_vector)
+                        append(buf, ": ");
                 }
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
-
-                break;
-            case tracker_type::tracker_key_map:
-                as_vector = std::static_pointer_cast<tracker_element_device_key_map>(e)->as_vector();
-                as_key_vector = std::static_pointer_cast<tracker_element_device_key_map>(e)->as_key_vector();
+                if (!as_key_vector) {
+                    if (std::isnan(i.second) || std::isinf(i.second))
+                        append(buf, "0");
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
-                else
-                    stream << ppendl << indent << "{" << ppendl;
-
-                prepend_comma = false;
-                for (auto i : *(std::static_pointer_cast<tracker_element_device_key_map>(e))) {
-                    if (i.second == nullptr && !as_key_vector)
-                        continue;
+                    if (floor(i.second) == i.second)
+                        fmt::format_to(buf, "{}", (long long) i.second);
+                    else
+                        fmt::format_to(buf, "{:f}", i.second);
+                }
+            }
 
-                    if (prepend_comma)
-                        stream << "," << ppendl;
-                    prepend_comma = true;
+            close_map(ctx, depth, as_vector || as_key_vector);
+            break;
+        }
 
-                    if (!as_vector) {
+        case tracker_type::tracker_key_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_device_key_map>(e), depth,
+                    [&buf](const device_key& k) {
                         // Keymap keys are handled as strings
-                        stream << indent << "\"" << i.first << "\"";
+                        buf.push_back('"');
+                        append_device_key(buf, k);
+                        buf.push_back('"');
+                    });
+            close_map(ctx, depth, 
+                    std::static_pointer_cast<tracker_element_device_key_map>(e)->as_vector() ||
+                    std::static_pointer_cast<tracker_element_device_key_map>(e)->as_key_vector());
+            break;
+
+        case tracker_type::tracker_pair_double: {
+            auto p = std::static_pointer_cast<tracker_element_pair_double>(e);
+
+            buf.push_back('[');
+            append_float(buf, std::get<0>(p->get()));
+            append(buf, ", ");
+            append_float(buf, std::get<1>(p->get()));
+            buf.push_back(']');
+            break;
+        }
 
-                        if (!as_key_vector)
-                            stream << ": ";
-                    }
+        default:
+            break;
+    }
 
-                    if (!as_key_vector) {
-                        json_adapter::pack(stream,i.second, name_map, prettyprint, depth + 1, name_permuter);
-                    }
-                }
+    if (buf.size() >= pack_flush_size)
+        ctx.flush();
+}
 
-                if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
-                else
-                    stream << ppendl << indent << "}";
+}
 
-                break;
-            case tracker_type::tracker_pair_double:
-                stream << "[" << 
-                    dblstr.as_string(std::get<0>(std::static_pointer_cast<tracker_element_pair_double>(e)->get()))
-                    << ", " << 
-                    dblstr.as_string(std::get<1>(std::static_pointer_cast<tracker_element_pair_double>(e)->get()))
-                    << "]"; 
-            default:
-                break;
-        }
-    }
+void json_adapter::pack(std::ostream &stream, shared_tracker_element e, 
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        bool prettyprint, unsigned int depth) {
+    pack_context ctx(stream, name_map, prettyprint, pack_names::plain, nullptr);
+    pack_element(ctx, e, depth);
 }
 
+void json_adapter::pack(std::ostream &stream, shared_tracker_element e, 
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        bool prettyprint, unsigned int depth,
+        std::function<std::string (const std::string&)> name_permuter) {
+    pack_context ctx(stream, name_map, prettyprint, pack_names::permuted, &name_permuter);
+    pack_element(ctx, e, depth);
+}
+
+void json_adapter::pack_ek(std::ostream &stream, shared_tracker_element e, 
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map) {
+    pack_context ctx(stream, name_map, false, pack_names::ek, nullptr);
+    pack_element(ctx, e, 0);
+}
@@ -32,11 +32,23 @@ namespace json_adapter {
 
 // Basic packer with some defaulted options - prettyprint and depth used for
 // recursive indenting and prettifying the output
+//
+// Output is formatted into a local buffer and written to the stream in large blocks;
+// field names come from a pre-escaped table indexed by field id, so packing takes no
+// entrytracker locks
 void pack(std::ostream &stream, shared_tracker_element e,
         std::shared_ptr<tracker_element_serializer::rename_map> name_map = nullptr,
-        bool prettyprint = false, unsigned int depth = 0,
-        std::function<std::string (const std::string&)> name_permuter = 
-            [](const std::string& s) -> std::string { return s; });
+        bool prettyprint = false, unsigned int depth = 0);
+
+// Packer with a custom field name permuter, applied to every field name
+void pack(std::ostream &stream, shared_tracker_element e,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        bool prettyprint, unsigned int depth,
+        std::function<std::string (const std::string&)> name_permuter);
+
+// ELK-style packer, with all dots in field names converted to underscores
+void pack_ek(std::ostream &stream, shared_tracker_element e,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map = nullptr);
 
 std::string sanitize_string(const std::string& in) noexcept;
 std::size_t sanitize_extra_space(const std::string& in) noexcept;
@@ -79,17 +91,11 @@ public:
                 if (i == nullptr)
                     continue;
 
-                json_adapter::pack(stream, i, name_map, false, 0,
-                        [](const std::string& s) { 
-                            return multi_replace_all(s, ".", "_");
-                        });
+                json_adapter::pack_ek(stream, i, name_map);
                 stream << "\n";
             }
         } else {
-            json_adapter::pack(stream, in_elem, name_map, false, 0,
-                    [](const std::string& s) { 
-                    return multi_replace_all(s, ".", "_");
-                    });
+            json_adapter::pack_ek(stream, in_elem, name_map);
             stream << "\n";
         }
 
@@ -20,6 +20,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "globalregistry.h"
 #include "json_adapter.h"
@@ -59,6 +60,26 @@ kis_database_logfile::kis_database_logfile():
 
     message_evt_id = 0;
     alert_evt_id = 0;
+
+    last_transaction = 0;
+
+    packet_stmt = nullptr;
+    data_stmt = nullptr;
+    alert_stmt = nullptr;
+    snapshot_stmt = nullptr;
+    message_stmt = nullptr;
+    device_stmt = nullptr;
+
+    compress_devices = false;
+
+    writer_shutdown = false;
+    writer_dropped = 0;
+    writer_batch_max = 
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_write_batch", 256);
+    if (writer_batch_max == 0)
+        writer_batch_max = 1;
+    writer_queue_max =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_write_queue", 16384);
 }
 
 kis_database_logfile::~kis_database_logfile() {
@@ -66,6 +87,11 @@ kis_database_logfile::~kis_database_logfile() {
     eventbus->remove_listener(alert_evt_id);
 
     close_log();
+
+    // Anything queued after the writer stopped
+    kismetdb_log_record *record;
+    while (writer_queue.try_dequeue(record))
+        delete record;
 }
 
 void kis_database_logfile::trigger_deferred_startup() {
@@ -101,24 +127,22 @@ bool kis_database_logfile::open_log(std::string in_path) {
     }
 
     sqlite3_exec(db, "PRAGMA journal_mode=PERSIST", NULL, NULL, NULL);
+
+    if (!prepare_log_statements()) {
+        _MSG_FATAL("Unable to prepare KismetDB log inserts for {}: {}", in_path, sqlite3_errmsg(db));
+        Globalreg::globalreg->fatal_condition = true;
+        return false;
+    }
     
-    // Go into transactional mode where we only commit every 10 seconds
+    // Go into transactional mode where we only commit every 10 seconds; the writer
+    // thread handles the commit cycle
     sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    last_transaction = time(0);
 
-    transaction_timer = 
-        timetracker->register_timer(SERVER_TIMESLICES_SEC * 10, NULL, 1,
-            [this](int) -> int {
-
-            // local_locker dblock(&ds_mutex, "kismetdb transaction_timer");
-
-            in_transaction_sync = true;
-
-            sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
-            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
-
-            in_transaction_sync = false;
-
-            return 1;
+    writer_shutdown = false;
+    writer_thread = std::thread([this]() {
+            thread_set_process_name("kismetdb writer");
+            writer_thread_func();
         });
 
 
@@ -239,6 +263,9 @@ bool kis_database_logfile::open_log(std::string in_path) {
     log_duplicate_packets =
         Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_duplicate_packets", true);
 
+    compress_devices =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_device_compress", false);
+
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
     httpd->register_route("/logging/kismetdb/pcap/drop", {"POST"}, httpd->LOGON_ROLE, {"cmd"},
@@ -405,9 +432,9 @@ bool kis_database_logfile::open_log(std::string in_path) {
 
         auto this_ref = shared_from_this();
         packet_handler_id = 
-            packetchain->register_handler([this, this_ref](kis_packet *packet) -> int {
-                    return log_packet(packet);
-                }, CHAINPOS_LOGGING, -100);
+            packetchain->register_batch_handler([this, this_ref](const std::vector<kis_packet *>& packets) -> int {
+                    return log_packets(packets);
+                }, CHAINPOS_LOGGING, -100, "kismetdb log");
     } else {
         packet_handler_id = -1;
         _MSG_INFO("Packets will not be saved to the Kismet database log.");
@@ -420,12 +447,17 @@ void kis_database_logfile::close_log() {
     // We have to shut down inside lock but not cancel packet handlers while 
     // the various handlers might be holding locks
 
+    // Stop accepting new records and let the writer flush what it has
+    db_enabled = false;
+    stop_writer();
+
     {
         kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb close_log");
         db_lock_with_sync_check(dblock, return);
 
         set_int_log_open(false);
-        db_enabled = false;
+
+        finalize_log_statements();
 
         // End the transaction
         sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
@@ -453,7 +485,6 @@ void kis_database_logfile::close_log() {
         Globalreg::fetch_global_as<time_tracker>();
 
     if (timetracker != NULL) {
-        timetracker->remove_timer(transaction_timer);
         timetracker->remove_timer(packet_timeout_timer);
         timetracker->remove_timer(alert_timeout_timer);
         timetracker->remove_timer(device_timeout_timer);
@@ -499,6 +530,8 @@ int kis_database_logfile::database_upgrade_db() {
 
         "device BLOB, " // Actual device
 
+        "compressed INT, " // Device JSON is zlib-compressed
+
         "UNIQUE(phyname, devmac) ON CONFLICT REPLACE)";
 
     r = sqlite3_exec(db, sql.c_str(),
@@ -704,201 +737,133 @@ void kis_database_logfile::handle_message(std::shared_ptr<tracked_message> msg)
     if (!db_enabled)
         return;
 
-    int r;
-    std::string sql;
-    sqlite3_stmt *msg_stmt;
-    const char *msg_pz;
+    auto record = new kismetdb_log_record(kismetdb_log_record::record_type::message);
 
-    std::shared_ptr<kis_gps_packinfo> loc;
+    record->ts_sec = time(0);
 
-    if (gpstracker != nullptr) 
-        loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
-
-    sql =
-        "INSERT INTO messages "
-        "(ts_sec, "
-        "lat, lon, "
-        "msgtype, message) "
-        "VALUES (?, ?, ?, ?, ?)";
-
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb handle_message");
-    db_lock_with_sync_check(dblock, return);
-
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &msg_stmt, &msg_pz);
+    if (gpstracker != nullptr) {
+        auto loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for messages in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return;
-    }
-
-    unsigned int spos = 1;
-
-    sqlite3_bind_int64(msg_stmt, spos++, time(0));
-
-    if (loc != nullptr && loc->fix >= 2) {
-        sqlite3_bind_double(msg_stmt, spos++, loc->lat);
-        sqlite3_bind_double(msg_stmt, spos++, loc->lon);
-    } else {
-        sqlite3_bind_double(msg_stmt, spos++, 0);
-        sqlite3_bind_double(msg_stmt, spos++, 0);
+        if (loc != nullptr && loc->fix >= 2) {
+            record->has_location = true;
+            record->lat = loc->lat;
+            record->lon = loc->lon;
+        }
     }
 
-    std::string msgtype;
-
     if (msg->get_flags() & MSGFLAG_INFO)
-        msgtype = "INFO";
+        record->header = "INFO";
     else if (msg->get_flags() & MSGFLAG_ERROR)
-        msgtype = "ERROR";
+        record->header = "ERROR";
     else if (msg->get_flags() & MSGFLAG_DEBUG)
-        msgtype = "DEBUG";
+        record->header = "DEBUG";
     else if (msg->get_flags() & MSGFLAG_FATAL)
-        msgtype = "FATAL";
+        record->header = "FATAL";
 
-    sqlite3_bind_text(msg_stmt, spos++, msgtype.c_str(), msgtype.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(msg_stmt, spos++, msg->get_message().c_str(), msg->get_message().length(), SQLITE_TRANSIENT);
-
-    if (sqlite3_step(msg_stmt) != SQLITE_DONE) {
-        close_log();
-        _MSG_ERROR("Unable to insert message into {}: {}", ds_dbfile, sqlite3_errmsg(db));
-    }
+    record->content = msg->get_message();
 
-    sqlite3_finalize(msg_stmt);
+    queue_log_record(record);
 }
 
 int kis_database_logfile::log_device(std::shared_ptr<kis_tracked_device_base> d) {
     if (!db_enabled)
         return 0;
 
-    std::string sql;
-
-    std::string phystring;
-    std::string macstring;
-    std::string typestring;
-    std::string keystring;
-
     if (d == nullptr)
         return 0;
 
-    if (device_mac_filter->filter(d->get_macaddr(), d->get_phyid()))
-        return 0;
+    auto record = new kismetdb_log_record(kismetdb_log_record::record_type::device);
 
-    phystring = d->get_phyname();
-    macstring = d->get_macaddr().mac_to_string();
-    typestring = d->get_type_string();
-    keystring = d->get_key().as_string();
+    {
+        // Hold the devicelist only long enough to copy this one device out
+        kis_lock_guard<kis_mutex> lg_dl(devicetracker->get_devicelist_mutex(), "database_logfile::log_device");
 
-    int spos = 1;
+        if (device_mac_filter->filter(d->get_macaddr(), d->get_phyid())) {
+            delete record;
+            return 0;
+        }
 
-    std::stringstream sstr;
+        std::stringstream sstr;
 
-    {
-        kis_lock_guard<kis_mutex> lg_dl(devicetracker->get_devicelist_mutex(), "database_logfile::log_device");
         int r = Globalreg::globalreg->entrytracker->serialize("json", sstr, d, nullptr);
 
         if (r < 0) {
             _MSG_ERROR("Failure serializing device key {} to the kisdatabaselog", d->get_key());
+            delete record;
             return 0;
         }
-    }
-
-    std::string streamstring = sstr.str();
 
-    int r;
-    sqlite3_stmt *device_stmt;
-    const char *device_pz;
-
-    sql =
-        "INSERT INTO devices "
-        "(first_time, last_time, devkey, phyname, devmac, strongest_signal, "
-        "min_lat, min_lon, max_lat, max_lon, "
-        "avg_lat, avg_lon, "
-        "bytes_data, type, device) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+        record->content = sstr.str();
+
+        record->first_time = d->get_first_time();
+        record->last_time = d->get_last_time();
+        record->devkey = d->get_key().as_string();
+        record->phyname = d->get_phyname();
+        record->sourcemac = d->get_macaddr();
+        record->signal = d->get_signal_data()->get_max_signal();
+
+        if (d->get_tracker_location() != NULL) {
+            record->min_lat = d->get_location()->get_min_loc()->get_lat();
+            record->min_lon = d->get_location()->get_min_loc()->get_lon();
+            record->max_lat = d->get_location()->get_max_loc()->get_lat();
+            record->max_lon = d->get_location()->get_max_loc()->get_lon();
+            record->lat = d->get_location()->get_avg_loc()->get_lat();
+            record->lon = d->get_location()->get_avg_loc()->get_lon();
+        }
 
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_device");
-    db_lock_with_sync_check(dblock, return);
+        record->datasize = d->get_datasize();
+        record->header = d->get_type_string();
+    }
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &device_stmt, &device_pz);
+    if (!queue_log_record(record, true))
+        return 0;
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for devices in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    return 1;
+}
 
-    sqlite3_bind_int64(device_stmt, spos++, d->get_first_time());
-    sqlite3_bind_int64(device_stmt, spos++, d->get_last_time());
-    sqlite3_bind_text(device_stmt, spos++, keystring.c_str(), 
-            keystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(device_stmt, spos++, phystring.c_str(), 
-            phystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(device_stmt, spos++, macstring.c_str(), 
-            macstring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_int(device_stmt, spos++, d->get_signal_data()->get_max_signal());
-
-    if (d->get_tracker_location() != NULL) {
-        sqlite3_bind_double(device_stmt, spos++, 
-                d->get_location()->get_min_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                d->get_location()->get_min_loc()->get_lon());
-        sqlite3_bind_double(device_stmt, spos++,
-                d->get_location()->get_max_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                d->get_location()->get_max_loc()->get_lon());
-        sqlite3_bind_double(device_stmt, spos++,
-                d->get_location()->get_avg_loc()->get_lat());
-        sqlite3_bind_double(device_stmt, spos++,
-                d->get_location()->get_avg_loc()->get_lon());
-    } else {
-        // Empty location
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
-        sqlite3_bind_double(device_stmt, spos++, 0);
+int kis_database_logfile::log_packet(kis_packet *in_pack) {
+    if (!db_enabled) {
+        return 0;
     }
 
-    sqlite3_bind_int64(device_stmt, spos++, d->get_datasize());
-    sqlite3_bind_text(device_stmt, spos++, typestring.c_str(), 
-            typestring.length(), SQLITE_TRANSIENT);
+    std::vector<kismetdb_log_record *> records;
 
-    sqlite3_bind_blob(device_stmt, spos++, streamstring.c_str(), 
-            streamstring.length(), SQLITE_TRANSIENT);
+    build_packet_records(in_pack, records);
 
-    if (sqlite3_step(device_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert device in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    auto n_records = records.size();
 
-    sqlite3_finalize(device_stmt);
+    if (n_records == 0 || queue_log_records(records) != n_records)
+        return 0;
 
     return 1;
 }
 
-int kis_database_logfile::log_packet(kis_packet *in_pack) {
+int kis_database_logfile::log_packets(const std::vector<kis_packet *>& in_packets) {
     if (!db_enabled) {
         return 0;
     }
 
-    std::string phystring;
-    std::string macstring;
-    std::string deststring;
-    std::string transstring;
-    std::string keystring;
-    std::string sourceuuidstring;
-    double frequency;
+    // Packet threads run this for every batch, so keep the record list around
+    thread_local std::vector<kismetdb_log_record *> records;
 
-    if (in_pack->duplicate && !log_duplicate_packets)
+    for (const auto& p : in_packets)
+        build_packet_records(p, records);
+
+    if (records.size() == 0)
         return 0;
 
+    queue_log_records(records);
+
+    return 1;
+}
+
+void kis_database_logfile::build_packet_records(kis_packet *in_pack, 
+        std::vector<kismetdb_log_record *>& records) {
+    if (in_pack->duplicate && !log_duplicate_packets)
+        return;
+
     if (packet_mac_filter->filter_packet(in_pack)) {
-        return 0;
+        return;
     }
 
     kis_datachunk *chunk = 
@@ -919,154 +884,83 @@ int kis_database_logfile::log_packet(kis_packet *in_pack) {
     packet_metablob *metablob =
         (packet_metablob *) in_pack->fetch(pack_comp_metablob);
 
-    kis_phy_handler *phyh = NULL;
-
-    // Packets are no longer a 1:1 with a device
-    keystring = "0";
-
-    if (commoninfo != NULL) {
-        phyh = devicetracker->fetch_phy_handler(commoninfo->phyid);
-        macstring = commoninfo->source.mac_to_string();
-        deststring = commoninfo->dest.mac_to_string();
-        transstring = commoninfo->transmitter.mac_to_string();
-        frequency = commoninfo->freq_khz;
-    } else {
-        macstring = "00:00:00:00:00:00";
-        deststring = "00:00:00:00:00:00";
-        transstring = "00:00:00:00:00:00";
-        frequency = 0;
-    }
-
-    if (phyh == NULL)
-        phystring = "Unknown";
-    else
-        phystring = phyh->fetch_phy_name();
-
-
-    if (datasrc != NULL) {
-        sourceuuidstring = datasrc->ref_source->get_source_uuid().uuid_to_string();
-    } else {
-        sourceuuidstring = "00000000-0000-0000-0000-000000000000";
-    }
-
     // Log into the PACKET table if we're a loggable packet (ie, have a link frame)
     if (chunk != nullptr) {
-        int r;
-        std::string sql;
-        sqlite3_stmt *packet_stmt;
-        const char *packet_pz;
-
-        sql =
-            "INSERT INTO packets "
-            "(ts_sec, ts_usec, phyname, "
-            "sourcemac, destmac, transmac, devkey, frequency, " 
-            "lat, lon, alt, speed, heading, "
-            "packet_len, signal, "
-            "datasource, "
-            "dlt, packet, "
-            "error, tags, datarate) "
-            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
-
-        kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_packet");
-        db_lock_with_sync_check(dblock, return -1);
+        auto record = new kismetdb_log_record(kismetdb_log_record::record_type::packet);
 
+        record->ts_sec = in_pack->ts.tv_sec;
+        record->ts_usec = in_pack->ts.tv_usec;
 
-        r = sqlite3_prepare(db, sql.c_str(), sql.length(), &packet_stmt, &packet_pz);
-
-        if (r != SQLITE_OK) {
-            _MSG("kis_database_logfile unable to prepare database insert for packets in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
+        if (commoninfo != nullptr) {
+            record->phyid = commoninfo->phyid;
+            record->sourcemac = commoninfo->source;
+            record->destmac = commoninfo->dest;
+            record->transmac = commoninfo->transmitter;
+            record->frequency = commoninfo->freq_khz;
         }
 
-        int sql_pos = 1;
-
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_sec);
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_usec);
-
-        sqlite3_bind_text(packet_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, deststring.c_str(), deststring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, transstring.c_str(), transstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, keystring.c_str(), keystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_double(packet_stmt, sql_pos++, frequency);
-
-        if (gpsdata != NULL) {
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lat);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lon);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->alt);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->speed);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->heading);
-        } else {
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
+        if (gpsdata != nullptr) {
+            record->has_location = true;
+            record->lat = gpsdata->lat;
+            record->lon = gpsdata->lon;
+            record->alt = gpsdata->alt;
+            record->speed = gpsdata->speed;
+            record->heading = gpsdata->heading;
         }
 
-        sqlite3_bind_int64(packet_stmt, sql_pos++, chunk->length);
-
         if (radioinfo != nullptr) {
-            sqlite3_bind_int(packet_stmt, sql_pos++, radioinfo->signal_dbm);
-        } else {
-            sqlite3_bind_int(packet_stmt, sql_pos++, 0);
+            record->signal = radioinfo->signal_dbm;
+            record->datarate = radioinfo->datarate / 10;
         }
 
-        sqlite3_bind_text(packet_stmt, sql_pos++, sourceuuidstring.c_str(), 
-                sourceuuidstring.length(), SQLITE_TRANSIENT);
-
-        sqlite3_bind_int(packet_stmt, sql_pos++, chunk->dlt);
-        sqlite3_bind_blob(packet_stmt, sql_pos++, (const char *) chunk->data, chunk->length, 0);
-
-        sqlite3_bind_int(packet_stmt, sql_pos++, in_pack->error);
+        if (datasrc != nullptr)
+            record->datasource = datasrc->ref_source->get_source_uuid();
 
-        std::stringstream tagstream;
-        bool space_needed = false;
+        record->dlt = chunk->dlt;
+        record->content.assign((const char *) chunk->data, chunk->length);
+        record->packet_len = std::max<uint64_t>(in_pack->original_len, chunk->length);
 
-        for (auto tag : in_pack->tag_vec) {
-            if (space_needed)
-                tagstream << " ";
-            space_needed = true;
-            tagstream << tag;
-        }
-
-        auto str = tagstream.str();
-        sqlite3_bind_text(packet_stmt, sql_pos++, str.c_str(), tagstream.str().length(), SQLITE_TRANSIENT);
-
-        if (radioinfo != nullptr)
-            sqlite3_bind_double(packet_stmt, sql_pos++, radioinfo->datarate / 10);
-        else
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
+        record->error = in_pack->error;
 
-        if (sqlite3_step(packet_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert packet in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
+        for (const auto& tag : in_pack->tag_vec) {
+            if (record->tags.length() > 0)
+                record->tags += " ";
+            record->tags += tag;
         }
 
-        sqlite3_finalize(packet_stmt);
+        records.push_back(record);
     }
 
     // If the packet has a metablob record, log that; if the packet ONLY has meta data we should only get a 'data'
     // record; if the packet has both, we'll get both a 'packet' and a 'data' record.
     if (metablob != nullptr) {
-        mac_addr smac("00:00:00:00:00:00");
-        uuid puuid;
+        auto record = new kismetdb_log_record(kismetdb_log_record::record_type::data);
 
-        if (commoninfo != nullptr)
-            smac = commoninfo->source;
+        record->ts_sec = in_pack->ts.tv_sec;
+        record->ts_usec = in_pack->ts.tv_usec;
+
+        if (commoninfo != nullptr) {
+            record->phyid = commoninfo->phyid;
+            record->sourcemac = commoninfo->source;
+        }
+
+        if (gpsdata != nullptr) {
+            record->has_location = true;
+            record->lat = gpsdata->lat;
+            record->lon = gpsdata->lon;
+            record->alt = gpsdata->alt;
+            record->speed = gpsdata->speed;
+            record->heading = gpsdata->heading;
+        }
 
         if (datasrc != nullptr) 
-            puuid = datasrc->ref_source->get_source_uuid();
+            record->datasource = datasrc->ref_source->get_source_uuid();
 
-        log_data(gpsdata, in_pack->ts, phystring, smac, puuid,
-                metablob->meta_type, metablob->meta_data);
-    }
+        record->header = metablob->meta_type;
+        record->content = metablob->meta_data;
 
-    return 1;
+        records.push_back(record);
+    }
 }
 
 int kis_database_logfile::log_data(kis_gps_packinfo *gps, struct timeval tv, 
@@ -1076,73 +970,29 @@ int kis_database_logfile::log_data(kis_gps_packinfo *gps, struct timeval tv,
     if (!db_enabled)
         return 0;
 
-    std::string macstring = devmac.mac_to_string();
-    std::string uuidstring = datasource_uuid.uuid_to_string();
-
-    int r;
-    std::string sql;
-    sqlite3_stmt *data_stmt;
-    const char *data_pz;
-
-    sql =
-        "INSERT INTO data "
-        "(ts_sec, ts_usec, "
-        "phyname, devmac, "
-        "lat, lon, alt, speed, heading, "
-        "datasource, "
-        "type, json) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
-
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_data");
-    db_lock_with_sync_check(dblock, return -1);
-
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &data_stmt, &data_pz);
+    auto record = new kismetdb_log_record(kismetdb_log_record::record_type::data);
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for data in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    record->ts_sec = tv.tv_sec;
+    record->ts_usec = tv.tv_usec;
 
-    sqlite3_reset(data_stmt);
-    sqlite3_clear_bindings(data_stmt);
+    record->phyname = phystring;
+    record->sourcemac = devmac;
+    record->datasource = datasource_uuid;
 
-    int sql_pos = 1;
-
-    sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_sec);
-    sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_usec);
-
-    sqlite3_bind_text(data_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(data_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
-
-    if (gps != NULL) {
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->lat);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->lon);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->alt);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->speed);
-        sqlite3_bind_double(data_stmt, sql_pos++, gps->heading);
-    } else {
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        sqlite3_bind_double(data_stmt, sql_pos++, 0);
+    if (gps != nullptr) {
+        record->has_location = true;
+        record->lat = gps->lat;
+        record->lon = gps->lon;
+        record->alt = gps->alt;
+        record->speed = gps->speed;
+        record->heading = gps->heading;
     }
 
-    sqlite3_bind_text(data_stmt, sql_pos++, uuidstring.c_str(), uuidstring.length(), SQLITE_TRANSIENT);
-
-    sqlite3_bind_text(data_stmt, sql_pos++, type.data(), type.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(data_stmt, sql_pos++, json.data(), json.length(), SQLITE_TRANSIENT);
-
-    if (sqlite3_step(data_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert data in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    record->header = type;
+    record->content = json;
 
-    sqlite3_finalize(data_stmt);
+    if (!queue_log_record(record))
+        return 0;
 
     return 1;
 }
@@ -1231,140 +1081,488 @@ int kis_database_logfile::log_alert(std::shared_ptr<tracked_alert> in_alert) {
     if (!db_enabled)
         return 0;
 
-    std::string macstring = in_alert->get_transmitter_mac().mac_to_string();
-    std::string phystring = devicetracker->fetch_phy_name(in_alert->get_phy());
-    std::string headerstring = in_alert->get_header();
-
-    std::stringstream ss;
-    std::string jsonstring;
-
-    json_adapter::pack(ss, in_alert, NULL);
-    jsonstring = ss.str();
+    auto record = new kismetdb_log_record(kismetdb_log_record::record_type::alert);
 
     // Break the double timestamp into two integers
     double intpart, fractpart;
     fractpart = modf(in_alert->get_timestamp(), &intpart);
 
-    int r;
-    std::string sql;
-    sqlite3_stmt *alert_stmt;
-    const char *alert_pz;
+    record->ts_sec = intpart;
+    record->ts_usec = fractpart * 1000000;
 
-    sql =
-        "INSERT INTO alerts "
-        "(ts_sec, ts_usec, phyname, devmac, "
-        "lat, lon, "
-        "header, "
-        "json) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+    record->phyname = devicetracker->fetch_phy_name(in_alert->get_phy());
+    record->sourcemac = in_alert->get_transmitter_mac();
 
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_alert");
-    db_lock_with_sync_check(dblock, return -1);
+    if (in_alert->get_location()->get_valid()) {
+        record->has_location = true;
+        record->lat = in_alert->get_location()->get_lat();
+        record->lon = in_alert->get_location()->get_lon();
+    }
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &alert_stmt, &alert_pz);
+    record->header = in_alert->get_header();
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for alerts in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
+    std::stringstream ss;
+    json_adapter::pack(ss, in_alert, NULL);
+    record->content = ss.str();
+
+    if (!queue_log_record(record))
+        return 0;
+
+    return 1;
+}
+
+int kis_database_logfile::log_snapshot(kis_gps_packinfo *gps, struct timeval tv,
+        std::string snaptype, std::string json) {
+
+    if (!db_enabled)
+        return 0;
+
+    auto record = new kismetdb_log_record(kismetdb_log_record::record_type::snapshot);
+
+    record->ts_sec = tv.tv_sec;
+    record->ts_usec = tv.tv_usec;
+
+    if (gps != nullptr) {
+        record->has_location = true;
+        record->lat = gps->lat;
+        record->lon = gps->lon;
+    } else if (gpstracker != nullptr) {
+        auto loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
+
+        if (loc != nullptr && loc->fix >= 2) {
+            record->has_location = true;
+            record->lat = loc->lat;
+            record->lon = loc->lon;
+        }
     }
 
-    sqlite3_bind_int64(alert_stmt, 1, intpart);
-    sqlite3_bind_int64(alert_stmt, 2, fractpart * 1000000);
+    record->header = snaptype;
+    record->content = json;
 
-    sqlite3_bind_text(alert_stmt, 3, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(alert_stmt, 4, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
+    if (!queue_log_record(record))
+        return 0;
 
-    if (in_alert->get_location()->get_valid()) {
-        sqlite3_bind_double(alert_stmt, 5, in_alert->get_location()->get_lat());
-        sqlite3_bind_double(alert_stmt, 6, in_alert->get_location()->get_lon());
-    } else {
-        sqlite3_bind_int(alert_stmt, 5, 0);
-        sqlite3_bind_int(alert_stmt, 6, 0);
+    return 1;
+}
+
+bool kis_database_logfile::prepare_log_statements() {
+    std::vector<std::pair<sqlite3_stmt **, std::string>> statements = {
+        { &packet_stmt, 
+            "INSERT INTO packets "
+            "(ts_sec, ts_usec, phyname, "
+            "sourcemac, destmac, transmac, devkey, frequency, " 
+            "lat, lon, alt, speed, heading, "
+            "packet_len, signal, "
+            "datasource, "
+            "dlt, packet, "
+            "error, tags, datarate) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)" },
+        { &data_stmt,
+            "INSERT INTO data "
+            "(ts_sec, ts_usec, "
+            "phyname, devmac, "
+            "lat, lon, alt, speed, heading, "
+            "datasource, "
+            "type, json) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)" },
+        { &alert_stmt,
+            "INSERT INTO alerts "
+            "(ts_sec, ts_usec, phyname, devmac, "
+            "lat, lon, "
+            "header, "
+            "json) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?)" },
+        { &snapshot_stmt,
+            "INSERT INTO snapshots "
+            "(ts_sec, ts_usec, "
+            "lat, lon, "
+            "snaptype, json) "
+            "VALUES (?, ?, ?, ?, ?, ?)" },
+        { &device_stmt,
+            "INSERT INTO devices "
+            "(first_time, last_time, devkey, phyname, devmac, strongest_signal, "
+            "min_lat, min_lon, max_lat, max_lon, "
+            "avg_lat, avg_lon, "
+            "bytes_data, type, device, compressed) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)" },
+        { &message_stmt,
+            "INSERT INTO messages "
+            "(ts_sec, "
+            "lat, lon, "
+            "msgtype, message) "
+            "VALUES (?, ?, ?, ?, ?)" },
+    };
+
+    for (const auto& s : statements) {
+        if (sqlite3_prepare_v2(db, s.second.c_str(), s.second.length(), s.first, NULL) != SQLITE_OK) {
+            finalize_log_statements();
+            return false;
+        }
     }
 
-    sqlite3_bind_text(alert_stmt, 7, headerstring.c_str(), headerstring.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_blob(alert_stmt, 8, jsonstring.data(), jsonstring.length(), SQLITE_TRANSIENT);
+    return true;
+}
 
-    if (sqlite3_step(alert_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert alert in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
+void kis_database_logfile::finalize_log_statements() {
+    for (auto s : {&packet_stmt, &data_stmt, &alert_stmt, &snapshot_stmt, &message_stmt, &device_stmt}) {
+        if (*s != nullptr)
+            sqlite3_finalize(*s);
+        *s = nullptr;
     }
+}
 
-    sqlite3_finalize(alert_stmt);
+bool kis_database_logfile::queue_log_record(kismetdb_log_record *record, bool wait_for_space) {
+    if (wait_for_space) {
+        while (writer_queue_max > 0 && writer_queue.size_approx() >= writer_queue_max && db_enabled)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
 
-    return 1;
+    if (writer_queue_max > 0 && writer_queue.size_approx() >= writer_queue_max) {
+        writer_dropped++;
+        delete record;
+        return false;
+    }
+
+    writer_queue.enqueue(record);
+    return true;
 }
 
-int kis_database_logfile::log_snapshot(kis_gps_packinfo *gps, struct timeval tv,
-        std::string snaptype, std::string json) {
+size_t kis_database_logfile::queue_log_records(std::vector<kismetdb_log_record *>& records) {
+    auto n_queue = records.size();
 
-    if (!db_enabled)
-        return 0;
+    if (writer_queue_max > 0) {
+        auto depth = writer_queue.size_approx();
+        n_queue = depth >= writer_queue_max ? 0 : std::min(n_queue, writer_queue_max - depth);
+    }
 
-    int r;
-    std::string sql;
-    sqlite3_stmt *snapshot_stmt;
-    const char *snapshot_pz;
+    if (n_queue > 0)
+        writer_queue.enqueue_bulk(records.begin(), n_queue);
 
-    std::shared_ptr<kis_gps_packinfo> loc;
+    if (n_queue < records.size()) {
+        writer_dropped += records.size() - n_queue;
 
-    if (gps == nullptr && gpstracker != nullptr) 
-        loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
+        for (auto i = records.begin() + n_queue; i != records.end(); ++i)
+            delete *i;
+    }
 
-    sql =
-        "INSERT INTO snapshots "
-        "(ts_sec, ts_usec, "
-        "lat, lon, "
-        "snaptype, json) "
-        "VALUES (?, ?, ?, ?, ?, ?)";
+    records.clear();
 
-    kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb log_snapshot");
-    db_lock_with_sync_check(dblock, return -1);
+    return n_queue;
+}
 
-    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &snapshot_stmt, &snapshot_pz);
+const std::string& kis_database_logfile::writer_uuid_string(const uuid& in_uuid) {
+    // Almost every record comes from the same handful of datasources
+    if (writer_last_uuid_str.length() == 0 || !(writer_last_uuid == in_uuid)) {
+        writer_last_uuid = in_uuid;
+        writer_last_uuid_str = in_uuid.uuid_to_string();
+    }
 
-    if (r != SQLITE_OK) {
-        _MSG("kis_database_logfile unable to prepare database insert for snapshots in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
+    return writer_last_uuid_str;
+}
+
+int kis_database_logfile::write_log_record(kismetdb_log_record *record) {
+    sqlite3_stmt *stmt = nullptr;
+    int sql_pos = 1;
+
+    std::string phystring;
+    std::string macstring;
+
+    switch (record->type) {
+        case kismetdb_log_record::record_type::packet:
+        case kismetdb_log_record::record_type::data:
+            if (record->phyid >= 0) {
+                auto phyh = devicetracker->fetch_phy_handler(record->phyid);
+
+                if (phyh != nullptr)
+                    phystring = phyh->fetch_phy_name();
+                else
+                    phystring = "Unknown";
+            } else if (record->phyname.length() > 0) {
+                phystring = record->phyname;
+            } else {
+                phystring = "Unknown";
+            }
+
+            macstring = record->sourcemac.mac_to_string();
+            break;
+        case kismetdb_log_record::record_type::alert:
+        case kismetdb_log_record::record_type::device:
+            phystring = record->phyname;
+            macstring = record->sourcemac.mac_to_string();
+            break;
+        default:
+            break;
     }
 
-    sqlite3_bind_int64(snapshot_stmt, 1, tv.tv_sec);
-    sqlite3_bind_int64(snapshot_stmt, 2, tv.tv_usec);
+    switch (record->type) {
+        case kismetdb_log_record::record_type::packet: {
+            stmt = packet_stmt;
 
-    if (gps != NULL) {
-        sqlite3_bind_double(snapshot_stmt, 3, gps->lat);
-        sqlite3_bind_double(snapshot_stmt, 4, gps->lon);
-    } else {
-        if (loc != nullptr && loc->fix >= 2) {
-            sqlite3_bind_double(snapshot_stmt, 3, loc->lat);
-            sqlite3_bind_double(snapshot_stmt, 4, loc->lon);
-        } else {
-            sqlite3_bind_int(snapshot_stmt, 3, 0);
-            sqlite3_bind_int(snapshot_stmt, 4, 0);
+            auto deststring = record->destmac.mac_to_string();
+            auto transstring = record->transmac.mac_to_string();
+            const auto& uuidstring = writer_uuid_string(record->datasource);
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_sec);
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_usec);
+
+            sqlite3_bind_text(stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, deststring.c_str(), deststring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, transstring.c_str(), transstring.length(), SQLITE_STATIC);
+            // Packets are no longer a 1:1 with a device
+            sqlite3_bind_text(stmt, sql_pos++, "0", 1, SQLITE_STATIC);
+            sqlite3_bind_double(stmt, sql_pos++, record->frequency);
+
+            sqlite3_bind_double(stmt, sql_pos++, record->lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->lon);
+            sqlite3_bind_double(stmt, sql_pos++, record->alt);
+            sqlite3_bind_double(stmt, sql_pos++, record->speed);
+            sqlite3_bind_double(stmt, sql_pos++, record->heading);
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->packet_len);
+            sqlite3_bind_int(stmt, sql_pos++, record->signal);
+
+            sqlite3_bind_text(stmt, sql_pos++, uuidstring.c_str(), uuidstring.length(), SQLITE_STATIC);
+
+            sqlite3_bind_int(stmt, sql_pos++, record->dlt);
+            sqlite3_bind_blob(stmt, sql_pos++, record->content.data(), record->content.length(), SQLITE_STATIC);
+
+            sqlite3_bind_int(stmt, sql_pos++, record->error);
+            sqlite3_bind_text(stmt, sql_pos++, record->tags.c_str(), record->tags.length(), SQLITE_STATIC);
+            sqlite3_bind_double(stmt, sql_pos++, record->datarate);
+
+            break;
         }
+        case kismetdb_log_record::record_type::data: {
+            stmt = data_stmt;
+
+            const auto& uuidstring = writer_uuid_string(record->datasource);
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_sec);
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_usec);
+
+            sqlite3_bind_text(stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_STATIC);
+
+            sqlite3_bind_double(stmt, sql_pos++, record->lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->lon);
+            sqlite3_bind_double(stmt, sql_pos++, record->alt);
+            sqlite3_bind_double(stmt, sql_pos++, record->speed);
+            sqlite3_bind_double(stmt, sql_pos++, record->heading);
+
+            sqlite3_bind_text(stmt, sql_pos++, uuidstring.c_str(), uuidstring.length(), SQLITE_STATIC);
+
+            sqlite3_bind_text(stmt, sql_pos++, record->header.data(), record->header.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, record->content.data(), record->content.length(), SQLITE_STATIC);
+
+            break;
+        }
+        case kismetdb_log_record::record_type::alert:
+            stmt = alert_stmt;
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_sec);
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_usec);
+
+            sqlite3_bind_text(stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_STATIC);
+
+            if (record->has_location) {
+                sqlite3_bind_double(stmt, sql_pos++, record->lat);
+                sqlite3_bind_double(stmt, sql_pos++, record->lon);
+            } else {
+                sqlite3_bind_int(stmt, sql_pos++, 0);
+                sqlite3_bind_int(stmt, sql_pos++, 0);
+            }
+
+            sqlite3_bind_text(stmt, sql_pos++, record->header.c_str(), record->header.length(), SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, sql_pos++, record->content.data(), record->content.length(), SQLITE_STATIC);
+
+            break;
+        case kismetdb_log_record::record_type::snapshot:
+            stmt = snapshot_stmt;
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_sec);
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_usec);
+
+            if (record->has_location) {
+                sqlite3_bind_double(stmt, sql_pos++, record->lat);
+                sqlite3_bind_double(stmt, sql_pos++, record->lon);
+            } else {
+                sqlite3_bind_int(stmt, sql_pos++, 0);
+                sqlite3_bind_int(stmt, sql_pos++, 0);
+            }
+
+            sqlite3_bind_text(stmt, sql_pos++, record->header.c_str(), record->header.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, record->content.data(), record->content.length(), SQLITE_STATIC);
+
+            break;
+        case kismetdb_log_record::record_type::device: {
+            stmt = device_stmt;
+
+            const std::string *blob = &record->content;
+            bool compressed = false;
+
+            if (compress_devices) {
+                auto complen = compressBound(record->content.length());
+                writer_compress_buf.resize(complen);
+
+                if (compress2((Bytef *) &writer_compress_buf[0], &complen, 
+                            (const Bytef *) record->content.data(), record->content.length(), 
+                            Z_BEST_SPEED) == Z_OK) {
+                    writer_compress_buf.resize(complen);
+                    blob = &writer_compress_buf;
+                    compressed = true;
+                }
+            }
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->first_time);
+            sqlite3_bind_int64(stmt, sql_pos++, record->last_time);
+            sqlite3_bind_text(stmt, sql_pos++, record->devkey.c_str(), record->devkey.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_STATIC);
+            sqlite3_bind_int(stmt, sql_pos++, record->signal);
+
+            sqlite3_bind_double(stmt, sql_pos++, record->min_lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->min_lon);
+            sqlite3_bind_double(stmt, sql_pos++, record->max_lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->max_lon);
+            sqlite3_bind_double(stmt, sql_pos++, record->lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->lon);
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->datasize);
+            sqlite3_bind_text(stmt, sql_pos++, record->header.c_str(), record->header.length(), SQLITE_STATIC);
+
+            sqlite3_bind_blob(stmt, sql_pos++, blob->data(), blob->length(), SQLITE_STATIC);
+            sqlite3_bind_int(stmt, sql_pos++, compressed);
+
+            break;
+        }
+        case kismetdb_log_record::record_type::message:
+            stmt = message_stmt;
+
+            sqlite3_bind_int64(stmt, sql_pos++, record->ts_sec);
+
+            sqlite3_bind_double(stmt, sql_pos++, record->lat);
+            sqlite3_bind_double(stmt, sql_pos++, record->lon);
+
+            sqlite3_bind_text(stmt, sql_pos++, record->header.c_str(), record->header.length(), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, sql_pos++, record->content.c_str(), record->content.length(), SQLITE_STATIC);
+
+            break;
     }
 
-    sqlite3_bind_text(snapshot_stmt, 5, snaptype.c_str(), snaptype.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(snapshot_stmt, 6, json.data(), json.length(), SQLITE_TRANSIENT);
+    if (stmt == nullptr)
+        return 0;
 
-    if (sqlite3_step(snapshot_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert snapshot in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
+    int r = sqlite3_step(stmt);
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (r != SQLITE_DONE) {
+        _MSG_ERROR("kis_database_logfile unable to insert record in {}: {}", ds_dbfile, sqlite3_errmsg(db));
         return -1;
     }
 
-    sqlite3_finalize(snapshot_stmt);
-
     return 1;
 }
 
+void kis_database_logfile::writer_thread_func() {
+    std::vector<kismetdb_log_record *> batch(writer_batch_max);
+    time_t last_drop_report = 0;
+
+    // Records still held from a batch we couldn't get the database lock for
+    size_t n = 0;
+
+    while (true) {
+        if (n == 0) {
+            n = writer_queue.wait_dequeue_bulk_timed(batch.data(), batch.size(), 
+                    std::chrono::milliseconds(500));
+
+            if (n == 0 && writer_shutdown)
+                break;
+        }
+
+        bool failed = false;
+
+        {
+            kis_unique_lock<kis_mutex> dblock(ds_mutex, std::defer_lock, "kismetdb writer");
+
+            try {
+                db_lock_with_sync_check(dblock, return);
+            } catch (const std::exception& e) {
+                if (Globalreg::globalreg->fatal_condition) {
+                    // A stalled transaction is fatal; stop taking records and let
+                    // the shutdown close the log
+                    db_enabled = false;
+
+                    for (size_t i = 0; i < n; i++)
+                        delete batch[i];
+
+                    _MSG_ERROR("The kismetdb log writer could not lock the database ({}); no "
+                            "further records will be logged.", e.what());
+                    break;
+                }
+
+                // Keep the batch and try again; the queue backs up in the meantime
+                // and overflows are counted as drops
+                _MSG_ERROR("The kismetdb log writer timed out waiting for the database ({}), "
+                        "retrying.", e.what());
+                continue;
+            }
+
+            // The whole batch goes into the current transaction under one lock
+            for (size_t i = 0; i < n; i++) {
+                if (batch[i] != nullptr && !failed && db != nullptr) {
+                    if (write_log_record(batch[i]) < 0)
+                        failed = true;
+                }
+
+                delete batch[i];
+            }
+
+            n = 0;
+
+            if (!failed && db != nullptr && time(0) - last_transaction >= 10) {
+                in_transaction_sync = true;
+
+                sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+                sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+                in_transaction_sync = false;
+
+                last_transaction = time(0);
+            }
+        }
+
+        if (writer_dropped > 0 && time(0) - last_drop_report >= 10) {
+            last_drop_report = time(0);
+            _MSG_ERROR("The kismetdb log could not keep up and dropped {} records; the disk "
+                    "may be too slow, or kis_log_write_queue may need to be larger.", 
+                    writer_dropped.exchange(0));
+        }
+
+        if (failed) {
+            close_log();
+            break;
+        }
+    }
+}
+
+void kis_database_logfile::stop_writer() {
+    writer_shutdown = true;
+    writer_queue.enqueue(nullptr);
+
+    if (!writer_thread.joinable())
+        return;
+
+    // The writer closes the log itself on an insert error and can't wait on itself;
+    // it exits as soon as close_log returns, so let it go
+    if (writer_thread.get_id() == std::this_thread::get_id())
+        writer_thread.detach();
+    else
+        writer_thread.join();
+}
 
 void kis_database_logfile::usage(const char *argv0) {
 
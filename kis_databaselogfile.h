@@ -40,6 +40,7 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
 
 #include "globalregistry.h"
 #include "kis_mutex.h"
@@ -53,10 +54,90 @@
 #include "class_filter.h"
 #include "packet_filter.h"
 #include "messagebus.h"
+#include "moodycamel/blockingconcurrentqueue.h"
 
 // Kismetdb version
+//
+// 8 - devices.compressed flags device records stored as zlib-compressed JSON
 
-#define KISMETDB_LOG_VERSION        7
+#define KISMETDB_LOG_VERSION        8
+
+// A single insert queued for the kismetdb writer thread; everything needed to bind
+// the insert is copied out of the source record, and MAC, UUID, and phy names are
+// only formatted once the writer gets to it
+struct kismetdb_log_record {
+    enum class record_type {
+        packet, data, alert, snapshot, message, device
+    };
+
+    kismetdb_log_record(record_type type) :
+        type {type},
+        ts_sec {0},
+        ts_usec {0},
+        phyid {-1},
+        frequency {0},
+        has_location {false},
+        lat {0},
+        lon {0},
+        alt {0},
+        speed {0},
+        heading {0},
+        signal {0},
+        datarate {0},
+        dlt {0},
+        error {0},
+        first_time {0},
+        last_time {0},
+        min_lat {0},
+        min_lon {0},
+        max_lat {0},
+        max_lon {0},
+        datasize {0},
+        packet_len {0} { }
+
+    record_type type;
+
+    uint64_t ts_sec;
+    uint64_t ts_usec;
+
+    // Phy by id for packets, or by name for everything else
+    int phyid;
+    std::string phyname;
+
+    mac_addr sourcemac;
+    mac_addr destmac;
+    mac_addr transmac;
+
+    uuid datasource;
+
+    double frequency;
+
+    bool has_location;
+    double lat, lon, alt, speed, heading;
+
+    int signal;
+    double datarate;
+    unsigned int dlt;
+    int error;
+
+    // Data type, alert header, snapshot type, or message type
+    std::string header;
+    std::string tags;
+
+    // Device summary columns
+    uint64_t first_time;
+    uint64_t last_time;
+    std::string devkey;
+    double min_lat, min_lon, max_lat, max_lon;
+    uint64_t datasize;
+
+    // Original length of the captured frame, which may be longer than the
+    // content when the capture source sliced it
+    uint64_t packet_len;
+
+    // Packet bytes, json, or message text
+    std::string content;
+};
 
 // This is a bit of a unique case - because so many things plug into this, it has
 // to exist as a global record; we build it like we do any other global record;
@@ -93,7 +174,10 @@ public:
 
     virtual int database_upgrade_db() override;
 
-    // Log a vector of multiple devices, replacing any old device records
+    // Log a device, replacing any old record of it.  The device is serialized under
+    // the devicelist lock and written by the writer thread.  Callers logging many
+    // devices should not hold the devicelist lock themselves, and will wait for the
+    // writer when the queue is full instead of dropping devices.
     virtual int log_device(std::shared_ptr<kis_tracked_device_base> in_device);
 
     // Device logs are non-streaming; we need to know the last time we generated
@@ -102,6 +186,9 @@ public:
 
     // Log a packet
     virtual int log_packet(kis_packet *in_packet);
+    // Log a batch of packets from the packet chain, handing all of their records to
+    // the writer in one queue operation
+    virtual int log_packets(const std::vector<kis_packet *>& in_packets);
 
     // Log data that isn't a packet; this is a slightly more clunky API because we 
     // can't derive the data from the simple packet interface.  GPS may be null,
@@ -175,7 +262,48 @@ protected:
     // Keep track of our commit cycles; to avoid thrashing the filesystem with
     // commit state we run a 10 second tranasction commit loop
     kis_mutex transaction_mutex;
-    int transaction_timer;
+    time_t last_transaction;
+
+    // Cached insert statements, prepared when the log is opened
+    sqlite3_stmt *packet_stmt;
+    sqlite3_stmt *data_stmt;
+    sqlite3_stmt *alert_stmt;
+    sqlite3_stmt *snapshot_stmt;
+    sqlite3_stmt *message_stmt;
+    sqlite3_stmt *device_stmt;
+
+    bool prepare_log_statements();
+    void finalize_log_statements();
+
+    // Packets, data, alerts, snapshots, and messages are queued and inserted in
+    // batches by the writer thread, so the callers never wait on sqlite
+    moodycamel::BlockingConcurrentQueue<kismetdb_log_record *> writer_queue;
+    std::thread writer_thread;
+    std::atomic<bool> writer_shutdown;
+    size_t writer_batch_max;
+    size_t writer_queue_max;
+    std::atomic<uint64_t> writer_dropped;
+
+    void writer_thread_func();
+    void stop_writer();
+
+    bool queue_log_record(kismetdb_log_record *record, bool wait_for_space = false);
+    // Queue a group of records; records which don't fit in the queue are dropped.  
+    // Returns the number of records queued and empties the vector.
+    size_t queue_log_records(std::vector<kismetdb_log_record *>& records);
+    int write_log_record(kismetdb_log_record *record);
+
+    // Build the packet and metadata records for a packet which passes the filters
+    void build_packet_records(kis_packet *in_pack, std::vector<kismetdb_log_record *>& records);
+
+    // Store device records as zlib-compressed json
+    bool compress_devices;
+    std::string writer_compress_buf;
+
+    // The writer is the only thread formatting datasource uuids
+    uuid writer_last_uuid;
+    std::string writer_last_uuid_str;
+    const std::string& writer_uuid_string(const uuid& in_uuid);
 
     // Packet time limit
     unsigned int packet_timeout;
@@ -18,6 +18,9 @@
 
 #include "config.h"
 
+#include <fcntl.h>
+#include <zlib.h>
+
 #include "kis_datasource.h"
 #include "endian_magic.h"
 #include "configfile.h"
@@ -27,6 +30,71 @@
 #include "packetchain.h"
 #include "timetracker.h"
 
+// Layer1 signal info from either a protobuf SubSignal or a shared memory ring record;
+// the signal source provides the protobuf-style has_x() / x() accessors
+template<typename S>
+static kis_layer1_packinfo *build_layer1_packinfo(const S& in_sig) {
+    kis_layer1_packinfo *siginfo = packet_component_pool<kis_layer1_packinfo>::acquire();
+
+    if (in_sig.has_signal_dbm()) {
+        siginfo->signal_type = kis_l1_signal_type_dbm;
+        siginfo->signal_dbm = in_sig.signal_dbm();
+    }
+
+    if (in_sig.has_noise_dbm()) {
+        siginfo->signal_type = kis_l1_signal_type_dbm;
+        siginfo->noise_dbm = in_sig.noise_dbm();
+    }
+
+    if (in_sig.has_signal_rssi()) {
+        siginfo->signal_type = kis_l1_signal_type_rssi;
+        siginfo->signal_rssi = in_sig.signal_rssi();
+    }
+
+    if (in_sig.has_noise_rssi()) {
+        siginfo->signal_type = kis_l1_signal_type_rssi;
+        siginfo->noise_rssi = in_sig.noise_rssi();
+    }
+
+    if (in_sig.has_freq_khz()) 
+        siginfo->freq_khz = in_sig.freq_khz();
+
+    if (in_sig.has_channel())
+        siginfo->channel = in_sig.channel();
+
+    if (in_sig.has_datarate()) 
+        siginfo->datarate = in_sig.datarate();
+
+    return siginfo;
+}
+
+// SubSignal-style accessors for the signal fields of a shared memory ring record
+class shm_record_signal {
+public:
+    shm_record_signal(const kis_shm_record_t *rec) : rec{rec} { }
+
+    bool has_signal_dbm() const { return rec->fields & KIS_SHM_FIELD_SIGNAL_DBM; }
+    bool has_noise_dbm() const { return rec->fields & KIS_SHM_FIELD_NOISE_DBM; }
+    bool has_signal_rssi() const { return rec->fields & KIS_SHM_FIELD_SIGNAL_RSSI; }
+    bool has_noise_rssi() const { return rec->fields & KIS_SHM_FIELD_NOISE_RSSI; }
+    bool has_freq_khz() const { return rec->fields & KIS_SHM_FIELD_FREQ_KHZ; }
+    bool has_channel() const { return rec->fields & KIS_SHM_FIELD_CHANNEL; }
+    bool has_datarate() const { return rec->fields & KIS_SHM_FIELD_DATARATE; }
+
+    double signal_dbm() const { return rec->signal_dbm; }
+    double noise_dbm() const { return rec->noise_dbm; }
+    double signal_rssi() const { return rec->signal_rssi; }
+    double noise_rssi() const { return rec->noise_rssi; }
+    double freq_khz() const { return rec->freq_khz; }
+    std::string channel() const { 
+        return std::string(rec->channel, strnlen(rec->channel, KIS_SHM_CHANNEL_LEN));
+    }
+    double datarate() const { return rec->datarate; }
+
+protected:
+    const kis_shm_record_t *rec;
+};
+
 // We never instantiate from a generic tracker component or from a stored
 // record so we always re-allocate ourselves
 kis_datasource::kis_datasource(shared_datasource_builder in_builder) :
@@ -287,7 +355,8 @@ void kis_datasource::open_interface(std::string in_definition, unsigned int in_t
     if (error_timer_id > 0)
         timetracker->remove_timer(error_timer_id);
 
-    // Launch the IPC
+    // Launch the IPC, offering the helper a frame ring if we're configured to
+    create_shm_ring();
     launch_ipc();
 
     set_int_source_running(true);
@@ -563,11 +632,173 @@ void kis_datasource::close_external() {
 
     set_int_source_running(false);
 
+    release_shm_ring();
+
     lk.unlock();
     cancel_all_commands("source closed");
     kis_external_interface::close_external();
 }
 
+void kis_datasource::create_shm_ring() {
+    release_shm_ring();
+
+    auto datasourcetracker =
+        Globalreg::fetch_mandatory_global_as<datasource_tracker>("DATASOURCETRACKER");
+    auto defaults = datasourcetracker->get_config_defaults();
+
+    if (!get_definition_opt_bool("shm_ring", defaults->get_shm_ring()))
+        return;
+
+    auto ring = kis_shm_ring_create((size_t) defaults->get_shm_ring_kb() * 1024);
+
+    if (ring == nullptr) {
+        _MSG_ERROR("Data source '{}' could not create a shared memory frame ring ({}), "
+                "frames will be sent over IPC", get_source_name(), kis_strerror_r(errno));
+        return;
+    }
+
+    int notifypair[2];
+
+    // Only the helper we launch should inherit these; create them close-on-exec where
+    // we can so a helper launched by another thread never sees them
+#ifdef HAVE_PIPE2
+    if (pipe2(notifypair, O_CLOEXEC) < 0) {
+#else
+    if (pipe(notifypair) < 0) {
+#endif
+        _MSG_ERROR("Data source '{}' could not create a shared memory frame ring pipe ({}), "
+                "frames will be sent over IPC", get_source_name(), kis_strerror_r(errno));
+        kis_shm_ring_free(ring);
+        return;
+    }
+
+#ifndef HAVE_PIPE2
+    fcntl(notifypair[0], F_SETFD, FD_CLOEXEC);
+    fcntl(notifypair[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    shm_ring = std::shared_ptr<kis_shm_ring_t>(ring, kis_shm_ring_free);
+    shm_notify = std::make_shared<boost::asio::posix::stream_descriptor>(Globalreg::globalreg->io,
+            notifypair[0]);
+
+    shm_child_fd = ring->shm_fd;
+    shm_child_notify_fd = notifypair[1];
+
+    ipc_child_fds = {shm_child_fd, shm_child_notify_fd};
+}
+
+void kis_datasource::close_shm_child_fds() {
+    for (auto fd : ipc_child_fds)
+        ::close(fd);
+
+    ipc_child_fds.clear();
+
+    // The mapping stays valid without the descriptor
+    if (shm_ring != nullptr)
+        shm_ring->shm_fd = -1;
+}
+
+void kis_datasource::release_shm_ring() {
+    close_shm_child_fds();
+
+    if (shm_notify != nullptr) {
+        try {
+            shm_notify->cancel();
+            shm_notify->close();
+        } catch (const std::exception& e) {
+            ;
+        }
+
+        shm_notify.reset();
+    }
+
+    // Any drain still queued on the strand holds its own reference
+    shm_ring.reset();
+}
+
+void kis_datasource::drain_shm_ring(std::shared_ptr<kis_external_interface> ref,
+        std::shared_ptr<kis_shm_ring_t> ring,
+        std::shared_ptr<boost::asio::posix::stream_descriptor> notify) {
+    if (stopped || cancelled || !notify->is_open())
+        return;
+
+    kis_shm_record_t *rec;
+    unsigned int n = 0;
+    int r = 0;
+
+    bool paused = get_source_paused();
+
+    rx_batch.clear();
+    rx_batching = true;
+
+    while (n < shm_drain_max && (r = kis_shm_ring_peek(ring.get(), &rec)) > 0) {
+        if (!paused)
+            handle_rx_packet(build_shm_packet(rec));
+
+        kis_shm_ring_consume(ring.get(), rec);
+        n++;
+    }
+
+    rx_batching = false;
+
+    packetchain->process_packets(rx_batch);
+    rx_batch.clear();
+
+    if (r < 0)
+        return trigger_error("Corrupt shared memory frame ring");
+
+    // Yield to the pipe traffic, or go around again if data raced our sleep
+    if (n >= shm_drain_max || !kis_shm_ring_prepare_wait(ring.get())) {
+        boost::asio::post(strand_, [this, ref, ring, notify]() { 
+                drain_shm_ring(ref, ring, notify); 
+                });
+        return;
+    }
+
+    notify->async_read_some(boost::asio::buffer(shm_notify_buf),
+            boost::asio::bind_executor(strand_, 
+                [this, ref, ring, notify](const boost::system::error_code& ec, std::size_t) {
+                if (ec)
+                    return;
+
+                drain_shm_ring(ref, ring, notify);
+                }));
+}
+
+kis_packet *kis_datasource::build_shm_packet(const kis_shm_record_t *rec) {
+    kis_packet *packet = packetchain->generate_packet();
+
+    packet->ts.tv_sec = rec->ts_sec;
+    packet->ts.tv_usec = rec->ts_usec;
+
+    kis_datachunk *datachunk = packet_component_pool<kis_datachunk>::acquire();
+
+    if (get_source_override_linktype()) {
+        datachunk->dlt = get_source_override_linktype();
+    } else {
+        datachunk->dlt = rec->dlt;
+    }
+
+    // The ring slot is reused as soon as we consume it
+    datachunk->copy_data(rec->data, rec->data_sz);
+
+    // Sliced frames carry the length they had before the helper cut them
+    if (rec->orig_sz > rec->data_sz)
+        packet->original_len = rec->orig_sz;
+
+    get_source_packet_size_rrd()->add_sample(std::max(rec->orig_sz, rec->data_sz), time(0));
+
+    packet->insert(pack_comp_linkframe, datachunk);
+
+    if (rec->fields != 0)
+        packet->insert(pack_comp_l1info, build_layer1_packinfo(shm_record_signal(rec)));
+
+    if (suppress_gps)
+        packet->insert(pack_comp_no_gps, new kis_no_gps_packinfo());
+
+    return packet;
+}
+
 std::string kis_datasource::get_definition_opt(std::string in_opt) {
     auto i = source_definition_opts.find(str_lower(in_opt));
 
@@ -607,6 +838,27 @@ double kis_datasource::get_definition_opt_double(std::string in_opt, double in_d
     return d;
 }
 
+unsigned int kis_datasource::get_definition_opt_uint(std::string in_opt, unsigned int in_def) {
+    auto i = source_definition_opts.find(str_lower(in_opt));
+    std::string opt;
+
+    if (i != source_definition_opts.end())
+        opt = i->second;
+    else
+        return in_def;
+
+    std::stringstream ss;
+    ss << opt << std::endl;
+
+    unsigned int u;
+    ss >> u;
+
+    if (ss.fail())
+        return in_def;
+
+    return u;
+}
+
 bool kis_datasource::parse_interface_definition(std::string in_definition) {
     kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource parse_interface");
 
@@ -674,6 +926,53 @@ bool kis_datasource::parse_interface_definition(std::string in_definition) {
     clobber_timestamp = get_definition_opt_bool("timestamp", 
             datasourcetracker->get_config_defaults()->get_remote_cap_timestamp());
 
+    // Batching holds packets back, so only remote sources batch by default
+    batch_max_packets = get_definition_opt_uint("batch_packets",
+            get_source_remote() ?
+            datasourcetracker->get_config_defaults()->get_remote_batch_packets() :
+            datasourcetracker->get_config_defaults()->get_batch_packets());
+    batch_max_bytes = get_definition_opt_uint("batch_bytes",
+            datasourcetracker->get_config_defaults()->get_batch_bytes());
+    // Remote sensors are often on slow links, where longer batches save more
+    batch_max_msec = get_definition_opt_uint("batch_msec",
+            get_source_remote() ?
+            datasourcetracker->get_config_defaults()->get_remote_batch_msec() :
+            datasourcetracker->get_config_defaults()->get_batch_msec());
+
+    compress_level = 0;
+    if (get_definition_opt_bool("compress",
+                datasourcetracker->get_config_defaults()->get_remote_compress()))
+        compress_level = get_definition_opt_uint("compress_level",
+                datasourcetracker->get_config_defaults()->get_remote_compress_level());
+
+    // Header-only capture is mostly useful for remote sensors, but any source
+    // can ask for it
+    slice_snaplen = get_definition_opt_uint("snaplen",
+            get_source_remote() ?
+            datasourcetracker->get_config_defaults()->get_remote_snaplen() : 0);
+    slice_keep_mgmt = get_definition_opt_bool("snaplen_mgmt", true);
+    slice_keep_ctrl = get_definition_opt_bool("snaplen_ctrl", true);
+
+    // Ethertypes of unencrypted data frames sent whole, in hex; EAPOL by default
+    slice_keep_ethertypes.clear();
+
+    auto ethertypes = get_definition_opt("snaplen_ethertypes");
+    if (ethertypes.length() == 0)
+        ethertypes = "888e";
+
+    for (const auto& e : str_tokenize(ethertypes, ",")) {
+        std::stringstream ss;
+        unsigned int et;
+
+        ss << std::hex << e;
+        ss >> et;
+
+        if (ss.fail() || et > 0xFFFF)
+            continue;
+
+        slice_keep_ethertypes.push_back(et);
+    }
+
     set_source_info_antenna_type(get_definition_opt("info_antenna_type"));
     set_source_info_antenna_gain(get_definition_opt_double("info_antenna_gain", 0.0f));
     set_source_info_antenna_orientation(get_definition_opt_double("info_antenna_orientation", 0.0f));
@@ -773,6 +1072,16 @@ bool kis_datasource::dispatch_rx_packet(std::shared_ptr<KismetExternal::Command>
     } else if (c->command() == "KDSDATAREPORT") {
         handle_packet_data_report(c->seqno(), c->content());
         return true;
+    } else if (c->command() == "KDSDATABATCH") {
+        // A compressing helper sends batches which would not shrink as they are
+        if (compress_level > 0 && get_source_remote())
+            add_batch_compress_bytes(c->content().size(), c->content().size());
+
+        handle_packet_data_batch(c->seqno(), c->content());
+        return true;
+    } else if (c->command() == "KDSDATABATCHZ") {
+        handle_packet_data_batch_z(c->seqno(), c->content());
+        return true;
     } else if (c->command() == "KDSERRORREPORT") {
         handle_packet_error_report(c->seqno(), c->content());
         return true;
@@ -790,6 +1099,9 @@ bool kis_datasource::dispatch_rx_packet(std::shared_ptr<KismetExternal::Command>
     } else if (c->command() == "KDSWARNINGREPORT") {
         handle_packet_warning_report(c->seqno(), c->content());
         return true;
+    } else if (c->command() == "KDSSTATSREPORT") {
+        handle_packet_stats_report(c->seqno(), c->content());
+        return true;
     }
 
     return false;
@@ -1253,6 +1565,110 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
         return;
     }
 
+    handle_rx_packet(build_data_report_packet(report, nullptr, nullptr));
+}
+
+void kis_datasource::handle_packet_data_batch(uint32_t in_seqno, const std::string& in_content) {
+    // If we're paused, throw away the whole batch
+    {
+        kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource handle_packet_data_batch");
+
+        if (get_source_paused())
+            return;
+    }
+
+    auto batch = std::make_shared<KismetDatasource::DataBatchReport>();
+
+    if (!batch->ParseFromString(in_content)) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" could not parse the batched data report, something is wrong with "
+                    "the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSDATABATCH");
+        return;
+    }
+
+    const KismetDatasource::SubGps *batch_gps = nullptr;
+    const KismetDatasource::SubSignal *prev_signal = nullptr;
+
+    if (batch->has_gps())
+        batch_gps = &(batch->gps());
+
+    rx_batch.clear();
+    rx_batch.reserve(batch->reports_size());
+    rx_batching = true;
+
+    for (int i = 0; i < batch->reports_size(); i++) {
+        // Each report shares ownership of the batch so the packet data can reference
+        // the parsed buffer directly
+        auto report = std::shared_ptr<KismetDatasource::DataReport>(batch, batch->mutable_reports(i));
+
+        handle_rx_packet(build_data_report_packet(report, batch_gps, prev_signal));
+
+        if (report->has_signal())
+            prev_signal = &(report->signal());
+        else if (!report->repeat_signal())
+            prev_signal = nullptr;
+    }
+
+    rx_batching = false;
+
+    packetchain->process_packets(rx_batch);
+    rx_batch.clear();
+}
+
+void kis_datasource::handle_packet_data_batch_z(uint32_t in_seqno, const std::string& in_content) {
+    KismetDatasource::CompressedDataBatch zbatch;
+
+    if (!zbatch.ParseFromString(in_content) || 
+            zbatch.uncompressed_sz() > compress_max_batch_sz) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" could not parse the compressed data report, something is wrong with "
+                    "the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSDATABATCHZ");
+        return;
+    }
+
+    add_batch_compress_bytes(zbatch.uncompressed_sz(), zbatch.data().size());
+
+    // Don't decompress batches we'd throw away
+    {
+        kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource handle_packet_data_batch_z");
+
+        if (get_source_paused())
+            return;
+    }
+
+    std::string batch;
+    batch.resize(zbatch.uncompressed_sz());
+    uLongf batch_len = batch.size();
+
+    if (uncompress(reinterpret_cast<Bytef *>(&batch[0]), &batch_len,
+                reinterpret_cast<const Bytef *>(zbatch.data().data()), 
+                zbatch.data().size()) != Z_OK || batch_len != batch.size()) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" sent a compressed data report which could not be decompressed, "
+                    "something is wrong with the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSDATABATCHZ");
+        return;
+    }
+
+    handle_packet_data_batch(in_seqno, batch);
+}
+
+void kis_datasource::add_batch_compress_bytes(size_t raw_sz, size_t wire_sz) {
+    kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource add_batch_compress_bytes");
+
+    (*source_compress_raw_bytes) += raw_sz;
+    (*source_compress_bytes) += wire_sz;
+
+    if (source_compress_bytes->get() > 0)
+        source_compress_ratio->set((double) source_compress_raw_bytes->get() /
+                (double) source_compress_bytes->get());
+}
+
+kis_packet *kis_datasource::build_data_report_packet(std::shared_ptr<KismetDatasource::DataReport> report,
+        const KismetDatasource::SubGps *batch_gps,
+        const KismetDatasource::SubSignal *prev_signal) {
     if (report->has_message()) 
         handle_msg_proxy(report->message().msgtext(), report->message().msgtype());
 
@@ -1265,7 +1681,7 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
 
     // Process the data chunk
     if (report->has_packet()) {
-        kis_datachunk *datachunk = new kis_datachunk();
+        kis_datachunk *datachunk = packet_component_pool<kis_datachunk>::acquire();
 
         if (clobber_timestamp && get_source_remote()) {
             gettimeofday(&(packet->ts), NULL);
@@ -1285,7 +1701,13 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
 
         datachunk->set_data(const_cast<char *>(report->packet().data().data()), report->packet().data().length(), false);
 
-        get_source_packet_size_rrd()->add_sample(report->packet().data().length(), time(0));
+        // Sliced frames carry the length they had before the helper cut them
+        if (report->packet().size() > report->packet().data().length())
+            packet->original_len = report->packet().size();
+
+        get_source_packet_size_rrd()->add_sample(
+                std::max<uint64_t>(report->packet().size(), report->packet().data().length()), 
+                time(0));
 
         packet->insert(pack_comp_linkframe, datachunk);
     }
@@ -1293,7 +1715,7 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
     // Process JSON
     if (report->has_json()) {
         // fprintf(stderr, "debug - got JSON report- %s\n", report.json().json().c_str());
-        kis_json_packinfo *jsoninfo = new kis_json_packinfo();
+        kis_json_packinfo *jsoninfo = packet_component_pool<kis_json_packinfo>::acquire();
       
         if (clobber_timestamp && get_source_remote()) {
             gettimeofday(&(packet->ts), NULL);
@@ -1325,30 +1747,34 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
         packet->insert(pack_comp_protobuf, bufinfo);
     }
 
-    // Signal
+    // Signal, possibly carried over from the previous report in a batch
     if (report->has_signal()) {
         kis_layer1_packinfo *siginfo = NULL;
         siginfo = handle_sub_signal(report->signal());
         packet->insert(pack_comp_l1info, siginfo);
+    } else if (report->repeat_signal() && prev_signal != nullptr) {
+        packet->insert(pack_comp_l1info, handle_sub_signal(*prev_signal));
     }
 
-    // GPS
+    // GPS, falling back to the GPS shared by the whole batch
     if (report->has_gps()) {
         kis_gps_packinfo *gpsinfo = NULL;
         gpsinfo = handle_sub_gps(report->gps());
         packet->insert(pack_comp_gps, gpsinfo);
+    } else if (batch_gps != nullptr) {
+        packet->insert(pack_comp_gps, handle_sub_gps(*batch_gps));
     } else if (suppress_gps) {
         auto nogpsinfo = new kis_no_gps_packinfo();
         packet->insert(pack_comp_no_gps, nogpsinfo);
     }
 
     // TODO handle spectrum
-   
-    handle_rx_packet(packet);
+
+    return packet;
 }
 
 void kis_datasource::handle_rx_packet(kis_packet *packet) {
-    packetchain_comp_datasource *datasrcinfo = new packetchain_comp_datasource();
+    packetchain_comp_datasource *datasrcinfo = packet_component_pool<packetchain_comp_datasource>::acquire();
     datasrcinfo->ref_source = this;
 
     packet->insert(pack_comp_datasrc, datasrcinfo);
@@ -1356,6 +1782,12 @@ void kis_datasource::handle_rx_packet(kis_packet *packet) {
     inc_source_num_packets(1);
     get_source_packet_rrd()->add_sample(1, time(0));
 
+    // Batched reports are handed to the packetchain together once decoded
+    if (rx_batching) {
+        rx_batch.push_back(packet);
+        return;
+    }
+
     // Inject the packet into the packetchain if we have one
     packetchain->process_packet(packet);
 }
@@ -1377,46 +1809,33 @@ void kis_datasource::handle_packet_warning_report(uint32_t in_seqno, const std::
     set_int_source_warning(report.warning());
 }
 
-kis_layer1_packinfo *kis_datasource::handle_sub_signal(KismetDatasource::SubSignal in_sig) {
-    // Extract l1 info from a KV pair so we can add it to a packet
-    
-    kis_layer1_packinfo *siginfo = new kis_layer1_packinfo();
+void kis_datasource::handle_packet_stats_report(uint32_t in_seqno, const std::string& in_content) {
+    kis_lock_guard<kis_mutex> lk(ext_mutex, "datasource handle_packet_stats_report");
 
-    if (in_sig.has_signal_dbm()) {
-        siginfo->signal_type = kis_l1_signal_type_dbm;
-        siginfo->signal_dbm = in_sig.signal_dbm();
-    }
+    KismetDatasource::StatsReport report;
 
-    if (in_sig.has_noise_dbm()) {
-        siginfo->signal_type = kis_l1_signal_type_dbm;
-        siginfo->noise_dbm = in_sig.noise_dbm();
-    }
-
-    if (in_sig.has_signal_rssi()) {
-        siginfo->signal_type = kis_l1_signal_type_rssi;
-        siginfo->signal_rssi = in_sig.signal_rssi();
+    if (!report.ParseFromString(in_content)) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" could not parse the stats report, something is wrong with "
+                    "the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSSTATSREPORT");
+        return;
     }
 
-    if (in_sig.has_noise_rssi()) {
-        siginfo->signal_type = kis_l1_signal_type_rssi;
-        siginfo->noise_rssi = in_sig.noise_rssi();
+    if (report.dropped() > 0) {
+        inc_source_num_dropped_packets(report.dropped());
+        get_source_packet_drop_rrd()->add_sample(report.dropped(), time(0));
     }
+}
 
-    if (in_sig.has_freq_khz()) 
-        siginfo->freq_khz = in_sig.freq_khz();
-
-    if (in_sig.has_channel())
-        siginfo->channel = in_sig.channel();
-
-    if (in_sig.has_datarate()) 
-        siginfo->datarate = in_sig.datarate();
-
-    return siginfo;
+kis_layer1_packinfo *kis_datasource::handle_sub_signal(KismetDatasource::SubSignal in_sig) {
+    // Extract l1 info from a KV pair so we can add it to a packet
+    return build_layer1_packinfo(in_sig);
 }
 
 kis_gps_packinfo *kis_datasource::handle_sub_gps(KismetDatasource::SubGps in_gps) {
     // Extract a GPS record from a packet and turn it into a packinfo gps log
-    kis_gps_packinfo *gpsinfo = new kis_gps_packinfo();
+    kis_gps_packinfo *gpsinfo = packet_component_pool<kis_gps_packinfo>::acquire();
 
     gpsinfo->lat = in_gps.lat();
     gpsinfo->lon = in_gps.lon();
@@ -1489,6 +1908,37 @@ unsigned int kis_datasource::send_open_source(std::string in_definition,
     KismetDatasource::OpenSource o;
     o.set_definition(in_definition);
 
+    // Helpers which don't understand batching ignore the offer and keep sending
+    // individual data reports
+    if (batch_max_packets > 1) {
+        auto b = o.mutable_batch();
+        b->set_max_packets(batch_max_packets);
+        b->set_max_bytes(batch_max_bytes);
+        b->set_max_usec(batch_max_msec * 1000);
+    }
+
+    // Compression is only worth it over the network, and only applies to batches
+    if (batch_max_packets > 1 && compress_level > 0 && get_source_remote())
+        o.mutable_compress()->set_level(compress_level);
+
+    // Helpers which don't understand slicing keep sending whole frames
+    if (slice_snaplen > 0) {
+        auto s = o.mutable_slice();
+        s->set_snaplen(slice_snaplen);
+        s->set_keep_mgmt(slice_keep_mgmt);
+        s->set_keep_ctrl(slice_keep_ctrl);
+
+        for (auto e : slice_keep_ethertypes)
+            s->add_keep_ethertypes(e);
+    }
+
+    // Local helpers launched with a frame ring inherited its descriptors
+    if (shm_ring != nullptr) {
+        auto s = o.mutable_shm();
+        s->set_shm_fd(shm_child_fd);
+        s->set_notify_fd(shm_child_notify_fd);
+    }
+
     c->set_content(o.SerializeAsString());
 
     seqno = send_packet(c);
@@ -1717,6 +2167,22 @@ void kis_datasource::register_fields() {
                 "received data RRD (in bytes)",
                 &packet_size_rrd);
 
+    register_field("kismet.datasource.num_dropped_packets",
+            "Number of packets dropped by the capture driver before reaching Kismet",
+            &source_num_dropped_packets);
+
+    packet_drop_rrd_id =
+        register_dynamic_field("kismet.datasource.packets_dropped_rrd",
+                "packets dropped by the capture driver RRD",
+                &packet_drop_rrd);
+
+    register_field("kismet.datasource.compression.raw_bytes",
+            "Bytes of batched data reports before compression", &source_compress_raw_bytes);
+    register_field("kismet.datasource.compression.compressed_bytes",
+            "Bytes of batched data reports as received, compressed or not", &source_compress_bytes);
+    register_field("kismet.datasource.compression.ratio",
+            "Compression ratio of batched data reports", &source_compress_ratio);
+
     register_field("kismet.datasource.retry", 
             "Source will try to re-open after failure", &source_retry);
     register_field("kismet.datasource.retry_attempts", 
@@ -1871,7 +2337,26 @@ bool kis_datasource::launch_ipc() {
 
     external_binary = get_source_ipc_binary();
 
-    if (run_ipc()) {
+    auto r = run_ipc();
+
+    // The helper holds its own copies of the ring descriptors now
+    if (shm_ring != nullptr && ipc_child_fds.size() > 0) {
+        close_shm_child_fds();
+
+        if (r) {
+            auto ref = shared_from_this();
+            auto ring = shm_ring;
+            auto notify = shm_notify;
+
+            boost::asio::post(strand_, [this, ref, ring, notify]() { 
+                    drain_shm_ring(ref, ring, notify); 
+                    });
+        } else {
+            release_shm_ring();
+        }
+    }
+
+    if (r) {
         set_int_source_ipc_pid(ipc.pid);
         return true;
     }
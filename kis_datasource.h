@@ -32,6 +32,7 @@
 #include "packetchain.h"
 #include "entrytracker.h"
 #include "kis_external.h"
+#include "shm_ring_c.h"
 #include "timetracker.h"
 
 #include "protobuf_cpp/kismet.pb.h"
@@ -333,6 +334,7 @@ public:
     virtual std::string get_definition_opt(std::string in_opt);
     virtual bool get_definition_opt_bool(std::string in_opt, bool in_default);
     virtual double get_definition_opt_double(std::string in_opt, double in_default);
+    virtual unsigned int get_definition_opt_uint(std::string in_opt, unsigned int in_default);
 
 
     // Kismet-only variables can be set realtime, they have no capture-binary
@@ -382,12 +384,23 @@ public:
     __ProxyM(source_num_error_packets, uint64_t, uint64_t, uint64_t, source_num_error_packets, ext_mutex);
     __ProxyIncDecM(Msource_num_error_packets, uint64_t, uint64_t, source_num_error_packets, ext_mutex);
 
+    __ProxyM(source_num_dropped_packets, uint64_t, uint64_t, uint64_t, source_num_dropped_packets, ext_mutex);
+    __ProxyIncDecM(source_num_dropped_packets, uint64_t, uint64_t, source_num_dropped_packets, ext_mutex);
+
     __ProxyDynamicTrackableM(source_packet_rrd, kis_tracked_rrd<>, 
             packet_rate_rrd, packet_rate_rrd_id, ext_mutex);
 
     __ProxyDynamicTrackableM(source_packet_size_rrd, kis_tracked_rrd<>, 
             packet_size_rrd, packet_size_rrd_id, ext_mutex);
 
+    __ProxyDynamicTrackableM(source_packet_drop_rrd, kis_tracked_rrd<>,
+            packet_drop_rrd, packet_drop_rrd_id, ext_mutex);
+
+    // Compressed batch traffic from remote helpers
+    __ProxyGetM(source_compress_raw_bytes, uint64_t, uint64_t, source_compress_raw_bytes, ext_mutex);
+    __ProxyGetM(source_compress_bytes, uint64_t, uint64_t, source_compress_bytes, ext_mutex);
+    __ProxyGetM(source_compress_ratio, double, double, source_compress_ratio, ext_mutex);
+
     // IPC binary name, if any
     __ProxyGetM(source_ipc_binary, std::string, std::string, source_ipc_binary, ext_mutex);
     // IPC channel pid, if any
@@ -534,11 +547,19 @@ protected:
 
     virtual void handle_packet_configure_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_data_report(uint32_t in_seqno, const std::string& in_packet);
+    virtual void handle_packet_data_batch(uint32_t in_seqno, const std::string& in_packet);
+    virtual void handle_packet_data_batch_z(uint32_t in_seqno, const std::string& in_packet);
+
+    // Count a batch against the compression stats, by its size before compression and
+    // its size on the wire; batches the helper could not shrink are sent plain and
+    // count at the same size for both
+    void add_batch_compress_bytes(size_t raw_sz, size_t wire_sz);
     virtual void handle_packet_error_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_interfaces_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_opensource_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_probesource_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_warning_report(uint32_t in_seqno, const std::string& in_packet);
+    virtual void handle_packet_stats_report(uint32_t in_seqno, const std::string& in_packet);
 
     virtual unsigned int send_configure_channel(std::string in_channel, unsigned int in_transaction,
             configure_callback_t in_cb);
@@ -557,6 +578,12 @@ protected:
     virtual kis_gps_packinfo *handle_sub_gps(KismetDatasource::SubGps in_gps);
     virtual kis_layer1_packinfo *handle_sub_signal(KismetDatasource::SubSignal in_signal);
 
+    // Build a packet from a single data report; batched reports supply the shared batch
+    // GPS and the signal to use when the report repeats the previous one
+    kis_packet *build_data_report_packet(std::shared_ptr<KismetDatasource::DataReport> report,
+            const KismetDatasource::SubGps *batch_gps,
+            const KismetDatasource::SubSignal *prev_signal);
+
 
     // Launch the IPC binary
     virtual bool launch_ipc();
@@ -645,12 +672,24 @@ protected:
     std::shared_ptr<tracker_element_uint64> source_num_packets;
     std::shared_ptr<tracker_element_uint64> source_num_error_packets;
 
+    // Packets the capture driver reports losing before they reached us, such as
+    // kernel ring overflows
+    std::shared_ptr<tracker_element_uint64> source_num_dropped_packets;
+
     int packet_rate_rrd_id;
     std::shared_ptr<kis_tracked_rrd<>> packet_rate_rrd;
 
     int packet_size_rrd_id;
     std::shared_ptr<kis_tracked_rrd<>> packet_size_rrd;
 
+    int packet_drop_rrd_id;
+    std::shared_ptr<kis_tracked_rrd<>> packet_drop_rrd;
+
+    // Bytes of batched data reports before and after compression, and their ratio
+    std::shared_ptr<tracker_element_uint64> source_compress_raw_bytes;
+    std::shared_ptr<tracker_element_uint64> source_compress_bytes;
+    std::shared_ptr<tracker_element_double> source_compress_ratio;
+
 
     // Local ID number is an increasing number assigned to each 
     // unique UUID; it's used inside Kismet for fast mapping for seenby, 
@@ -709,6 +748,43 @@ protected:
     // Do we clobber the remote timestamp?
     bool clobber_timestamp;
 
+    // Data report batching offered to the capture helper when opening
+    unsigned int batch_max_packets = 0, batch_max_bytes = 0, batch_max_msec = 0;
+
+    // zlib level offered to remote helpers for batches, 0 for none
+    unsigned int compress_level = 0;
+
+    // 802.11 slicing policy offered to the helper; a snaplen of 0 sends whole frames
+    unsigned int slice_snaplen = 0;
+    bool slice_keep_mgmt = true, slice_keep_ctrl = true;
+    std::vector<uint16_t> slice_keep_ethertypes;
+
+    // Largest decompressed batch we accept from a helper
+    static const size_t compress_max_batch_sz = 16 * 1024 * 1024;
+
+    // While a batch is being decoded, handle_rx_packet collects packets here so the
+    // whole batch enters the packet chain at once
+    bool rx_batching = false;
+    std::vector<kis_packet *> rx_batch;
+
+    // Shared memory frame ring for local helpers; the descriptor numbers are the
+    // ones the helper inherits and are sent to it in the open command
+    std::shared_ptr<kis_shm_ring_t> shm_ring;
+    std::shared_ptr<boost::asio::posix::stream_descriptor> shm_notify;
+    int shm_child_fd = -1, shm_child_notify_fd = -1;
+    std::array<uint8_t, 64> shm_notify_buf;
+
+    // Most records decoded per pass before yielding the strand to pipe traffic
+    static const unsigned int shm_drain_max = 1024;
+
+    void create_shm_ring();
+    void close_shm_child_fds();
+    void release_shm_ring();
+    void drain_shm_ring(std::shared_ptr<kis_external_interface> ref,
+            std::shared_ptr<kis_shm_ring_t> ring,
+            std::shared_ptr<boost::asio::posix::stream_descriptor> notify);
+    kis_packet *build_shm_packet(const kis_shm_record_t *rec);
+
     __ProxySetM(int_source_remote, uint8_t, bool, source_remote, ext_mutex);
     std::shared_ptr<tracker_element_uint8> source_remote;
 
@@ -858,6 +934,11 @@ public:
         ref_source = NULL;
     }
 
+    // Return to the freshly constructed state for reuse by a packet_component_pool
+    void reset() {
+        ref_source = NULL;
+    }
+
     virtual ~packetchain_comp_datasource() { }
 };
 
@@ -114,7 +114,7 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
 
         if (fh_len > linkchunk->length || fh_len > ph_len) {
             if (radioheader != NULL)
-                delete radioheader;
+                release_packet_component(radioheader);
 
             _MSG("pcap PPI converter got corrupt/invalid PPI field length",
                     MSGFLAG_ERROR);
@@ -132,7 +132,7 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
             if ((tuint & PPI_80211_FLAG_INVALFCS) || (tuint & PPI_80211_FLAG_PHYERROR)) {
                 // Junk packets that are FCS or phy compromised
                 if (radioheader != NULL)
-                    delete radioheader;
+                    release_packet_component(radioheader);
 
                 return 0;
             }
@@ -147,7 +147,7 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
             }
 
             if (radioheader == NULL)
-                radioheader = new kis_layer1_packinfo;
+                radioheader = packet_component_pool<kis_layer1_packinfo>::acquire();
 
             // Channel flags
             tuint = kis_letoh16(ppic->chan_flags);
@@ -178,7 +178,7 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
             ppi_11n_mac *ppin = (ppi_11n_mac *) ppi_fh;
 
             if (radioheader == NULL)
-                radioheader = new kis_layer1_packinfo;
+                radioheader = packet_component_pool<kis_layer1_packinfo>::acquire();
 
             // Decode greenfield notation
             tuint = kis_letoh16(ppin->flags);
@@ -191,7 +191,7 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
             ppi_11n_macphy *ppinp = (ppi_11n_macphy *) ppi_fh;
 
             if (radioheader == NULL)
-                radioheader = new kis_layer1_packinfo;
+                radioheader = packet_component_pool<kis_layer1_packinfo>::acquire();
 
             // Decode greenfield notation
             tuint = kis_letoh16(ppinp->flags);
@@ -267,10 +267,14 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
         }
     }
 
+    // Frames sliced by the capture source no longer end in their FCS
+    if (in_pack->original_len > linkchunk->length)
+        applyfcs = 0;
+
     if (applyfcs)
         applyfcs = 4;
 
-    decapchunk = new kis_datachunk;
+    decapchunk = packet_component_pool<kis_datachunk>::acquire();
 
     decapchunk->dlt = ppi_dlt;
 
@@ -211,8 +211,8 @@ int kis_dlt_radiotap::handle_packet(kis_packet *in_pack) {
         return 0;
     }
 
-	decapchunk = new kis_datachunk;
-	radioheader = new kis_layer1_packinfo;
+	decapchunk = packet_component_pool<kis_datachunk>::acquire();
+	radioheader = packet_component_pool<kis_layer1_packinfo>::acquire();
 
 	decapchunk->dlt = KDLT_IEEE802_11;
 	
@@ -411,13 +411,17 @@ int kis_dlt_radiotap::handle_packet(kis_packet *in_pack) {
         record_num++;
     }
 
+    // Frames sliced by the capture source no longer end in their FCS
+    if (in_pack->original_len > linkchunk->length)
+        fcs_cut = 0;
+
 	if (EXTRACT_LE_16BITS(&(hdr->it_len)) + fcs_cut > (int) linkchunk->length) {
 		/*
 		_MSG("Pcap Radiotap converter got corrupted Radiotap frame, not "
 			 "long enough for radiotap header plus indicated FCS", MSGFLAG_ERROR);
 		*/
-		delete decapchunk;
-		delete radioheader;
+		release_packet_component(decapchunk);
+		release_packet_component(radioheader);
         return 0;
 	}
 
@@ -17,6 +17,7 @@
 */
 
 #include <memory>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 #include "configfile.h"
@@ -491,6 +492,10 @@ bool kis_external_interface::run_ipc() {
                 ::close(inpipepair[1]);
                 ::close(outpipepair[0]);
 
+                // Keep any extra descriptors open across exec
+                for (auto fd : ipc_child_fds)
+                    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+
                 execvp(cmdarg[0], cmdarg);
 
                 exit(255);
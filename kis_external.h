@@ -185,6 +185,10 @@ protected:
     kis_ipc_record ipc;
     boost::asio::posix::stream_descriptor ipc_in, ipc_out;
 
+    // Additional descriptors the launched helper inherits, such as a shared memory
+    // frame ring; the owner closes its copies once the helper is running
+    std::vector<int> ipc_child_fds;
+
     std::atomic<bool> ipc_running;
 
 
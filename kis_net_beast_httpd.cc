@@ -78,12 +78,132 @@ kis_net_beast_httpd::kis_net_beast_httpd(boost::asio::ip::tcp::endpoint& endpoin
     deferred_startup{},
     running{false},
     endpoint{endpoint},
-    acceptor{Globalreg::globalreg->io} {
+    acceptor{Globalreg::globalreg->io},
+    connection_pool_{std::make_shared<kis_net_beast_worker_pool>("HTTP request",
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_request_threads", 64),
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_request_queue", 256))},
+    generator_pool_{std::make_shared<kis_net_beast_worker_pool>("HTTP generator",
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_generator_threads", 64),
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_generator_queue", 256))},
+    n_sockets{0},
+    n_sockets_peak{0},
+    n_requests{0},
+    n_websockets{0},
+    n_streams{0},
+    max_streams{Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_max_streams", 32)} {
 
     mime_mutex.set_name("kis_net_beast_httpd MIME map");
     route_mutex.set_name("kis_net_beast_httpd route vector");
     auth_mutex.set_name("kis_net_beast_httpd auth");
     static_mutex.set_name("kis_net_beast_httpd static");
+
+    stats_sockets =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.httpd.sockets",
+                tracker_element_factory<tracker_element_uint64>(),
+                "open HTTP sockets");
+    stats_sockets_peak =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.httpd.sockets_peak",
+                tracker_element_factory<tracker_element_uint64>(),
+                "peak open HTTP sockets");
+    stats_requests =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.httpd.requests",
+                tracker_element_factory<tracker_element_uint64>(),
+                "HTTP requests handled");
+    stats_websockets =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.httpd.websockets",
+                tracker_element_factory<tracker_element_uint64>(),
+                "active websockets");
+    stats_streams =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.httpd.streams",
+                tracker_element_factory<tracker_element_uint64>(),
+                "active long-running streams");
+
+    pool_threads_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.threads",
+                tracker_element_factory<tracker_element_uint64>(),
+                "worker threads");
+    pool_threads_max_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.threads_max",
+                tracker_element_factory<tracker_element_uint64>(),
+                "maximum worker threads");
+    pool_busy_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.busy",
+                tracker_element_factory<tracker_element_uint64>(),
+                "busy worker threads");
+    pool_queued_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queued",
+                tracker_element_factory<tracker_element_uint64>(),
+                "jobs waiting for a worker");
+    pool_queued_max_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queued_max",
+                tracker_element_factory<tracker_element_uint64>(),
+                "maximum queued jobs before rejecting");
+    pool_queued_peak_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queued_peak",
+                tracker_element_factory<tracker_element_uint64>(),
+                "peak queued jobs");
+    pool_completed_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.completed",
+                tracker_element_factory<tracker_element_uint64>(),
+                "completed jobs");
+    pool_rejected_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.rejected",
+                tracker_element_factory<tracker_element_uint64>(),
+                "jobs rejected because the pool and queue were full");
+    pool_wait_total_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queue_wait_us",
+                tracker_element_factory<tracker_element_uint64>(),
+                "total time jobs spent queued, in microseconds");
+    pool_wait_max_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queue_wait_max_us",
+                tracker_element_factory<tracker_element_uint64>(),
+                "longest time a job spent queued, in microseconds");
+
+    stats_connection_pool =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_map>("kismet.httpd.request_pool",
+                tracker_element_factory<tracker_element_map>(),
+                "HTTP request handling pool");
+    stats_generator_pool =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_map>("kismet.httpd.generator_pool",
+                tracker_element_factory<tracker_element_map>(),
+                "HTTP endpoint generator pool");
+
+    for (auto id : {pool_threads_id, pool_threads_max_id, pool_busy_id, pool_queued_id, 
+            pool_queued_max_id, pool_queued_peak_id, pool_completed_id, pool_rejected_id,
+            pool_wait_total_id, pool_wait_max_id}) {
+        stats_connection_pool->insert(std::make_shared<tracker_element_uint64>(id));
+        stats_generator_pool->insert(std::make_shared<tracker_element_uint64>(id));
+    }
+
+    stats_map = std::make_shared<tracker_element_map>();
+    stats_map->insert(stats_sockets);
+    stats_map->insert(stats_sockets_peak);
+    stats_map->insert(stats_requests);
+    stats_map->insert(stats_websockets);
+    stats_map->insert(stats_streams);
+    stats_map->insert(stats_connection_pool);
+    stats_map->insert(stats_generator_pool);
+}
+
+void kis_net_beast_httpd::update_pool_stats(std::shared_ptr<kis_net_beast_worker_pool> pool, 
+        std::shared_ptr<tracker_element_map> map) {
+    auto set_field = [&map](int id, uint64_t v) {
+        auto e = map->get_sub_as<tracker_element_uint64>(id);
+
+        if (e != nullptr)
+            e->set(v);
+    };
+
+    set_field(pool_threads_id, pool->threads());
+    set_field(pool_threads_max_id, pool->max_threads());
+    set_field(pool_busy_id, pool->busy());
+    set_field(pool_queued_id, pool->queued());
+    set_field(pool_queued_max_id, pool->max_queue());
+    set_field(pool_queued_peak_id, pool->queued_peak());
+    set_field(pool_completed_id, pool->completed());
+    set_field(pool_rejected_id, pool->rejected());
+    set_field(pool_wait_total_id, pool->queue_wait_us());
+    set_field(pool_wait_max_id, pool->queue_wait_max_us());
 }
 
 void kis_net_beast_httpd::trigger_deferred_startup() {
@@ -97,6 +217,7 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     register_mime_type("prettyjson", "application/json");
     register_mime_type("ekjson", "application/json");
     register_mime_type("itjson", "application/json");
+    register_mime_type("msgpack", "application/x-msgpack");
     register_mime_type("cmd", "application/json");
     register_mime_type("jcmd", "application/json");
     register_mime_type("xml", "application/xml");
@@ -208,6 +329,21 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     allowed_prefix = 
         Globalreg::globalreg->kismet_config->fetch_opt("httpd_uri_prefix");
 
+    register_route("/httpd/stats", {"GET", "POST"}, RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    stats_sockets->set(n_sockets);
+                    stats_sockets_peak->set(n_sockets_peak);
+                    stats_requests->set(n_requests);
+                    stats_websockets->set(n_websockets);
+                    stats_streams->set(n_streams);
+
+                    update_pool_stats(connection_pool_, stats_connection_pool);
+                    update_pool_stats(generator_pool_, stats_generator_pool);
+
+                    return stats_map;
+                }));
+
     // Basic session management endpoints
     register_unauth_route("/session/check_setup_ok", {"GET"}, 
             std::make_shared<kis_net_web_function_endpoint>(
@@ -433,6 +569,9 @@ int kis_net_beast_httpd::stop_httpd() {
 
     running = false;
 
+    connection_pool_->shutdown();
+    generator_pool_->shutdown();
+
     if (acceptor.is_open()) {
         try {
             acceptor.cancel();
@@ -461,41 +600,11 @@ void kis_net_beast_httpd::handle_connection(const boost::system::error_code& ec,
     if (!running)
         return;
 
-    auto socket_moved = std::promise<bool>();
-    auto socket_moved_ft = socket_moved.get_future();
-
     if (!ec) {
-        std::thread conthread([this, &socket, &socket_moved]() {
-                thread_set_process_name("beast connection");
-
-                auto mv_socket = boost::beast::tcp_stream{std::move(socket)};
-                socket_moved.set_value(true);
-
-                while (mv_socket.socket().is_open()) {
-                    // Associate the socket
-                    auto conn = 
-                        std::make_shared<kis_net_beast_httpd_connection>(mv_socket, shared_from_this());
-
-                    // Run the connection
-                    auto retain = conn->start();
-
-                    if (retain == false)
-                        break;
-                }
-
-                try {
-                    mv_socket.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send);
-                } catch (std::exception& e) {
-                    ;
-                }
-            });
-
-        conthread.detach();
+        auto session = std::make_shared<kis_net_beast_httpd_session>(std::move(socket), shared_from_this());
+        session->start_read();
     }
 
-    // Make sure we know we've moved the socket inside the thread before we leave scope
-    socket_moved_ft.wait();
-
     // Accept another connection
     return start_accept();
 }
@@ -687,6 +796,7 @@ void kis_net_beast_httpd::register_route(const std::string& route, const std::li
         b_verbs.emplace_back(boost::beast::http::string_to_verb(v));
 
     route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, b_verbs, true, roles, handler));
+    rebuild_route_trie();
 }
 
 void kis_net_beast_httpd::register_route(const std::string& route, 
@@ -713,6 +823,7 @@ void kis_net_beast_httpd::register_route(const std::string& route,
         b_verbs.emplace_back(boost::beast::http::string_to_verb(v));
 
     route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, b_verbs, true, roles, extensions, handler));
+    rebuild_route_trie();
 }
 
 void kis_net_beast_httpd::remove_route(const std::string& route) {
@@ -721,6 +832,7 @@ void kis_net_beast_httpd::remove_route(const std::string& route) {
     for (auto i = route_vec.begin(); i != route_vec.end(); ++i) {
         if ((*i)->route() == route) {
             route_vec.erase(i);
+            rebuild_route_trie();
             return;
         }
     }
@@ -735,6 +847,7 @@ void kis_net_beast_httpd::register_unauth_route(const std::string& route,
         b_verbs.emplace_back(boost::beast::http::string_to_verb(v));
     route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, b_verbs, false, 
                 std::list<std::string>{""}, handler));
+    rebuild_route_trie();
 }
 
 void kis_net_beast_httpd::register_unauth_route(const std::string& route, 
@@ -747,6 +860,7 @@ void kis_net_beast_httpd::register_unauth_route(const std::string& route,
     route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, b_verbs, false, 
                 std::list<std::string>{""},
                 extensions, handler));
+    rebuild_route_trie();
 }
 
 void kis_net_beast_httpd::register_websocket_route(const std::string& route, 
@@ -762,7 +876,7 @@ void kis_net_beast_httpd::register_websocket_route(const std::string& route,
 
     websocket_route_vec.emplace_back(std::make_shared<kis_net_beast_route>(route, 
                 std::list<boost::beast::http::verb>{}, true, roles, extensions, handler));
-
+    rebuild_websocket_route_trie();
 }
 
 std::string kis_net_beast_httpd::create_auth(const std::string& name, const std::string& role, time_t expiry) {
@@ -915,25 +1029,41 @@ void kis_net_beast_httpd::load_auth() {
 }
 
 std::shared_ptr<kis_net_beast_route> kis_net_beast_httpd::find_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con) {
-    kis_lock_guard<kis_mutex> lk(route_mutex, "beast_httpd find_endpoint");
+    auto trie = std::atomic_load(&route_trie);
 
-    for (const auto& r : route_vec) {
-        if (r->match_url(static_cast<const std::string>(con->uri()), con->uri_params_, con->http_variables_)) 
-            return r;
-    }
+    if (trie == nullptr)
+        return nullptr;
 
-    return nullptr;
+    return trie->match(con->uri(), con->uri_params_);
 }
 
 std::shared_ptr<kis_net_beast_route> kis_net_beast_httpd::find_websocket_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con) {
-    kis_lock_guard<kis_mutex> lk(route_mutex, "beast_httpd find_websocket_endpoint");
+    auto trie = std::atomic_load(&websocket_route_trie);
 
-    for (const auto& r : websocket_route_vec) {
-        if (r->match_url(static_cast<const std::string>(con->uri()), con->uri_params_, con->http_variables_))
-            return r;
-    }
+    if (trie == nullptr)
+        return nullptr;
 
-    return nullptr;
+    return trie->match(con->uri(), con->uri_params_);
+}
+
+void kis_net_beast_httpd::rebuild_route_trie() {
+    // Must be called under route_mutex
+    auto trie = std::make_shared<kis_net_beast_route_trie>();
+
+    for (size_t i = 0; i < route_vec.size(); i++)
+        trie->insert(route_vec[i], i);
+
+    std::atomic_store(&route_trie, std::shared_ptr<const kis_net_beast_route_trie>(trie));
+}
+
+void kis_net_beast_httpd::rebuild_websocket_route_trie() {
+    // Must be called under route_mutex
+    auto trie = std::make_shared<kis_net_beast_route_trie>();
+
+    for (size_t i = 0; i < websocket_route_vec.size(); i++)
+        trie->insert(websocket_route_vec[i], i);
+
+    std::atomic_store(&websocket_route_trie, std::shared_ptr<const kis_net_beast_route_trie>(trie));
 }
 
 void kis_net_beast_httpd::register_static_dir(const std::string& prefix, const std::string& path) {
@@ -1077,6 +1207,139 @@ void kis_net_beast_httpd::strip_uri_prefix(boost::beast::string_view& uri_view)
     }
 }
 
+bool kis_net_beast_httpd::claim_stream() {
+    if (++n_streams > max_streams) {
+        n_streams--;
+        return false;
+    }
+
+    return true;
+}
+
+void kis_net_beast_httpd::release_stream() {
+    n_streams--;
+}
+
+
+
+void kis_net_beast_worker_pool::release(std::thread::id tid) {
+    std::unique_lock<std::mutex> lk(mutex);
+
+    // Ignore threads which aren't (or are no longer) workers of this pool
+    if (worker_ids.erase(tid) == 0)
+        return;
+
+    // The released worker is busy, so it only leaves the thread count
+    n_workers--;
+
+    // Take over any work that was waiting on the slot the worker held
+    if (!shutdown_ && queue.size() > idle_workers && n_workers < max_threads_)
+        spawn_worker();
+}
+
+
+kis_net_beast_httpd_session::kis_net_beast_httpd_session(boost::asio::ip::tcp::socket&& socket,
+        std::shared_ptr<kis_net_beast_httpd> httpd) :
+    httpd{httpd},
+    stream{std::move(socket)} {
+
+    auto n = ++httpd->n_sockets;
+    auto prev_peak = httpd->n_sockets_peak.load();
+    while (n > prev_peak && !httpd->n_sockets_peak.compare_exchange_weak(prev_peak, n))
+        ;
+}
+
+kis_net_beast_httpd_session::~kis_net_beast_httpd_session() {
+    httpd->n_sockets--;
+}
+
+void kis_net_beast_httpd_session::start_read() {
+    parser.emplace();
+    parser->body_limit(100000);
+
+    // Timeout applies to the async read only; idle keep-alive sockets are closed after it
+    stream.expires_after(std::chrono::seconds(30));
+
+    boost::beast::http::async_read(stream, buffer, *parser,
+            boost::beast::bind_front_handler(&kis_net_beast_httpd_session::handle_read, 
+                shared_from_this()));
+}
+
+void kis_net_beast_httpd_session::handle_read(boost::system::error_code ec, std::size_t bytes_transferred) {
+    // Silently drop any error from the transport layer, because we can't deal with a broken 
+    // client spamming us
+    if (ec || !httpd->httpd_running())
+        return close();
+
+    stream.expires_never();
+
+    // Websockets live as long as the client keeps them open, so they get their own thread 
+    // instead of tying up a pool worker
+    if (boost::beast::websocket::is_upgrade(parser->get())) {
+        std::thread wst([self = shared_from_this()]() {
+            thread_set_process_name("HTTP websocket");
+
+            self->httpd->n_websockets++;
+            self->handle_request(true);
+            self->httpd->n_websockets--;
+        });
+        wst.detach();
+
+        return;
+    }
+
+    auto queued = httpd->connection_pool()->submit([self = shared_from_this()](bool run) {
+        self->handle_request(run);
+    });
+
+    if (!queued)
+        return write_unavailable();
+}
+
+void kis_net_beast_httpd_session::handle_request(bool run) {
+    if (!run)
+        return close();
+
+    httpd->n_requests++;
+
+    bool retain;
+
+    {
+        auto conn = std::make_shared<kis_net_beast_httpd_connection>(stream, httpd);
+        retain = conn->start(parser->release());
+    }
+
+    if (!retain || !stream.socket().is_open())
+        return close();
+
+    // Hand the socket back to the IO threads until the next request arrives
+    start_read();
+}
+
+void kis_net_beast_httpd_session::write_unavailable() {
+    // Called from the IO thread, so the response is written async and held until the write completes
+    auto res = std::make_shared<boost::beast::http::response<boost::beast::http::string_body>>(
+            boost::beast::http::status::service_unavailable, parser->get().version());
+
+    res->set(boost::beast::http::field::server, "Kismet");
+    res->set(boost::beast::http::field::content_type, "text/html");
+    res->set(boost::beast::http::field::retry_after, "1");
+    res->keep_alive(false);
+    res->body() = std::string("<html><head><title>503 Service unavailable</title></head><body><h1>503 Service unavailable</h1><br><p>The server is too busy to handle this request.</p></body></html>\n");
+    res->prepare_payload();
+
+    stream.expires_after(std::chrono::seconds(5));
+
+    boost::beast::http::async_write(stream, *res, 
+            [self = shared_from_this(), res](boost::system::error_code ec, std::size_t) {
+                self->close();
+            });
+}
+
+void kis_net_beast_httpd_session::close() {
+    boost::system::error_code ec;
+    stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+}
 
 
 kis_net_beast_httpd_connection::kis_net_beast_httpd_connection(boost::beast::tcp_stream& socket,
@@ -1084,7 +1347,8 @@ kis_net_beast_httpd_connection::kis_net_beast_httpd_connection(boost::beast::tcp
     httpd{httpd},
     stream_{socket},
     login_valid_{false},
-    first_response_write{false} {
+    first_response_write{false},
+    stream_claimed_{false} {
         Globalreg::n_tracked_http_connections++;
     }
 
@@ -1092,6 +1356,9 @@ kis_net_beast_httpd_connection::~kis_net_beast_httpd_connection() {
     Globalreg::n_tracked_http_connections--;
     if (closure_cb)
         closure_cb();
+
+    if (stream_claimed_)
+        httpd->release_stream();
 }
 
 void kis_net_beast_httpd_connection::set_status(unsigned int status) {
@@ -1127,6 +1394,29 @@ void kis_net_beast_httpd_connection::clear_timeout() {
     boost::beast::get_lowest_layer(stream_).expires_never();
 }
 
+bool kis_net_beast_httpd_connection::start_stream() {
+    if (!httpd->claim_stream()) {
+        set_status(503);
+        append_header("Retry-After", "5");
+
+        std::ostream os(&response_stream_);
+        os << "Too many streams are already open\n";
+
+        return false;
+    }
+
+    stream_claimed_ = true;
+
+    clear_timeout();
+
+    // The endpoint runs in the generator pool while the request thread feeds the response
+    // to the socket; neither returns until the stream ends
+    httpd->connection_pool()->release(request_thread_);
+    httpd->generator_pool()->release(std::this_thread::get_id());
+
+    return true;
+}
+
 void kis_net_beast_httpd_connection::append_header(const std::string& header, const std::string& value) {
     if (first_response_write)
         throw std::runtime_error("tried to set a header on a connection already in progress");
@@ -1134,22 +1424,9 @@ void kis_net_beast_httpd_connection::append_header(const std::string& header, co
     response.set(header, value);
 }
 
-bool kis_net_beast_httpd_connection::start() {
-    // Set a default timeout
-    boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
-
-    parser_.emplace();
-    parser_->body_limit(100000);
-
-    try {
-        boost::beast::http::read(stream_, buffer, *parser_);
-    } catch (const boost::system::system_error& e) {
-        // Silently catch and fail on any error from the transport layer, because we don't
-        // care; we can't deal with a broken client spamming us
-        return do_close();
-    }
-
-    request_ = boost::beast::http::request<boost::beast::http::string_body>(parser_->release());
+bool kis_net_beast_httpd_connection::start(boost::beast::http::request<boost::beast::http::string_body>&& req) {
+    request_ = std::move(req);
+    request_thread_ = std::this_thread::get_id();
 
     uri_ = request_.target();
     verb_ = request_.method();
@@ -1456,14 +1733,21 @@ bool kis_net_beast_httpd_connection::start() {
         boost::beast::http::fields> sr{response};
 
 
-    // Spawn the generator thread
-    auto generator_launched = std::promise<void>();
-    auto generator_ft = generator_launched.get_future();
-
+    // Queue the generator; if the generator pool is saturated, shed the request instead of
+    // piling up more work behind it
     auto self_ref = shared_from_this();
 
-    std::thread tr([this, route, &generator_launched, self_ref]() {
-        generator_launched.set_value();
+    auto queued = httpd->generator_pool()->submit([this, route, self_ref](bool run) {
+        if (!run) {
+            try {
+                set_status(503);
+            } catch (const std::exception& e) {
+                ;
+            }
+
+            response_stream_.complete();
+            return;
+        }
 
         try {
             route->invoke(self_ref);
@@ -1480,9 +1764,26 @@ bool kis_net_beast_httpd_connection::start() {
 
         response_stream_.complete();
     });
-    tr.detach();
 
-    generator_ft.wait();
+    if (!queued) {
+        boost::beast::http::response<boost::beast::http::string_body> 
+            res{boost::beast::http::status::service_unavailable, request_.version()};
+
+        res.set(boost::beast::http::field::server, "Kismet");
+        res.set(boost::beast::http::field::content_type, "text/html");
+        res.set(boost::beast::http::field::retry_after, "1");
+        res.body() = std::string("<html><head><title>503 Service unavailable</title></head><body><h1>503 Service unavailable</h1><br><p>The server is too busy to handle this request.</p></body></html>\n");
+        res.prepare_payload();
+
+        boost::system::error_code error;
+
+        boost::beast::http::write(stream_, res, error);
+
+        if (error || client_req_close) 
+            return do_close();
+
+        return true;
+    }
 
     boost::system::error_code error;
     while (response_stream_.size() || response_stream_.running()) {
@@ -1568,6 +1869,55 @@ bool kis_net_beast_httpd_connection::do_close() {
 }
 
 
+namespace {
+    std::vector<kis_net_beast_route::route_segment> split_route_segments(const std::string& route) {
+        std::vector<kis_net_beast_route::route_segment> ret;
+
+        std::string::size_type start = 0;
+
+        while (true) {
+            auto end = route.find('/', start);
+            auto seg = route.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+            kis_net_beast_route::route_segment rs;
+
+            auto cp = seg.find(':');
+            if (cp == std::string::npos) {
+                rs.literal = seg;
+            } else {
+                rs.literal = seg.substr(0, cp);
+                rs.key = seg.substr(cp);
+            }
+
+            ret.push_back(rs);
+
+            if (end == std::string::npos)
+                break;
+
+            start = end + 1;
+        }
+
+        return ret;
+    }
+
+    void split_url_segments(const boost::beast::string_view& url, 
+            std::vector<boost::beast::string_view>& segments) {
+        boost::beast::string_view::size_type start = 0;
+
+        while (true) {
+            auto end = url.find('/', start);
+
+            if (end == boost::beast::string_view::npos) {
+                segments.push_back(url.substr(start));
+                break;
+            }
+
+            segments.push_back(url.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+}
+
 kis_net_beast_route::kis_net_beast_route(const std::string& route, 
         const std::list<boost::beast::http::verb>& verbs, 
         bool login, const std::list<std::string>& roles, std::shared_ptr<kis_net_web_endpoint> handler) :
@@ -1576,21 +1926,8 @@ kis_net_beast_route::kis_net_beast_route(const std::string& route,
     verbs_{verbs},
     login_{login},
     roles_{roles},
-    match_types{false} {
-
-    // Generate the keys list
-    for (auto i = std::sregex_token_iterator(route.begin(), route.end(), path_re); 
-            i != std::sregex_token_iterator(); i++) {
-        match_keys.push_back(static_cast<std::string>(*i));
-    }
-
-    match_keys.push_back("GETVARS");
-
-    // Generate the extractor expressions
-    auto ext_str = std::regex_replace(route, path_re, path_capture_pattern);
-    // Match the RE + http variables
-    match_re = std::regex(fmt::format("^{}(\\?.*?)?$", ext_str));
-}
+    segments_{split_route_segments(route)},
+    match_types_{false} { }
 
 kis_net_beast_route::kis_net_beast_route(const std::string& route, 
         const std::list<boost::beast::http::verb>& verbs,
@@ -1601,73 +1938,183 @@ kis_net_beast_route::kis_net_beast_route(const std::string& route,
     verbs_{verbs},
     login_{login},
     roles_{roles},
-    match_types{true} {
+    segments_{split_route_segments(route)},
+    match_types_{true},
+    extensions_{extensions.begin(), extensions.end()} { }
 
-    // Generate the keys list
-    for (auto i = std::sregex_token_iterator(route.begin(), route.end(), path_re); 
-            i != std::sregex_token_iterator(); i++) {
-        match_keys.push_back(static_cast<std::string>(*i));
-    }
+bool kis_net_beast_route::match_extension(bool has_ext, const boost::beast::string_view& ext) const {
+    if (!match_types_)
+        return !has_ext;
 
-    match_keys.push_back("FILETYPE");
-    match_keys.push_back("GETVARS");
+    if (!has_ext || ext.length() == 0)
+        return false;
 
-    // Generate the file type regex
-    auto ft_regex = std::string("\\.(");
-    if (extensions.size() == 0) {
-        // If passed an empty list we accept all types and resolve during serialization
-        ft_regex += "[A-Za-z0-9]+";
-    } else {
-        bool prepend_pipe = false;
-        for (const auto& i : extensions) {
-            if (prepend_pipe)
-                ft_regex += fmt::format("|{}", i);
-            else
-                ft_regex += fmt::format("{}", i);
-            prepend_pipe = true;
-        }
+    // If passed an empty list we accept all types and resolve during serialization
+    if (extensions_.size() == 0) {
+        for (auto c : ext)
+            if (!std::isalnum(static_cast<unsigned char>(c)))
+                return false;
+        return true;
     }
-    ft_regex += ")";
 
-    // Generate the extractor expressions
-    auto ext_str = std::regex_replace(route, path_re, path_capture_pattern);
+    for (const auto& e : extensions_)
+        if (ext == e)
+            return true;
 
-    // Match the RE + filetypes + http variables
-    match_re = std::regex(fmt::format("^{}{}(\\?.*?)?$", ext_str, ft_regex));
+    return false;
 }
 
 bool kis_net_beast_route::match_url(const std::string& url, 
         kis_net_beast_httpd_connection::uri_param_t& uri_params,
         kis_net_beast_httpd::http_var_map_t& uri_variables) {
 
-    auto match_values = std::smatch();
+    // Match against a trie holding only this route; the server matches against the 
+    // combined trie instead
+    kis_net_beast_route_trie trie;
+    trie.insert(std::shared_ptr<kis_net_beast_route>(this, [](kis_net_beast_route *) { }), 0);
 
-    if (!std::regex_match(url, match_values, match_re)) 
-        return false;
+    return trie.match(url, uri_params) != nullptr;
+}
 
-    if (match_values.size() != match_keys.size() + 1) {
-        // _MSG_ERROR("(DEBUG) HTTP req {} didn't match enough elements, {} wanted {}", url, match_values.size(), match_keys.size());
-        return false;
-    }
+void kis_net_beast_route_trie::insert(std::shared_ptr<kis_net_beast_route> route, size_t priority) {
+    auto node = root.get();
+
+    for (const auto& seg : route->segments()) {
+        if (seg.key.length() == 0) {
+            auto& child = node->literals[seg.literal];
+
+            if (child == nullptr)
+                child.reset(new trie_node());
 
-    size_t key_num = 0;
-    bool first = true;
-    for (const auto& i : match_values) {
-        if (first) {
-            first = false;
+            node = child.get();
             continue;
         }
 
-        if (key_num >= match_keys.size()) {
-            // _MSG_ERROR("(DEBUG) HTTP req {} matched more values than known keys in route, something is wrong key pos {}", url, key_num);
-            continue;
+        trie_node *next = nullptr;
+
+        for (const auto& p : node->params) {
+            if (p.prefix == seg.literal && p.key == seg.key) {
+                next = p.node.get();
+                break;
+            }
         }
 
-        uri_params.emplace(std::make_pair(match_keys[key_num], static_cast<std::string>(i)));
-        key_num++;
+        if (next == nullptr) {
+            node->params.push_back(param_child{seg.literal, seg.key, 
+                    std::unique_ptr<trie_node>(new trie_node())});
+            next = node->params.back().node.get();
+        }
+
+        node = next;
     }
 
-    return true;
+    node->routes.push_back(std::make_pair(priority, route));
+}
+
+std::shared_ptr<kis_net_beast_route> kis_net_beast_route_trie::match(const boost::beast::string_view& url,
+        kis_net_beast_httpd_connection::uri_param_t& uri_params) const {
+
+    // Anything past a '?' is left to the GETVARS key
+    auto path = url;
+    auto getvars = boost::beast::string_view{};
+
+    auto qp = url.find('?');
+    if (qp != boost::beast::string_view::npos) {
+        path = url.substr(0, qp);
+        getvars = url.substr(qp);
+    }
+
+    std::vector<boost::beast::string_view> segments;
+    split_url_segments(path, segments);
+
+    capture_vec captures;
+    match_state best{std::numeric_limits<size_t>::max(), nullptr, {}, {}};
+
+    match_node(root.get(), segments, 0, captures, best);
+
+    if (best.route == nullptr)
+        return nullptr;
+
+    for (const auto& c : best.captures)
+        uri_params.emplace(std::make_pair(*c.first, static_cast<std::string>(c.second)));
+
+    if (best.route->match_types())
+        uri_params.emplace(std::make_pair("FILETYPE", static_cast<std::string>(best.ext)));
+
+    uri_params.emplace(std::make_pair("GETVARS", static_cast<std::string>(getvars)));
+
+    return best.route;
+}
+
+void kis_net_beast_route_trie::match_node(const trie_node *node, 
+        const std::vector<boost::beast::string_view>& segments, size_t pos, 
+        capture_vec& captures, match_state& best) const {
+
+    const auto& seg = segments[pos];
+    const bool last = (pos + 1 == segments.size());
+
+    if (!last) {
+        auto lk = node->literals.find(static_cast<std::string>(seg));
+        if (lk != node->literals.end())
+            match_node(lk->second.get(), segments, pos + 1, captures, best);
+
+        for (const auto& p : node->params) {
+            if (seg.length() <= p.prefix.length() || !seg.starts_with(p.prefix))
+                continue;
+
+            captures.push_back(std::make_pair(&p.key, seg.substr(p.prefix.length())));
+            match_node(p.node.get(), segments, pos + 1, captures, best);
+            captures.pop_back();
+        }
+
+        return;
+    }
+
+    // The final segment may carry a file type; try the whole segment first, then every
+    // split at a '.' from the left, matching the shortest capture as the regex routes did
+    auto lk = node->literals.find(static_cast<std::string>(seg));
+    if (lk != node->literals.end())
+        match_terminal(lk->second.get(), captures, false, {}, best);
+
+    for (auto dp = seg.find('.'); dp != boost::beast::string_view::npos; dp = seg.find('.', dp + 1)) {
+        auto base_k = node->literals.find(static_cast<std::string>(seg.substr(0, dp)));
+        if (base_k != node->literals.end())
+            match_terminal(base_k->second.get(), captures, true, seg.substr(dp + 1), best);
+    }
+
+    for (const auto& p : node->params) {
+        if (seg.length() <= p.prefix.length() || !seg.starts_with(p.prefix))
+            continue;
+
+        captures.push_back(std::make_pair(&p.key, seg.substr(p.prefix.length())));
+        match_terminal(p.node.get(), captures, false, {}, best);
+        captures.pop_back();
+
+        for (auto dp = seg.find('.', p.prefix.length() + 1); dp != boost::beast::string_view::npos;
+                dp = seg.find('.', dp + 1)) {
+            captures.push_back(std::make_pair(&p.key, 
+                        seg.substr(p.prefix.length(), dp - p.prefix.length())));
+            match_terminal(p.node.get(), captures, true, seg.substr(dp + 1), best);
+            captures.pop_back();
+        }
+    }
+}
+
+void kis_net_beast_route_trie::match_terminal(const trie_node *node, capture_vec& captures, 
+        bool has_ext, const boost::beast::string_view& ext, match_state& best) const {
+
+    for (const auto& r : node->routes) {
+        if (r.first >= best.priority)
+            continue;
+
+        if (!r.second->match_extension(has_ext, ext))
+            continue;
+
+        best.priority = r.first;
+        best.route = r.second;
+        best.captures = captures;
+        best.ext = ext;
+    }
 }
 
 bool kis_net_beast_route::match_verb(boost::beast::http::verb verb) {
@@ -22,11 +22,15 @@
 #include "config.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <list>
-#include <regex>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "boost/asio.hpp"
 #include "boost/beast.hpp"
@@ -37,14 +41,32 @@
 #include "globalregistry.h"
 #include "json/json.h"
 #include "kis_mutex.h"
+#include "kis_worker_pool.h"
 #include "messagebus.h"
 #include "trackedelement.h"
 
 class kis_net_beast_httpd_connection;
+class kis_net_beast_httpd_session;
 class kis_net_beast_route;
+class kis_net_beast_route_trie;
 class kis_net_beast_auth;
 class kis_net_web_endpoint;
 
+// Worker pool used by the HTTP server for request handling and endpoint generation.  On top
+// of the generic pool, a request which turns into a long-lived stream can release the
+// worker it is running on, so open streams do not count against the pool.
+class kis_net_beast_worker_pool : public kis_worker_pool {
+public:
+    kis_net_beast_worker_pool(const std::string& name, unsigned int max_threads, 
+            unsigned int max_queue) :
+        kis_worker_pool{name, max_threads, max_queue} { }
+
+    // Remove the worker running on thread tid from the pool while its job is still running, 
+    // so that a long-lived job (such as a streaming endpoint) does not count against the pool;
+    // the thread exits once the job completes instead of returning to the pool
+    void release(std::thread::id tid);
+};
+
 class kis_net_beast_httpd : public lifetime_global, public deferred_startup,
     public std::enable_shared_from_this<kis_net_beast_httpd> {
 public:
@@ -150,7 +172,17 @@ public:
 
     void strip_uri_prefix(boost::beast::string_view& uri_view);
 
+    // Request handling and endpoint generation pools
+    std::shared_ptr<kis_net_beast_worker_pool> connection_pool() { return connection_pool_; }
+    std::shared_ptr<kis_net_beast_worker_pool> generator_pool() { return generator_pool_; }
+
+    // Claim one of the long-lived stream slots; returns false if max_streams are already open
+    bool claim_stream();
+    void release_stream();
+
 protected:
+    friend class kis_net_beast_httpd_session;
+
     std::atomic<bool> running;
     unsigned int port;
 
@@ -160,10 +192,18 @@ protected:
     kis_mutex mime_mutex;
     std::unordered_map<std::string, std::string> mime_map;
 
+    // Routes are kept in registration order under route_mutex; every change rebuilds the route
+    // trie, which request threads read without locking
     kis_mutex route_mutex;
     std::vector<std::shared_ptr<kis_net_beast_route>> route_vec;
     std::vector<std::shared_ptr<kis_net_beast_route>> websocket_route_vec;
 
+    std::shared_ptr<const kis_net_beast_route_trie> route_trie;
+    std::shared_ptr<const kis_net_beast_route_trie> websocket_route_trie;
+
+    void rebuild_route_trie();
+    void rebuild_websocket_route_trie();
+
     kis_mutex auth_mutex;
     std::vector<std::shared_ptr<kis_net_beast_auth>> auth_vec;
 
@@ -187,6 +227,27 @@ protected:
     void start_accept();
     void handle_connection(const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket);
 
+    // Requests are read asynchronously on the IO threads and only handed to the connection pool
+    // once a complete request is available, so idle keep-alive sockets do not hold a thread
+    std::shared_ptr<kis_net_beast_worker_pool> connection_pool_;
+    std::shared_ptr<kis_net_beast_worker_pool> generator_pool_;
+
+    // Concurrency and queueing stats
+    std::atomic<uint64_t> n_sockets, n_sockets_peak, n_requests, n_websockets, n_streams;
+
+    // Streams are released from both pools once they start, and are capped separately
+    unsigned int max_streams;
+
+    std::shared_ptr<tracker_element_map> stats_map;
+    std::shared_ptr<tracker_element_uint64> stats_sockets, stats_sockets_peak, stats_requests,
+        stats_websockets, stats_streams;
+    std::shared_ptr<tracker_element_map> stats_connection_pool, stats_generator_pool;
+    int pool_threads_id, pool_threads_max_id, pool_busy_id, pool_queued_id, pool_queued_max_id,
+        pool_queued_peak_id, pool_completed_id, pool_rejected_id, pool_wait_total_id, pool_wait_max_id;
+
+    void update_pool_stats(std::shared_ptr<kis_net_beast_worker_pool> pool, 
+            std::shared_ptr<tracker_element_map> map);
+
     bool use_ssl;
     bool serve_files;
 
@@ -203,7 +264,29 @@ protected:
 
 };
 
+// An accepted socket; owns the stream across keep-alive requests.  Reads are performed async on
+// the IO threads, each complete request is then dispatched to the connection pool, and the
+// session returns to an async read once the response is written.
+class kis_net_beast_httpd_session : public std::enable_shared_from_this<kis_net_beast_httpd_session> {
+public:
+    kis_net_beast_httpd_session(boost::asio::ip::tcp::socket&& socket,
+            std::shared_ptr<kis_net_beast_httpd> httpd);
+    ~kis_net_beast_httpd_session();
+
+    void start_read();
 
+protected:
+    void handle_read(boost::system::error_code ec, std::size_t bytes_transferred);
+    void handle_request(bool run);
+    void write_unavailable();
+    void close();
+
+    std::shared_ptr<kis_net_beast_httpd> httpd;
+
+    boost::beast::tcp_stream stream;
+    boost::beast::flat_buffer buffer;
+    boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser;
+};
 
 // Central entity which tracks everything about a connection, parsed variables, generator thread, etc.
 class kis_net_beast_httpd_connection : public std::enable_shared_from_this<kis_net_beast_httpd_connection> {
@@ -216,7 +299,9 @@ public:
 
     using uri_param_t = std::unordered_map<std::string, std::string>;
 
-    bool start();
+    // Handle a request which has already been read from the stream; returns false if the 
+    // connection should be closed
+    bool start(boost::beast::http::request<boost::beast::http::string_body>&& req);
 
     boost::beast::http::request<boost::beast::http::string_body>& request() { return request_; }
     boost::beast::http::verb& verb() { return verb_; }
@@ -253,6 +338,13 @@ public:
     kis_net_beast_httpd::http_cookie_map_t& cookies() { return cookies_; }
     Json::Value& json() { return json_; }
 
+    // Mark this connection as a long-running stream (such as a live pcap stream); clears the
+    // timeout and moves the request and generator threads out of the bounded pools so that open
+    // streams do not starve other endpoints.  Streams have their own limit (httpd_max_streams);
+    // if it is reached the status is set to 503 and false is returned, and the endpoint should
+    // return without streaming.
+    bool start_stream();
+
     // Optional closure callback to signal to an async operation that there's a problem (for example
     // long-running packet streams)
     void set_closure_cb(std::function<void ()> cb) {
@@ -269,9 +361,7 @@ protected:
     std::function<void ()> closure_cb;
 
     boost::beast::tcp_stream& stream_;
-    boost::beast::flat_buffer buffer;
 
-    boost::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser_;
     boost::beast::http::request<boost::beast::http::string_body> request_;
 
     boost::beast::http::response<boost::beast::http::buffer_body> response;
@@ -295,6 +385,10 @@ protected:
 
     std::atomic<bool> first_response_write;
 
+    // Request thread, so a stream can release it from the connection pool
+    std::thread::id request_thread_;
+    bool stream_claimed_;
+
     bool do_close();
 
     template<class Response>
@@ -584,6 +678,19 @@ public:
 
     std::string& route() { return route_; }
 
+    // Path segments of the route; a segment may end in a :key capture, which extends to
+    // the end of the segment
+    struct route_segment {
+        std::string literal;
+        std::string key;
+    };
+
+    const std::vector<route_segment>& segments() const { return segments_; }
+
+    // Does the route accept the file type of the final segment?
+    bool match_extension(bool has_ext, const boost::beast::string_view& ext) const;
+    bool match_types() const { return match_types_; }
+
 protected:
     std::shared_ptr<kis_net_web_endpoint> handler;
 
@@ -595,14 +702,56 @@ protected:
 
     std::list<std::string> roles_;
 
-    const std::string path_id_pattern = ":([^\\/]+)?";
-    const std::string path_capture_pattern = "(?:([^\\/]+?))";
-    const std::regex path_re = std::regex(path_id_pattern);
+    std::vector<route_segment> segments_;
+
+    bool match_types_;
+    std::vector<std::string> extensions_;
+};
+
+// Prefix tree of routes, keyed on path segments.  The httpd rebuilds the tree whenever routes
+// are added or removed and publishes it as an immutable snapshot, so lookups take no locks.
+// Matching follows the rules documented on kis_net_beast_route; when several routes match a
+// URL, the one registered first wins.
+class kis_net_beast_route_trie {
+public:
+    kis_net_beast_route_trie() :
+        root{new trie_node()} { }
+
+    void insert(std::shared_ptr<kis_net_beast_route> route, size_t priority);
+
+    std::shared_ptr<kis_net_beast_route> match(const boost::beast::string_view& url, 
+            kis_net_beast_httpd_connection::uri_param_t& uri_params) const;
+
+protected:
+    struct trie_node;
+
+    struct param_child {
+        std::string prefix;
+        std::string key;
+        std::unique_ptr<trie_node> node;
+    };
+
+    struct trie_node {
+        std::unordered_map<std::string, std::unique_ptr<trie_node>> literals;
+        std::vector<param_child> params;
+        std::vector<std::pair<size_t, std::shared_ptr<kis_net_beast_route>>> routes;
+    };
+
+    using capture_vec = std::vector<std::pair<const std::string *, boost::beast::string_view>>;
+
+    struct match_state {
+        size_t priority;
+        std::shared_ptr<kis_net_beast_route> route;
+        capture_vec captures;
+        boost::beast::string_view ext;
+    };
 
-    bool match_types;
-    std::vector<std::string> match_keys;
+    void match_node(const trie_node *node, const std::vector<boost::beast::string_view>& segments,
+            size_t pos, capture_vec& captures, match_state& best) const;
+    void match_terminal(const trie_node *node, capture_vec& captures, bool has_ext,
+            const boost::beast::string_view& ext, match_state& best) const;
 
-    std::regex match_re;
+    std::unique_ptr<trie_node> root;
 };
 
 struct auth_construction_error : public std::exception {
@@ -0,0 +1,180 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include "kis_worker_pool.h"
+#include "messagebus.h"
+#include "util.h"
+
+kis_worker_pool::kis_worker_pool(const std::string& name,
+        unsigned int max_threads, unsigned int max_queue) :
+    name{name},
+    max_threads_{max_threads == 0 ? 1 : max_threads},
+    max_queue_{max_queue},
+    n_workers{0},
+    idle_workers{0},
+    shutdown_{false},
+    queued_peak_{0},
+    completed_{0},
+    rejected_{0},
+    queue_wait_us_{0},
+    queue_wait_max_us_{0} { }
+
+kis_worker_pool::~kis_worker_pool() {
+    shutdown();
+}
+
+bool kis_worker_pool::spawn_worker() {
+    try {
+        std::thread t([self = shared_from_this()]() {
+            self->worker_func();
+        });
+        t.detach();
+
+        // New workers count as idle until they claim a job
+        n_workers++;
+        idle_workers++;
+    } catch (const std::system_error& e) {
+        _MSG_ERROR("Could not create {} worker thread: {}", name, e.what());
+        return false;
+    }
+
+    return true;
+}
+
+bool kis_worker_pool::submit(job_func_t job) {
+    std::unique_lock<std::mutex> lk(mutex);
+
+    if (shutdown_) {
+        rejected_++;
+        return false;
+    }
+
+    // Only grow the pool when no idle worker is available to take this job
+    if (idle_workers <= queue.size()) {
+        if (n_workers < max_threads_) {
+            if (!spawn_worker() && (n_workers == 0 || queue.size() >= max_queue_)) {
+                rejected_++;
+                return false;
+            }
+        } else if (queue.size() >= max_queue_) {
+            rejected_++;
+            return false;
+        }
+    }
+
+    queue.push_back(queued_job{std::move(job), std::chrono::steady_clock::now()});
+
+    if (queue.size() > queued_peak_)
+        queued_peak_ = queue.size();
+
+    lk.unlock();
+    cv.notify_one();
+
+    return true;
+}
+
+void kis_worker_pool::shutdown() {
+    std::deque<queued_job> cancelled;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        shutdown_ = true;
+        cancelled.swap(queue);
+    }
+
+    cv.notify_all();
+
+    for (auto& j : cancelled) {
+        try {
+            j.func(false);
+        } catch (const std::exception& e) {
+            ;
+        }
+    }
+}
+
+unsigned int kis_worker_pool::threads() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return n_workers;
+}
+
+unsigned int kis_worker_pool::busy() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return n_workers - idle_workers;
+}
+
+unsigned int kis_worker_pool::queued() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return queue.size();
+}
+
+void kis_worker_pool::worker_func() {
+    thread_set_process_name(name);
+
+    std::unique_lock<std::mutex> lk(mutex);
+
+    worker_ids.insert(std::this_thread::get_id());
+
+    while (true) {
+        cv.wait(lk, [this]() { return shutdown_ || queue.size() > 0; });
+
+        // Shutdown cancels anything still queued, so an empty queue here means we're done
+        if (queue.size() == 0)
+            break;
+
+        auto job = std::move(queue.front());
+        queue.pop_front();
+        idle_workers--;
+
+        lk.unlock();
+
+        uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - job.queued_ts).count();
+        queue_wait_us_ += wait_us;
+
+        auto prev_max = queue_wait_max_us_.load();
+        while (wait_us > prev_max && !queue_wait_max_us_.compare_exchange_weak(prev_max, wait_us))
+            ;
+
+        try {
+            job.func(true);
+        } catch (const std::exception& e) {
+            _MSG_ERROR("Uncaught exception in {} worker: {}", name, e.what());
+        }
+
+        // Release anything the job captured before we go idle
+        job.func = nullptr;
+
+        completed_++;
+
+        lk.lock();
+
+        // Workers removed from the pool while running have already left the accounting
+        if (worker_ids.count(std::this_thread::get_id()) == 0)
+            return;
+
+        idle_workers++;
+    }
+
+    worker_ids.erase(std::this_thread::get_id());
+    idle_workers--;
+    n_workers--;
+}
+
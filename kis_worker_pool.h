@@ -0,0 +1,105 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_WORKER_POOL_H__
+#define __KIS_WORKER_POOL_H__
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+// Bounded pool of worker threads.  Threads are created on demand up to max_threads and are
+// kept for re-use; once every thread is busy, jobs queue up to max_queue and further jobs are
+// rejected so the caller can shed load or run the work itself instead of creating another
+// thread.
+//
+// Workers are detached and hold a reference to the pool, so a worker blocked in a long-running
+// job at shutdown does not stall the caller.
+class kis_worker_pool : public std::enable_shared_from_this<kis_worker_pool> {
+public:
+    // Jobs are called with 'true' when they run, or with 'false' if the pool is shut down
+    // before they could start, so they can release anything they are holding
+    using job_func_t = std::function<void (bool)>;
+
+    kis_worker_pool(const std::string& name, unsigned int max_threads, unsigned int max_queue);
+    virtual ~kis_worker_pool();
+
+    // Returns false if the job was rejected because the pool and queue are full
+    bool submit(job_func_t job);
+
+    // Stop accepting jobs, cancel anything still queued, and release idle workers
+    void shutdown();
+
+    unsigned int max_threads() const { return max_threads_; }
+    unsigned int max_queue() const { return max_queue_; }
+
+    unsigned int threads();
+    unsigned int busy();
+    unsigned int queued();
+
+    unsigned int queued_peak() const { return queued_peak_; }
+    uint64_t completed() const { return completed_; }
+    uint64_t rejected() const { return rejected_; }
+    uint64_t queue_wait_us() const { return queue_wait_us_; }
+    uint64_t queue_wait_max_us() const { return queue_wait_max_us_; }
+
+protected:
+    struct queued_job {
+        job_func_t func;
+        std::chrono::steady_clock::time_point queued_ts;
+    };
+
+    // Start another worker; must be called under mutex.  Returns false if the thread
+    // could not be created
+    bool spawn_worker();
+
+    void worker_func();
+
+    std::string name;
+    unsigned int max_threads_;
+    unsigned int max_queue_;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<queued_job> queue;
+
+    // Threads currently counted as workers of the pool; a worker whose id is removed
+    // while it runs a job leaves the pool once the job completes
+    std::unordered_set<std::thread::id> worker_ids;
+    unsigned int n_workers;
+    unsigned int idle_workers;
+    bool shutdown_;
+
+    std::atomic<unsigned int> queued_peak_;
+    std::atomic<uint64_t> completed_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> queue_wait_us_;
+    std::atomic<uint64_t> queue_wait_max_us_;
+};
+
+#endif
+
@@ -122,6 +122,7 @@
 #include "manuf.h"
 #include "entrytracker.h"
 #include "json_adapter.h"
+#include "msgpack_adapter.h"
 
 #include "kis_server_announce.h"
 
@@ -786,6 +787,7 @@ int main(int argc, char *argv[], char *envp[]) {
     entrytracker->register_serializer("ekjson", std::make_shared<ek_json_adapter::serializer>());
     entrytracker->register_serializer("itjson", std::make_shared<it_json_adapter::serializer>());
     entrytracker->register_serializer("prettyjson", std::make_shared<pretty_json_adapter::serializer>());
+    entrytracker->register_serializer("msgpack", std::make_shared<msgpack_adapter::serializer>());
 
     entrytracker->register_serializer("jcmd", std::make_shared<json_adapter::serializer>());
     entrytracker->register_serializer("cmd", std::make_shared<json_adapter::serializer>());
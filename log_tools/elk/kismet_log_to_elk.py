@@ -11,6 +11,7 @@ import sqlite3
 import string
 import sys
 import re
+import zlib
 
 def strip_old_empty_trees(obj):
     # Hardcoded list of previously dynamic objects which could be set to 0
@@ -77,13 +78,22 @@ except Exception as e:
     print "Failed to connect to elk: ", e
     sys.exit(1)
 
-sql = "SELECT device FROM devices "
-
 c = db.cursor()
 
+# kismetdb 8 and newer flag zlib-compressed device records
+db_version = c.execute("SELECT db_version FROM KISMET").fetchone()[0]
+
+if db_version >= 8:
+    sql = "SELECT device, compressed FROM devices "
+else:
+    sql = "SELECT device, 0 FROM devices "
+
 for row in c.execute(sql):
     try:
-        dev = strip_old_empty_trees(json.loads(str(row[0])))
+        raw = str(row[0])
+        if row[1]:
+            raw = zlib.decompress(raw)
+        dev = strip_old_empty_trees(json.loads(raw))
         dev = rename_json_keys(dev)
         res = es.index(index='kismet', doc_type='device', body=dev)
         print dev['kismet_device_base_key'], res
@@ -0,0 +1,90 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KISMETDB_DEVICE_JSON_H__
+#define __KISMETDB_DEVICE_JSON_H__
+
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+#include "sqlite3_cpp11.h"
+
+// Since kismetdb version 8, device records may be stored as zlib-compressed JSON,
+// flagged by the 'compressed' column of the devices table.  Readers select the
+// device columns with kismetdb_device_fields, which adds the flag after the
+// 'device' column when the log has it, and fetch the JSON with kismetdb_device_json.
+
+#define KISMETDB_DEVICE_COMPRESS_VERSION    8
+
+inline std::list<std::string> kismetdb_device_fields(int db_version,
+        std::list<std::string> fields) {
+    if (db_version >= KISMETDB_DEVICE_COMPRESS_VERSION)
+        fields.push_back("compressed");
+    return fields;
+}
+
+// Device JSON from column device_col of a row selected with kismetdb_device_fields,
+// with device_col being the last of the requested fields
+inline std::string kismetdb_device_json(int db_version, std::shared_ptr<sqlite3_stmt> row,
+        unsigned int device_col) {
+    using namespace kissqlite3;
+
+    auto blob = sqlite3_column_as<std::string>(row, device_col);
+
+    if (db_version < KISMETDB_DEVICE_COMPRESS_VERSION ||
+            !sqlite3_column_as<bool>(row, device_col + 1))
+        return blob;
+
+    z_stream zs{};
+
+    if (inflateInit(&zs) != Z_OK)
+        throw std::runtime_error("unable to initialize zlib");
+
+    std::string json;
+    json.resize(blob.length() * 8 + 1024);
+
+    zs.next_in = (Bytef *) blob.data();
+    zs.avail_in = blob.length();
+
+    int r;
+
+    do {
+        if (zs.total_out >= json.length())
+            json.resize(json.length() * 2);
+
+        zs.next_out = (Bytef *) &json[zs.total_out];
+        zs.avail_out = json.length() - zs.total_out;
+
+        r = inflate(&zs, Z_NO_FLUSH);
+    } while (r == Z_OK);
+
+    json.resize(zs.total_out);
+    inflateEnd(&zs);
+
+    if (r != Z_STREAM_END)
+        throw std::runtime_error("corrupt compressed device record");
+
+    return json;
+}
+
+#endif
+
@@ -39,6 +39,7 @@
 #include "fmt.h"
 #include "json/json.h"
 #include "sqlite3_cpp11.h"
+#include "kismetdb_device_json.h"
 
 void print_help(char *argv) {
     printf("Kismetdb to JSON\n");
@@ -249,7 +250,7 @@ int main(int argc, char *argv[]) {
     if (!ekjson)
         fprintf(ofile, "[\n");
 
-    auto query = _SELECT(db, "devices", {"device"});
+    auto query = _SELECT(db, "devices", kismetdb_device_fields(db_version, {"device"}));
 
     unsigned long n_logs = 0;
     unsigned long n_division = (n_devices_db / 20);
@@ -269,10 +270,8 @@ int main(int argc, char *argv[]) {
 
         }
 
-        auto json = sqlite3_column_as<std::string>(d, 0);
-
         try {
-            std::stringstream ss(json);
+            std::stringstream ss(kismetdb_device_json(db_version, d, 0));
 
             Json::Value parsed_json;
 
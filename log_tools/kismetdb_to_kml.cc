@@ -42,6 +42,7 @@
 #include "getopt.h"
 #include "json/json.h"
 #include "sqlite3_cpp11.h"
+#include "kismetdb_device_json.h"
 #include "fmt.h"
 #include "packet_ieee80211.h"
 
@@ -441,7 +442,8 @@ int main(int argc, char *argv[]) {
     if (basiclocation) {
         auto basic_q = 
             _SELECT(db, "devices", 
-                    {"min_lat", "min_lon", "max_lat", "max_lon", "avg_lat", "avg_lon", "device"}, 
+                    kismetdb_device_fields(db_version, 
+                        {"min_lat", "min_lon", "max_lat", "max_lon", "avg_lat", "avg_lon", "device"}), 
                     _WHERE("avglat", NEQ, 0, AND, "avglon", NEQ, 0));
 
         for (auto d : basic_q) {
@@ -470,9 +472,10 @@ int main(int argc, char *argv[]) {
             }
 
             Json::Value json;
-            std::stringstream ss(sqlite3_column_as<std::string>(d, 6));
+            std::stringstream ss;
 
             try {
+                ss.str(kismetdb_device_json(db_version, d, 6));
                 ss >> json;
 
                 kml_point p;
@@ -509,7 +512,8 @@ int main(int argc, char *argv[]) {
         }
     } else {
         auto basic_q = 
-            _SELECT(db, "devices", {"phyname", "devmac", "device"});
+            _SELECT(db, "devices", 
+                    kismetdb_device_fields(db_version, {"phyname", "devmac", "device"}));
 
         for (auto d : basic_q) {
             // Prep the packet list for different kismetdb versions
@@ -525,11 +529,12 @@ int main(int argc, char *argv[]) {
             auto devmac = sqlite3_column_as<std::string>(d, 1);
             Json::Value json;
 
-            std::stringstream ss(sqlite3_column_as<std::string>(d, 2));
+            std::stringstream ss;
 
             kml_placemark pl;
 
             try {
+                ss.str(kismetdb_device_json(db_version, d, 2));
                 ss >> json;
                 pl.name = json["kismet.device.base.commonname"].asString();
                 pl.phy_layer = json["kismet.device.base.phyname"].asString();
@@ -213,12 +213,12 @@ FILE *open_pcap_file(const std::string& path, bool force, unsigned int dlt) {
 }
 
 void write_pcap_packet(FILE *pcap_file, const std::string& packet,
-        unsigned long ts_sec, unsigned long ts_usec) {
+        unsigned long orig_len, unsigned long ts_sec, unsigned long ts_usec) {
     pcap_packet_hdr_t hdr;
     hdr.ts_sec = ts_sec;
     hdr.ts_usec = ts_usec;
     hdr.incl_len = packet.size();
-    hdr.orig_len = packet.size();
+    hdr.orig_len = orig_len;
 
     if (fwrite(&hdr, sizeof(pcap_packet_hdr_t), 1, pcap_file) != 1)
         throw std::runtime_error(fmt::format("error writing pcap packet: {} (errno {})",
@@ -460,7 +460,7 @@ void write_pcapng_gps(FILE *pcapng_file, unsigned long ts_sec, unsigned long ts_
 }
 
 void write_pcapng_packet(FILE *pcapng_file, const std::string& packet,
-        unsigned long ts_sec, unsigned long ts_usec, const std::string& tag,
+        unsigned long orig_len, unsigned long ts_sec, unsigned long ts_usec, const std::string& tag,
         unsigned int ngindex, double lat, double lon, double alt) {
 
     // Assemble the packet in the file in steps to avoid another memcpy
@@ -497,7 +497,7 @@ void write_pcapng_packet(FILE *pcapng_file, const std::string& packet,
     epb.timestamp_low = conv_ts;
 
     epb.captured_length = packet.size();
-    epb.original_length = packet.size();
+    epb.original_length = orig_len;
 
     if (fwrite(&epb, sizeof(pcapng_epb_t), 1, pcapng_file) != 1)
         throw std::runtime_error(fmt::format("error writing pcapng packet header: {} (errno {})",
@@ -1003,10 +1003,10 @@ int main(int argc, char *argv[]) {
     std::list<std::string> packet_fields;
     if (db_version < 6) {
         packet_fields = 
-            std::list<std::string>{"ts_sec", "ts_usec", "dlt", "datasource", "packet", "lat", "lon", "alt"};
+            std::list<std::string>{"ts_sec", "ts_usec", "dlt", "datasource", "packet", "lat", "lon", "alt", "packet_len"};
     } else {
         packet_fields = 
-            std::list<std::string>{"ts_sec", "ts_usec", "dlt", "datasource", "packet", "lat", "lon", "alt", "tags"};
+            std::list<std::string>{"ts_sec", "ts_usec", "dlt", "datasource", "packet", "lat", "lon", "alt", "packet_len", "tags"};
     }
 
     auto packets_q = _SELECT(db, "packets", 
@@ -1049,10 +1049,14 @@ int main(int argc, char *argv[]) {
                 auto lon = sqlite3_column_as<double>(*pkt, 6);
                 auto alt = sqlite3_column_as<double>(*pkt, 7);
 
+                // Frames sliced by the capture source are shorter than the original
+                auto orig_len = std::max(sqlite3_column_as<unsigned long>(*pkt, 8), 
+                        (unsigned long) bytes.size());
+
                 std::string tags;
 
                 if (db_version >= 6)
-                    tags = sqlite3_column_as<std::string>(*pkt, 8);
+                    tags = sqlite3_column_as<std::string>(*pkt, 9);
 
                 if (!pcapng) {
                     std::shared_ptr<log_file> log_interface;
@@ -1095,7 +1099,7 @@ int main(int argc, char *argv[]) {
                         log_interface->file = open_pcap_file(fname, force, file_dlt);
                     }
 
-                    write_pcap_packet(log_interface->file, bytes, ts_sec, ts_usec);
+                    write_pcap_packet(log_interface->file, bytes, orig_len, ts_sec, ts_usec);
 
                     log_interface->sz += bytes.size();
                     log_interface->count++;
@@ -1190,7 +1194,7 @@ int main(int argc, char *argv[]) {
                         alt = 0;
                     }
 
-                    write_pcapng_packet(log_interface->file, bytes, ts_sec, ts_usec, tags, ngindex,
+                    write_pcapng_packet(log_interface->file, bytes, orig_len, ts_sec, ts_usec, tags, ngindex,
                             lat, lon, alt);
 
                     log_interface->sz += bytes.size();
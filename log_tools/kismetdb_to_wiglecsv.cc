@@ -43,6 +43,7 @@
 #include "getopt.h"
 #include "json/json.h"
 #include "sqlite3_cpp11.h"
+#include "kismetdb_device_json.h"
 #include "fmt.h"
 #include "packet_ieee80211.h"
 #include "version.h"
@@ -506,7 +507,7 @@ int main(int argc, char *argv[]) {
         if (ci != device_cache_map.end()) {
             cached = ci->second;
         } else {
-            auto dev_query = _SELECT(db, "devices", {"device"},
+            auto dev_query = _SELECT(db, "devices", kismetdb_device_fields(db_version, {"device"}),
                     _WHERE("devmac", EQ, sourcemac,
                         AND,
                         "phyname", EQ, phy));
@@ -533,9 +534,10 @@ int main(int argc, char *argv[]) {
             }
 
             Json::Value json;
-            std::stringstream ss(sqlite3_column_as<std::string>(*dev, 0));
+            std::stringstream ss;
 
             try {
+                ss.str(kismetdb_device_json(db_version, *dev, 0));
                 ss >> json;
 
                 auto timestamp = json["kismet.device.base.first_time"].asUInt64();
@@ -674,7 +676,7 @@ int main(int argc, char *argv[]) {
         if (ci != device_cache_map.end()) {
             cached = ci->second;
         } else {
-            auto dev_query = _SELECT(db, "devices", {"device"},
+            auto dev_query = _SELECT(db, "devices", kismetdb_device_fields(db_version, {"device"}),
                     _WHERE("devmac", EQ, sourcemac,
                         AND,
                         "phyname", EQ, phy));
@@ -701,9 +703,10 @@ int main(int argc, char *argv[]) {
             }
 
             Json::Value json;
-            std::stringstream ss(sqlite3_column_as<std::string>(*dev, 0));
+            std::stringstream ss;
 
             try {
+                ss.str(kismetdb_device_json(db_version, *dev, 0));
                 ss >> json;
 
                 auto timestamp = json["kismet.device.base.first_time"].asUInt64();
@@ -32,6 +32,9 @@ kis_manuf::kis_manuf() {
         entrytracker->register_field("kismet.device.base.manuf", 
                 tracker_element_factory<tracker_element_string>(), "manufacturer name");
 
+    // Most manufacturers own many OUIs, so share one element per manufacturer name
+    manuf_pool = tracker_string_pool::get_field_pool(manuf_id);
+
     unknown_manuf = std::make_shared<tracker_element_string>(manuf_id);
     unknown_manuf->set("Unknown");
 
@@ -62,8 +65,7 @@ kis_manuf::kis_manuf() {
 
             manuf_data md;
             md.oui = oui;
-            md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-            md.manuf->set(m_pair[1]);
+            md.manuf = manuf_pool->intern(m_pair[1]);
             oui_map[oui] = md;
         } else {
             _MSG_ERROR("Expected 'manuf=AA:BB:CC,Name' for a config file manuf record.");
@@ -229,8 +231,7 @@ std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(mac_addr in_mac) {
                     manuf_data md;
                     md.oui = soui;
 
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
+                    md.manuf = manuf_pool->intern(munge_to_printable(std::string(buf + 9, mlen)));
                     oui_map[soui] = md;
                     return md.manuf;
                 }
@@ -319,8 +320,7 @@ std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(uint32_t in_oui) {
                     manuf_data md;
                     md.oui = soui;
 
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
+                    md.manuf = manuf_pool->intern(munge_to_printable(std::string(buf + 9, mlen)));
                     oui_map[soui] = md;
                     return md.manuf;
                 }
@@ -340,9 +340,7 @@ std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(uint32_t in_oui) {
 }
 
 std::shared_ptr<tracker_element_string> kis_manuf::make_manuf(const std::string& in_manuf) {
-    auto manuf = std::make_shared<tracker_element_string>(manuf_id);
-    manuf->set(in_manuf);
-    return manuf;
+    return manuf_pool->intern(in_manuf);
 }
 
 bool kis_manuf::is_unknown_manuf(std::shared_ptr<tracker_element_string> in_manuf) {
@@ -39,6 +39,7 @@
 #include "globalregistry.h"
 #include "robin_hood.h"
 #include "trackedelement.h"
+#include "trackedstringpool.h"
 #include "util.h"
 
 class kis_manuf {
@@ -81,6 +82,7 @@ protected:
     int manuf_id;
     std::shared_ptr<tracker_element_string> unknown_manuf;
     std::shared_ptr<tracker_element_string> random_manuf;
+    std::shared_ptr<tracker_string_pool> manuf_pool;
 };
 
 #endif
@@ -0,0 +1,624 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "globalregistry.h"
+#include "trackedelement.h"
+#include "macaddr.h"
+#include "entrytracker.h"
+#include "uuid.h"
+#include "devicetracker_component.h"
+#include "msgpack_adapter.h"
+#include "endian_magic.h"
+
+namespace {
+
+// Flush the local buffer to the stream once it grows past this size
+const size_t pack_flush_size = 65536;
+
+enum class record_type {
+    dictionary = 0,
+    data = 1,
+};
+
+// Raw MessagePack writers; all multi-byte values are big endian
+inline void put_be(std::string& buf, uint64_t v, unsigned int len) {
+    for (unsigned int i = len; i > 0; i--)
+        buf.push_back((char) ((v >> ((i - 1) * 8)) & 0xFF));
+}
+
+inline void put_nil(std::string& buf) {
+    buf.push_back((char) 0xc0);
+}
+
+inline void put_uint(std::string& buf, uint64_t v) {
+    if (v < 0x80) {
+        buf.push_back((char) v);
+    } else if (v <= 0xFF) {
+        buf.push_back((char) 0xcc);
+        put_be(buf, v, 1);
+    } else if (v <= 0xFFFF) {
+        buf.push_back((char) 0xcd);
+        put_be(buf, v, 2);
+    } else if (v <= 0xFFFFFFFF) {
+        buf.push_back((char) 0xce);
+        put_be(buf, v, 4);
+    } else {
+        buf.push_back((char) 0xcf);
+        put_be(buf, v, 8);
+    }
+}
+
+inline void put_int(std::string& buf, int64_t v) {
+    if (v >= 0) {
+        put_uint(buf, (uint64_t) v);
+    } else if (v >= -32) {
+        buf.push_back((char) (0xe0 | (v + 32)));
+    } else if (v >= INT8_MIN) {
+        buf.push_back((char) 0xd0);
+        put_be(buf, (uint64_t) v, 1);
+    } else if (v >= INT16_MIN) {
+        buf.push_back((char) 0xd1);
+        put_be(buf, (uint64_t) v, 2);
+    } else if (v >= INT32_MIN) {
+        buf.push_back((char) 0xd2);
+        put_be(buf, (uint64_t) v, 4);
+    } else {
+        buf.push_back((char) 0xd3);
+        put_be(buf, (uint64_t) v, 8);
+    }
+}
+
+inline void put_float(std::string& buf, float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    buf.push_back((char) 0xca);
+    put_be(buf, u, 4);
+}
+
+inline void put_double(std::string& buf, double v) {
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    buf.push_back((char) 0xcb);
+    put_be(buf, u, 8);
+}
+
+inline void put_str(std::string& buf, const char *s, size_t len) {
+    if (len < 32) {
+        buf.push_back((char) (0xa0 | len));
+    } else if (len <= 0xFF) {
+        buf.push_back((char) 0xd9);
+        put_be(buf, len, 1);
+    } else if (len <= 0xFFFF) {
+        buf.push_back((char) 0xda);
+        put_be(buf, len, 2);
+    } else {
+        buf.push_back((char) 0xdb);
+        put_be(buf, len, 4);
+    }
+
+    buf.append(s, len);
+}
+
+inline void put_str(std::string& buf, const std::string& s) {
+    put_str(buf, s.data(), s.length());
+}
+
+inline void put_bin_header(std::string& buf, size_t len) {
+    if (len <= 0xFF) {
+        buf.push_back((char) 0xc4);
+        put_be(buf, len, 1);
+    } else if (len <= 0xFFFF) {
+        buf.push_back((char) 0xc5);
+        put_be(buf, len, 2);
+    } else {
+        buf.push_back((char) 0xc6);
+        put_be(buf, len, 4);
+    }
+}
+
+inline void put_bin(std::string& buf, const std::string& s) {
+    put_bin_header(buf, s.length());
+    buf.append(s);
+}
+
+inline void put_array_header(std::string& buf, size_t len) {
+    if (len < 16) {
+        buf.push_back((char) (0x90 | len));
+    } else if (len <= 0xFFFF) {
+        buf.push_back((char) 0xdc);
+        put_be(buf, len, 2);
+    } else {
+        buf.push_back((char) 0xdd);
+        put_be(buf, len, 4);
+    }
+}
+
+inline void put_map_header(std::string& buf, size_t len) {
+    if (len < 16) {
+        buf.push_back((char) (0x80 | len));
+    } else if (len <= 0xFFFF) {
+        buf.push_back((char) 0xde);
+        put_be(buf, len, 2);
+    } else {
+        buf.push_back((char) 0xdf);
+        put_be(buf, len, 4);
+    }
+}
+
+// Container headers are written before the number of non-null children is known;
+// reserve the largest header and patch it once the container is closed
+inline size_t open_container(std::string& buf) {
+    auto pos = buf.length();
+    buf.append(5, '\0');
+    return pos;
+}
+
+inline void close_container(std::string& buf, size_t pos, size_t count, bool as_map) {
+    std::string hdr;
+
+    if (as_map)
+        put_map_header(hdr, count);
+    else
+        put_array_header(hdr, count);
+
+    buf.replace(pos, 5, hdr);
+}
+
+inline void put_mac(std::string& buf, const mac_addr& m) {
+    auto len = m.length();
+
+    put_bin_header(buf, len);
+
+    for (unsigned int i = 0; i < len; i++)
+        buf.push_back((char) ((m.longmac >> ((MAC_LEN_MAX - i - 1) * 8)) & 0xFF));
+}
+
+inline void put_uuid(std::string& buf, const uuid& u) {
+    put_bin_header(buf, 16);
+    put_be(buf, u.time_low, 4);
+    put_be(buf, u.time_mid, 2);
+    put_be(buf, u.time_hi, 2);
+    put_be(buf, u.clock_seq, 2);
+
+    // Node is stored with the first printed octet in the low byte
+    for (unsigned int i = 0; i < 6; i++)
+        buf.push_back((char) ((u.node >> (i * 8)) & 0xFF));
+}
+
+// Same byte order as the exported [SPKEY]_[DKEY] string form
+inline void put_device_key(std::string& buf, const device_key& k) {
+    put_bin_header(buf, 16);
+    put_be(buf, kis_hton64(k.get_spkey()), 8);
+    put_be(buf, kis_hton64(k.get_dkey()), 8);
+}
+
+inline void put_ipv4(std::string& buf, uint32_t s_addr) {
+    // Already in network order
+    put_bin_header(buf, 4);
+    buf.append(reinterpret_cast<const char *>(&s_addr), 4);
+}
+
+template<typename T>
+inline auto scalar_value(const shared_tracker_element& e) -> decltype(static_cast<T *>(e.get())->get()) {
+    return static_cast<T *>(e.get())->get();
+}
+
+struct pack_context {
+    pack_context(std::ostream& stream,
+            std::shared_ptr<tracker_element_serializer::rename_map> name_map) :
+        stream{stream},
+        name_map{name_map} {
+        buf.reserve(pack_flush_size * 2);
+    }
+
+    ~pack_context() {
+        flush();
+    }
+
+    void flush() {
+        if (buf.length() == 0)
+            return;
+
+        stream.write(buf.data(), buf.length());
+        buf.clear();
+    }
+
+    // Record a field id as used by the current record; ids not yet sent to this
+    // stream are queued for the next dictionary record
+    void use_field(int id) {
+        if (id < 0)
+            return;
+
+        if (id >= (int) sent_fields.size())
+            sent_fields.resize(id + 1, false);
+
+        if (sent_fields[id])
+            return;
+
+        sent_fields[id] = true;
+        pending_fields.push_back(id);
+    }
+
+    std::ostream& stream;
+    std::string buf;
+
+    // Scratch buffer for the record being encoded
+    std::string record;
+
+    std::shared_ptr<tracker_element_serializer::rename_map> name_map;
+
+    std::vector<bool> sent_fields;
+    std::vector<int> pending_fields;
+
+    // Field names, fetched from the entrytracker when a dictionary is needed
+    std::vector<std::string> field_names;
+};
+
+void pack_element(pack_context& ctx, shared_tracker_element e);
+
+void pack_field_key(pack_context& ctx, int id, const shared_tracker_element& e) {
+    if (ctx.name_map != nullptr) {
+        auto nmi = ctx.name_map->find(e);
+        if (nmi != ctx.name_map->end() && nmi->second->rename.length() != 0) {
+            put_str(ctx.record, nmi->second->rename);
+            return;
+        }
+    }
+
+    if (e->get_type() == tracker_type::tracker_placeholder_missing) {
+        auto& n = std::static_pointer_cast<tracker_element_placeholder>(e)->get_name();
+        if (n.length() != 0) {
+            put_str(ctx.record, n);
+            return;
+        }
+    } else if (e->get_type() == tracker_type::tracker_alias) {
+        auto& n = std::static_pointer_cast<tracker_element_alias>(e)->get_alias_name();
+        if (n.length() != 0) {
+            put_str(ctx.record, n);
+            return;
+        }
+    }
+
+    // Unregistered fields have no dictionary entry
+    if (id < 0) {
+        put_str(ctx.record, Globalreg::globalreg->entrytracker->get_field_name(id));
+        return;
+    }
+
+    ctx.use_field(id);
+    put_uint(ctx.record, id);
+}
+
+void pack_scalar(pack_context& ctx, const shared_tracker_element& e) {
+    auto& buf = ctx.record;
+
+    switch (e->get_type()) {
+        case tracker_type::tracker_string:
+            put_str(buf, scalar_value<tracker_element_string>(e));
+            return;
+        case tracker_type::tracker_byte_array:
+            put_bin(buf, scalar_value<tracker_element_byte_array>(e));
+            return;
+        case tracker_type::tracker_int8:
+            put_int(buf, scalar_value<tracker_element_int8>(e));
+            return;
+        case tracker_type::tracker_uint8:
+            put_uint(buf, scalar_value<tracker_element_uint8>(e));
+            return;
+        case tracker_type::tracker_int16:
+            put_int(buf, scalar_value<tracker_element_int16>(e));
+            return;
+        case tracker_type::tracker_uint16:
+            put_uint(buf, scalar_value<tracker_element_uint16>(e));
+            return;
+        case tracker_type::tracker_int32:
+            put_int(buf, scalar_value<tracker_element_int32>(e));
+            return;
+        case tracker_type::tracker_uint32:
+            put_uint(buf, scalar_value<tracker_element_uint32>(e));
+            return;
+        case tracker_type::tracker_int64:
+            put_int(buf, scalar_value<tracker_element_int64>(e));
+            return;
+        case tracker_type::tracker_uint64:
+            put_uint(buf, scalar_value<tracker_element_uint64>(e));
+            return;
+        case tracker_type::tracker_float:
+            put_float(buf, scalar_value<tracker_element_float>(e));
+            return;
+        case tracker_type::tracker_double:
+            put_double(buf, scalar_value<tracker_element_double>(e));
+            return;
+        case tracker_type::tracker_mac_addr:
+            put_mac(buf, scalar_value<tracker_element_mac_addr>(e));
+            return;
+        case tracker_type::tracker_uuid:
+            put_uuid(buf, scalar_value<tracker_element_uuid>(e));
+            return;
+        case tracker_type::tracker_key:
+            put_device_key(buf, scalar_value<tracker_element_device_key>(e));
+            return;
+        case tracker_type::tracker_ipv4_addr:
+            put_ipv4(buf, scalar_value<tracker_element_ipv4_addr>(e));
+            return;
+        case tracker_type::tracker_placeholder_missing:
+            put_nil(buf);
+            return;
+        default:
+            break;
+    }
+
+    put_str(buf, e->as_string());
+}
+
+// Maps keyed by something other than a field; key_writer encodes the key
+template<typename M, typename KF>
+void pack_keyed_map(pack_context& ctx, const std::shared_ptr<M>& m, KF key_writer) {
+    auto as_vector = m->as_vector();
+    auto as_key_vector = m->as_key_vector();
+    auto as_map = !as_vector && !as_key_vector;
+
+    auto pos = open_container(ctx.record);
+    size_t count = 0;
+
+    for (const auto& i : *m) {
+        if (i.second == nullptr && !as_key_vector)
+            continue;
+
+        count++;
+
+        if (!as_vector)
+            key_writer(i.first);
+
+        if (!as_key_vector)
+            pack_element(ctx, i.second);
+    }
+
+    close_container(ctx.record, pos, count, as_map);
+}
+
+void pack_element(pack_context& ctx, shared_tracker_element e) {
+    auto& buf = ctx.record;
+
+    if (e == nullptr) {
+        put_nil(buf);
+        return;
+    }
+
+    serializer_scope s(e, ctx.name_map);
+
+    // If we're serializing an alias, remap as the aliased element
+    if (e->get_type() == tracker_type::tracker_alias) {
+        e = std::static_pointer_cast<tracker_element_alias>(e)->get();
+
+        if (e == nullptr) {
+            put_nil(buf);
+            return;
+        }
+    }
+
+    if (e->is_stringable() || e->get_type() == tracker_type::tracker_placeholder_missing) {
+        pack_scalar(ctx, e);
+        return;
+    }
+
+    switch (e->get_type()) {
+        case tracker_type::tracker_vector: {
+            auto pos = open_container(buf);
+            size_t count = 0;
+
+            for (const auto& i : *(std::static_pointer_cast<tracker_element_vector>(e))) {
+                if (i == nullptr)
+                    continue;
+
+                count++;
+                pack_element(ctx, i);
+            }
+
+            close_container(buf, pos, count, false);
+            break;
+        }
+
+        case tracker_type::tracker_vector_double: {
+            auto v = std::static_pointer_cast<tracker_element_vector_double>(e);
+
+            put_array_header(buf, v->size());
+
+            for (const auto& i : *v)
+                put_double(buf, i);
+
+            break;
+        }
+
+        case tracker_type::tracker_vector_string: {
+            auto v = std::static_pointer_cast<tracker_element_vector_string>(e);
+
+            put_array_header(buf, v->size());
+
+            for (const auto& i : *v)
+                put_str(buf, i);
+
+            break;
+        }
+
+        case tracker_type::tracker_map: {
+            auto m = std::static_pointer_cast<tracker_element_map>(e);
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            auto pos = open_container(buf);
+            size_t count = 0;
+
+            auto pack_field = [&](int id, const shared_tracker_element& f) {
+                count++;
+
+                if (!as_vector)
+                    pack_field_key(ctx, id, f);
+
+                pack_element(ctx, f);
+            };
+
+            for (const auto& i : *m) {
+                if (i.second == nullptr)
+                    continue;
+
+                pack_field(i.first, i.second);
+            }
+
+            m->for_each_unmapped([&](const shared_tracker_element& f) {
+                    pack_field(f->get_id(), f);
+                });
+
+            close_container(buf, pos, count, !as_vector && !as_key_vector);
+            break;
+        }
+
+        case tracker_type::tracker_int_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_int_map>(e),
+                    [&buf](int k) { put_int(buf, k); });
+            break;
+
+        case tracker_type::tracker_mac_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_mac_map>(e),
+                    [&buf](const mac_addr& k) { put_mac(buf, k); });
+            break;
+
+        case tracker_type::tracker_uuid_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_uuid_map>(e),
+                    [&buf](const uuid& k) { put_uuid(buf, k); });
+            break;
+
+        case tracker_type::tracker_string_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_string_map>(e),
+                    [&buf](const std::string& k) { put_str(buf, k); });
+            break;
+
+        case tracker_type::tracker_double_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_double_map>(e),
+                    [&buf](double k) { put_double(buf, k); });
+            break;
+
+        case tracker_type::tracker_hashkey_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_hashkey_map>(e),
+                    [&buf](size_t k) { put_uint(buf, k); });
+            break;
+
+        case tracker_type::tracker_key_map:
+            pack_keyed_map(ctx, std::static_pointer_cast<tracker_element_device_key_map>(e),
+                    [&buf](const device_key& k) { put_device_key(buf, k); });
+            break;
+
+        case tracker_type::tracker_double_map_double: {
+            auto m = std::static_pointer_cast<tracker_element_double_map_double>(e);
+            auto as_vector = m->as_vector();
+            auto as_key_vector = m->as_key_vector();
+
+            if (as_vector || as_key_vector)
+                put_array_header(buf, m->size());
+            else
+                put_map_header(buf, m->size());
+
+            for (const auto& i : *m) {
+                if (!as_vector)
+                    put_double(buf, i.first);
+
+                if (!as_key_vector)
+                    put_double(buf, i.second);
+            }
+
+            break;
+        }
+
+        case tracker_type::tracker_pair_double: {
+            auto p = std::static_pointer_cast<tracker_element_pair_double>(e);
+
+            put_array_header(buf, 2);
+            put_double(buf, std::get<0>(p->get()));
+            put_double(buf, std::get<1>(p->get()));
+            break;
+        }
+
+        default:
+            put_nil(buf);
+            break;
+    }
+}
+
+// Encode a complete record, preceded by a dictionary record for any field ids
+// it introduces
+void pack_record(pack_context& ctx, const shared_tracker_element& e) {
+    ctx.record.clear();
+    ctx.pending_fields.clear();
+
+    pack_element(ctx, e);
+
+    if (ctx.pending_fields.size() != 0) {
+        auto max_id = *std::max_element(ctx.pending_fields.begin(), ctx.pending_fields.end());
+
+        if (max_id >= (int) ctx.field_names.size()) {
+            std::vector<std::string> descriptions;
+            Globalreg::globalreg->entrytracker->get_field_names(ctx.field_names, descriptions);
+        }
+
+        put_array_header(ctx.buf, 2);
+        put_uint(ctx.buf, (unsigned int) record_type::dictionary);
+        put_map_header(ctx.buf, ctx.pending_fields.size());
+
+        for (auto id : ctx.pending_fields) {
+            put_uint(ctx.buf, id);
+
+            if (id < (int) ctx.field_names.size())
+                put_str(ctx.buf, ctx.field_names[id]);
+            else
+                put_str(ctx.buf, Globalreg::globalreg->entrytracker->get_field_name(id));
+        }
+    }
+
+    put_array_header(ctx.buf, 2);
+    put_uint(ctx.buf, (unsigned int) record_type::data);
+    ctx.buf.append(ctx.record);
+
+    if (ctx.buf.length() >= pack_flush_size)
+        ctx.flush();
+}
+
+}
+
+void msgpack_adapter::pack(std::ostream &stream, shared_tracker_element e,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map) {
+    pack_context ctx(stream, name_map);
+
+    if (e != nullptr && e->get_type() == tracker_type::tracker_vector) {
+        for (const auto& i : *(std::static_pointer_cast<tracker_element_vector>(e))) {
+            if (i == nullptr)
+                continue;
+
+            pack_record(ctx, i);
+        }
+    } else {
+        pack_record(ctx, e);
+    }
+}
+
@@ -0,0 +1,70 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __MSGPACK_ADAPTER_H__
+#define __MSGPACK_ADAPTER_H__
+
+#include "config.h"
+
+#include "globalregistry.h"
+#include "trackedelement.h"
+#include "devicetracker_component.h"
+
+// Compact binary serialization adapter, using MessagePack as the wire encoding.
+//
+// The output is a stream of MessagePack arrays, each a record of [type, value]:
+//
+//   [0, {id: "field.name", ...}]   Field dictionary; maps numeric field ids to
+//                                  their names.  Each id is sent once per stream,
+//                                  before the first record that uses it.
+//   [1, value]                     Data record
+//
+// As with ekjson, if the top-level object is a vector, each member is sent as
+// an independent data record, so the client can decode the stream incrementally.
+//
+// Values are encoded with their native types:
+//   - tracked maps are maps keyed by the integer field id; renamed fields,
+//     aliases, and placeholders are keyed by their name as a string
+//   - integers use the smallest encoding which holds the value, floats are
+//     float32, doubles are float64
+//   - MAC addresses, UUIDs, IPv4 addresses, and device keys are sent as raw
+//     binary of 6 (or the MAC length), 16, 4, and 16 bytes, in network order
+//   - byte arrays are binary, strings are strings
+//   - keyed maps are keyed by their native type, maps flagged as vectors are
+//     arrays of values, and maps flagged as key vectors are arrays of keys
+namespace msgpack_adapter {
+
+void pack(std::ostream &stream, shared_tracker_element e,
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map = nullptr);
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override {
+        pack(stream, in_elem, name_map);
+        return 0;
+    }
+};
+
+}
+
+#endif
+
@@ -37,13 +37,21 @@
 #include "packet_ieee80211.h"
 
 
+std::atomic<unsigned int> packet_component_pool_stats::pool_max{0};
+std::atomic<uint64_t> packet_component_pool_stats::hits{0};
+std::atomic<uint64_t> packet_component_pool_stats::misses{0};
+std::atomic<uint64_t> packet_component_pool_stats::discards{0};
+
 kis_packet::kis_packet() {
+    ts.tv_sec = 0;
+    ts.tv_usec = 0;
+
 	error = 0;
     crc_ok = 0;
 	filtered = 0;
     duplicate = 0;
+    original_len = 0;
 
-    content_vec = new packet_component *[MAX_PACKET_COMPONENTS];
     for (unsigned int x = 0; x < MAX_PACKET_COMPONENTS; x++)
         content_vec[x] = nullptr;
 }
@@ -54,10 +62,34 @@ kis_packet::~kis_packet() {
             continue;
 
         if (content_vec[x]->self_destruct)
-            delete content_vec[x];
+            release_packet_component(content_vec[x]);
+    }
+}
+
+void kis_packet::reset() {
+    for (unsigned int x = 0; x < MAX_PACKET_COMPONENTS; x++) {
+        if (content_vec[x] == nullptr)
+            continue;
+
+        if (content_vec[x]->self_destruct)
+            release_packet_component(content_vec[x]);
+
+        content_vec[x] = nullptr;
     }
 
-    delete[] content_vec;
+    ts.tv_sec = 0;
+    ts.tv_usec = 0;
+
+    error = 0;
+    crc_ok = 0;
+    filtered = 0;
+    duplicate = 0;
+    original_len = 0;
+
+    // Clearing keeps the allocated capacity of the vectors, which is the
+    // point of recycling the packet
+    process_complete_events.clear();
+    tag_vec.clear();
 }
    
 void kis_packet::insert(const unsigned int index, packet_component *data) {
@@ -89,7 +121,7 @@ void kis_packet::erase(const unsigned int index) {
 	// to happen or it will be very unhappy
 	if (content_vec[index] != nullptr) {
 		if (content_vec[index]->self_destruct)
-			delete content_vec[index];
+			release_packet_component(content_vec[index]);
 
 		content_vec[index] = NULL;
 	}
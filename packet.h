@@ -29,6 +29,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
@@ -36,6 +37,7 @@
 #include "eventbus.h"
 #include "globalregistry.h"
 #include "macaddr.h"
+#include "moodycamel/concurrentqueue.h"
 #include "packet_ieee80211.h"
 #include "trackedelement.h"
 #include "trackedcomponent.h"
@@ -55,9 +57,91 @@
 // High-level packet component so that we can provide our own destructors
 class packet_component {
 public:
-    packet_component() { self_destruct = 1; };
+    packet_component() { self_destruct = 1; recycle = nullptr; };
     virtual ~packet_component() { }
     int self_destruct;
+
+    // Set on components taken from a packet_component_pool; the packet hands the 
+    // component back to its pool instead of deleting it
+    void (*recycle)(packet_component *);
+};
+
+// Free a component owned by a packet, returning it to its pool if it has one
+inline void release_packet_component(packet_component *in_comp) {
+    if (in_comp->recycle != nullptr)
+        in_comp->recycle(in_comp);
+    else
+        delete in_comp;
+}
+
+// Limit and counters shared by every packet component pool; the limit is set from 
+// packet_pool_size by the packetchain
+struct packet_component_pool_stats {
+    static std::atomic<unsigned int> pool_max;
+    static std::atomic<uint64_t> hits;
+    static std::atomic<uint64_t> misses;
+    static std::atomic<uint64_t> discards;
+};
+
+// Recycling pool for a packet component type which is built for nearly every frame.
+// Components are built on the datasource threads and released on the packet threads,
+// so like the packet pool this is a moodycamel queue rather than a per-thread list.
+//
+// Pooled types provide reset(), which returns a used component to its freshly
+// constructed state.  A pooled component may still be deleted directly.
+template<class T>
+class packet_component_pool {
+public:
+    static T *acquire() {
+        T *comp;
+
+        if (get_queue().queue.try_dequeue(comp)) {
+            packet_component_pool_stats::hits++;
+            return comp;
+        }
+
+        packet_component_pool_stats::misses++;
+
+        comp = new T();
+        comp->recycle = &packet_component_pool<T>::release;
+
+        return comp;
+    }
+
+    static void release(packet_component *in_comp) {
+        auto comp = static_cast<T *>(in_comp);
+        auto& q = get_queue();
+
+        if (q.queue.size_approx() >= packet_component_pool_stats::pool_max) {
+            packet_component_pool_stats::discards++;
+            delete comp;
+            return;
+        }
+
+        comp->reset();
+        q.queue.enqueue(comp);
+    }
+
+    static size_t size() {
+        return get_queue().queue.size_approx();
+    }
+
+protected:
+    struct pool_queue {
+        moodycamel::ConcurrentQueue<T *> queue;
+
+        ~pool_queue() {
+            T *comp;
+
+            while (queue.try_dequeue(comp))
+                delete comp;
+        }
+    };
+
+    static pool_queue& get_queue() {
+        static pool_queue q;
+        return q;
+    }
 };
 
 // Overall packet container that holds packet information
@@ -80,17 +164,25 @@ public:
     // Are we a duplicate?
     int duplicate;
 
+    // Length of the frame as captured, when the capture source sent only part of
+    // it; 0 when the linkframe is the whole frame
+    unsigned int original_len;
+
     // Did this packet trigger creation of a new device?  Since a 
     // single packet can create multiple devices in some phys, maintain
     // a vector of device events to publish
     std::vector<std::shared_ptr<eventbus_event>> process_complete_events;
 
     // pre-allocated vector of broken down packet components
-    packet_component **content_vec;
+    packet_component *content_vec[MAX_PACKET_COMPONENTS];
 
     kis_packet();
     ~kis_packet();
 
+    // Release all components and return the packet to a freshly generated state
+    // so that it can be recycled by the packetchain packet pool
+    void reset();
+
     void insert(const unsigned int index, packet_component *data);
     void *fetch(const unsigned int index) const;
     template<class T> T* fetch(const unsigned int index) {
@@ -194,11 +286,31 @@ public:
     uint16_t source_id;
     bool self_data;
 
+    // Size of the buffer allocated by set_data or copy_data, which can be reused by
+    // later copies into the same chunk
+    unsigned int data_capacity;
+
     kis_datachunk() {
         self_destruct = 1; // Our delete() handles everything
         self_data = true; // We assume for now we have our own data alloc
         data = NULL;
+        data_capacity = 0;
         length = 0;
+        dlt = 0;
+        source_id = 0;
+    }
+
+    // Return to the freshly constructed state for reuse by a packet_component_pool;
+    // a buffer we own is kept for the next copy
+    void reset() {
+        if (!self_data) {
+            data = NULL;
+            data_capacity = 0;
+        }
+
+        self_data = true;
+        length = 0;
+        dlt = 0;
         source_id = 0;
     }
 
@@ -215,31 +327,34 @@ public:
 
     // Default to copy=true; it's always safe to copy, it's not always safe not to
     virtual void set_data(uint8_t *in_data, unsigned int in_length, bool copy = true) {
+        if (copy) {
+            copy_data(in_data, in_length);
+            return;
+        }
+
         if (data != NULL && self_data)
             delete[] data;
 
-        if (copy) {
-            data = new uint8_t[in_length];
-            memcpy(data, in_data, in_length);
-            self_data = true;
-        } else {
-            data = in_data;
-            self_data = false;
-        }
+        data = in_data;
+        data_capacity = 0;
+        self_data = false;
 
         length = in_length;
     }
 
     virtual void copy_data(const uint8_t *in_data, unsigned int in_length) {
-        if (data != NULL && self_data)
-            delete[] data;
+        if (data == NULL || !self_data || data_capacity < in_length) {
+            if (data != NULL && self_data)
+                delete[] data;
+
+            data = new uint8_t[in_length];
+            data_capacity = in_length;
+        }
 
-        data = new uint8_t[in_length];
         memcpy(data, in_data, in_length);
         self_data = true;
 
         length = in_length;
-
     }
 };
 
@@ -435,6 +550,11 @@ class kis_layer1_packinfo : public packet_component {
 public:
     kis_layer1_packinfo() {
         self_destruct = 1;  // Safe to delete us
+        reset();
+    }
+
+    // Return to the freshly constructed state for reuse by a packet_component_pool
+    void reset() {
         signal_type = kis_l1_signal_type_none;
         signal_dbm = noise_dbm = 0;
         signal_rssi = noise_rssi = 0;
@@ -444,6 +564,8 @@ public:
         freq_khz = 0;
         accuracy = 0;
         channel = "0";
+        antenna_signal_map.clear();
+        content_checkum = 0;
     }
 
     // How "accurate" are we?  Higher == better.  Nothing uses this yet
@@ -486,6 +608,12 @@ public:
         self_destruct = 1;
     }
 
+    // Return to the freshly constructed state for reuse by a packet_component_pool
+    void reset() {
+        type.clear();
+        json_string.clear();
+    }
+
     std::string type;
     std::string json_string;
 };
@@ -0,0 +1,170 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "packet_dedup.h"
+#include "xxhash.h"
+
+packet_dedup_filter::packet_dedup_filter(size_t in_capacity, uint64_t in_window_usec,
+        unsigned int in_shards) :
+    capacity{in_capacity},
+    window_usec{in_window_usec},
+    lookups{0},
+    hits{0} {
+
+    if (capacity == 0)
+        return;
+
+    // Don't make shards smaller than is useful for small dedup sizes
+    if (in_shards == 0)
+        in_shards = 1;
+
+    while (in_shards > 1 && capacity / in_shards < 64)
+        in_shards /= 2;
+
+    auto shard_sz = (capacity + in_shards - 1) / in_shards;
+
+    for (unsigned int s = 0; s < in_shards; s++) {
+        auto shard = std::unique_ptr<dedup_shard>(new dedup_shard());
+
+        shard->mutex.set_name("packet_dedup_filter shard");
+        shard->seen.reserve(shard_sz);
+        shard->ring.resize(shard_sz);
+        shard->head = 0;
+        shard->count = 0;
+
+        shards.push_back(std::move(shard));
+    }
+}
+
+uint64_t packet_dedup_filter::hash(const uint8_t *in_data, size_t in_len) {
+    return XXH64(in_data, in_len, 0);
+}
+
+void packet_dedup_filter::dedup_shard::pop_oldest() {
+    const auto& r = ring[head];
+
+    // Only drop the hash if it wasn't refreshed by a later record
+    auto si = seen.find(r.hash);
+    if (si != seen.end() && si->second == r.ts)
+        seen.erase(si);
+
+    head = (head + 1) % ring.size();
+    count--;
+}
+
+bool packet_dedup_filter::dedup_shard::check_locked(uint64_t in_hash, uint64_t in_now_usec,
+        uint64_t in_window_usec) {
+    // The timestamp is sampled before the shard lock, so another thread may already have 
+    // recorded a later one; never step backwards, which keeps the ring in time order and 
+    // stops the age below from underflowing
+    if (count > 0) {
+        auto newest = ring[(head + count - 1) % ring.size()].ts;
+        if (in_now_usec < newest)
+            in_now_usec = newest;
+    }
+
+    // Retire anything which has aged out of the window
+    if (in_window_usec != 0) {
+        while (count > 0 && 
+                ring[head].ts <= in_now_usec &&
+                in_now_usec - ring[head].ts > in_window_usec)
+            pop_oldest();
+    }
+
+    if (seen.find(in_hash) != seen.end())
+        return true;
+
+    if (count == ring.size())
+        pop_oldest();
+
+    auto tail = (head + count) % ring.size();
+    ring[tail].hash = in_hash;
+    ring[tail].ts = in_now_usec;
+    count++;
+
+    seen[in_hash] = in_now_usec;
+
+    return false;
+}
+
+void packet_dedup_filter::check(const std::vector<uint64_t>& in_hashes, 
+        std::vector<bool>& out_dupe, uint64_t in_now_usec) {
+    auto in_n = in_hashes.size();
+
+    out_dupe.assign(in_n, false);
+
+    if (capacity == 0)
+        return;
+
+    // Visit the hashes grouped by shard; the sort is stable so duplicates within the 
+    // group are still found in packet order
+    thread_local std::vector<uint32_t> order;
+
+    order.resize(in_n);
+    for (size_t i = 0; i < in_n; i++)
+        order[i] = i;
+
+    auto n_shards = shards.size();
+
+    std::stable_sort(order.begin(), order.end(), 
+            [&in_hashes, n_shards](uint32_t a, uint32_t b) {
+                return in_hashes[a] % n_shards < in_hashes[b] % n_shards;
+            });
+
+    uint64_t n_hits = 0;
+    size_t i = 0;
+
+    while (i < in_n) {
+        auto& shard = shards[in_hashes[order[i]] % n_shards];
+
+        std::lock_guard<kis_mutex> lk(shard->mutex);
+
+        do {
+            auto h = order[i];
+
+            out_dupe[h] = shard->check_locked(in_hashes[h], in_now_usec, window_usec);
+
+            if (out_dupe[h])
+                n_hits++;
+
+            i++;
+        } while (i < in_n && shards[in_hashes[order[i]] % n_shards] == shard);
+    }
+
+    lookups += in_n;
+
+    if (n_hits)
+        hits += n_hits;
+}
+
+size_t packet_dedup_filter::get_occupancy() {
+    size_t occupancy = 0;
+
+    for (const auto& s : shards) {
+        std::lock_guard<kis_mutex> lk(s->mutex);
+        occupancy += s->count;
+    }
+
+    return occupancy;
+}
+
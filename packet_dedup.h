@@ -0,0 +1,106 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __PACKET_DEDUP_H__
+#define __PACKET_DEDUP_H__
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+#include "kis_mutex.h"
+#include "robin_hood.h"
+
+// Time-windowed duplicate packet filter.
+//
+// Packets are identified by a 64bit hash of their content; a packet is a duplicate if 
+// the same hash has been seen within the time window.  Each shard holds a hash set for
+// constant-time lookup and a fixed-size ring of insertion order, which lets expired
+// entries be retired in order and bounds the total memory used; when a shard is full
+// the oldest entry is evicted, even if it is still inside the window.
+//
+// Sharding by hash keeps the packet processing threads from contending on a single
+// lock.
+class packet_dedup_filter {
+public:
+    // in_capacity is the total number of hashes remembered across all shards, a window
+    // of 0 disables time-based expiry and relies only on capacity
+    packet_dedup_filter(size_t in_capacity, uint64_t in_window_usec, unsigned int in_shards = 16);
+
+    // Hash packet content
+    static uint64_t hash(const uint8_t *in_data, size_t in_len);
+
+    // Check a group of hashes, such as one packet chain batch, taking each shard lock
+    // once.  out_dupe[i] is set if in_hashes[i] was seen within the window or earlier
+    // in the group; hashes which were not seen are recorded.  in_now_usec must come
+    // from a monotonic clock.
+    void check(const std::vector<uint64_t>& in_hashes, std::vector<bool>& out_dupe, 
+            uint64_t in_now_usec);
+
+    bool enabled() const {
+        return capacity > 0;
+    }
+
+    uint64_t get_lookups() const {
+        return lookups;
+    }
+
+    uint64_t get_hits() const {
+        return hits;
+    }
+
+    size_t get_capacity() const {
+        return capacity;
+    }
+
+    // Number of hashes currently remembered
+    size_t get_occupancy();
+
+protected:
+    struct dedup_record {
+        uint64_t hash;
+        uint64_t ts;
+    };
+
+    struct dedup_shard {
+        kis_mutex mutex;
+        robin_hood::unordered_flat_map<uint64_t, uint64_t> seen;
+        std::vector<dedup_record> ring;
+        size_t head;
+        size_t count;
+
+        void pop_oldest();
+
+        // Check and record a hash; the shard must be locked
+        bool check_locked(uint64_t in_hash, uint64_t in_now_usec, uint64_t in_window_usec);
+    };
+
+    size_t capacity;
+    uint64_t window_usec;
+
+    std::vector<std::unique_ptr<dedup_shard>> shards;
+
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> hits;
+};
+
+#endif
+
@@ -30,14 +30,41 @@
 #include "alertracker.h"
 #include "configfile.h"
 #include "globalregistry.h"
+#include "kis_datasource.h"
+#include "kis_dlt_radiotap.h"
+#include "kis_ppi.h"
 #include "messagebus.h"
 #include "packet.h"
 #include "packetchain.h"
 
+void packet_chain_timing::record(uint64_t ns, unsigned int n_packets) {
+    count++;
+    packets += n_packets;
+    total_ns += ns;
+
+    auto prev_max = max_ns.load();
+    while (ns > prev_max && !max_ns.compare_exchange_weak(prev_max, ns))
+        ;
+
+    auto us = ns / 1000;
+    unsigned int b = 0;
+
+    while (us > 0 && b < num_buckets - 1) {
+        us >>= 1;
+        b++;
+    }
+
+    buckets[b]++;
+}
+
+// Set on packet processing threads so that handlers which modify the chain from inside 
+// the chain don't wait on themselves
+static thread_local bool packet_chain_worker_thread = false;
+
 class SortLinkPriority {
 public:
-    inline bool operator() (const packet_chain::pc_link *x, 
-                            const packet_chain::pc_link *y) const {
+    inline bool operator() (const std::shared_ptr<packet_chain::pc_link>& x, 
+                            const std::shared_ptr<packet_chain::pc_link>& y) const {
         if (x->priority < y->priority)
             return 1;
         return 0;
@@ -51,6 +78,8 @@ packet_chain::packet_chain() {
     next_componentid = 1;
 	next_handlerid = 1;
 
+    chain_snapshot = std::make_shared<pc_chain_snapshot>();
+
     last_packet_queue_user_warning = 0;
     last_packet_drop_user_warning = 0;
 
@@ -59,6 +88,56 @@ packet_chain::packet_chain() {
     packet_queue_drop =
         Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_backlog_limit", 8192);
 
+    packet_pool_max =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_pool_size", 4096);
+    packet_pool_hits = 0;
+    packet_pool_misses = 0;
+    packet_pool_discards = 0;
+
+    // The per-frame component pools follow the packet pool size
+    packet_component_pool_stats::pool_max = packet_pool_max;
+
+#if 1
+    packet_thread_count = std::thread::hardware_concurrency();
+#else
+    packet_thread_count = 1;
+#endif
+
+    if (packet_thread_count == 0)
+        packet_thread_count = 1;
+
+    auto dispatch_mode = 
+        Globalreg::globalreg->kismet_config->fetch_opt_dfl("packet_dispatch_mode", "shared");
+
+    if (str_lower(dispatch_mode) == "flow") {
+        flow_dispatch = true;
+    } else {
+        if (str_lower(dispatch_mode) != "shared")
+            _MSG_ERROR("Unknown packet_dispatch_mode '{}', expected 'shared' or 'flow'; using "
+                    "the shared packet queue.", dispatch_mode);
+        flow_dispatch = false;
+    }
+
+    flow_steal = 
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("packet_dispatch_steal", false);
+    flow_steal_threshold =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dispatch_steal_threshold", 64);
+
+    packet_batch_max =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_batch_size", 1);
+
+    if (packet_batch_max == 0)
+        packet_batch_max = 1;
+
+    chain_timing =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("packet_chain_timing", false);
+
+    for (int c = CHAINPOS_POSTCAP; c <= CHAINPOS_LOGGING; c++)
+        stage_timing[c] = std::make_shared<packet_chain_timing>();
+
+    pack_comp_linkframe = register_packet_component("LINKFRAME");
+    pack_comp_datasrc = register_packet_component("KISDATASRC");
+
     auto entrytracker = 
         Globalreg::fetch_mandatory_global_as<entry_tracker>();
 
@@ -115,6 +194,148 @@ packet_chain::packet_chain() {
     packet_processed_rrd =
         std::make_shared<kis_tracked_rrd<>>(packet_processed_rrd_id);
 
+    packet_pool_hits_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets allocated from the recycling pool");
+    packet_pool_misses_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.misses",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets allocated because the recycling pool was empty");
+    packet_pool_discards_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.discards",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets freed because the recycling pool was full");
+    packet_pool_size_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.size",
+                tracker_element_factory<tracker_element_uint64>(),
+                "approximate number of packets in the recycling pool");
+
+    component_pool_hits_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.component_hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packet components allocated from the recycling pools");
+    component_pool_misses_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.component_misses",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packet components allocated because the recycling pool was empty");
+    component_pool_discards_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool.component_discards",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packet components freed because the recycling pool was full");
+
+    packet_pool_map =
+        std::make_shared<tracker_element_map>();
+    packet_pool_map->insert(packet_pool_hits_elem);
+    packet_pool_map->insert(packet_pool_misses_elem);
+    packet_pool_map->insert(packet_pool_discards_elem);
+    packet_pool_map->insert(packet_pool_size_elem);
+    packet_pool_map->insert(component_pool_hits_elem);
+    packet_pool_map->insert(component_pool_misses_elem);
+    packet_pool_map->insert(component_pool_discards_elem);
+
+    auto worker_map_id =
+        entrytracker->register_field("kismet.packetchain.worker",
+                tracker_element_factory<tracker_element_map>(),
+                "packet processing worker");
+    auto worker_id_id =
+        entrytracker->register_field("kismet.packetchain.worker.id",
+                tracker_element_factory<tracker_element_uint32>(),
+                "worker number");
+    auto worker_depth_id =
+        entrytracker->register_field("kismet.packetchain.worker.queue_depth",
+                tracker_element_factory<tracker_element_uint64>(),
+                "approximate packets queued for this worker");
+    auto worker_processed_id =
+        entrytracker->register_field("kismet.packetchain.worker.processed",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets processed by this worker");
+    auto worker_steals_id =
+        entrytracker->register_field("kismet.packetchain.worker.steals",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets stolen from other workers");
+
+    packet_worker_vec =
+        entrytracker->register_and_get_field_as<tracker_element_vector>("kismet.packetchain.workers",
+                tracker_element_factory<tracker_element_vector>(),
+                "per-worker packet dispatch statistics");
+
+    // Worker queues are only used in flow mode, but the stats are always built so the
+    // structure of the stats records doesn't change with the dispatch mode
+    for (unsigned int n = 0; n < packet_thread_count; n++) {
+        auto worker = std::unique_ptr<packet_worker>(new packet_worker());
+
+        worker->processed = 0;
+        worker->steals = 0;
+
+        worker->stats_map = std::make_shared<tracker_element_map>(worker_map_id);
+        worker->queue_depth_elem = std::make_shared<tracker_element_uint64>(worker_depth_id);
+        worker->processed_elem = std::make_shared<tracker_element_uint64>(worker_processed_id);
+        worker->steals_elem = std::make_shared<tracker_element_uint64>(worker_steals_id);
+
+        worker->stats_map->insert(std::make_shared<tracker_element_uint32>(worker_id_id, n));
+        worker->stats_map->insert(worker->queue_depth_elem);
+        worker->stats_map->insert(worker->processed_elem);
+        worker->stats_map->insert(worker->steals_elem);
+
+        packet_worker_vec->push_back(worker->stats_map);
+
+        packet_workers.push_back(std::move(worker));
+    }
+
+    handler_stats_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats",
+                tracker_element_factory<tracker_element_map>(),
+                "packet chain handler timing");
+    handler_stats_handlers_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.handlers",
+                tracker_element_factory<tracker_element_vector>(),
+                "per-handler timing");
+    handler_stats_stages_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.stages",
+                tracker_element_factory<tracker_element_vector>(),
+                "per-chain-stage timing");
+    handler_stats_entry_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.entry",
+                tracker_element_factory<tracker_element_map>(),
+                "handler or stage timing");
+    handler_stats_name_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.name",
+                tracker_element_factory<tracker_element_string>(),
+                "handler name");
+    handler_stats_chain_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.chain",
+                tracker_element_factory<tracker_element_string>(),
+                "packet chain stage");
+    handler_stats_priority_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.priority",
+                tracker_element_factory<tracker_element_int32>(),
+                "handler priority");
+    handler_stats_count_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.calls",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of calls");
+    handler_stats_packets_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.packets",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of packets processed");
+    handler_stats_total_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.total_usec",
+                tracker_element_factory<tracker_element_uint64>(),
+                "total time spent (usec)");
+    handler_stats_max_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.max_usec",
+                tracker_element_factory<tracker_element_uint64>(),
+                "longest call (usec)");
+    handler_stats_mean_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.mean_usec",
+                tracker_element_factory<tracker_element_double>(),
+                "mean time per call (usec)");
+    handler_stats_hist_id =
+        entrytracker->register_field("kismet.packetchain.handler_stats.histogram",
+                tracker_element_factory<tracker_element_vector_double>(),
+                "call time histogram; bucket 0 is under 1us, bucket N is 2^(N-1) to 2^N usec");
+
     packet_stats_map = 
         std::make_shared<tracker_element_map>();
     packet_stats_map->insert(packet_peak_rrd);
@@ -124,6 +345,11 @@ packet_chain::packet_chain() {
     packet_stats_map->insert(packet_queue_rrd);
     packet_stats_map->insert(packet_drop_rrd);
     packet_stats_map->insert(packet_processed_rrd);
+    packet_stats_map->insert(packet_pool_hits_elem);
+    packet_stats_map->insert(packet_pool_misses_elem);
+    packet_stats_map->insert(packet_pool_discards_elem);
+    packet_stats_map->insert(packet_pool_size_elem);
+    packet_stats_map->insert(packet_worker_vec);
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
@@ -144,6 +370,23 @@ packet_chain::packet_chain() {
             std::make_shared<kis_net_web_tracked_endpoint>(packet_drop_rrd));
     httpd->register_route("/packetchain/packet_processed", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(packet_processed_rrd));
+    httpd->register_route("/packetchain/packet_workers", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection>) -> std::shared_ptr<tracker_element> {
+                    update_worker_stats();
+                    return packet_worker_vec;
+                }));
+    httpd->register_route("/packetchain/handler_stats", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection>) -> std::shared_ptr<tracker_element> {
+                    return generate_handler_stats();
+                }));
+    httpd->register_route("/packetchain/packet_pool", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection>) -> std::shared_ptr<tracker_element> {
+                    update_pool_stats();
+                    return packet_pool_map;
+                }));
 
     packetchain_shutdown = false;
 
@@ -154,8 +397,14 @@ packet_chain::packet_chain() {
         timetracker->register_timer(std::chrono::seconds(1), true, 
                 [this](int) -> int {
 
+                update_pool_stats();
+                update_worker_stats();
+
                 auto evt = eventbus->get_eventbus_event(event_packetstats());
                 evt->get_event_content()->insert(event_packetstats(), packet_stats_map);
+
+                if (chain_timing)
+                    evt->get_event_content()->insert(event_handlerstats(), generate_handler_stats());
                 eventbus->publish(evt);
 
                 return 1;
@@ -166,9 +415,15 @@ packet_chain::~packet_chain() {
     timetracker->remove_timer(event_timer_id);
 
     {
-        // Tell the packet thread we're dying and unlock it
+        // Tell the packet threads we're dying and unlock them
         packetchain_shutdown = true;
-        packet_queue.enqueue(nullptr);
+
+        for (unsigned int n = 0; n < packet_thread_count; n++) {
+            if (flow_dispatch)
+                packet_workers[n]->queue.enqueue(nullptr);
+            else
+                packet_queue.enqueue(nullptr);
+        }
 
         for (auto& t: packet_threads) {
             if (t.joinable())
@@ -179,54 +434,35 @@ packet_chain::~packet_chain() {
     }
 
     {
-        kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, "~packet_chain");
-
-        Globalreg::globalreg->remove_global("PACKETCHAIN");
-        Globalreg::globalreg->packetchain = NULL;
-
-        for (auto i : postcap_chain)
-            delete(i);
-        postcap_chain.clear();
-
-        for (auto i : llcdissect_chain)
-            delete(i);
-        llcdissect_chain.clear();
-
-        for (auto i : decrypt_chain)
-            delete(i);
-        decrypt_chain.clear();
+        kis_packet *pack;
 
-        for (auto i : datadissect_chain)
-            delete(i);
-        datadissect_chain.clear();
-
-        for (auto i : classifier_chain)
-            delete(i);
-        classifier_chain.clear();
+        while (packet_pool.try_dequeue(pack))
+            delete pack;
+    }
 
-        for (auto i : tracker_chain)
-            delete(i);
-        tracker_chain.clear();
+    {
+        kis_lock_guard<kis_mutex> lk(packetchain_mutex, "~packet_chain");
 
-        for (auto i : logging_chain)
-            delete(i);
-        logging_chain.clear();
+        Globalreg::globalreg->remove_global("PACKETCHAIN");
+        Globalreg::globalreg->packetchain = NULL;
 
+        std::atomic_store(&chain_snapshot, 
+                std::shared_ptr<const pc_chain_snapshot>(std::make_shared<pc_chain_snapshot>()));
     }
 
 }
 
 void packet_chain::start_processing() {
-#if 1
-    auto nt = static_cast<int>(std::thread::hardware_concurrency());
-#else
-    auto nt = int(1);
-#endif
+    auto nt = packet_thread_count;
+
+    if (flow_dispatch)
+        _MSG_INFO("Dispatching packets to {} packet processing threads by flow{}", nt,
+                flow_steal ? ", with work stealing" : "");
 
-    for (int n = 0; n < nt; n++) {
+    for (unsigned int n = 0; n < nt; n++) {
         packet_threads.emplace_back(std::thread([this, nt, n]() {
                 thread_set_process_name(fmt::format("packethandler {}/{}", n, nt));
-                packet_queue_processor();
+                packet_queue_processor(n);
                 }));
     }
 
@@ -282,94 +518,303 @@ std::string packet_chain::fetch_packet_component_name(int in_id) {
 }
 
 kis_packet *packet_chain::generate_packet() {
-    kis_packet *newpack = new kis_packet();
+    kis_packet *newpack;
+
+    if (packet_pool.try_dequeue(newpack)) {
+        packet_pool_hits++;
+        return newpack;
+    }
+
+    packet_pool_misses++;
 
-    return newpack;
+    return new kis_packet();
 }
 
-void packet_chain::packet_queue_processor() {
-    kis_packet *packet = NULL;
+void packet_chain::update_pool_stats() {
+    packet_pool_hits_elem->set(packet_pool_hits);
+    packet_pool_misses_elem->set(packet_pool_misses);
+    packet_pool_discards_elem->set(packet_pool_discards);
+    packet_pool_size_elem->set(packet_pool.size_approx());
+    component_pool_hits_elem->set(packet_component_pool_stats::hits);
+    component_pool_misses_elem->set(packet_component_pool_stats::misses);
+    component_pool_discards_elem->set(packet_component_pool_stats::discards);
+}
+
+uint64_t packet_chain::packet_flow_key(kis_packet *in_pack) {
+    uint64_t key = 0;
+
+    auto chunk = in_pack->fetch<kis_datachunk>(pack_comp_linkframe);
+
+    if (chunk != nullptr && chunk->data != nullptr) {
+        unsigned int offt = chunk->length;
+
+        switch (chunk->dlt) {
+            case KDLT_IEEE802_11:
+                offt = 0;
+                break;
+            // Radiotap and PPI both carry a little-endian header length at the 
+            // same location
+            case DLT_IEEE802_11_RADIO:
+            case DLT_PPI:
+                if (chunk->length >= 4)
+                    offt = chunk->data[2] | (chunk->data[3] << 8);
+                break;
+        }
+
+        // Use the transmitter when there is one; short control frames like ACK and 
+        // CTS only carry the receiver, which is the device they relate to
+        if (chunk->length >= offt + 16)
+            memcpy(&key, chunk->data + offt + 10, 6);
+        else if (chunk->length >= offt + 10)
+            memcpy(&key, chunk->data + offt + 4, 6);
+    }
+
+    if (key == 0) {
+        auto datasrc = in_pack->fetch<packetchain_comp_datasource>(pack_comp_datasrc);
+
+        if (datasrc != nullptr)
+            key = reinterpret_cast<uintptr_t>(datasrc->ref_source);
+    }
+
+    // Mix the key so that sequential addresses spread across workers
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+size_t packet_chain::dequeue_worker_packets(unsigned int worker_id, kis_packet **packets, 
+        size_t max) {
+    if (!flow_dispatch)
+        return packet_queue.wait_dequeue_bulk(packets, max);
+
+    auto& worker = packet_workers[worker_id];
+
+    if (!flow_steal)
+        return worker->queue.wait_dequeue_bulk(packets, max);
+
+    auto n = worker->queue.try_dequeue_bulk(packets, max);
+
+    if (n > 0)
+        return n;
+
+    // Only steal from workers which are significantly backlogged, so that normal
+    // load keeps strict per-flow ordering
+    for (unsigned int w = 1; w < packet_thread_count; w++) {
+        auto& victim = packet_workers[(worker_id + w) % packet_thread_count];
+
+        if (victim->queue.size_approx() < flow_steal_threshold)
+            continue;
+
+        n = victim->queue.try_dequeue_bulk(packets, max);
+
+        if (n > 0) {
+            worker->steals += n;
+            return n;
+        }
+    }
+
+    return worker->queue.wait_dequeue_bulk_timed(packets, max, std::chrono::milliseconds(5));
+}
+
+size_t packet_chain::packet_queue_size() {
+    if (!flow_dispatch)
+        return packet_queue.size_approx();
+
+    size_t sz = 0;
+
+    for (const auto& w : packet_workers)
+        sz += w->queue.size_approx();
+
+    return sz;
+}
+
+void packet_chain::update_worker_stats() {
+    for (const auto& w : packet_workers) {
+        w->queue_depth_elem->set(w->queue.size_approx());
+        w->processed_elem->set(w->processed);
+        w->steals_elem->set(w->steals);
+    }
+}
+
+void packet_chain::process_chain_batch(const pc_chain_t& chain, 
+        const std::vector<kis_packet *>& batch) {
+    for (const auto& pcl : chain) {
+        if (pcl->b_callback != nullptr) {
+            pcl->b_callback(batch);
+            continue;
+        }
+
+        if (pcl->callback != nullptr) {
+            for (const auto& packet : batch) 
+                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
+        } else if (pcl->l_callback != nullptr) {
+            for (const auto& packet : batch) 
+                pcl->l_callback(packet);
+        }
+    }
+}
+
+void packet_chain::process_chain_batch_timed(int chainpos, const pc_chain_t& chain,
+        const std::vector<kis_packet *>& batch) {
+    auto stage_start = std::chrono::steady_clock::now();
+
+    for (const auto& pcl : chain) {
+        auto handler_start = std::chrono::steady_clock::now();
+
+        if (pcl->b_callback != nullptr) {
+            pcl->b_callback(batch);
+        } else if (pcl->callback != nullptr) {
+            for (const auto& packet : batch) 
+                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
+        } else if (pcl->l_callback != nullptr) {
+            for (const auto& packet : batch) 
+                pcl->l_callback(packet);
+        }
+
+        pcl->timing->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - handler_start).count(), batch.size());
+    }
+
+    stage_timing[chainpos]->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - stage_start).count(), batch.size());
+}
+
+std::string packet_chain::chain_name(int chainpos) {
+    switch (chainpos) {
+        case CHAINPOS_POSTCAP:
+            return "postcap";
+        case CHAINPOS_LLCDISSECT:
+            return "llcdissect";
+        case CHAINPOS_DECRYPT:
+            return "decrypt";
+        case CHAINPOS_DATADISSECT:
+            return "datadissect";
+        case CHAINPOS_CLASSIFIER:
+            return "classifier";
+        case CHAINPOS_TRACKER:
+            return "tracker";
+        case CHAINPOS_LOGGING:
+            return "logging";
+    }
+
+    return "unknown";
+}
+
+std::shared_ptr<tracker_element_map> packet_chain::timing_to_map(const std::string& name, 
+        int chainpos, int priority, const std::shared_ptr<packet_chain_timing>& timing) {
+    auto m = std::make_shared<tracker_element_map>(handler_stats_entry_id);
+
+    uint64_t count = timing->count;
+    uint64_t total = timing->total_ns;
+
+    m->insert(std::make_shared<tracker_element_string>(handler_stats_name_id, name));
+    m->insert(std::make_shared<tracker_element_string>(handler_stats_chain_id, chain_name(chainpos)));
+    m->insert(std::make_shared<tracker_element_int32>(handler_stats_priority_id, priority));
+    m->insert(std::make_shared<tracker_element_uint64>(handler_stats_count_id, count));
+    m->insert(std::make_shared<tracker_element_uint64>(handler_stats_packets_id, timing->packets));
+    m->insert(std::make_shared<tracker_element_uint64>(handler_stats_total_id, total / 1000));
+    m->insert(std::make_shared<tracker_element_uint64>(handler_stats_max_id, timing->max_ns / 1000));
+    m->insert(std::make_shared<tracker_element_double>(handler_stats_mean_id,
+                count == 0 ? 0 : (double) total / count / 1000));
+
+    auto hist = std::make_shared<tracker_element_vector_double>(handler_stats_hist_id);
+    for (unsigned int b = 0; b < packet_chain_timing::num_buckets; b++)
+        hist->push_back(timing->buckets[b]);
+    m->insert(hist);
+
+    return m;
+}
+
+std::shared_ptr<tracker_element_map> packet_chain::generate_handler_stats() {
+    auto stats = std::make_shared<tracker_element_map>(handler_stats_id);
+    auto handlers = std::make_shared<tracker_element_vector>(handler_stats_handlers_id);
+    auto stages = std::make_shared<tracker_element_vector>(handler_stats_stages_id);
+
+    stats->insert(handlers);
+    stats->insert(stages);
+
+    if (!chain_timing)
+        return stats;
+
+    auto snapshot = get_chain_snapshot();
+
+    for (int c = CHAINPOS_POSTCAP; c <= CHAINPOS_LOGGING; c++) {
+        stages->push_back(timing_to_map(chain_name(c), c, 0, stage_timing[c]));
+
+        for (const auto& pcl : snapshot->chains[c]) 
+            handlers->push_back(timing_to_map(pcl->name, c, pcl->priority, pcl->timing));
+    }
+
+    return stats;
+}
+
+void packet_chain::packet_queue_processor(unsigned int worker_id) {
+    std::vector<kis_packet *> batch;
+
+    packet_chain_worker_thread = true;
 
     while (!packetchain_shutdown && 
             !Globalreg::globalreg->spindown && 
             !Globalreg::globalreg->fatal_condition &&
             !Globalreg::globalreg->complete) {
 
-        packet_queue.wait_dequeue(packet);
+        batch.resize(packet_batch_max);
 
-        if (packet == nullptr)
-            break;
+        auto n = dequeue_worker_packets(worker_id, batch.data(), packet_batch_max);
 
-        {
-            // Lock the chain mutexes until we're done processing this packet
-            // kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, kismet::shared_lock, "packet_queue_processor");
-            std::shared_lock<kis_shared_mutex> lk(packetchain_mutex);
-
-            // These can only be perturbed inside a sync, which can only occur when
-            // the worker thread is in the sync block above, so we shouldn't
-            // need to worry about the integrity of these vectors while running
-
-            for (const auto& pcl : postcap_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+        // Drop any shutdown sentinels; the loop condition takes care of the rest
+        size_t valid = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i] != nullptr)
+                batch[valid++] = batch[i];
+        }
 
-            for (const auto& pcl : llcdissect_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+        if (valid == 0)
+            continue;
 
-            for (const auto& pcl : decrypt_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+        batch.resize(valid);
 
-            for (const auto& pcl : datadissect_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
+        {
+            // Hold a reference to the current chains until we're done with this batch;
+            // handler changes publish a new snapshot and don't affect this one
+            auto snapshot = get_chain_snapshot();
+            const auto& chains = snapshot->chains;
+
+            if (chain_timing) {
+                for (int c = CHAINPOS_POSTCAP; c <= CHAINPOS_LOGGING; c++)
+                    process_chain_batch_timed(c, chains[c], batch);
+            } else {
+                for (int c = CHAINPOS_POSTCAP; c <= CHAINPOS_LOGGING; c++)
+                    process_chain_batch(chains[c], batch);
             }
+        }
 
-            for (const auto& pcl : classifier_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+        // Aggregate the rrd updates across the whole batch
+        unsigned int n_error = 0, n_dupe = 0;
 
-            for (const auto& pcl : tracker_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+        for (const auto& packet : batch) {
+            if (packet->error)
+                n_error++;
 
-            for (const auto& pcl : logging_chain) {
-                if (pcl->callback != nullptr)
-                    pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-                else if (pcl->l_callback != nullptr)
-                    pcl->l_callback(packet);
-            }
+            if (packet->duplicate)
+                n_dupe++;
+
+            destroy_packet(packet);
         }
 
-        if (packet->error)
-            packet_error_rrd->add_sample(1, time(0));
+        auto now = time(0);
 
-        if (packet->duplicate)
-            packet_dupe_rrd->add_sample(1, time(0));
+        if (n_error)
+            packet_error_rrd->add_sample(n_error, now);
 
-        packet_processed_rrd->add_sample(1, time(0));
+        if (n_dupe)
+            packet_dupe_rrd->add_sample(n_dupe, now);
 
-        destroy_packet(packet);
+        packet_processed_rrd->add_sample(batch.size(), now);
 
-        continue;
+        packet_workers[worker_id]->processed += batch.size();
     }
 }
 
@@ -378,7 +823,9 @@ int packet_chain::process_packet(kis_packet *in_pack) {
     packet_rate_rrd->add_sample(1, time(0));
     packet_peak_rrd->add_sample(1, time(0));
 
-    if (packet_queue_drop != 0 && packet_queue.size_approx() > packet_queue_drop) {
+    auto queue_sz = packet_queue_size();
+
+    if (packet_queue_drop != 0 && queue_sz > packet_queue_drop) {
         time_t offt = time(0) - last_packet_drop_user_warning;
 
         if (offt > 30) {
@@ -402,7 +849,7 @@ int packet_chain::process_packet(kis_packet *in_pack) {
         return 1;
     }
 
-    if (packet_queue.size_approx() > packet_queue_warning && packet_queue_warning != 0) {
+    if (queue_sz > packet_queue_warning && packet_queue_warning != 0) {
         time_t offt = time(0) - last_packet_queue_user_warning;
 
         if (offt > 30) {
@@ -421,233 +868,159 @@ int packet_chain::process_packet(kis_packet *in_pack) {
 
 
     // Queue the packet
-    packet_queue.enqueue(in_pack);
+    if (flow_dispatch)
+        packet_workers[packet_flow_key(in_pack) % packet_thread_count]->queue.enqueue(in_pack);
+    else
+        packet_queue.enqueue(in_pack);
 
-    packet_queue_rrd->add_sample(packet_queue.size_approx(), time(0));
+    packet_queue_rrd->add_sample(packet_queue_size(), time(0));
 
     return 1;
 }
 
-void packet_chain::destroy_packet(kis_packet *in_pack) {
-
-	delete in_pack;
-}
-
-int packet_chain::register_int_handler(pc_callback in_cb, void *in_aux,
-        std::function<int (kis_packet *)> in_l_cb, 
-        int in_chain, int in_prio) {
+int packet_chain::process_packets(const std::vector<kis_packet *>& in_packs) {
+    if (in_packs.size() == 0)
+        return 1;
 
-    kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, "register_int_handler");
+    auto queue_sz = packet_queue_size();
 
-    pc_link *link = NULL;
+    // Near the warning or drop limits, take the per-packet path so that drops
+    // and user warnings behave exactly as they do for single packets
+    if ((packet_queue_drop != 0 && queue_sz + in_packs.size() > packet_queue_drop) ||
+            (packet_queue_warning != 0 && queue_sz + in_packs.size() > packet_queue_warning)) {
+        for (auto p : in_packs)
+            process_packet(p);
+        return 1;
+    }
 
-    // Generate packet, we'll nuke it if it's invalid later
-    link = new pc_link;
-    link->priority = in_prio;
-    link->callback = in_cb;
-    link->l_callback = in_l_cb;
-    link->auxdata = in_aux;
-    link->id = next_handlerid++;
+    auto now = time(0);
 
-    switch (in_chain) {
-        case CHAINPOS_POSTCAP:
-            postcap_chain.push_back(link);
-            stable_sort(postcap_chain.begin(), postcap_chain.end(), 
-                    SortLinkPriority());
-            break;
+    packet_rate_rrd->add_sample(in_packs.size(), now);
+    packet_peak_rrd->add_sample(in_packs.size(), now);
 
-        case CHAINPOS_LLCDISSECT:
-            llcdissect_chain.push_back(link);
-            stable_sort(llcdissect_chain.begin(), llcdissect_chain.end(), 
-                    SortLinkPriority());
-            break;
+    if (flow_dispatch) {
+        for (auto p : in_packs)
+            packet_workers[packet_flow_key(p) % packet_thread_count]->queue.enqueue(p);
+    } else {
+        packet_queue.enqueue_bulk(in_packs.begin(), in_packs.size());
+    }
 
-        case CHAINPOS_DECRYPT:
-            decrypt_chain.push_back(link);
-            stable_sort(decrypt_chain.begin(), decrypt_chain.end(), 
-                    SortLinkPriority());
-            break;
+    packet_queue_rrd->add_sample(packet_queue_size(), now);
 
-        case CHAINPOS_DATADISSECT:
-            datadissect_chain.push_back(link);
-            stable_sort(datadissect_chain.begin(), datadissect_chain.end(), 
-                    SortLinkPriority());
-            break;
+    return 1;
+}
 
-        case CHAINPOS_CLASSIFIER:
-            classifier_chain.push_back(link);
-            stable_sort(classifier_chain.begin(), classifier_chain.end(), 
-                    SortLinkPriority());
-            break;
+void packet_chain::destroy_packet(kis_packet *in_pack) {
+    if (in_pack == nullptr)
+        return;
 
-        case CHAINPOS_TRACKER:
-            tracker_chain.push_back(link);
-            stable_sort(tracker_chain.begin(), tracker_chain.end(), 
-                    SortLinkPriority());
-            break;
+    // Release the components now so that nothing lingers in a pooled packet
+    in_pack->reset();
 
-        case CHAINPOS_LOGGING:
-            logging_chain.push_back(link);
-            stable_sort(logging_chain.begin(), logging_chain.end(), 
-                    SortLinkPriority());
-            break;
-
-        default:
-            delete link;
-            _MSG("packet_chain::register_handler requested unknown chain", MSGFLAG_ERROR);
-            return -1;
+    if (packet_pool_max == 0 || packetchain_shutdown || 
+            packet_pool.size_approx() >= packet_pool_max) {
+        packet_pool_discards++;
+        delete in_pack;
+        return;
     }
 
-    return link->id;
-}
-
-int packet_chain::register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio) {
-    return register_int_handler(in_cb, in_aux, NULL, in_chain, in_prio);
+    packet_pool.enqueue(in_pack);
 }
 
-int packet_chain::register_handler(std::function<int (kis_packet *)> in_cb, int in_chain, int in_prio) {
-    return register_int_handler(NULL, NULL, in_cb, in_chain, in_prio);
-}
+void packet_chain::publish_chain_snapshot(std::shared_ptr<const pc_chain_snapshot> in_snapshot) {
+    auto old_snapshot = std::atomic_exchange(&chain_snapshot, in_snapshot);
 
-int packet_chain::remove_handler(int in_id, int in_chain) {
-    kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, "remove_handler");
+    // Packet threads only ever copy the current snapshot, so once every other reference
+    // to the old snapshot is gone no thread can be running a handler which was just 
+    // removed.  A handler modifying the chain from inside the chain would be waiting
+    // on itself, so skip the wait there.
+    if (packet_chain_worker_thread)
+        return;
 
-    unsigned int x;
+    while (old_snapshot.use_count() > 1)
+        std::this_thread::yield();
+}
 
-    switch (in_chain) {
-        case CHAINPOS_POSTCAP:
-            for (x = 0; x < postcap_chain.size(); x++) {
-                if (postcap_chain[x]->id == in_id) {
-                    postcap_chain.erase(postcap_chain.begin() + x);
-                }
-            }
-            break;
+int packet_chain::register_int_handler(pc_callback in_cb, void *in_aux,
+        std::function<int (kis_packet *)> in_l_cb, 
+        pc_batch_callback in_b_cb,
+        int in_chain, int in_prio, const std::string& in_name) {
 
-        case CHAINPOS_LLCDISSECT:
-            for (x = 0; x < llcdissect_chain.size(); x++) {
-                if (llcdissect_chain[x]->id == in_id) {
-                    llcdissect_chain.erase(llcdissect_chain.begin() + x);
-                }
-            }
-            break;
+    if (in_chain < CHAINPOS_POSTCAP || in_chain > CHAINPOS_LOGGING) {
+        _MSG("packet_chain::register_handler requested unknown chain", MSGFLAG_ERROR);
+        return -1;
+    }
 
-        case CHAINPOS_DECRYPT:
-            for (x = 0; x < decrypt_chain.size(); x++) {
-                if (decrypt_chain[x]->id == in_id) {
-                    decrypt_chain.erase(decrypt_chain.begin() + x);
-                }
-            }
-            break;
+    kis_lock_guard<kis_mutex> lk(packetchain_mutex, "register_int_handler");
 
-        case CHAINPOS_DATADISSECT:
-            for (x = 0; x < datadissect_chain.size(); x++) {
-                if (datadissect_chain[x]->id == in_id) {
-                    datadissect_chain.erase(datadissect_chain.begin() + x);
-                }
-            }
-            break;
+    auto link = std::make_shared<pc_link>();
+    link->priority = in_prio;
+    link->callback = in_cb;
+    link->l_callback = in_l_cb;
+    link->b_callback = in_b_cb;
+    link->auxdata = in_aux;
+    link->id = next_handlerid++;
+    link->timing = std::make_shared<packet_chain_timing>();
 
-        case CHAINPOS_CLASSIFIER:
-            for (x = 0; x < classifier_chain.size(); x++) {
-                if (classifier_chain[x]->id == in_id) {
-                    classifier_chain.erase(classifier_chain.begin() + x);
-                }
-            }
-            break;
+    if (in_name.length())
+        link->name = in_name;
+    else
+        link->name = fmt::format("{} handler {}", chain_name(in_chain), link->id);
 
-        case CHAINPOS_TRACKER:
-            for (x = 0; x < tracker_chain.size(); x++) {
-                if (tracker_chain[x]->id == in_id) {
-                    tracker_chain.erase(tracker_chain.begin() + x);
-                }
-            }
-            break;
+    auto snapshot = std::make_shared<pc_chain_snapshot>(*get_chain_snapshot());
+    auto& chain = snapshot->chains[in_chain];
 
-        case CHAINPOS_LOGGING:
-            for (x = 0; x < logging_chain.size(); x++) {
-                if (logging_chain[x]->id == in_id) {
-                    logging_chain.erase(logging_chain.begin() + x);
-                }
-            }
-            break;
+    chain.push_back(link);
+    stable_sort(chain.begin(), chain.end(), SortLinkPriority());
 
-        default:
-            _MSG("packet_chain::remove_handler requested unknown chain", 
-                    MSGFLAG_ERROR);
-            return -1;
-    }
+    publish_chain_snapshot(snapshot);
 
-    return 1;
+    return link->id;
 }
 
-int packet_chain::remove_handler(pc_callback in_cb, int in_chain) {
-    kis_lock_guard<kis_shared_mutex> lk(packetchain_mutex, "remove_handler");
+int packet_chain::register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio,
+        const std::string& in_name) {
+    return register_int_handler(in_cb, in_aux, NULL, NULL, in_chain, in_prio, in_name);
+}
 
-    unsigned int x;
+int packet_chain::register_handler(std::function<int (kis_packet *)> in_cb, int in_chain, int in_prio,
+        const std::string& in_name) {
+    return register_int_handler(NULL, NULL, in_cb, NULL, in_chain, in_prio, in_name);
+}
 
-    switch (in_chain) {
-        case CHAINPOS_POSTCAP:
-            for (x = 0; x < postcap_chain.size(); x++) {
-                if (postcap_chain[x]->callback == in_cb) {
-                    postcap_chain.erase(postcap_chain.begin() + x);
-                }
-            }
-            break;
+int packet_chain::register_batch_handler(pc_batch_callback in_cb, int in_chain, int in_prio,
+        const std::string& in_name) {
+    return register_int_handler(NULL, NULL, NULL, in_cb, in_chain, in_prio, in_name);
+}
 
-        case CHAINPOS_LLCDISSECT:
-            for (x = 0; x < llcdissect_chain.size(); x++) {
-                if (llcdissect_chain[x]->callback == in_cb) {
-                    llcdissect_chain.erase(llcdissect_chain.begin() + x);
-                }
-            }
-            break;
+int packet_chain::remove_handler(int in_id, int in_chain) {
+    return remove_int_handler([in_id](const std::shared_ptr<pc_link>& l) {
+                return l->id == in_id;
+            }, in_chain);
+}
 
-        case CHAINPOS_DECRYPT:
-            for (x = 0; x < decrypt_chain.size(); x++) {
-                if (decrypt_chain[x]->callback == in_cb) {
-                    decrypt_chain.erase(decrypt_chain.begin() + x);
-                }
-            }
-            break;
+int packet_chain::remove_handler(pc_callback in_cb, int in_chain) {
+    return remove_int_handler([in_cb](const std::shared_ptr<pc_link>& l) {
+                return l->callback == in_cb;
+            }, in_chain);
+}
 
-        case CHAINPOS_DATADISSECT:
-            for (x = 0; x < datadissect_chain.size(); x++) {
-                if (datadissect_chain[x]->callback == in_cb) {
-                    datadissect_chain.erase(datadissect_chain.begin() + x);
-                }
-            }
-            break;
+int packet_chain::remove_int_handler(std::function<bool (const std::shared_ptr<pc_link>&)> in_match,
+        int in_chain) {
+    if (in_chain < CHAINPOS_POSTCAP || in_chain > CHAINPOS_LOGGING) {
+        _MSG("packet_chain::remove_handler requested unknown chain", 
+                MSGFLAG_ERROR);
+        return -1;
+    }
 
-        case CHAINPOS_CLASSIFIER:
-            for (x = 0; x < classifier_chain.size(); x++) {
-                if (classifier_chain[x]->callback == in_cb) {
-                    classifier_chain.erase(classifier_chain.begin() + x);
-                }
-            }
-            break;
+    kis_lock_guard<kis_mutex> lk(packetchain_mutex, "remove_handler");
 
-        case CHAINPOS_TRACKER:
-            for (x = 0; x < tracker_chain.size(); x++) {
-                if (tracker_chain[x]->callback == in_cb) {
-                    tracker_chain.erase(tracker_chain.begin() + x);
-                }
-            }
-            break;
+    auto snapshot = std::make_shared<pc_chain_snapshot>(*get_chain_snapshot());
+    auto& chain = snapshot->chains[in_chain];
 
-        case CHAINPOS_LOGGING:
-            for (x = 0; x < logging_chain.size(); x++) {
-                if (logging_chain[x]->callback == in_cb) {
-                    logging_chain.erase(logging_chain.begin() + x);
-                }
-            }
-            break;
+    chain.erase(std::remove_if(chain.begin(), chain.end(), in_match), chain.end());
 
-        default:
-            _MSG("packet_chain::remove_handler requested unknown chain", 
-                    MSGFLAG_ERROR);
-            return -1;
-    }
+    publish_chain_snapshot(snapshot);
 
     return 1;
 }
-
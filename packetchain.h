@@ -29,6 +29,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
@@ -45,6 +46,7 @@
 #include "trackedrrd.h"
 
 #include "moodycamel/blockingconcurrentqueue.h"
+#include "moodycamel/concurrentqueue.h"
 
 /* Packets are added to the packet queue from any thread (including the main 
  * thread).
@@ -91,6 +93,31 @@
 
 class kis_packet;
 
+// Low-overhead timing histogram for packet chain handlers and stages; samples are
+// recorded into power-of-two microsecond buckets, bucket 0 holds everything under
+// 1us and the last bucket holds everything over the range.
+class packet_chain_timing {
+public:
+    static constexpr unsigned int num_buckets = 24;
+
+    packet_chain_timing() :
+        count{0},
+        packets{0},
+        total_ns{0},
+        max_ns{0} {
+        for (unsigned int i = 0; i < num_buckets; i++)
+            buckets[i] = 0;
+    }
+
+    void record(uint64_t ns, unsigned int n_packets);
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[num_buckets];
+};
+
 class packet_chain : public lifetime_global {
 public:
     static std::string global_name() { return "PACKETCHAIN"; }
@@ -115,58 +142,144 @@ public:
     int remove_packet_component(int in_id);
     std::string fetch_packet_component_name(int in_id);
 
-    // Generate a packet and hand it back
+    // Generate a packet and hand it back; packets are pulled from the recycling 
+    // pool when possible
     kis_packet *generate_packet();
     // Inject a packet into the chain
     int process_packet(kis_packet *in_pack);
-    // Destroy a packet at the end of its life
+    // Inject a group of packets, such as a batched datasource report, into the chain
+    // with a single queue operation when the queue is not backed up
+    int process_packets(const std::vector<kis_packet *>& in_packs);
+    // Destroy a packet at the end of its life; the packet is reset and returned
+    // to the recycling pool if there is room
     void destroy_packet(kis_packet *in_pack);
  
     // Callback and information 
     typedef int (*pc_callback)(CHAINCALL_PARMS);
+    typedef std::function<int (const std::vector<kis_packet *>&)> pc_batch_callback;
     typedef struct {
         int priority;
 		packet_chain::pc_callback callback;
         std::function<int (kis_packet *)> l_callback;
+        packet_chain::pc_batch_callback b_callback;
         void *auxdata;
 		int id;
+        std::string name;
+        std::shared_ptr<packet_chain_timing> timing;
     } pc_link;
 
-    // Register a callback, aux data, a chain to put it in, and the priority 
-    int register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio);
-    int register_handler(std::function<int (kis_packet *)> in_cb, int in_chain, int in_prio);
+    typedef std::vector<std::shared_ptr<packet_chain::pc_link>> pc_chain_t;
+
+    // Register a callback, aux data, a chain to put it in, and the priority; the optional
+    // name is used to identify the handler in the handler timing stats
+    int register_handler(pc_callback in_cb, void *in_aux, int in_chain, int in_prio,
+            const std::string& in_name = "");
+    int register_handler(std::function<int (kis_packet *)> in_cb, int in_chain, int in_prio,
+            const std::string& in_name = "");
+    // Register a batch callback; batch handlers are called once per chain stage with
+    // every packet in the current batch, in order, and are useful for handlers which
+    // can amortize work (such as database transactions) across multiple packets.  When
+    // batching is disabled, batch handlers are called with a single packet.
+    int register_batch_handler(pc_batch_callback in_cb, int in_chain, int in_prio,
+            const std::string& in_name = "");
     int remove_handler(pc_callback in_cb, int in_chain);
 	int remove_handler(int in_id, int in_chain);
 
     static std::string event_packetstats() { return "PACKETCHAIN_STATS"; }
+    // Key of the handler timing stats in the PACKETCHAIN_STATS event, when enabled
+    static std::string event_handlerstats() { return "PACKETCHAIN_HANDLER_STATS"; }
 
 protected:
-    void packet_queue_processor();
+    void packet_queue_processor(unsigned int worker_id);
+
+    // Run a chain stage across a batch of packets
+    void process_chain_batch(const pc_chain_t& chain, const std::vector<kis_packet *>& batch);
+    void process_chain_batch_timed(int chainpos, const pc_chain_t& chain, 
+            const std::vector<kis_packet *>& batch);
+
+    // Optional per-handler and per-stage timing
+    bool chain_timing;
+    std::map<int, std::shared_ptr<packet_chain_timing>> stage_timing;
+
+    int handler_stats_id, handler_stats_handlers_id, handler_stats_stages_id,
+        handler_stats_entry_id, handler_stats_name_id, handler_stats_chain_id,
+        handler_stats_priority_id, handler_stats_count_id, handler_stats_packets_id,
+        handler_stats_total_id, handler_stats_max_id, handler_stats_mean_id,
+        handler_stats_hist_id;
+
+    static std::string chain_name(int chainpos);
+    std::shared_ptr<tracker_element_map> timing_to_map(const std::string& name, int chainpos,
+            int priority, const std::shared_ptr<packet_chain_timing>& timing);
+    std::shared_ptr<tracker_element_map> generate_handler_stats();
+
+    // Maximum number of packets pulled from the queue and processed per stage at once
+    unsigned int packet_batch_max;
+
+    // Flow-affine dispatch; each worker owns a queue and packets are assigned to a 
+    // worker by hashing the transmitter (or the datasource when no transmitter can be
+    // found) so that all packets from a device are processed in order on the same
+    // thread.  Idle workers may optionally steal from backlogged workers, which trades
+    // strict ordering for throughput under uneven load.
+    struct packet_worker {
+        moodycamel::BlockingConcurrentQueue<kis_packet *> queue;
+        std::atomic<uint64_t> processed;
+        std::atomic<uint64_t> steals;
+
+        std::shared_ptr<tracker_element_map> stats_map;
+        std::shared_ptr<tracker_element_uint64> queue_depth_elem;
+        std::shared_ptr<tracker_element_uint64> processed_elem;
+        std::shared_ptr<tracker_element_uint64> steals_elem;
+    };
+
+    bool flow_dispatch;
+    bool flow_steal;
+    unsigned int flow_steal_threshold;
+    unsigned int packet_thread_count;
+    std::vector<std::unique_ptr<packet_worker>> packet_workers;
+    std::shared_ptr<tracker_element_vector> packet_worker_vec;
+
+    int pack_comp_linkframe, pack_comp_datasrc;
+
+    uint64_t packet_flow_key(kis_packet *in_pack);
+    size_t dequeue_worker_packets(unsigned int worker_id, kis_packet **packets, size_t max);
+    size_t packet_queue_size();
+    void update_worker_stats();
 
     // Common function for both insertion methods
     int register_int_handler(pc_callback in_cb, void *in_aux, 
             std::function<int (kis_packet *)> in_l_cb, 
-            int in_chain, int in_prio);
+            pc_batch_callback in_b_cb,
+            int in_chain, int in_prio, const std::string& in_name);
+    int remove_int_handler(std::function<bool (const std::shared_ptr<pc_link>&)> in_match, 
+            int in_chain);
 
     int next_componentid, next_handlerid;
 
     std::map<std::string, int> component_str_map;
     std::map<int, std::string> component_id_map;
 
-    // Core chain components
-    std::vector<packet_chain::pc_link *> postcap_chain;
-    std::vector<packet_chain::pc_link *> llcdissect_chain;
-    std::vector<packet_chain::pc_link *> decrypt_chain;
-    std::vector<packet_chain::pc_link *> datadissect_chain;
-    std::vector<packet_chain::pc_link *> classifier_chain;
-	std::vector<packet_chain::pc_link *> tracker_chain;
-    std::vector<packet_chain::pc_link *> logging_chain;
+    // Core chain components, indexed by chain position.  The chains are published as
+    // immutable snapshots:  packet threads grab the current snapshot once per batch 
+    // without taking any locks, while registering or removing a handler builds a new
+    // snapshot and swaps it in, so handler changes never stall packet processing.
+    struct pc_chain_snapshot {
+        pc_chain_t chains[CHAINPOS_LOGGING + 1];
+    };
+
+    std::shared_ptr<const pc_chain_snapshot> chain_snapshot;
+
+    std::shared_ptr<const pc_chain_snapshot> get_chain_snapshot() const {
+        return std::atomic_load(&chain_snapshot);
+    }
+
+    // Swap in a new snapshot and wait for packet threads to finish with the old one
+    void publish_chain_snapshot(std::shared_ptr<const pc_chain_snapshot> in_snapshot);
 
     // Packet component mutex
     kis_mutex packetcomp_mutex;
 
-    // Packet chain mutex
-    kis_shared_mutex packetchain_mutex;
+    // Handler modification mutex; only serializes writers of the chain snapshot
+    kis_mutex packetchain_mutex;
 
     // std::thread packet_thread;
     std::list<std::thread> packet_threads;
@@ -174,6 +287,25 @@ protected:
     moodycamel::BlockingConcurrentQueue<kis_packet *> packet_queue;
     bool packetchain_shutdown;
 
+    // Recycled packets.  Packets are generated on the datasource threads and destroyed
+    // on the packet processing threads, so a strictly thread-local free list would
+    // only ever fill on one side and drain on the other; the moodycamel queue keeps
+    // per-producer sub-queues internally which gets us most of the locality anyway.
+    moodycamel::ConcurrentQueue<kis_packet *> packet_pool;
+    unsigned int packet_pool_max;
+    std::atomic<uint64_t> packet_pool_hits, packet_pool_misses, packet_pool_discards;
+
+    std::shared_ptr<tracker_element_uint64> packet_pool_hits_elem;
+    std::shared_ptr<tracker_element_uint64> packet_pool_misses_elem;
+    std::shared_ptr<tracker_element_uint64> packet_pool_discards_elem;
+    std::shared_ptr<tracker_element_uint64> packet_pool_size_elem;
+    std::shared_ptr<tracker_element_uint64> component_pool_hits_elem;
+    std::shared_ptr<tracker_element_uint64> component_pool_misses_elem;
+    std::shared_ptr<tracker_element_uint64> component_pool_discards_elem;
+    std::shared_ptr<tracker_element_map> packet_pool_map;
+
+    void update_pool_stats();
+
     // Warning and discard levels for packet queue being full
     unsigned int packet_queue_warning, packet_queue_drop;
     time_t last_packet_queue_user_warning, last_packet_drop_user_warning;
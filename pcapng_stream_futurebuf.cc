@@ -347,7 +347,7 @@ int pcapng_stream_futurebuf::pcapng_write_packet(kis_packet *in_packet, kis_data
     epb->timestamp_low = conv_ts;
 
     epb->captured_length = in_data->length;
-    epb->original_length = in_data->length;
+    epb->original_length = std::max(in_packet->original_len, in_data->length);
 
     // Copy the data after the epb header
     memcpy(buf.get() + sizeof(pcapng_epb_t), in_data->data, in_data->length);
@@ -527,7 +527,7 @@ void pcapng_stream_packetchain::start_stream() {
         packetchain->register_handler([this](kis_packet *packet) {
             handle_packet(packet);
             return 1;
-        }, CHAINPOS_LOGGING, -100);
+        }, CHAINPOS_LOGGING, -100, "pcapng stream");
 }
 
 void pcapng_stream_packetchain::stop_stream(std::string in_reason) {
@@ -102,10 +102,14 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
                 "IEEE802.11 device");
 
     // Packet classifier - makes basic records plus dot11 data
-    packetchain->register_handler(&packet_dot11_common_classifier, this, CHAINPOS_CLASSIFIER, -100);
-    packetchain->register_handler(&packet_dot11_scan_json_classifier, this, CHAINPOS_CLASSIFIER, -99);
-    packetchain->register_handler(&phydot11_packethook_wep, this, CHAINPOS_DECRYPT, -100);
-    packetchain->register_handler(&phydot11_packethook_dot11, this, CHAINPOS_LLCDISSECT, -100);
+    packetchain->register_handler(&packet_dot11_common_classifier, this, CHAINPOS_CLASSIFIER, -100,
+            "dot11 classifier");
+    packetchain->register_handler(&packet_dot11_scan_json_classifier, this, CHAINPOS_CLASSIFIER, -99,
+            "dot11 scan classifier");
+    packetchain->register_handler(&phydot11_packethook_wep, this, CHAINPOS_DECRYPT, -100,
+            "dot11 wep decrypt");
+    packetchain->register_handler(&phydot11_packethook_dot11, this, CHAINPOS_LLCDISSECT, -100,
+            "dot11 dissector");
 
     // If we haven't registered packet components yet, do so.  We have to
     // co-exist with the old tracker core for some time
@@ -568,14 +572,71 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
 
     ssidtracker = phy_80211_ssid_tracker::create_dot11_ssidtracker();
 
-    // Set up the de-duplication list
-    recent_packet_checksums_sz = 
-        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dedup_size", 2048);
-    recent_packet_checksums = new std::atomic<uint32_t>[recent_packet_checksums_sz];
-    for (unsigned int x = 0; x < recent_packet_checksums_sz; x++) {
-        recent_packet_checksums[x] = 0;
+    // Set up the de-duplication filter
+    dedup_filter = std::unique_ptr<packet_dedup_filter>(new packet_dedup_filter(
+                Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dedup_size", 2048),
+                Globalreg::globalreg->kismet_config->fetch_opt_ulong("packet_dedup_window", 1000) * 1000));
+
+    if (dedup_filter->enabled()) {
+        dedup_handler_id = 
+            packetchain->register_batch_handler([this](const std::vector<kis_packet *>& packets) -> int {
+                    return packet_dot11_dedup(packets);
+                }, CHAINPOS_LLCDISSECT, -101, "dot11 dedup");
+    } else {
+        dedup_handler_id = -1;
     }
-    recent_packet_checksum_pos = 0;
+
+    dedup_lookups =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.lookups",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets checked for duplicates");
+    dedup_hits =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "duplicate packets found");
+    dedup_hit_rate =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_double>("dot11.dedup.hit_rate",
+                tracker_element_factory<tracker_element_double>(),
+                "fraction of checked packets which were duplicates");
+    dedup_occupancy =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.occupancy",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packet hashes currently in the dedup window");
+    dedup_capacity =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.capacity",
+                tracker_element_factory<tracker_element_uint64>(),
+                "maximum number of packet hashes in the dedup window");
+
+    dedup_stats_map = std::make_shared<tracker_element_map>();
+    dedup_stats_map->insert(dedup_lookups);
+    dedup_stats_map->insert(dedup_hits);
+    dedup_stats_map->insert(dedup_hit_rate);
+    dedup_stats_map->insert(dedup_occupancy);
+    dedup_stats_map->insert(dedup_capacity);
+
+    // Set up the IE cache
+    ie_cache_max = 
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("dot11_ie_cache_size", 4096);
+    ie_cache_hits = 0;
+    ie_cache_misses = 0;
+
+    ie_cache_hits_elem =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.iecache.hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "management frames which reused cached IE results");
+    ie_cache_misses_elem =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.iecache.misses",
+                tracker_element_factory<tracker_element_uint64>(),
+                "management frames which needed a full IE dissection");
+    ie_cache_size_elem =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.iecache.size",
+                tracker_element_factory<tracker_element_uint64>(),
+                "transmitters with cached IE results");
+
+    ie_cache_stats_map = std::make_shared<tracker_element_map>();
+    ie_cache_stats_map->insert(ie_cache_hits_elem);
+    ie_cache_stats_map->insert(ie_cache_misses_elem);
+    ie_cache_stats_map->insert(ie_cache_size_elem);
 
     // Parse the ssid regex options
     auto apspoof_lines = Globalreg::globalreg->kismet_config->fetch_opt_vec("apspoof");
@@ -749,6 +810,35 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
+    httpd->register_route("/phy/phy80211/dedup", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    auto lookups = dedup_filter->get_lookups();
+                    auto hits = dedup_filter->get_hits();
+
+                    dedup_lookups->set(lookups);
+                    dedup_hits->set(hits);
+                    dedup_hit_rate->set(lookups == 0 ? 0 : (double) hits / lookups);
+                    dedup_occupancy->set(dedup_filter->get_occupancy());
+                    dedup_capacity->set(dedup_filter->get_capacity());
+
+                    return dedup_stats_map;
+                }));
+
+    httpd->register_route("/phy/phy80211/iecache", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    ie_cache_hits_elem->set(ie_cache_hits);
+                    ie_cache_misses_elem->set(ie_cache_misses);
+
+                    {
+                        kis_lock_guard<kis_mutex> lk(ie_cache_mutex, "dot11 iecache stats");
+                        ie_cache_size_elem->set(ie_cache.size());
+                    }
+
+                    return ie_cache_stats_map;
+                }));
+
     httpd->register_route("/phy/phy80211/clients-of/:key/clients", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
@@ -901,7 +991,9 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
                             nullptr,
                             1024*512);
         
-                    con->clear_timeout();
+                    if (!con->start_stream())
+                        return;
+
                     con->set_target_file(fmt::format("kismet-80211-bssid-{}.pcapng", mac));
                     con->set_closure_cb([pcapng]() { pcapng->stop_stream("http connection lost"); });
 
@@ -921,11 +1013,12 @@ kis_80211_phy::kis_80211_phy(int in_phyid) :
 kis_80211_phy::~kis_80211_phy() {
 	packetchain->remove_handler(&phydot11_packethook_wep, CHAINPOS_DECRYPT);
 	packetchain->remove_handler(&phydot11_packethook_dot11, CHAINPOS_LLCDISSECT);
+
+    if (dedup_handler_id >= 0)
+        packetchain->remove_handler(dedup_handler_id, CHAINPOS_LLCDISSECT);
 	packetchain->remove_handler(&packet_dot11_common_classifier, CHAINPOS_CLASSIFIER);
 
     timetracker->remove_timer(device_idle_timer);
-
-    delete[] recent_packet_checksums;
 }
 
 const std::string kis_80211_phy::khz_to_channel(const double in_khz) {
@@ -37,6 +37,7 @@
 #include "boost_like_hash.h"
 #include "globalregistry.h"
 #include "packetchain.h"
+#include "packet_dedup.h"
 #include "timetracker.h"
 #include "packet.h"
 #include "gpstracker.h"
@@ -284,6 +285,60 @@ class dot11_packinfo : public packet_component {
         bool new_adv_ssid;
 };
 
+// IE-derived results of a dissected management frame; the IE cache keeps one
+// per transmitter and subtype so that a frame with an unchanged IE block can
+// skip the tag parsers entirely
+class dot11_ie_cache_entry {
+public:
+    uint64_t ie_hash;
+    ieee_80211_subtype subtype;
+
+    // Bits the IE parsers added to the packet and common crypt sets
+    uint64_t cryptset;
+    uint64_t basic_crypt_set;
+
+    std::string ssid;
+    int ssid_len;
+    int ssid_blank;
+    uint32_t ssid_csum;
+
+    std::string channel;
+    std::string beacon_info;
+
+    std::multimap<std::tuple<uint8_t, uint32_t, uint8_t>, size_t> ietag_hash_map;
+
+    std::string dot11d_country;
+    std::vector<dot11_packinfo_dot11d_entry> dot11d_vec;
+
+    uint8_t wps_version;
+    uint8_t wps;
+    uint16_t wps_config_methods;
+    std::string wps_manuf;
+    std::string wps_device_name;
+    std::string wps_model_name;
+    std::string wps_model_number;
+    std::string wps_serial_number;
+    std::string wps_uuid_e;
+
+    std::shared_ptr<dot11_ie_11_qbss> qbss;
+    std::shared_ptr<dot11_ie_33_power> tx_power;
+    std::shared_ptr<dot11_ie_36_supported_channels> supported_channels;
+    std::shared_ptr<dot11_ie_54_mobility> dot11r_mobility;
+    std::shared_ptr<dot11_ie_61_ht_op> dot11ht;
+    std::shared_ptr<dot11_ie_192_vht_op> dot11vht;
+    std::shared_ptr<dot11_ie_221_owe_transition> owe_transition;
+    std::shared_ptr<dot11_ie_48_rsn> rsn;
+    std::shared_ptr<dot11_ie_221_dji_droneid> droneid;
+
+    double maxrate;
+    std::vector<std::string> basic_rates;
+    std::vector<std::string> extended_rates;
+    std::vector<std::string> mcs_rates;
+
+    unsigned int ccx_txpower;
+    bool cisco_client_mfp;
+};
+
 class dot11_ssid_alert {
     public:
         dot11_ssid_alert() {
@@ -328,6 +383,9 @@ public:
 
     // Dot11 decoders, wep decryptors, etc
     int packet_wep_decryptor(kis_packet *in_pack);
+    // Drop packets seen recently; runs over a whole packet chain batch ahead of the
+    // dissector so the dedup filter is locked once per shard per batch
+    int packet_dot11_dedup(const std::vector<kis_packet *>& in_packs);
     // Top-level dissector; decodes basic type and populates the dot11 packet
     int packet_dot11_dissector(kis_packet *in_pack);
     // Expects an existing dot11 packet with the basic type intact, interprets
@@ -389,9 +447,15 @@ public:
     const std::string dot11_wpa_handshake_event_dot11 = "DOT11_WPA_HANDSHAKE_DOT11";
 
     static size_t ssid_hash(const std::string& ssid, unsigned int ssid_len) {
+        return ssid_hash(ssid.data(), ssid.length(), ssid_len);
+    }
+
+    // Hash an SSID directly from a buffer, such as the IE tag in the packet; matches
+    // the string form for the same bytes
+    static size_t ssid_hash(const char *ssid, size_t ssid_sz, unsigned int ssid_len) {
         auto hash = xx_hash_cpp{};
 
-        boost_like::hash_combine(hash, ssid);
+        hash.update(ssid, ssid_sz);
         boost_like::hash_combine(hash, ssid_len);
 
         return hash.hash();
@@ -406,10 +470,33 @@ protected:
     std::shared_ptr<entry_tracker> entrytracker;
     std::shared_ptr<stream_tracker> streamtracker;
 
-    // Checksum of recent packets for duplication filtering
-    std::atomic<uint32_t> *recent_packet_checksums;
-    size_t recent_packet_checksums_sz;
-    std::atomic<unsigned int> recent_packet_checksum_pos;
+    // Hashes of recent packets for duplication filtering
+    std::unique_ptr<packet_dedup_filter> dedup_filter;
+    int dedup_handler_id;
+
+    std::shared_ptr<tracker_element_map> dedup_stats_map;
+    std::shared_ptr<tracker_element_uint64> dedup_lookups;
+    std::shared_ptr<tracker_element_uint64> dedup_hits;
+    std::shared_ptr<tracker_element_double> dedup_hit_rate;
+    std::shared_ptr<tracker_element_uint64> dedup_occupancy;
+    std::shared_ptr<tracker_element_uint64> dedup_capacity;
+
+    // Parsed IE results of recent management frames, keyed by transmitter and subtype
+    kis_mutex ie_cache_mutex;
+    robin_hood::unordered_flat_map<uint64_t, std::shared_ptr<const dot11_ie_cache_entry>> ie_cache;
+    size_t ie_cache_max;
+    std::atomic<uint64_t> ie_cache_hits;
+    std::atomic<uint64_t> ie_cache_misses;
+
+    std::shared_ptr<tracker_element_map> ie_cache_stats_map;
+    std::shared_ptr<tracker_element_uint64> ie_cache_hits_elem;
+    std::shared_ptr<tracker_element_uint64> ie_cache_misses_elem;
+    std::shared_ptr<tracker_element_uint64> ie_cache_size_elem;
+
+    bool ie_cache_apply(uint64_t key, uint64_t ie_hash, const dot11_ie_view& ie_view,
+            dot11_packinfo *packinfo, kis_common_info *common);
+    void ie_cache_store(uint64_t key, uint64_t ie_hash, uint64_t pre_cryptset,
+            uint64_t pre_basic_crypt_set, dot11_packinfo *packinfo, kis_common_info *common);
 
     // Handle advertised SSIDs
     void handle_ssid(std::shared_ptr<kis_tracked_device_base> basedev, 
@@ -470,7 +470,7 @@ public:
         return std::move(dup);
     }
 
-    __Proxy(ssid, std::string, std::string, std::string, ssid);
+    __ProxyInterned(ssid, ssid);
     __Proxy(ssid_len, uint32_t, unsigned int, unsigned int, ssid_len);
     __Proxy(bssid, mac_addr, mac_addr, mac_addr, bssid);
     __Proxy(first_time, uint64_t, time_t, time_t, first_time);
@@ -651,7 +651,7 @@ public:
         return std::move(dup);
     }
 
-    __Proxy(ssid, std::string, std::string, std::string, ssid);
+    __ProxyInterned(ssid, ssid);
     __Proxy(ssid_len, uint32_t, unsigned int, unsigned int, ssid_len);
 
     __Proxy(ssid_hash, uint64_t, uint64_t, uint64_t, ssid_hash);
@@ -1106,7 +1106,7 @@ public:
         bss_invalid_count = 0;
         snapshot_next_beacon = false;
 
-        __ImportField(type_set, p);
+        __ImportInline(type_set, p);
 
         __ImportId(client_map_id, p);
         __ImportId(client_map_entry_id, p);
@@ -1127,24 +1127,24 @@ public:
         __ImportId(associated_client_map_id, p);
         __ImportId(associated_client_map_entry_id, p);
         __ImportField(num_associated_clients, p);
-        __ImportField(client_disconnects, p);
-        __ImportField(client_disconnects_last, p);
+        __ImportInline(client_disconnects, p);
+        __ImportInline(client_disconnects_last, p);
 
-        __ImportField(last_sequence, p);
-        __ImportField(bss_timestamp, p);
+        __ImportInline(last_sequence, p);
+        __ImportInline(bss_timestamp, p);
 
-        __ImportField(num_fragments, p);
-        __ImportField(num_retries, p);
+        __ImportInline(num_fragments, p);
+        __ImportInline(num_retries, p);
 
-        __ImportField(datasize, p);
-        __ImportField(datasize_retry, p);
+        __ImportInline(datasize, p);
+        __ImportInline(datasize_retry, p);
 
         __ImportId(last_bssid_id, p);
 
-        __ImportField(last_beacon_timestamp, p);
+        __ImportInline(last_beacon_timestamp, p);
 
-        __ImportField(wps_m3_count, p);
-        __ImportField(wps_m3_last, p);
+        __ImportInline(wps_m3_count, p);
+        __ImportInline(wps_m3_last, p);
 
         __ImportId(wpa_key_vec_id, p);
         __ImportId(wpa_key_entry_id, p);
@@ -1152,24 +1152,24 @@ public:
         __ImportId(wpa_nonce_entry_id, p);
         __ImportId(wpa_anonce_vec_id, p);
 
-        __ImportField(wpa_present_handshake, p);
+        __ImportInline(wpa_present_handshake, p);
 
         __ImportId(ssid_beacon_packet_id, p);
         __ImportId(pmkid_packet_id, p);
 
-        __ImportField(min_tx_power, p);
-        __ImportField(max_tx_power, p);
+        __ImportInline(min_tx_power, p);
+        __ImportInline(max_tx_power, p);
 
         __ImportId(supported_channels_id, p);
 
-        __ImportField(link_measurement_capable, p);
-        __ImportField(neighbor_report_capable, p);
+        __ImportInline(link_measurement_capable, p);
+        __ImportInline(neighbor_report_capable, p);
 
         __ImportId(extended_capabilities_list_id, p);
 
-        __ImportField(beacon_fingerprint, p);
-        __ImportField(probe_fingerprint, p);
-        __ImportField(response_fingerprint, p);
+        __ImportInline(beacon_fingerprint, p);
+        __ImportInline(probe_fingerprint, p);
+        __ImportInline(response_fingerprint, p);
 
         __ImportId(last_beaconed_ssid_record_id, p);
         __ImportId(last_probed_ssid_record_id, p);
@@ -1187,6 +1187,8 @@ public:
         return std::move(dup);
     }
 
+    __InlineLayout
+
     static void attach_base_parent(std::shared_ptr<dot11_tracked_device> self, 
             std::shared_ptr<kis_tracked_device_base> parent) {
         parent->insert(self);
@@ -1560,7 +1562,7 @@ protected:
     // record to eapol or pmkid?
     std::atomic<bool> snapshot_next_beacon;
 
-    std::shared_ptr<tracker_element_uint64> type_set;
+    tracker_inline<tracker_element_uint64> type_set;
 
     std::shared_ptr<tracker_element_mac_map> client_map;
     int client_map_id;
@@ -1586,25 +1588,25 @@ protected:
     int associated_client_map_id;
     int associated_client_map_entry_id;
     std::shared_ptr<tracker_element_uint64> num_associated_clients;
-    std::shared_ptr<tracker_element_uint64> client_disconnects;
-    std::shared_ptr<tracker_element_uint64> client_disconnects_last;
+    tracker_inline<tracker_element_uint64> client_disconnects;
+    tracker_inline<tracker_element_uint64> client_disconnects_last;
 
-    std::shared_ptr<tracker_element_uint64> last_sequence;
-    std::shared_ptr<tracker_element_uint64> bss_timestamp;
+    tracker_inline<tracker_element_uint64> last_sequence;
+    tracker_inline<tracker_element_uint64> bss_timestamp;
 
-    std::shared_ptr<tracker_element_uint64> num_fragments;
-    std::shared_ptr<tracker_element_uint64> num_retries;
+    tracker_inline<tracker_element_uint64> num_fragments;
+    tracker_inline<tracker_element_uint64> num_retries;
 
-    std::shared_ptr<tracker_element_uint64> datasize;
-    std::shared_ptr<tracker_element_uint64> datasize_retry;
+    tracker_inline<tracker_element_uint64> datasize;
+    tracker_inline<tracker_element_uint64> datasize_retry;
 
     std::shared_ptr<tracker_element_mac_addr> last_bssid;
     int last_bssid_id;
 
-    std::shared_ptr<tracker_element_uint64> last_beacon_timestamp;
+    tracker_inline<tracker_element_uint64> last_beacon_timestamp;
 
-    std::shared_ptr<tracker_element_uint64> wps_m3_count;
-    std::shared_ptr<tracker_element_uint64> wps_m3_last;
+    tracker_inline<tracker_element_uint64> wps_m3_count;
+    tracker_inline<tracker_element_uint64> wps_m3_last;
 
     std::shared_ptr<tracker_element_vector> wpa_key_vec;
     int wpa_key_vec_id;
@@ -1616,7 +1618,7 @@ protected:
     std::shared_ptr<tracker_element_vector> wpa_anonce_vec;
     int wpa_anonce_vec_id;
 
-    std::shared_ptr<tracker_element_uint8> wpa_present_handshake;
+    tracker_inline<tracker_element_uint8> wpa_present_handshake;
     int wpa_nonce_entry_id;
 
     std::shared_ptr<kis_tracked_packet> ssid_beacon_packet;
@@ -1630,21 +1632,21 @@ protected:
     std::shared_ptr<dot11_advertised_ssid> last_adv_ssid;
 
     // Advertised in association requests but device-centric
-    std::shared_ptr<tracker_element_uint8> min_tx_power;
-    std::shared_ptr<tracker_element_uint8> max_tx_power;
+    tracker_inline<tracker_element_uint8> min_tx_power;
+    tracker_inline<tracker_element_uint8> max_tx_power;
 
     std::shared_ptr<tracker_element_vector_double> supported_channels;
     int supported_channels_id;
 
-    std::shared_ptr<tracker_element_uint8> link_measurement_capable;
-    std::shared_ptr<tracker_element_uint8> neighbor_report_capable;
+    tracker_inline<tracker_element_uint8> link_measurement_capable;
+    tracker_inline<tracker_element_uint8> neighbor_report_capable;
 
     std::shared_ptr<tracker_element_vector_string> extended_capabilities_list;
     int extended_capabilities_list_id;
 
-    std::shared_ptr<tracker_element_uint32> beacon_fingerprint;
-    std::shared_ptr<tracker_element_uint32> probe_fingerprint;
-    std::shared_ptr<tracker_element_uint32> response_fingerprint;
+    tracker_inline<tracker_element_uint32> beacon_fingerprint;
+    tracker_inline<tracker_element_uint32> probe_fingerprint;
+    tracker_inline<tracker_element_uint32> response_fingerprint;
 
     int last_beaconed_ssid_record_id;
     std::shared_ptr<tracker_element_alias> last_beaconed_ssid_record;
@@ -34,6 +34,7 @@
 
 #include "endian_magic.h"
 #include "phy_80211.h"
+#include "xxhash.h"
 #include "phy_80211_packetsignatures.h"
 #include "packetchain.h"
 #include "alertracker.h"
@@ -280,6 +281,49 @@ int kis_80211_phy::wpa_key_mgt_conv(uint8_t mgt_index) {
     return ret;
 }
 
+int kis_80211_phy::packet_dot11_dedup(const std::vector<kis_packet *>& in_packs) {
+    thread_local std::vector<kis_packet *> packs;
+    thread_local std::vector<uint64_t> hashes;
+    thread_local std::vector<bool> dupes;
+
+    packs.clear();
+    hashes.clear();
+
+    // Hash every frame the dissector would look at
+    for (const auto& p : in_packs) {
+        if (p->error)
+            continue;
+
+        kis_datachunk *chunk = (kis_datachunk *) p->fetch(pack_comp_decap);
+
+        if (chunk == NULL)
+            chunk = (kis_datachunk *) p->fetch(pack_comp_linkframe);
+
+        if (chunk == NULL || chunk->dlt != KDLT_IEEE802_11 || chunk->length < 10)
+            continue;
+
+        packs.push_back(p);
+        hashes.push_back(packet_dedup_filter::hash(chunk->data, chunk->length));
+    }
+
+    if (packs.size() == 0)
+        return 0;
+
+    auto now_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    dedup_filter->check(hashes, dupes, now_usec);
+
+    for (size_t i = 0; i < packs.size(); i++) {
+        if (dupes[i]) {
+            packs[i]->filtered = 1;
+            packs[i]->duplicate = 1;
+        }
+    }
+
+    return 1;
+}
+
 // This needs to be optimized and it needs to not use casting to do its magic
 int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
     if (in_pack->error) {
@@ -310,23 +354,9 @@ int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
         return 0;
     }
 
-    // Compare the checksum and see if we've recently seen this exact packet
-    uint32_t chunk_csum = adler32_checksum((const char *) chunk->data, chunk->length);
-
-    for (unsigned int c = 0; c < recent_packet_checksums_sz; c++) {
-        if (recent_packet_checksums[c] == 0)
-            break;
-
-        if (recent_packet_checksums[c] == chunk_csum) {
-            in_pack->filtered = 1;
-            in_pack->duplicate = 1;
-            return 0;
-        }
-    }
-
-    if (recent_packet_checksums_sz > 0) 
-        recent_packet_checksums[(recent_packet_checksum_pos++ % recent_packet_checksums_sz)] = 
-            chunk_csum;
+    // Recently seen packets are flagged by the dedup handler
+    if (in_pack->duplicate)
+        return 0;
 
     kis_layer1_packinfo *pack_l1info =
         (kis_layer1_packinfo *) in_pack->fetch(pack_comp_l1info);
@@ -1270,6 +1300,158 @@ std::vector<kis_80211_phy::ie_tag_tuple> kis_80211_phy::PacketDot11IElist(kis_pa
     return ret;
 }
 
+// Hash of an IE block for the IE cache.  The TIM changes with nearly every beacon
+// and isn't dissected, so it's left out and its tag hash is refreshed on a hit
+static uint64_t dot11_ie_cache_hash(const dot11_ie_view& ie_view) {
+    uint64_t hash = 0;
+
+    for (const auto& ie_tag : ie_view) {
+        if (ie_tag.tag_num() == 5)
+            continue;
+
+        hash = XXH64(ie_tag.tag_bytes(), ie_tag.tag_len(), 
+                hash ^ ((ie_tag.tag_num() << 8) | ie_tag.tag_len()));
+    }
+
+    return hash;
+}
+
+bool kis_80211_phy::ie_cache_apply(uint64_t key, uint64_t ie_hash, const dot11_ie_view& ie_view,
+        dot11_packinfo *packinfo, kis_common_info *common) {
+    std::shared_ptr<const dot11_ie_cache_entry> entry;
+
+    {
+        kis_lock_guard<kis_mutex> lk(ie_cache_mutex, "dot11 iecache lookup");
+
+        auto ei = ie_cache.find(key);
+        if (ei != ie_cache.end())
+            entry = ei->second;
+    }
+
+    if (entry == nullptr || entry->ie_hash != ie_hash || entry->subtype != packinfo->subtype) {
+        ie_cache_misses++;
+        return false;
+    }
+
+    ie_cache_hits++;
+
+    packinfo->cryptset |= entry->cryptset;
+    if (common != nullptr)
+        common->basic_crypt_set |= entry->basic_crypt_set;
+
+    packinfo->ssid = entry->ssid;
+    packinfo->ssid_len = entry->ssid_len;
+    packinfo->ssid_blank = entry->ssid_blank;
+    packinfo->ssid_csum = entry->ssid_csum;
+
+    packinfo->channel = entry->channel;
+    packinfo->beacon_info = entry->beacon_info;
+
+    packinfo->ietag_hash_map = entry->ietag_hash_map;
+
+    // The TIM isn't part of the cache hash, so hash the current one
+    packinfo->ietag_hash_map.erase(ie_tag_tuple{5, 0, 0});
+    for (const auto& ie_tag : ie_view) {
+        if (ie_tag.tag_num() == 5)
+            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{5, 0, 0}, 
+                        (size_t) XXH64(ie_tag.tag_bytes(), ie_tag.tag_len(), 0)));
+    }
+
+    packinfo->dot11d_country = entry->dot11d_country;
+    packinfo->dot11d_vec = entry->dot11d_vec;
+
+    packinfo->wps_version = entry->wps_version;
+    packinfo->wps = entry->wps;
+    packinfo->wps_config_methods = entry->wps_config_methods;
+    packinfo->wps_manuf = entry->wps_manuf;
+    packinfo->wps_device_name = entry->wps_device_name;
+    packinfo->wps_model_name = entry->wps_model_name;
+    packinfo->wps_model_number = entry->wps_model_number;
+    packinfo->wps_serial_number = entry->wps_serial_number;
+    packinfo->wps_uuid_e = entry->wps_uuid_e;
+
+    packinfo->qbss = entry->qbss;
+    packinfo->tx_power = entry->tx_power;
+    packinfo->supported_channels = entry->supported_channels;
+    packinfo->dot11r_mobility = entry->dot11r_mobility;
+    packinfo->dot11ht = entry->dot11ht;
+    packinfo->dot11vht = entry->dot11vht;
+    packinfo->owe_transition = entry->owe_transition;
+    packinfo->rsn = entry->rsn;
+    packinfo->droneid = entry->droneid;
+
+    packinfo->maxrate = entry->maxrate;
+    packinfo->basic_rates = entry->basic_rates;
+    packinfo->extended_rates = entry->extended_rates;
+    packinfo->mcs_rates = entry->mcs_rates;
+
+    packinfo->ccx_txpower = entry->ccx_txpower;
+    packinfo->cisco_client_mfp = entry->cisco_client_mfp;
+
+    return true;
+}
+
+void kis_80211_phy::ie_cache_store(uint64_t key, uint64_t ie_hash, uint64_t pre_cryptset,
+        uint64_t pre_basic_crypt_set, dot11_packinfo *packinfo, kis_common_info *common) {
+    auto entry = std::make_shared<dot11_ie_cache_entry>();
+
+    entry->ie_hash = ie_hash;
+    entry->subtype = packinfo->subtype;
+
+    entry->cryptset = packinfo->cryptset & ~pre_cryptset;
+    entry->basic_crypt_set = common != nullptr ? (common->basic_crypt_set & ~pre_basic_crypt_set) : 0;
+
+    entry->ssid = packinfo->ssid;
+    entry->ssid_len = packinfo->ssid_len;
+    entry->ssid_blank = packinfo->ssid_blank;
+    entry->ssid_csum = packinfo->ssid_csum;
+
+    entry->channel = packinfo->channel;
+    entry->beacon_info = packinfo->beacon_info;
+
+    entry->ietag_hash_map = packinfo->ietag_hash_map;
+
+    entry->dot11d_country = packinfo->dot11d_country;
+    entry->dot11d_vec = packinfo->dot11d_vec;
+
+    entry->wps_version = packinfo->wps_version;
+    entry->wps = packinfo->wps;
+    entry->wps_config_methods = packinfo->wps_config_methods;
+    entry->wps_manuf = packinfo->wps_manuf;
+    entry->wps_device_name = packinfo->wps_device_name;
+    entry->wps_model_name = packinfo->wps_model_name;
+    entry->wps_model_number = packinfo->wps_model_number;
+    entry->wps_serial_number = packinfo->wps_serial_number;
+    entry->wps_uuid_e = packinfo->wps_uuid_e;
+
+    entry->qbss = packinfo->qbss;
+    entry->tx_power = packinfo->tx_power;
+    entry->supported_channels = packinfo->supported_channels;
+    entry->dot11r_mobility = packinfo->dot11r_mobility;
+    entry->dot11ht = packinfo->dot11ht;
+    entry->dot11vht = packinfo->dot11vht;
+    entry->owe_transition = packinfo->owe_transition;
+    entry->rsn = packinfo->rsn;
+    entry->droneid = packinfo->droneid;
+
+    entry->maxrate = packinfo->maxrate;
+    entry->basic_rates = packinfo->basic_rates;
+    entry->extended_rates = packinfo->extended_rates;
+    entry->mcs_rates = packinfo->mcs_rates;
+
+    entry->ccx_txpower = packinfo->ccx_txpower;
+    entry->cisco_client_mfp = packinfo->cisco_client_mfp;
+
+    kis_lock_guard<kis_mutex> lk(ie_cache_mutex, "dot11 iecache store");
+
+    // Evict an arbitrary transmitter when full; the table is hashed, so this is
+    // effectively random replacement
+    if (ie_cache.size() >= ie_cache_max && ie_cache.find(key) == ie_cache.end())
+        ie_cache.erase(ie_cache.begin());
+
+    ie_cache[key] = entry;
+}
+
 int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo *packinfo) {
     // If we can't have IE tags at all
     if (packinfo->type != packet_management || !(
@@ -1295,26 +1477,45 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
     if (chunk->dlt != KDLT_IEEE802_11)
         return 0;
 
-    if (packinfo->ie_tags == nullptr) {
-        membuf tags_membuf((char *) &(chunk->data[packinfo->header_offset]), 
-                (char *) &(chunk->data[chunk->length]));
-        std::istream istream_ietags(&tags_membuf);
+    if (packinfo->header_offset > chunk->length) {
+        packinfo->corrupt = 1;
+        return -1;
+    }
 
-        packinfo->ie_tags = std::make_shared<dot11_ie>();
+    // Walk the tags in place in the packet; the full dot11_ie tag list is only
+    // built by PacketDot11IElist when something needs to keep the tags
+    dot11_ie_view ie_view(&(chunk->data[packinfo->header_offset]), 
+            chunk->length - packinfo->header_offset);
 
-        try {
-            std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
-            packinfo->ie_tags->parse(stream_ietags);
-        } catch (const std::exception& e) {
-            // fmt::print(stderr, "debug - IE tag structure corrupt\n");
-            packinfo->corrupt = 1;
-            return -1;
-        }
+    if (!ie_view.valid()) {
+        // fmt::print(stderr, "debug - IE tag structure corrupt\n");
+        packinfo->corrupt = 1;
+        return -1;
     }
 
     kis_common_info *common = 
         (kis_common_info *) in_pack->fetch(pack_comp_common);
 
+    // An unchanged IE block from the same transmitter reuses the previous results
+    // and skips the tag parsers entirely
+    uint64_t ie_cache_key = 0;
+    uint64_t ie_hash = 0;
+    uint64_t pre_ie_cryptset = packinfo->cryptset;
+    uint64_t pre_ie_basic_crypt_set = common != nullptr ? common->basic_crypt_set : 0;
+
+    // Frames which raise an IE alert are never cached, so a repeated attack frame
+    // goes through the parsers (and the alert checks) every time
+    bool ie_alerted = false;
+
+    if (ie_cache_max > 0) {
+        ie_cache_key = std::hash<mac_addr>{}(packinfo->source_mac) ^ 
+            ((uint64_t) packinfo->subtype << 56);
+        ie_hash = dot11_ie_cache_hash(ie_view);
+
+        if (ie_cache_apply(ie_cache_key, ie_hash, ie_view, packinfo, common))
+            return 1;
+    }
+
     // Track if we've seen some of these tags already
     // bool seen_ssid = false;
     // bool seen_basicrates = false;
@@ -1322,35 +1523,31 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
     // bool seen_mcsrates = false;
     unsigned int wmmtspec_responses = 0;
 
-    for (auto ie_tag : *(packinfo->ie_tags->tags())) {
-        auto hash = std::hash<std::string>{};
-
-        if (ie_tag->tag_num() == 150) {
-            try {
-                auto vendor = std::make_shared<dot11_ie_150_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
+    for (const auto& ie_tag : ie_view) {
+        auto tag_hash = (size_t) XXH64(ie_tag.tag_bytes(), ie_tag.tag_len(), 0);
 
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{150, vendor->vendor_oui_int(), vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
-            } catch (const std::exception& e) {
+        if (ie_tag.tag_num() == 150 || ie_tag.tag_num() == 221) {
+            // Vendor tags are keyed by OUI and subtype; a vendor tag too short to
+            // hold an OUI is corrupt
+            if (ie_tag.tag_len() < 3) {
                 packinfo->corrupt = 1;
                 return -1;
             }
-        } else if (ie_tag->tag_num() == 221) {
-            try {
-                auto vendor = std::make_shared<dot11_ie_221_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
 
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{221, vendor->vendor_oui_int(), vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
-            } catch (const std::exception& e) {
-                packinfo->corrupt = 1;
-                return -1;
-            }
+            auto vendor_bytes = ie_tag.tag_bytes();
+            uint32_t vendor_oui = 
+                ((vendor_bytes[0] & 0xFF) << 16) +
+                ((vendor_bytes[1] & 0xFF) << 8) +
+                (vendor_bytes[2] & 0xFF);
+            uint8_t vendor_type = ie_tag.tag_len() > 3 ? vendor_bytes[3] : 0;
+
+            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag.tag_num(), vendor_oui, vendor_type}, tag_hash));
         } else {
-            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag->tag_num(), 0, 0}, hash(ie_tag->tag_data())));
+            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag.tag_num(), 0, 0}, tag_hash));
         }
 
         // IE 0 SSID
-        if (ie_tag->tag_num() == 0) {
+        if (ie_tag.tag_num() == 0) {
             /*
             if (seen_ssid) {
                 fprintf(stderr, "debug - multiple SSID ie tags?\n");
@@ -1359,9 +1556,11 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             seen_ssid = true;
             */
 
-            packinfo->ssid_len = ie_tag->tag_data().length();
-            packinfo->ssid_csum = kis_80211_phy::ssid_hash(ie_tag->tag_data().data(), 
-                    ie_tag->tag_data().length());
+            packinfo->ssid_len = ie_tag.tag_len();
+            // SSIDs hash up to the first null, same as the string-built hashes
+            // used elsewhere, but straight from the tag without a string copy
+            packinfo->ssid_csum = kis_80211_phy::ssid_hash(ie_tag.tag_data().data(), 
+                    strnlen(ie_tag.tag_data().data(), ie_tag.tag_len()), ie_tag.tag_len());
 
             if (packinfo->ssid_len == 0) {
                 packinfo->ssid_blank = true;
@@ -1369,10 +1568,11 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             }
 
             if (packinfo->ssid_len <= DOT11_PROTO_SSID_LEN) {
-                if (ie_tag->tag_data().find_first_not_of('\0') == std::string::npos) {
+                if (ie_tag.tag_data().find_first_not_of('\0') == nonstd::string_view::npos) {
                     packinfo->ssid_blank = true;
                 } else {
-                    packinfo->ssid = munge_to_printable(ie_tag->tag_data().data());
+                    packinfo->ssid = munge_to_printable(ie_tag.tag_data().data(), 
+                            ie_tag.tag_len(), 1);
                 }
             } else { 
                 _ALERT(alert_longssid_ref, in_pack, packinfo,
@@ -1389,8 +1589,8 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
         // IE 1 Basic Rates
         // IE 50 Extended Rates
-        if (ie_tag->tag_num() == 1 || ie_tag->tag_num() == 50) {
-            if (ie_tag->tag_num() == 1) {
+        if (ie_tag.tag_num() == 1 || ie_tag.tag_num() == 50) {
+            if (ie_tag.tag_num() == 1) {
                 /*
                 if (seen_basicrates) {
                     fprintf(stderr, "debug - seen multiple basicrates?\n");
@@ -1401,7 +1601,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
             }
 
-            if (ie_tag->tag_num() == 50) {
+            if (ie_tag.tag_num() == 50) {
                 /*
                 if (seen_extendedrates) {
                     fprintf(stderr, "debug - seen multiple extendedrates?\n");
@@ -1411,7 +1611,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                 */
             }
 
-            if (ie_tag->tag_data().find("\x75\xEB\x49") != std::string::npos) {
+            if (ie_tag.tag_data().find("\x75\xEB\x49") != nonstd::string_view::npos) {
                 _ALERT(alert_msfdlinkrate_ref, in_pack, packinfo,
                         "MSF-style poisoned rate field in beacon for network " +
                         packinfo->bssid_mac.mac_to_string() + ", exploit attempt "
@@ -1422,7 +1622,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             }
 
             std::vector<std::string> basicrates;
-            for (uint8_t r : ie_tag->tag_data()) {
+            for (uint8_t r : ie_tag.tag_data()) {
                 std::string rate;
 
                 switch (r) {
@@ -1568,14 +1768,14 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 3 channel
-        if (ie_tag->tag_num() == 3) {
-            if (ie_tag->tag_len() > 1) {
+        if (ie_tag.tag_num() == 3) {
+            if (ie_tag.tag_len() > 1) {
                 std::string al = fmt::format("IEEE80211 packet from {0} to {1} BSSID {2} included an IE "
                         "tag {3} entry with an invalid length; IE {3} should be {4} bytes, but was {5}. "
                         "This may be indicative of an as-yet-unknown buffer overflow attempt against "
                         "the Wi-Fi drivers or firmware, but could also be caused by a misconfigured device.",
                         packinfo->source_mac, packinfo->dest_mac, packinfo->bssid_mac, 
-                        3, 1, ie_tag->tag_len());
+                        3, 1, ie_tag.tag_len());
 
                 alertracker->raise_alert(alert_bad_fixlen_ie, in_pack, 
                         packinfo->bssid_mac, packinfo->source_mac, 
@@ -1585,17 +1785,17 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                 return -1;
             }
                 
-            packinfo->channel = fmt::format("{}", (uint8_t) (ie_tag->tag_data()[0]));
+            packinfo->channel = fmt::format("{}", ie_tag.tag_len() > 0 ? ie_tag.tag_bytes()[0] : 0);
             continue;
         }
 
         // IE 7 802.11d
-        if (ie_tag->tag_num() == 7) {
+        if (ie_tag.tag_num() == 7) {
             try {
                 dot11_ie_7_country dot11d;
                 // Allow fragmented 11d, take what we can parse
                 dot11d.set_allow_fragments(true);
-                dot11d.parse(ie_tag->tag_data_stream());
+                dot11d.parse(ie_tag.tag_data_stream());
 
                 packinfo->dot11d_country = munge_to_printable(dot11d.country_code());
 
@@ -1618,11 +1818,11 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 11 QBSS
-        if (ie_tag->tag_num() == 11) {
+        if (ie_tag.tag_num() == 11) {
             try {
                 std::shared_ptr<dot11_ie_11_qbss> qbss(new dot11_ie_11_qbss());
-                ie_tag->tag_data_stream()->seek(0);
-                qbss->parse(ie_tag->tag_data_stream());
+                ie_tag.tag_data_stream()->seek(0);
+                qbss->parse(ie_tag.tag_data_stream());
                 packinfo->qbss = qbss;
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - corrupt QBSS %s\n", e.what());
@@ -1634,10 +1834,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 33 advertised txpower in probe req
-        if (ie_tag->tag_num() == 33) {
+        if (ie_tag.tag_num() == 33) {
             try {
                 packinfo->tx_power = std::make_shared<dot11_ie_33_power>();
-                packinfo->tx_power->parse(ie_tag->tag_data_stream());
+                packinfo->tx_power->parse(ie_tag.tag_data_stream());
             } catch (const std::exception& e) {
                 // fmt::print(stderr, "debug - corrupt IE33 power: {}\n", e.what());
             }
@@ -1645,16 +1845,16 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 36, advertised supported channels in probe req
-        if (ie_tag->tag_num() == 36) {
+        if (ie_tag.tag_num() == 36) {
             try {
                 packinfo->supported_channels = std::make_shared<dot11_ie_36_supported_channels>();
-                packinfo->supported_channels->parse(ie_tag->tag_data_stream());
+                packinfo->supported_channels->parse(ie_tag.tag_data_stream());
             } catch (const std::exception& e) {
                 // fmt::print(stderr, "debug  corrupt ie36 supported channels: {}\n", e.what());
             }
         }
 
-        if (ie_tag->tag_num() == 45) {
+        if (ie_tag.tag_num() == 45) {
             /*
             if (seen_mcsrates) {
                 fprintf(stderr, "debug - duplicate ie45 mcs rates\n");
@@ -1667,7 +1867,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
             try {
                 std::shared_ptr<dot11_ie_45_ht_cap> ht(new dot11_ie_45_ht_cap());
-                ht->parse(ie_tag->tag_data_stream());
+                ht->parse(ie_tag.tag_data_stream());
 
                 std::stringstream mcsstream;
 
@@ -1735,12 +1935,12 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 48, RSN
-        if (ie_tag->tag_num() == 48) {
+        if (ie_tag.tag_num() == 48) {
             bool rsn_invalid = false;
 
             try {
                 std::shared_ptr<dot11_ie_48_rsn> rsn(new dot11_ie_48_rsn());
-                rsn->parse(ie_tag->tag_data_stream());
+                rsn->parse(ie_tag.tag_data_stream());
 
                 // TODO - don't aggregate these in the future
 
@@ -1781,8 +1981,8 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             if (rsn_invalid) {
                 try {
                     std::shared_ptr<dot11_ie_48_rsn_partial> rsn(new dot11_ie_48_rsn_partial());
-                    ie_tag->tag_data_stream()->seek(0);
-                    rsn->parse(ie_tag->tag_data_stream());
+                    ie_tag.tag_data_stream()->seek(0);
+                    rsn->parse(ie_tag.tag_data_stream());
 
                     if (rsn->pairwise_count() > 1024) {
                         alertracker->raise_alert(alert_atheros_rsnloop_ref, 
@@ -1795,6 +1995,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                                 "be an attack against Atheros drivers per "
                                 "CVE-2017-9714 and "
                                 "https://pleasestopnamingvulnerabilities.com/");
+                        ie_alerted = true;
                     }
 
                 } catch (const std::exception& e) {
@@ -1806,10 +2007,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 54 Mobility
-        if (ie_tag->tag_num() == 54) {
+        if (ie_tag.tag_num() == 54) {
             try {
                 std::shared_ptr<dot11_ie_54_mobility> mobility(new dot11_ie_54_mobility());
-                mobility->parse(ie_tag->tag_data_stream());
+                mobility->parse(ie_tag.tag_data_stream());
                 packinfo->dot11r_mobility = mobility;
             } catch (const std::exception& e) {
                 packinfo->corrupt = 1;
@@ -1819,10 +2020,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 61 HT
-        if (ie_tag->tag_num() == 61) {
+        if (ie_tag.tag_num() == 61) {
             try {
                 std::shared_ptr<dot11_ie_61_ht_op> ht(new dot11_ie_61_ht_op());
-                ht->parse(ie_tag->tag_data_stream());
+                ht->parse(ie_tag.tag_data_stream());
                 packinfo->dot11ht = ht;
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - unparsable HT\n");
@@ -1834,10 +2035,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 133 CISCO CCX
-        if (ie_tag->tag_num() == 133) {
+        if (ie_tag.tag_num() == 133) {
             try {
                 std::shared_ptr<dot11_ie_133_cisco_ccx> ccx1(new dot11_ie_133_cisco_ccx());
-                ccx1->parse(ie_tag->tag_data_stream());
+                ccx1->parse(ie_tag.tag_data_stream());
                 packinfo->beacon_info = munge_to_printable(ccx1->ap_name());
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - ccx error %s\n", e.what());
@@ -1847,28 +2048,29 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             continue;
         }
 
-        if (ie_tag->tag_num() == 127) {
-            if (ie_tag->tag_len() > 11) {
+        if (ie_tag.tag_num() == 127) {
+            if (ie_tag.tag_len() > 11) {
                 std::string al = fmt::format("IEEE80211 Access Point BSSID {} sent a beacon with "
                     "an invalid IE 127 Extended Capabilities tag; this may indicate attempts to "
                     "exploit Qualcomm drivers using the CVE-2019-10539 vulnerability.  Extended "
                     "capability tags should typically have 10-11 bytes, but saw {}.",
-                    packinfo->bssid_mac, ie_tag->tag_len());
+                    packinfo->bssid_mac, ie_tag.tag_len());
 
                 alertracker->raise_alert(alert_qcom_extended_ref, in_pack, 
                         packinfo->bssid_mac, packinfo->source_mac, 
                         packinfo->dest_mac, packinfo->other_mac, 
                         packinfo->channel, al);
+                ie_alerted = true;
 
             }
         }
 
         // IE 191 VHT Capabilities TODO compbine with VHT OP to derive actual usable
         // rate
-        if (ie_tag->tag_num() == 191) {
+        if (ie_tag.tag_num() == 191) {
             try {
                 std::shared_ptr<dot11_ie_191_vht_cap> vht(new dot11_ie_191_vht_cap());
-                vht->parse(ie_tag->tag_data_stream());
+                vht->parse(ie_tag.tag_data_stream());
 
                 bool gi80 = vht->vht_cap_80mhz_shortgi();
                 bool gi160 = vht->vht_cap_160mhz_shortgi();
@@ -1943,11 +2145,11 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
 
         // Vendor 150 collection
-        if (ie_tag->tag_num() == 150) {
+        if (ie_tag.tag_num() == 150) {
             try {
                 auto vendor = std::make_shared<dot11_ie_150_vendor>();
-                ie_tag->tag_data_stream()->seek(0);
-                vendor->parse(ie_tag->tag_data_stream());
+                ie_tag.tag_data_stream()->seek(0);
+                vendor->parse(ie_tag.tag_data_stream());
 
                 if (vendor->vendor_oui_int() == dot11_ie_150_cisco_powerlevel::cisco_oui()) {
                     auto ccx_power = std::make_shared<dot11_ie_150_cisco_powerlevel>();
@@ -1962,10 +2164,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 192 VHT Operation
-        if (ie_tag->tag_num() == 192) {
+        if (ie_tag.tag_num() == 192) {
             try {
                 auto vht = std::make_shared<dot11_ie_192_vht_op>();
-                vht->parse(ie_tag->tag_data_stream());
+                vht->parse(ie_tag.tag_data_stream());
                 packinfo->dot11vht = vht;
 
             } catch (const std::exception& e) {
@@ -1976,17 +2178,17 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             continue;
         }
 
-        if (ie_tag->tag_num() == 221) {
+        if (ie_tag.tag_num() == 221) {
             try {
                 auto vendor = std::make_shared<dot11_ie_221_vendor>();
-                ie_tag->tag_data_stream()->seek(0);
-                vendor->parse(ie_tag->tag_data_stream());
+                ie_tag.tag_data_stream()->seek(0);
+                vendor->parse(ie_tag.tag_data_stream());
 
                 // Match mis-sized WMM
                 if (packinfo->subtype == packet_sub_beacon &&
                         vendor->vendor_oui_int() == 0x0050f2 &&
                         vendor->vendor_oui_type() == 2 &&
-                        ie_tag->tag_data().length() > 24) {
+                        ie_tag.tag_len() > 24) {
 
                     std::string al = "IEEE80211 Access Point BSSID " + 
                         packinfo->bssid_mac.mac_to_string() + " sent association "
@@ -1998,6 +2200,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                             packinfo->bssid_mac, packinfo->source_mac, 
                             packinfo->dest_mac, packinfo->other_mac, 
                             packinfo->channel, al);
+                    ie_alerted = true;
                 }
 
                 // Count wmmtspec frames; per
@@ -2028,6 +2231,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                             packinfo->bssid_mac, packinfo->source_mac, 
                             packinfo->dest_mac, packinfo->other_mac, 
                             packinfo->channel, al);
+                    ie_alerted = true;
                 }
 
                 // Look for DJI DroneID OUIs
@@ -2115,6 +2319,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                                             "A Wi-Fi Direct P2P packet with an over-long Notification of Absence report "
                                             "seen.  This may indicate an attempt to exploit a bug "
                                             "in the Linux RTLWIFI drivers as detailed in CVE-2019-17666");
+                                    ie_alerted = true;
                                 }
                             }
                         }
@@ -2210,6 +2415,9 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
     }
 
+    if (ie_cache_max > 0 && !ie_alerted)
+        ie_cache_store(ie_cache_key, ie_hash, pre_ie_cryptset, pre_ie_basic_crypt_set, packinfo, common);
+
     return 1;
 
 #if 0
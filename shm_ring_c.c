@@ -0,0 +1,270 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#ifdef SYS_LINUX
+#define _GNU_SOURCE 1
+#endif
+
+#include <stdint.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "shm_ring_c.h"
+
+#define KIS_SHM_ALIGN(x)    (((x) + 7) & ~((size_t) 7))
+
+kis_shm_ring_t *kis_shm_ring_create(size_t data_sz) {
+    kis_shm_ring_t *ring;
+    const char *shmdirs[] = { "/dev/shm", "/tmp", NULL };
+    char shmname[64];
+    unsigned int x;
+    void *map;
+
+    data_sz = KIS_SHM_ALIGN(data_sz);
+
+    ring = (kis_shm_ring_t *) malloc(sizeof(kis_shm_ring_t));
+
+    if (ring == NULL)
+        return NULL;
+
+    ring->shm_fd = -1;
+    ring->notify_fd = -1;
+    ring->map_sz = sizeof(struct kis_shm_ring_hdr) + data_sz;
+
+    /* Back the ring with a temporary file, preferring tmpfs, which is unlinked as
+     * soon as it exists so only inherited descriptors can reach it.  This avoids
+     * shm_open, which needs librt on older systems. */
+    for (x = 0; shmdirs[x] != NULL && ring->shm_fd < 0; x++) {
+        snprintf(shmname, 64, "%s/kismet-ring-XXXXXX", shmdirs[x]);
+#ifdef SYS_LINUX
+        ring->shm_fd = mkostemp(shmname, O_CLOEXEC);
+#else
+        ring->shm_fd = mkstemp(shmname);
+
+        if (ring->shm_fd >= 0)
+            fcntl(ring->shm_fd, F_SETFD, FD_CLOEXEC);
+#endif
+    }
+
+    if (ring->shm_fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    unlink(shmname);
+
+    if (ftruncate(ring->shm_fd, ring->map_sz) < 0) {
+        close(ring->shm_fd);
+        free(ring);
+        return NULL;
+    }
+
+    map = mmap(NULL, ring->map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, ring->shm_fd, 0);
+
+    if (map == MAP_FAILED) {
+        close(ring->shm_fd);
+        free(ring);
+        return NULL;
+    }
+
+    ring->hdr = (struct kis_shm_ring_hdr *) map;
+    ring->data = (uint8_t *) map + sizeof(struct kis_shm_ring_hdr);
+
+    memset(ring->hdr, 0, sizeof(struct kis_shm_ring_hdr));
+    ring->hdr->signature = KIS_SHM_RING_SIG;
+    ring->hdr->version = KIS_SHM_RING_VERSION;
+    ring->hdr->data_sz = data_sz;
+
+    return ring;
+}
+
+kis_shm_ring_t *kis_shm_ring_attach(int shm_fd, int notify_fd) {
+    kis_shm_ring_t *ring;
+    struct stat sb;
+    void *map;
+
+    if (fstat(shm_fd, &sb) < 0 || (size_t) sb.st_size <= sizeof(struct kis_shm_ring_hdr))
+        return NULL;
+
+    ring = (kis_shm_ring_t *) malloc(sizeof(kis_shm_ring_t));
+
+    if (ring == NULL)
+        return NULL;
+
+    ring->map_sz = (size_t) sb.st_size;
+
+    map = mmap(NULL, ring->map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+
+    if (map == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->hdr = (struct kis_shm_ring_hdr *) map;
+    ring->data = (uint8_t *) map + sizeof(struct kis_shm_ring_hdr);
+
+    if (ring->hdr->signature != KIS_SHM_RING_SIG ||
+            ring->hdr->version != KIS_SHM_RING_VERSION ||
+            ring->hdr->data_sz + sizeof(struct kis_shm_ring_hdr) > ring->map_sz) {
+        munmap(map, ring->map_sz);
+        free(ring);
+        return NULL;
+    }
+
+    ring->shm_fd = shm_fd;
+    ring->notify_fd = notify_fd;
+
+    return ring;
+}
+
+void kis_shm_ring_free(kis_shm_ring_t *ring) {
+    if (ring == NULL)
+        return;
+
+    munmap(ring->hdr, ring->map_sz);
+
+    if (ring->shm_fd >= 0)
+        close(ring->shm_fd);
+
+    if (ring->notify_fd >= 0)
+        close(ring->notify_fd);
+
+    free(ring);
+}
+
+int kis_shm_ring_write(kis_shm_ring_t *ring, const kis_shm_record_t *rec,
+        const uint8_t *data, size_t data_sz) {
+    struct kis_shm_ring_hdr *hdr = ring->hdr;
+    kis_shm_record_t *out;
+    uint64_t head, tail;
+    size_t rec_sz, offt, contig, need;
+
+    rec_sz = KIS_SHM_ALIGN(sizeof(kis_shm_record_t) + data_sz);
+
+    if (rec_sz > hdr->data_sz / 2)
+        return -1;
+
+    head = hdr->head;
+    tail = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+
+    offt = head % hdr->data_sz;
+    contig = hdr->data_sz - offt;
+
+    need = rec_sz;
+    if (contig < rec_sz)
+        need += contig;
+
+    if (hdr->data_sz - (head - tail) < need)
+        return 0;
+
+    /* Records never wrap; pad out the end of the ring and start over at 0 */
+    if (contig < rec_sz) {
+        out = (kis_shm_record_t *) (ring->data + offt);
+        out->record_sz = contig;
+        out->type = KIS_SHM_RECORD_PAD;
+
+        head += contig;
+        offt = 0;
+    }
+
+    out = (kis_shm_record_t *) (ring->data + offt);
+    memcpy(out, rec, sizeof(kis_shm_record_t));
+    out->record_sz = rec_sz;
+    out->type = KIS_SHM_RECORD_PACKET;
+    out->data_sz = data_sz;
+    memcpy(out->data, data, data_sz);
+
+    __atomic_store_n(&hdr->head, head + rec_sz, __ATOMIC_RELEASE);
+
+    /* Pairs with the fence in kis_shm_ring_prepare_wait so that either we see the
+     * consumer waiting or it sees our new head */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&hdr->consumer_waiting, __ATOMIC_RELAXED) &&
+            __atomic_exchange_n(&hdr->consumer_waiting, 0, __ATOMIC_SEQ_CST) &&
+            ring->notify_fd >= 0) {
+        uint8_t b = 0;
+        ssize_t r;
+
+        do {
+            r = write(ring->notify_fd, &b, 1);
+        } while (r < 0 && errno == EINTR);
+    }
+
+    return 1;
+}
+
+int kis_shm_ring_peek(kis_shm_ring_t *ring, kis_shm_record_t **rec) {
+    struct kis_shm_ring_hdr *hdr = ring->hdr;
+    kis_shm_record_t *r;
+    uint64_t head, tail;
+
+    while (1) {
+        head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+        tail = hdr->tail;
+
+        if (head == tail)
+            return 0;
+
+        r = (kis_shm_record_t *) (ring->data + (tail % hdr->data_sz));
+
+        /* Records never wrap; a pad record fills the end of the buffer instead */
+        if (r->record_sz < 8 || r->record_sz > head - tail || (r->record_sz & 7) ||
+                (tail % hdr->data_sz) + r->record_sz > hdr->data_sz)
+            return -1;
+
+        if (r->type == KIS_SHM_RECORD_PAD) {
+            __atomic_store_n(&hdr->tail, tail + r->record_sz, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        if (r->record_sz < sizeof(kis_shm_record_t) + r->data_sz)
+            return -1;
+
+        *rec = r;
+        return 1;
+    }
+}
+
+void kis_shm_ring_consume(kis_shm_ring_t *ring, kis_shm_record_t *rec) {
+    __atomic_store_n(&ring->hdr->tail, ring->hdr->tail + rec->record_sz, __ATOMIC_RELEASE);
+}
+
+int kis_shm_ring_prepare_wait(kis_shm_ring_t *ring) {
+    struct kis_shm_ring_hdr *hdr = ring->hdr;
+
+    __atomic_store_n(&hdr->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) != hdr->tail) {
+        __atomic_store_n(&hdr->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+        return 0;
+    }
+
+    return 1;
+}
+
@@ -0,0 +1,179 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* A single-producer, single-consumer ring in shared memory, used to move captured
+ * frames from a local capture helper to the Kismet server without going through
+ * the IPC pipes.  The server creates the ring and hands the descriptor to the
+ * helper it launches; control traffic stays on the normal pipe protocol.
+ *
+ * The producer only advances head and the consumer only advances tail.  When the
+ * consumer runs out of data it sets consumer_waiting and sleeps on the notify pipe;
+ * the producer only writes to the pipe when it sees that flag, so a busy server
+ * never costs the helper a syscall per frame.
+ *
+ * Implemented in plain C so that it can be shared by the capture framework and
+ * the server. */
+
+#ifndef __SHM_RING_C_H__
+#define __SHM_RING_C_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KIS_SHM_RING_SIG        0x4B534852
+#define KIS_SHM_RING_VERSION    2
+
+/* Control block at the start of the mapping; the positions are free-running byte
+ * counters and sit on their own cache lines */
+struct kis_shm_ring_hdr {
+    uint32_t signature;
+    uint32_t version;
+    uint64_t data_sz;
+
+    /* Written only by the producer */
+    uint64_t head __attribute__((aligned(64)));
+
+    /* Written only by the consumer */
+    uint64_t tail __attribute__((aligned(64)));
+
+    /* Set by the consumer before it sleeps on the notify pipe */
+    uint32_t consumer_waiting __attribute__((aligned(64)));
+};
+
+#define KIS_SHM_RECORD_PACKET   1
+#define KIS_SHM_RECORD_PAD      2
+
+/* Which radio fields of a record are valid */
+#define KIS_SHM_FIELD_SIGNAL_DBM    (1 << 0)
+#define KIS_SHM_FIELD_NOISE_DBM     (1 << 1)
+#define KIS_SHM_FIELD_SIGNAL_RSSI   (1 << 2)
+#define KIS_SHM_FIELD_NOISE_RSSI    (1 << 3)
+#define KIS_SHM_FIELD_FREQ_KHZ      (1 << 4)
+#define KIS_SHM_FIELD_CHANNEL       (1 << 5)
+#define KIS_SHM_FIELD_DATARATE      (1 << 6)
+
+#define KIS_SHM_CHANNEL_LEN     32
+
+/* A captured frame and its radio metadata, mirroring the SubPacket and SubSignal
+ * fields of a data report.  Records are padded to 8 bytes; a PAD record fills the
+ * end of the ring when the next record would not fit. */
+struct kis_shm_record {
+    uint32_t record_sz;
+    uint32_t type;
+
+    uint64_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t dlt;
+
+    uint32_t fields;
+    uint32_t data_sz;
+
+    /* Length of the frame before the capture source sliced it; 0 when data holds
+     * the whole frame */
+    uint32_t orig_sz;
+    uint32_t reserved;
+
+    double signal_dbm;
+    double noise_dbm;
+    double signal_rssi;
+    double noise_rssi;
+    double freq_khz;
+    double datarate;
+    char channel[KIS_SHM_CHANNEL_LEN];
+
+    uint8_t data[0];
+};
+typedef struct kis_shm_record kis_shm_record_t;
+
+struct kis_shm_ring {
+    struct kis_shm_ring_hdr *hdr;
+    uint8_t *data;
+    size_t map_sz;
+
+    /* Shared memory descriptor; kept open by the server until the helper has
+     * inherited it */
+    int shm_fd;
+
+    /* Wakeup pipe; the write side in the helper, the read side in the server */
+    int notify_fd;
+};
+typedef struct kis_shm_ring kis_shm_ring_t;
+
+/* Create a ring with at least data_sz bytes of record space, backed by an
+ * unlinked temporary file
+ *
+ * Returns NULL if the ring could not be created
+ */
+kis_shm_ring_t *kis_shm_ring_create(size_t data_sz);
+
+/* Map a ring created by the server from an inherited descriptor
+ *
+ * Returns NULL if the descriptor does not hold a valid ring
+ */
+kis_shm_ring_t *kis_shm_ring_attach(int shm_fd, int notify_fd);
+
+/* Unmap a ring and close its descriptors
+ */
+void kis_shm_ring_free(kis_shm_ring_t *ring);
+
+/* Producer: copy a record header and frame into the ring and wake the consumer
+ * if it is sleeping.  The record_sz, type, and data_sz fields of the header are
+ * filled in.
+ *
+ * Returns:
+ * -1   Record can never fit in this ring
+ *  0   Insufficient space
+ *  1   Success
+ */
+int kis_shm_ring_write(kis_shm_ring_t *ring, const kis_shm_record_t *rec,
+        const uint8_t *data, size_t data_sz);
+
+/* Consumer: get the next record without consuming it
+ *
+ * Returns:
+ * -1   Ring is corrupt
+ *  0   No data
+ *  1   Record returned in *rec
+ */
+int kis_shm_ring_peek(kis_shm_ring_t *ring, kis_shm_record_t **rec);
+
+/* Consumer: release a record returned by kis_shm_ring_peek
+ */
+void kis_shm_ring_consume(kis_shm_ring_t *ring, kis_shm_record_t *rec);
+
+/* Consumer: announce that we are about to sleep on the notify pipe
+ *
+ * Returns 1 if the ring is empty and it is safe to sleep, 0 if data arrived and
+ * the ring should be drained again instead.
+ */
+int kis_shm_ring_prepare_wait(kis_shm_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
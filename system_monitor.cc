@@ -37,6 +37,7 @@
 #include "json_adapter.h"
 #include "kis_databaselogfile.h"
 #include "system_monitor.h"
+#include "trackedstringpool.h"
 #include "util.h"
 #include "version.h"
 
@@ -138,6 +139,12 @@ Systemmonitor::Systemmonitor() :
             }, monitor_mutex);
     httpd->register_route("/system/timestamp", {"GET", "POST"}, httpd->RO_ROLE, {}, timestamp_endp);
 
+    httpd->register_route("/system/string_pools", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [](std::shared_ptr<kis_net_beast_httpd_connection>) -> std::shared_ptr<tracker_element> {
+                    return tracker_string_pool::get_pool_stats();
+                }));
+
     if (Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_system_status", true)) {
         auto snap_time_s = 
             Globalreg::globalreg->kismet_config->fetch_opt_as<unsigned int>("kis_log_system_status_rate", 30);
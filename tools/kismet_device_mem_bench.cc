@@ -0,0 +1,235 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Memory cost of a tracked Wi-Fi device.  Builds device records the way the device
+ * tracker and the dot11 phy do - a new core device record, with a dot11 device
+ * record cloned from the registered builder attached - fills in the fields every device
+ * gets, and reports the heap bytes, components, and elements held per device.
+ *
+ * Heap use is counted by replacing the global allocator, so it is exact and does not
+ * depend on the malloc implementation or RSS granularity.
+ *
+ * With a thread count, the devices are then serialized to JSON from that many threads
+ * at once, to exercise concurrent serialization of components with inline fields.
+ *
+ * Build with 'make tools/kismet_device_mem_bench'
+ *
+ * Usage: kismet_device_mem_bench [devices] [serialize threads]
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "devicetracker_component.h"
+#include "entrytracker.h"
+#include "globalregistry.h"
+#include "json_adapter.h"
+#include "phy_80211_components.h"
+#include "trackedstringpool.h"
+
+static std::atomic<int64_t> bench_heap_bytes{0};
+static std::atomic<int64_t> bench_heap_allocs{0};
+
+// Each allocation carries its size ahead of the returned block
+static constexpr size_t bench_hdr_sz = alignof(std::max_align_t);
+
+void *operator new(size_t sz) {
+    auto p = static_cast<uint8_t *>(malloc(sz + bench_hdr_sz));
+
+    if (p == nullptr)
+        throw std::bad_alloc();
+
+    *reinterpret_cast<size_t *>(p) = sz;
+
+    bench_heap_bytes += sz;
+    bench_heap_allocs++;
+
+    return p + bench_hdr_sz;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr == nullptr)
+        return;
+
+    auto p = static_cast<uint8_t *>(ptr) - bench_hdr_sz;
+
+    bench_heap_bytes -= *reinterpret_cast<size_t *>(p);
+    bench_heap_allocs--;
+
+    free(p);
+}
+
+void *operator new[](size_t sz) {
+    return operator new(sz);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int n_devices = 100000;
+    unsigned int n_threads = 0;
+
+    if (argc > 1)
+        n_devices = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        n_threads = strtoul(argv[2], NULL, 10);
+
+    if (n_devices == 0) {
+        fprintf(stderr, "Usage: %s [devices] [serialize threads]\n", argv[0]);
+        exit(1);
+    }
+
+    Globalreg::globalreg = new global_registry;
+    Globalreg::n_tracked_fields = 0;
+    Globalreg::n_tracked_components = 0;
+
+    auto entrytracker = entry_tracker::create_entrytracker();
+    entrytracker->register_serializer("json", std::make_shared<json_adapter::serializer>());
+
+    auto device_base_id =
+        entrytracker->register_field("kismet.device.base",
+                tracker_element_factory<kis_tracked_device_base>(),
+                "core device record");
+    auto dot11_device_id =
+        entrytracker->register_field("dot11.device",
+                tracker_element_factory<dot11_tracked_device>(),
+                "IEEE802.11 device");
+
+    auto type_pool =
+        tracker_string_pool::get_field_pool(entrytracker->register_field("kismet.device.base.type",
+                    tracker_element_factory<tracker_element_string>(), "printable device type"));
+    auto phy_pool =
+        tracker_string_pool::get_field_pool(entrytracker->register_field("kismet.device.base.phyname",
+                    tracker_element_factory<tracker_element_string>(), "phy name"));
+
+    // Build one of each first so the builders, field registrations, and pools are
+    // not counted against the devices
+    {
+        auto dev = std::make_shared<kis_tracked_device_base>(device_base_id);
+        dev->insert(entrytracker->get_shared_instance_as<dot11_tracked_device>(dot11_device_id));
+        dev->set_tracker_type_string(type_pool->intern("Wi-Fi AP"));
+        dev->set_tracker_phyname(phy_pool->intern("IEEE802.11"));
+        dev->set_crypt_string("WPA2-PSK");
+    }
+
+    auto base_bytes = bench_heap_bytes.load();
+    auto base_allocs = bench_heap_allocs.load();
+    auto base_components = Globalreg::n_tracked_components.load();
+    auto base_fields = Globalreg::n_tracked_fields.load();
+
+    std::vector<std::shared_ptr<kis_tracked_device_base>> devices;
+    devices.reserve(n_devices);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < n_devices; i++) {
+        auto dev = std::make_shared<kis_tracked_device_base>(device_base_id);
+        auto dot11 = entrytracker->get_shared_instance_as<dot11_tracked_device>(dot11_device_id);
+
+        dev->insert(dot11);
+
+        auto mac = mac_addr(fmt::format("02:00:{:02X}:{:02X}:{:02X}:{:02X}",
+                    (i >> 24) & 0xFF, (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF));
+
+        dev->set_key(device_key(1, mac));
+        dev->set_macaddr(mac);
+        dev->set_tracker_type_string(type_pool->intern("Wi-Fi AP"));
+        dev->set_tracker_phyname(phy_pool->intern("IEEE802.11"));
+        dev->set_crypt_string("WPA2-PSK");
+        dev->set_first_time(1600000000 + i);
+        dev->set_last_time(1600000000 + i);
+        dev->set_packets(i);
+        dev->set_datasize(i * 100);
+
+        dot11->set_type_set(1);
+        dot11->set_last_sequence(i & 0xFFF);
+
+        devices.push_back(dev);
+    }
+
+    auto build_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto dev_bytes = bench_heap_bytes.load() - base_bytes;
+    auto dev_allocs = bench_heap_allocs.load() - base_allocs;
+
+    // The vector of device pointers isn't part of the device cost
+    dev_bytes -= devices.capacity() * sizeof(std::shared_ptr<kis_tracked_device_base>);
+    dev_allocs -= 1;
+
+    printf("devices:                 %u\n", n_devices);
+    printf("heap bytes per device:   %.1f\n", (double) dev_bytes / n_devices);
+    printf("allocations per device:  %.1f\n", (double) dev_allocs / n_devices);
+    printf("components per device:   %.1f\n",
+            (double) (Globalreg::n_tracked_components - base_components) / n_devices);
+    printf("elements per device:     %.1f\n",
+            (double) (Globalreg::n_tracked_fields - base_fields) / n_devices);
+    printf("build time per device:   %.2f usec\n", (build_sec * 1000000) / n_devices);
+
+    if (n_threads > 0) {
+        std::vector<std::thread> threads;
+        std::atomic<uint64_t> serialized_bytes{0};
+
+        start = std::chrono::steady_clock::now();
+
+        // Every thread serializes every device, so the same components are serialized
+        // concurrently
+        for (unsigned int t = 0; t < n_threads; t++) {
+            threads.emplace_back([&]() {
+                for (const auto& d : devices) {
+                    std::stringstream ss;
+                    Globalreg::globalreg->entrytracker->serialize("json", ss, d, nullptr);
+                    serialized_bytes += ss.str().length();
+                }
+            });
+        }
+
+        for (auto& t : threads)
+            t.join();
+
+        auto ser_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("serialize threads:       %u\n", n_threads);
+        printf("serialize per device:    %.2f usec\n",
+                (ser_sec * 1000000) / ((double) n_devices * n_threads));
+        printf("json bytes per device:   %.1f\n",
+                (double) serialized_bytes / ((double) n_devices * n_threads));
+    }
+
+    return 0;
+}
+
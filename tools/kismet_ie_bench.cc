@@ -0,0 +1,444 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Cost of walking the IE tags of beacons, comparing the kaitai path the 802.11
+ * dissector used to take - a membuf, istream, and kstream over the tags, a copied
+ * dot11_ie tag list, and a vendor parser per vendor tag - against the in-place
+ * dot11_ie_view it uses now.  Both paths do the per-tag work the dissector does for
+ * the fingerprint map:  hash the tag contents, and pull the OUI and subtype of vendor
+ * tags.
+ *
+ * Beacons are read from a pcap file (802.11, radiotap, or PPI); without one, a built-in
+ * set of beacon tag blocks laid out like common access points is used.  The tags
+ * found by both paths are compared before timing.
+ *
+ * Heap allocations are counted by replacing the global allocator.
+ *
+ * Build with 'make tools/kismet_ie_bench'
+ *
+ * Usage: kismet_ie_bench [iterations] [pcap file]
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LIBPCAP
+#include <pcap.h>
+#endif
+
+#include "dot11_parsers/dot11_ie.h"
+#include "dot11_parsers/dot11_ie_221_vendor.h"
+#include "xxhash.h"
+
+#ifndef DLT_IEEE802_11
+#define DLT_IEEE802_11          105
+#endif
+#ifndef DLT_IEEE802_11_RADIO
+#define DLT_IEEE802_11_RADIO    127
+#endif
+#ifndef DLT_PPI
+#define DLT_PPI                 192
+#endif
+
+static std::atomic<uint64_t> bench_heap_allocs{0};
+
+void *operator new(size_t sz) {
+    auto p = malloc(sz);
+
+    if (p == nullptr)
+        throw std::bad_alloc();
+
+    bench_heap_allocs++;
+
+    return p;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void *operator new[](size_t sz) {
+    return operator new(sz);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+// Same read-only streambuf as membuf in util.h, which the dissector wrapped the
+// tags in before parsing them with kaitai
+struct bench_membuf : std::streambuf {
+    bench_membuf(char *begin, char *end) : begin(begin), end(end) {
+        this->setg(begin, begin, end);
+    }
+
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override {
+        if (dir == std::ios_base::cur)
+            gbump(off);
+        else if (dir == std::ios_base::end)
+            setg(begin, end + off, end);
+        else if (dir == std::ios_base::beg)
+            setg(begin, begin + off, end);
+
+        return gptr() - eback();
+    }
+
+    virtual pos_type seekpos(std::streampos pos, std::ios_base::openmode mode) override {
+        return seekoff(pos - pos_type(off_type(0)), std::ios_base::beg, mode);
+    }
+
+    char *begin, *end;
+};
+
+// What each path learns from a tag block; both paths must agree
+struct bench_result {
+    unsigned int tags;
+    unsigned int tag_num_sum;
+    unsigned int tag_len_sum;
+    uint64_t vendor_sum;
+    size_t hash_sum;
+    bool valid;
+};
+
+static bench_result bench_kaitai(const std::vector<uint8_t>& ies) {
+    bench_result r{0, 0, 0, 0, 0, true};
+
+    bench_membuf tags_membuf((char *) ies.data(), (char *) ies.data() + ies.size());
+    std::istream istream_ietags(&tags_membuf);
+
+    auto ie_tags = std::make_shared<dot11_ie>();
+
+    try {
+        std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
+        ie_tags->parse(stream_ietags);
+
+        for (const auto& ie_tag : *(ie_tags->tags())) {
+            auto hash = std::hash<std::string>{};
+
+            r.tags++;
+            r.tag_num_sum += ie_tag->tag_num();
+            r.tag_len_sum += ie_tag->tag_len();
+            r.hash_sum += hash(ie_tag->tag_data());
+
+            if (ie_tag->tag_num() == 221) {
+                auto vendor = std::make_shared<dot11_ie_221_vendor>();
+                vendor->parse(ie_tag->tag_data_stream());
+
+                r.vendor_sum += vendor->vendor_oui_int() + vendor->vendor_oui_type();
+            }
+        }
+    } catch (const std::exception& e) {
+        r.valid = false;
+    }
+
+    return r;
+}
+
+static bench_result bench_view(const std::vector<uint8_t>& ies) {
+    bench_result r{0, 0, 0, 0, 0, true};
+
+    dot11_ie_view ie_view(ies.data(), ies.size());
+
+    if (!ie_view.valid()) {
+        r.valid = false;
+        return r;
+    }
+
+    for (const auto& ie_tag : ie_view) {
+        r.tags++;
+        r.tag_num_sum += ie_tag.tag_num();
+        r.tag_len_sum += ie_tag.tag_len();
+        r.hash_sum += (size_t) XXH64(ie_tag.tag_bytes(), ie_tag.tag_len(), 0);
+
+        if (ie_tag.tag_num() == 221) {
+            if (ie_tag.tag_len() < 3) {
+                r.valid = false;
+                return r;
+            }
+
+            auto vendor_bytes = ie_tag.tag_bytes();
+            uint32_t vendor_oui =
+                ((vendor_bytes[0] & 0xFF) << 16) +
+                ((vendor_bytes[1] & 0xFF) << 8) +
+                (vendor_bytes[2] & 0xFF);
+            uint8_t vendor_type = ie_tag.tag_len() > 3 ? vendor_bytes[3] : 0;
+
+            r.vendor_sum += vendor_oui + vendor_type;
+        }
+    }
+
+    return r;
+}
+
+// Beacon tag blocks laid out like common access points:  SSID, rates, DS, TIM,
+// country, ERP, RSN, extended rates, HT and VHT capabilities and operation, extended
+// capabilities, and WMM / WPS / vendor tags
+static const std::vector<std::vector<uint8_t>> bench_builtin_ies = {
+    {
+        0x00, 0x0b, 'K', 'i', 's', 'm', 'e', 't', '-', 'T', 'e', 's', 't',
+        0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x24, 0x30, 0x48, 0x6c,
+        0x03, 0x01, 0x06,
+        0x05, 0x04, 0x00, 0x01, 0x00, 0x00,
+        0x07, 0x06, 'U', 'S', 0x20, 0x01, 0x0b, 0x1e,
+        0x2a, 0x01, 0x00,
+        0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+            0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x0c, 0x00,
+        0x32, 0x04, 0x0c, 0x12, 0x18, 0x60,
+        0x2d, 0x1a, 0xad, 0x01, 0x1b, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00,
+        0x3d, 0x16, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x7f, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40,
+        0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x80, 0x00, 0x03, 0xa4, 0x00, 0x00,
+            0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+    },
+    {
+        0x00, 0x20, 'a', 'n', ' ', 'S', 'S', 'I', 'D', ' ', 'o', 'f', ' ', 't', 'h', 'e', ' ',
+            'f', 'u', 'l', 'l', ' ', 't', 'h', 'i', 'r', 't', 'y', ' ', 't', 'w', 'o', '!', '!',
+        0x01, 0x08, 0x8c, 0x12, 0x98, 0x24, 0xb0, 0x48, 0x60, 0x6c,
+        0x03, 0x01, 0x24,
+        0x05, 0x04, 0x00, 0x03, 0x00, 0x00,
+        0x07, 0x10, 'D', 'E', 0x20, 0x24, 0x04, 0x17, 0x34, 0x04, 0x17, 0x64, 0x0b, 0x1e,
+            0x00, 0x00, 0x00, 0x00,
+        0x0b, 0x05, 0x02, 0x00, 0x0c, 0x12, 0x7a,
+        0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+            0x01, 0x00, 0x00, 0x0f, 0xac, 0x08, 0xc0, 0x00,
+        0x2d, 0x1a, 0xef, 0x09, 0x1b, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00,
+        0x3d, 0x16, 0x24, 0x05, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x7f, 0x08, 0x04, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x40,
+        0xbf, 0x0c, 0xb2, 0x79, 0x91, 0x33, 0xfa, 0xff, 0x0c, 0x03, 0xfa, 0xff, 0x0c, 0x03,
+        0xc0, 0x05, 0x01, 0x2a, 0x00, 0xfc, 0xff,
+        0xc3, 0x04, 0x02, 0x2e, 0x2e, 0x2e,
+        0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x84, 0x00, 0x03, 0xa4, 0x00, 0x00,
+            0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+        0xdd, 0x07, 0x00, 0x0c, 0x43, 0x07, 0x00, 0x00, 0x00,
+    },
+    {
+        0x00, 0x0e, 'H', 'o', 'm', 'e', 'N', 'e', 't', 'w', 'o', 'r', 'k', '-', '5', 'G',
+        0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24,
+        0x03, 0x01, 0x01,
+        0x05, 0x04, 0x01, 0x02, 0x00, 0x00,
+        0x2a, 0x01, 0x04,
+        0x32, 0x04, 0x30, 0x48, 0x60, 0x6c,
+        0x30, 0x18, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x02, 0x00, 0x00, 0x0f, 0xac, 0x04,
+            0x00, 0x0f, 0xac, 0x02, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x00, 0x00,
+        0x2d, 0x1a, 0x6e, 0x10, 0x1b, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00,
+        0x3d, 0x16, 0x01, 0x08, 0x15, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x00, 0x00, 0x03, 0xa4, 0x00, 0x00,
+            0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+        0xdd, 0x1e, 0x00, 0x50, 0xf2, 0x04, 0x10, 0x4a, 0x00, 0x01, 0x10, 0x10, 0x44, 0x00,
+            0x01, 0x02, 0x10, 0x49, 0x00, 0x06, 0x00, 0x37, 0x2a, 0x00, 0x01, 0x20, 0x10, 0x3c,
+            0x00, 0x01, 0x01, 0x00,
+        0xdd, 0x09, 0x00, 0x10, 0x18, 0x02, 0x00, 0x00, 0x1c, 0x00, 0x00,
+    },
+    {
+        0x00, 0x00,
+        0x01, 0x04, 0x82, 0x84, 0x8b, 0x96,
+        0x03, 0x01, 0x0b,
+        0x05, 0x04, 0x00, 0x01, 0x00, 0x00,
+        0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+            0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x00, 0x00,
+        0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x00, 0x00, 0x03, 0xa4, 0x00, 0x00,
+            0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+    },
+};
+
+#ifdef HAVE_LIBPCAP
+// Offset of the 802.11 frame in a captured packet, or -1 if the link type isn't one
+// we can read
+static int bench_80211_offset(int dlt, const uint8_t *data, size_t len) {
+    if (dlt == DLT_IEEE802_11)
+        return 0;
+
+    if (dlt == DLT_IEEE802_11_RADIO || dlt == DLT_PPI) {
+        // Radiotap and PPI both carry a little-endian header length at byte 2
+        if (len < 4)
+            return -1;
+
+        return data[2] | (data[3] << 8);
+    }
+
+    return -1;
+}
+
+static int bench_load_pcap(const char *fname, std::vector<std::vector<uint8_t>>& ies) {
+    char errbuf[PCAP_ERRBUF_SIZE];
+    struct pcap_pkthdr *hdr;
+    const u_char *data;
+
+    auto pcap = pcap_open_offline(fname, errbuf);
+
+    if (pcap == nullptr) {
+        fprintf(stderr, "Could not open %s: %s\n", fname, errbuf);
+        return -1;
+    }
+
+    auto dlt = pcap_datalink(pcap);
+
+    while (pcap_next_ex(pcap, &hdr, &data) == 1) {
+        auto offt = bench_80211_offset(dlt, data, hdr->caplen);
+
+        // Beacons only; the tags follow the 24 byte header and 12 bytes of fixed
+        // parameters
+        if (offt < 0 || hdr->caplen < (unsigned int) offt + 36 || data[offt] != 0x80)
+            continue;
+
+        std::vector<uint8_t> block(data + offt + 36, data + hdr->caplen);
+
+        // Sources which keep the FCS leave 4 bytes after the last tag; drop them
+        // when the tags only parse without them
+        if (!dot11_ie_view(block.data(), block.size()).valid() && block.size() >= 4 &&
+                dot11_ie_view(block.data(), block.size() - 4).valid())
+            block.resize(block.size() - 4);
+
+        ies.push_back(block);
+    }
+
+    pcap_close(pcap);
+
+    return 0;
+}
+#endif
+
+static double bench_run(const std::vector<std::vector<uint8_t>>& ies, unsigned int n_iter,
+        std::function<bench_result (const std::vector<uint8_t>&)> fn,
+        double *allocs_per_frame, size_t *sink) {
+
+    auto start_allocs = bench_heap_allocs.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < n_iter; i++) {
+        for (const auto& b : ies)
+            *sink += fn(b).hash_sum;
+    }
+
+    auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto n_frames = (double) n_iter * ies.size();
+
+    *allocs_per_frame = (bench_heap_allocs.load() - start_allocs) / n_frames;
+
+    return (sec * 1000000000) / n_frames;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int n_iter = 100000;
+    std::vector<std::vector<uint8_t>> ies;
+
+    if (argc > 1)
+        n_iter = strtoul(argv[1], NULL, 10);
+
+    if (n_iter == 0) {
+        fprintf(stderr, "Usage: %s [iterations] [pcap file]\n", argv[0]);
+        exit(1);
+    }
+
+    if (argc > 2) {
+#ifdef HAVE_LIBPCAP
+        if (bench_load_pcap(argv[2], ies) < 0)
+            exit(1);
+#else
+        fprintf(stderr, "Kismet was built without libpcap; reading a pcap file is not available\n");
+        exit(1);
+#endif
+    } else {
+        ies = bench_builtin_ies;
+    }
+
+    if (ies.size() == 0) {
+        fprintf(stderr, "No beacons found\n");
+        exit(1);
+    }
+
+    // Both paths must see the same tags; blocks neither can parse are dropped, but a
+    // block only one of them accepts is a bug
+    unsigned int n_corrupt = 0, n_mismatch = 0, n_tags = 0;
+
+    for (auto i = ies.begin(); i != ies.end(); ) {
+        auto k = bench_kaitai(*i);
+        auto v = bench_view(*i);
+
+        if (k.valid != v.valid || (k.valid && (k.tags != v.tags ||
+                        k.tag_num_sum != v.tag_num_sum || k.tag_len_sum != v.tag_len_sum ||
+                        k.vendor_sum != v.vendor_sum))) {
+            n_mismatch++;
+        }
+
+        if (!k.valid || !v.valid) {
+            n_corrupt++;
+            i = ies.erase(i);
+            continue;
+        }
+
+        n_tags += v.tags;
+        ++i;
+    }
+
+    printf("beacons:                 %zu\n", ies.size());
+    printf("corrupt beacons:         %u\n", n_corrupt);
+    printf("tags per beacon:         %.1f\n", ies.size() ? (double) n_tags / ies.size() : 0);
+    printf("path mismatches:         %u\n", n_mismatch);
+
+    if (ies.size() == 0)
+        exit(1);
+
+    size_t sink = 0;
+    double kaitai_allocs, view_allocs;
+
+    auto kaitai_ns = bench_run(ies, n_iter, bench_kaitai, &kaitai_allocs, &sink);
+    auto view_ns = bench_run(ies, n_iter, bench_view, &view_allocs, &sink);
+
+    printf("kaitai ns per beacon:    %.1f\n", kaitai_ns);
+    printf("kaitai allocs per beacon:%.1f\n", kaitai_allocs);
+    printf("view ns per beacon:      %.1f\n", view_ns);
+    printf("view allocs per beacon:  %.1f\n", view_allocs);
+    printf("speedup:                 %.2fx\n", kaitai_ns / view_ns);
+
+    // Keep the hashes live so neither path is optimized away
+    if (sink == 1)
+        printf("\n");
+
+    return n_mismatch == 0 ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * HTTP route lookup, comparing the segment trie the server matches routes with
+ * (kis_net_beast_route_trie) against the per-route regexes it used to try in turn.
+ * The regex matcher is kept here, built the same way the routes used to build it.
+ *
+ * The routes are the ones the server registers, including examples of the routes
+ * built at runtime for device views and filters.  URLs are generated from every route -
+ * with captures, file types, and GET variables - along with near misses which should
+ * not match.  Before timing, every URL is checked to resolve to the same route with
+ * the same parameters under both matchers; any difference is printed and the exit
+ * status is non-zero.
+ *
+ * Build with 'make tools/kismet_route_bench'
+ *
+ * Usage: kismet_route_bench [iterations]
+ */
+
+#include "config.h"
+
+#include <chrono>
+#include <list>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fmt.h"
+#include "kis_net_beast_httpd.h"
+
+struct bench_route_def {
+    bool websocket;
+    const char *route;
+    bool match_types;
+    std::list<std::string> extensions;
+};
+
+// Routes as registered by the server, in registration order
+static const std::vector<bench_route_def> bench_route_defs = {
+    { false, "/alerts/definitions/define_alert", true, {"cmd"} },
+    { false, "/alerts/raise_alerts", true, {"cmd"} },
+    { false, "/alerts/definitions", true, {} },
+    { false, "/alerts/all_alerts", true, {} },
+    { false, "/alerts/alerts_view", true, {} },
+    { false, "/alerts/by-id/:alertid/alert", true, {} },
+    { false, "/alerts/last-time/:timestamp/alerts", true, {} },
+    { false, "/alerts/wrapped/last-time/:timestamp/alerts", true, {} },
+    { false, "/antennas/antennas", true, {} },
+    { false, "/channels/channels", true, {} },
+    { false, "/datasource/all_sources", true, {} },
+    { false, "/datasource/defaults", true, {} },
+    { false, "/datasource/types", true, {} },
+    { false, "/datasource/list_interfaces", true, {} },
+    { false, "/datasource/by-uuid/:uuid/source", true, {} },
+    { false, "/datasource/add_source", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/set_channel", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/set_hop", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/close_source", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/disable_source", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/open_source", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/pause_source", true, {"cmd"} },
+    { false, "/datasource/by-uuid/:uuid/resume_source", true, {"cmd"} },
+    { false, "/pcap/all_packets", true, {"pcapng"} },
+    { false, "/datasource/pcap/by-uuid/:uuid/packets", true, {"pcapng"} },
+    { true, "/datasource/remote/remotesource", true, {"ws"} },
+    { false, "/devices/views/all_views", true, {} },
+    { false, "/devices/multimac/devices", true, {} },
+    { false, "/devices/multikey/devices", true, {} },
+    { false, "/devices/multikey/as-object/devices", true, {} },
+    { false, "/devices/all_devices", true, {"ekjson", "itjson", "msgpack"} },
+    { false, "/devices/by-key/:key/device", true, {} },
+    { false, "/devices/by-mac/:mac/devices", true, {} },
+    { false, "/devices/last-time/:timestamp/devices", true, {} },
+    { false, "/devices/by-key/:key/set_name", true, {"cmd"} },
+    { false, "/devices/by-key/:key/set_tag", true, {"cmd"} },
+    { false, "/devices/pcap/by-key/:key/packets", true, {"pcapng"} },
+    { false, "/devices/alerts/mac/:type/add", true, {"cmd"} },
+    { false, "/devices/alerts/mac/:type/remove", true, {"cmd"} },
+    { false, "/devices/alerts/mac/:type/macs", true, {} },
+    { true, "/devices/monitor", true, {"ws"} },
+    { false, "/phy/all_phys", true, {} },
+    { false, "/phy/phy80211/ssidscan/status", true, {} },
+    { false, "/phy/phy80211/ssidscan/config", true, {"cmd"} },
+    { false, "/system/tracked_fields", true, {"html"} },
+    { true, "/eventbus/events", true, {"ws"} },
+    { false, "/gps/drivers", true, {} },
+    { false, "/gps/all_gps", true, {} },
+    { false, "/gps/location", true, {} },
+    { false, "/gps/by-uuid/:uuid/location", true, {} },
+    { false, "/gps/all_locations", true, {} },
+    { false, "/gps/add_gps", true, {"cmd"} },
+    { false, "/gps/by-uuid/:uuid/remove_gps", true, {"cmd"} },
+    { false, "/gps/web/update", true, {"cmd"} },
+    { false, "/logging/kismetdb/pcap/drop", true, {"cmd"} },
+    { false, "/poi/create_poi", true, {"cmd"} },
+    { false, "/poi/list_poi", true, {} },
+    { false, "/logging/kismetdb/pcap/:title", true, {"pcapng"} },
+    { false, "/httpd/stats", true, {} },
+    { false, "/session/check_login", false, {} },
+    { false, "/session/check_session", false, {} },
+    { false, "/auth/apikey/generate", true, {"cmd"} },
+    { false, "/auth/apikey/revoke", true, {"cmd"} },
+    { false, "/auth/apikey/list", true, {} },
+    { true, "/debug/echo", true, {"ws"} },
+    { false, "/logging/drivers", true, {} },
+    { false, "/logging/active", true, {} },
+    { false, "/logging/by-uuid/:uuid/stop", true, {"cmd"} },
+    { false, "/logging/by-class/:class/start", true, {"cmd"} },
+    { false, "/messagebus/last-time/:timestamp/messages", true, {} },
+    { false, "/messagebus/all_messages", true, {} },
+    { false, "/packetchain/packet_stats", true, {} },
+    { false, "/packetchain/packet_peak", true, {} },
+    { false, "/packetchain/packet_rate", true, {} },
+    { false, "/packetchain/packet_error", true, {} },
+    { false, "/packetchain/packet_dupe", true, {} },
+    { false, "/packetchain/packet_drop", true, {} },
+    { false, "/packetchain/packet_processed", true, {} },
+    { false, "/packetchain/packet_workers", true, {} },
+    { false, "/packetchain/handler_stats", true, {} },
+    { false, "/packetchain/packet_pool", true, {} },
+    { false, "/phy/phy80211/dedup", true, {} },
+    { false, "/phy/phy80211/iecache", true, {} },
+    { false, "/phy/phy80211/clients-of/:key/clients", true, {} },
+    { false, "/phy/phy80211/related-to/:key/devices", true, {} },
+    { false, "/phy/phy80211/by-key/:key/pcap/handshake", true, {"pcap"} },
+    { false, "/phy/phy80211/by-key/:key/pcap/handshake-pmkid", true, {"pcap"} },
+    { false, "/phy/phy80211/pcap/by-bssid/:mac/packets.pcapng", true, {"pcapng"} },
+    { false, "/phy/phy80211/ssids/views/ssids", true, {} },
+    { false, "/phy/phy80211/ssids/by-hash/:hash/ssid", true, {} },
+    { false, "/phy/RTLADSB/proxy/create", true, {"cmd"} },
+    { false, "/phy/RTLADSB/map_data", true, {} },
+    { true, "/phy/RTLADSB/beast", true, {"ws"} },
+    { true, "/phy/RTLADSB/raw", true, {"ws"} },
+    { true, "/datasource/by-uuid/:uuid/adsb_raw", true, {"ws"} },
+    { false, "/phy/phyuav/manuf_matchers", true, {} },
+    { false, "/plugins/all_plugins", true, {} },
+    { false, "/streams/all_streams", true, {} },
+    { false, "/streams/by-id/:id/stream_info", true, {} },
+    { false, "/streams/by-id/:id/close_stream", true, {} },
+    { false, "/system/status", true, {} },
+    { false, "/system/timestamp", true, {} },
+    { false, "/system/string_pools", true, {} },
+    { false, "/devices/views/phy-IEEE802.11/devices", true, {} },
+    { false, "/devices/views/phy-IEEE802.11/last-time/:timestamp/devices", true, {} },
+    { true, "/devices/views/phy-IEEE802.11/monitor", true, {"ws"} },
+    { false, "/devices/views/seenby-5fe308bd-0000-0000-0000-00c0ca91ac4b/devices", true, {} },
+    { false, "/devices/views/phydot11_accesspoints/devices", true, {} },
+    { false, "/devices/views/phydot11_accesspoints/last-time/:timestamp/devices", true, {} },
+    { false, "/filters/class/kismet.device.base/filter", true, {} },
+    { false, "/filters/class/kismet.device.base/set_default", true, {"cmd"} },
+    { false, "/filters/class/kismet.device.base/:phyname/set_filter", true, {"cmd"} },
+    { false, "/filters/class/kismet.device.base/:phyname/remove_filter", true, {"cmd"} },
+    { false, "/filters/packet/kismet.packetfilter.dot11.bssid/filter", true, {} },
+    { false, "/filters/packet/kismet.packetfilter.dot11.bssid/:phyname/:block/set_filter", true, {"cmd"} },
+    { false, "/filters/packet/kismet.packetfilter.dot11.bssid/:phyname/:block/remove_filter", true, {"cmd"} },
+    { true, "/phy/RTLADSB/by-uuid/5fe308bd-0000-0000-0000-00c0ca91ac4b/proxy", true, {"ws"} },
+};
+
+// The regex matcher routes used before the trie; the route is converted to a regex
+// with a non-greedy capture per :key, followed by the file types and GET variables
+class bench_regex_route {
+public:
+    bench_regex_route(const bench_route_def& def) {
+        const std::string route{def.route};
+        const std::regex path_re{":([^\\/]+)?"};
+        const std::string path_capture_pattern{"(?:([^\\/]+?))"};
+
+        for (auto i = std::sregex_token_iterator(route.begin(), route.end(), path_re);
+                i != std::sregex_token_iterator(); i++) {
+            match_keys.push_back(static_cast<std::string>(*i));
+        }
+
+        auto ext_str = std::regex_replace(route, path_re, path_capture_pattern);
+
+        if (!def.match_types) {
+            match_keys.push_back("GETVARS");
+            match_re = std::regex(fmt::format("^{}(\\?.*?)?$", ext_str));
+            return;
+        }
+
+        match_keys.push_back("FILETYPE");
+        match_keys.push_back("GETVARS");
+
+        auto ft_regex = std::string("\\.(");
+        if (def.extensions.size() == 0) {
+            ft_regex += "[A-Za-z0-9]+";
+        } else {
+            bool prepend_pipe = false;
+            for (const auto& i : def.extensions) {
+                if (prepend_pipe)
+                    ft_regex += fmt::format("|{}", i);
+                else
+                    ft_regex += fmt::format("{}", i);
+                prepend_pipe = true;
+            }
+        }
+        ft_regex += ")";
+
+        match_re = std::regex(fmt::format("^{}{}(\\?.*?)?$", ext_str, ft_regex));
+    }
+
+    bool match_url(const std::string& url, kis_net_beast_httpd_connection::uri_param_t& uri_params) const {
+        auto match_values = std::smatch();
+
+        if (!std::regex_match(url, match_values, match_re))
+            return false;
+
+        if (match_values.size() != match_keys.size() + 1)
+            return false;
+
+        for (size_t i = 1; i < match_values.size(); i++)
+            uri_params.emplace(std::make_pair(match_keys[i - 1], static_cast<std::string>(match_values[i])));
+
+        return true;
+    }
+
+protected:
+    std::vector<std::string> match_keys;
+    std::regex match_re;
+};
+
+// One set of routes, as the server keeps the http and websocket routes apart
+struct bench_route_set {
+    std::vector<std::shared_ptr<kis_net_beast_route>> routes;
+    std::vector<bench_regex_route> regex_routes;
+    kis_net_beast_route_trie trie;
+
+    void add(const bench_route_def& def) {
+        std::shared_ptr<kis_net_beast_route> r;
+
+        if (def.match_types)
+            r = std::make_shared<kis_net_beast_route>(def.route, 
+                    std::list<boost::beast::http::verb>{boost::beast::http::verb::get},
+                    false, std::list<std::string>{}, def.extensions, nullptr);
+        else
+            r = std::make_shared<kis_net_beast_route>(def.route, 
+                    std::list<boost::beast::http::verb>{boost::beast::http::verb::get},
+                    false, std::list<std::string>{}, nullptr);
+
+        trie.insert(r, routes.size());
+        routes.push_back(r);
+        regex_routes.emplace_back(def);
+    }
+
+    // Index of the matching route, or -1; the first registered route wins, as it did
+    // when the server tried each regex in turn
+    int match_regex(const std::string& url, kis_net_beast_httpd_connection::uri_param_t& params) const {
+        for (size_t i = 0; i < regex_routes.size(); i++) {
+            if (regex_routes[i].match_url(url, params))
+                return i;
+        }
+
+        return -1;
+    }
+
+    int match_trie(const std::string& url, kis_net_beast_httpd_connection::uri_param_t& params) const {
+        auto r = trie.match(url, params);
+
+        if (r == nullptr)
+            return -1;
+
+        for (size_t i = 0; i < routes.size(); i++) {
+            if (routes[i] == r)
+                return i;
+        }
+
+        return -1;
+    }
+};
+
+// Capture values, including ones with a '.' which must stay in the capture or split
+// off as a file type
+static const std::vector<std::string> bench_captures = {
+    "4202770D00000000_AABBCCDDEEFF", "1700000000", "-60", "AA:BB:CC:DD:EE:FF",
+    "5fe308bd-0000-0000-0000-00c0ca91ac4b", "phy-IEEE802.11", "1.5", "a.b.c",
+};
+
+static const std::vector<std::string> bench_types = {
+    "json", "itjson", "ekjson", "prettyjson", "cmd", "pcap", "pcapng", "ws", "html", "xyz", "tar.gz", "",
+};
+
+static const std::vector<std::string> bench_getvars = {
+    "", "?fields=kismet.device.base.key", "?a=b.json&c=/d",
+};
+
+static std::string bench_fill_route(const std::string& route, size_t n) {
+    std::string ret;
+    size_t c = 0;
+
+    for (size_t i = 0; i < route.length(); i++) {
+        if (route[i] != ':') {
+            ret += route[i];
+            continue;
+        }
+
+        ret += bench_captures[(n + c++) % bench_captures.size()];
+
+        while (i + 1 < route.length() && route[i + 1] != '/')
+            i++;
+    }
+
+    return ret;
+}
+
+static void bench_gen_urls(const bench_route_def& def, std::vector<std::string>& urls) {
+    size_t n_fill = std::string(def.route).find(':') == std::string::npos ? 1 : bench_captures.size();
+
+    for (size_t n = 0; n < n_fill; n++) {
+        auto path = bench_fill_route(def.route, n);
+
+        for (const auto& t : bench_types) {
+            for (const auto& g : bench_getvars) {
+                if (t.length() == 0)
+                    urls.push_back(path + g);
+                else
+                    urls.push_back(fmt::format("{}.{}{}", path, t, g));
+            }
+        }
+
+        // Near misses
+        urls.push_back(path + "/");
+        urls.push_back(path + "./");
+        urls.push_back(path + "..json");
+        urls.push_back(path.substr(0, path.rfind('/')));
+        urls.push_back(fmt::format("/x{}.json", path));
+    }
+
+    // Empty captures and captures spanning segments
+    if (std::string(def.route).find(':') != std::string::npos) {
+        std::string empty, spanning;
+        std::string route{def.route};
+
+        for (size_t i = 0; i < route.length(); i++) {
+            if (route[i] != ':') {
+                empty += route[i];
+                spanning += route[i];
+                continue;
+            }
+
+            spanning += "a/b";
+
+            while (i + 1 < route.length() && route[i + 1] != '/')
+                i++;
+        }
+
+        urls.push_back(empty + ".json");
+        urls.push_back(spanning + ".json");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int n_iter = 20;
+
+    if (argc > 1)
+        n_iter = strtoul(argv[1], NULL, 10);
+
+    if (n_iter == 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        exit(1);
+    }
+
+    bench_route_set http_routes, ws_routes;
+    std::vector<std::string> http_urls, ws_urls;
+
+    for (const auto& d : bench_route_defs) {
+        if (d.websocket) {
+            ws_routes.add(d);
+            bench_gen_urls(d, ws_urls);
+        } else {
+            http_routes.add(d);
+            bench_gen_urls(d, http_urls);
+        }
+    }
+
+    unsigned int n_matched = 0, n_mismatch = 0;
+
+    auto check = [&](const bench_route_set& set, const std::vector<std::string>& urls) {
+        for (const auto& u : urls) {
+            kis_net_beast_httpd_connection::uri_param_t regex_params, trie_params;
+
+            auto ri = set.match_regex(u, regex_params);
+            auto ti = set.match_trie(u, trie_params);
+
+            if (ri >= 0)
+                n_matched++;
+
+            if (ri == ti && regex_params == trie_params)
+                continue;
+
+            n_mismatch++;
+
+            printf("mismatch: %s\n", u.c_str());
+            printf("  regex: %s\n", ri < 0 ? "(none)" : set.routes[ri]->route().c_str());
+            for (const auto& p : regex_params)
+                printf("    %s = %s\n", p.first.c_str(), p.second.c_str());
+            printf("  trie:  %s\n", ti < 0 ? "(none)" : set.routes[ti]->route().c_str());
+            for (const auto& p : trie_params)
+                printf("    %s = %s\n", p.first.c_str(), p.second.c_str());
+        }
+    };
+
+    check(http_routes, http_urls);
+    check(ws_routes, ws_urls);
+
+    auto n_urls = http_urls.size() + ws_urls.size();
+
+    printf("routes:                  %zu http, %zu websocket\n", 
+            http_routes.routes.size(), ws_routes.routes.size());
+    printf("urls:                    %zu (%u match a route)\n", n_urls, n_matched);
+    printf("mismatches:              %u\n", n_mismatch);
+
+    auto time_lookups = [&](bool use_trie) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (unsigned int i = 0; i < n_iter; i++) {
+            for (const auto& u : http_urls) {
+                kis_net_beast_httpd_connection::uri_param_t params;
+                if (use_trie)
+                    http_routes.trie.match(u, params);
+                else
+                    http_routes.match_regex(u, params);
+            }
+
+            for (const auto& u : ws_urls) {
+                kis_net_beast_httpd_connection::uri_param_t params;
+                if (use_trie)
+                    ws_routes.trie.match(u, params);
+                else
+                    ws_routes.match_regex(u, params);
+            }
+        }
+
+        auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return (sec * 1000000) / ((double) n_iter * n_urls);
+    };
+
+    auto regex_us = time_lookups(false);
+    auto trie_us = time_lookups(true);
+
+    printf("regex usec per lookup:   %.2f\n", regex_us);
+    printf("trie usec per lookup:    %.2f\n", trie_us);
+    printf("speedup:                 %.1fx\n", regex_us / trie_us);
+
+    return n_mismatch == 0 ? 0 : 1;
+}
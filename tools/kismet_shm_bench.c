@@ -0,0 +1,315 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Throughput comparison of the two local capture transports:  framed and
+ * checksummed writes over a pipe, as used by the IPC protocol, and the shared
+ * memory frame ring.  A forked producer plays the capture helper and the parent
+ * plays the server, copying each frame out as the datasource would.
+ *
+ * The pipe numbers do not include the protobuf encoding of the real protocol, so
+ * they are a best case for the pipe transport.
+ *
+ * Build with 'make tools/kismet_shm_bench'
+ *
+ * Usage: kismet_shm_bench [frames] [frame size]
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#include "kis_external_packet.h"
+#include "shm_ring_c.h"
+
+#define BENCH_PIPE_BUF_SZ   (1024 * 256)
+
+/* Same checksum as adler32_csum in the capture framework */
+static uint32_t bench_adler32(const uint8_t *buf, size_t len) {
+    uint32_t s1 = 0, s2 = 0;
+    size_t i;
+
+    if (len < 4)
+        return 0;
+
+    for (i = 0; i < (len - 4); i += 4) {
+        s2 += 4 * (s1 + buf[i]) + 3 * buf[i + 1] + 2 * buf[i + 2] + buf[i + 3];
+        s1 += (buf[i + 0] + buf[i + 1] + buf[i + 2] + buf[i + 3]);
+    }
+
+    for (; i < len; i++) {
+        s1 += buf[i];
+        s2 += s1;
+    }
+
+    return (s1 & 0xffff) + (s2 << 16);
+}
+
+static double bench_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static void bench_report(const char *name, unsigned long frames, size_t frame_sz,
+        double elapsed) {
+    printf("%-6s %10lu frames  %8.3f sec  %12.0f frames/sec  %8.1f MB/sec\n",
+            name, frames, elapsed, frames / elapsed,
+            (frames * (double) frame_sz) / elapsed / (1024 * 1024));
+}
+
+static int bench_pipe(unsigned long frames, size_t frame_sz) {
+    int pipefd[2];
+    pid_t pid;
+    uint8_t *buf, *frame_copy;
+    size_t buf_len = 0;
+    unsigned long received = 0;
+    double start;
+
+    if (pipe(pipefd) < 0) {
+        fprintf(stderr, "ERROR: pipe(): %s\n", strerror(errno));
+        return -1;
+    }
+
+    fflush(stdout);
+    start = bench_now();
+
+    if ((pid = fork()) == 0) {
+        kismet_external_frame_t *frame;
+        size_t out_sz = sizeof(kismet_external_frame_t) + frame_sz;
+        unsigned long i;
+
+        close(pipefd[0]);
+
+        frame = (kismet_external_frame_t *) malloc(out_sz);
+        memset(frame->data, 0xAA, frame_sz);
+
+        for (i = 0; i < frames; i++) {
+            size_t written = 0;
+
+            frame->signature = htonl(KIS_EXTERNAL_PROTO_SIG);
+            frame->data_sz = htonl(frame_sz);
+            frame->data_checksum = htonl(bench_adler32(frame->data, frame_sz));
+
+            while (written < out_sz) {
+                ssize_t r = write(pipefd[1], (uint8_t *) frame + written, out_sz - written);
+
+                if (r < 0 && errno == EINTR)
+                    continue;
+                if (r < 0)
+                    _exit(1);
+
+                written += r;
+            }
+        }
+
+        _exit(0);
+    }
+
+    close(pipefd[1]);
+
+    buf = (uint8_t *) malloc(BENCH_PIPE_BUF_SZ);
+    frame_copy = (uint8_t *) malloc(frame_sz);
+
+    while (received < frames) {
+        ssize_t r = read(pipefd[0], buf + buf_len, BENCH_PIPE_BUF_SZ - buf_len);
+        size_t offt = 0;
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+
+        buf_len += r;
+
+        while (buf_len - offt >= sizeof(kismet_external_frame_t)) {
+            kismet_external_frame_t *frame = (kismet_external_frame_t *) (buf + offt);
+            uint32_t data_sz = ntohl(frame->data_sz);
+
+            if (buf_len - offt < sizeof(kismet_external_frame_t) + data_sz)
+                break;
+
+            if (ntohl(frame->signature) != KIS_EXTERNAL_PROTO_SIG ||
+                    ntohl(frame->data_checksum) != bench_adler32(frame->data, data_sz)) {
+                fprintf(stderr, "ERROR: corrupt pipe frame\n");
+                return -1;
+            }
+
+            memcpy(frame_copy, frame->data, data_sz);
+
+            offt += sizeof(kismet_external_frame_t) + data_sz;
+            received++;
+        }
+
+        memmove(buf, buf + offt, buf_len - offt);
+        buf_len -= offt;
+    }
+
+    bench_report("pipe", received, frame_sz, bench_now() - start);
+
+    waitpid(pid, NULL, 0);
+    close(pipefd[0]);
+    free(buf);
+    free(frame_copy);
+
+    return 0;
+}
+
+static int bench_shm(unsigned long frames, size_t frame_sz) {
+    kis_shm_ring_t *ring;
+    kis_shm_record_t *rec;
+    int notifypair[2];
+    pid_t pid;
+    uint8_t *frame_copy;
+    unsigned long received = 0;
+    unsigned long wakeups = 0;
+    double start;
+    int r;
+
+    if ((ring = kis_shm_ring_create(1024 * 1024 * 4)) == NULL) {
+        fprintf(stderr, "ERROR: could not create shared memory ring: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (pipe(notifypair) < 0) {
+        fprintf(stderr, "ERROR: pipe(): %s\n", strerror(errno));
+        return -1;
+    }
+
+    fflush(stdout);
+    start = bench_now();
+
+    if ((pid = fork()) == 0) {
+        kis_shm_ring_t *pring;
+        kis_shm_record_t meta;
+        uint8_t *data;
+        unsigned long i;
+
+        close(notifypair[0]);
+
+        /* Attach through the inherited descriptor, the same as a helper would */
+        if ((pring = kis_shm_ring_attach(ring->shm_fd, notifypair[1])) == NULL)
+            _exit(1);
+
+        data = (uint8_t *) malloc(frame_sz);
+        memset(data, 0xAA, frame_sz);
+
+        memset(&meta, 0, sizeof(kis_shm_record_t));
+        meta.fields = KIS_SHM_FIELD_SIGNAL_DBM | KIS_SHM_FIELD_FREQ_KHZ;
+        meta.signal_dbm = -50;
+        meta.freq_khz = 2412000;
+
+        for (i = 0; i < frames; i++) {
+            while ((r = kis_shm_ring_write(pring, &meta, data, frame_sz)) == 0)
+                sched_yield();
+
+            if (r < 0)
+                _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(notifypair[1]);
+
+    frame_copy = (uint8_t *) malloc(frame_sz);
+
+    while (received < frames) {
+        struct pollfd pfd;
+        uint8_t drain[64];
+
+        while ((r = kis_shm_ring_peek(ring, &rec)) > 0) {
+            memcpy(frame_copy, rec->data, rec->data_sz);
+            kis_shm_ring_consume(ring, rec);
+            received++;
+        }
+
+        if (r < 0) {
+            fprintf(stderr, "ERROR: corrupt shared memory ring\n");
+            return -1;
+        }
+
+        if (received >= frames || !kis_shm_ring_prepare_wait(ring))
+            continue;
+
+        pfd.fd = notifypair[0];
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, 1000) <= 0) {
+            if (waitpid(pid, NULL, WNOHANG) == pid)
+                break;
+            continue;
+        }
+
+        if (read(notifypair[0], drain, sizeof(drain)) <= 0)
+            break;
+
+        wakeups++;
+    }
+
+    bench_report("shm", received, frame_sz, bench_now() - start);
+    printf("       %lu consumer wakeups through the notify pipe\n", wakeups);
+
+    waitpid(pid, NULL, 0);
+    close(notifypair[0]);
+    kis_shm_ring_free(ring);
+    free(frame_copy);
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long frames = 1000000;
+    size_t frame_sz = 256;
+
+    if (argc > 1)
+        frames = strtoul(argv[1], NULL, 10);
+
+    if (argc > 2)
+        frame_sz = strtoul(argv[2], NULL, 10);
+
+    if (frames == 0 || frame_sz == 0) {
+        fprintf(stderr, "usage: %s [frames] [frame size]\n", argv[0]);
+        exit(1);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Transferring %lu frames of %lu bytes\n", frames, (unsigned long) frame_sz);
+
+    if (bench_pipe(frames, frame_sz) < 0)
+        exit(1);
+
+    if (bench_shm(frames, frame_sz) < 0)
+        exit(1);
+
+    return 0;
+}
+
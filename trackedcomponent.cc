@@ -46,7 +46,41 @@ int tracker_component::register_field(const std::string& in_name,
     return id;
 }
 
+void tracker_component::add_inline_field(inline_layout *layout, const inline_field& f) {
+    kis_lock_guard<kis_mutex> lk(layout->mutex, "tracker_component add_inline_field");
+
+    // Another instance may have completed the layout while we were registering
+    if (layout->sealed)
+        return;
+
+    for (const auto& lf : layout->fields) {
+        if (lf.id == f.id)
+            return;
+    }
+
+    layout->fields.push_back(f);
+}
+
 void tracker_component::reserve_fields(std::shared_ptr<tracker_element_map> e) {
+    auto layout = get_inline_layout();
+
+    if (layout != nullptr) {
+        if (!layout->sealed) {
+            kis_lock_guard<kis_mutex> lk(layout->mutex, "tracker_component reserve_fields");
+            layout->sealed = true;
+        }
+
+        // Pull inline values out of the imported element
+        if (e != nullptr && e->get_type() == tracker_type::tracker_map) {
+            for (const auto& f : layout->fields) {
+                auto r = e->get_sub(f.id);
+
+                if (r != nullptr)
+                    f.import(r, reinterpret_cast<char *>(this) + f.offset);
+            }
+        }
+    }
+
     if (registered_fields == nullptr)
         return;
 
@@ -104,6 +138,35 @@ shared_tracker_element tracker_component::import_or_new(std::shared_ptr<tracker_
     return r;
 }
 
+shared_tracker_element tracker_component::get_sub(int id) {
+    auto v = map.find(id);
+
+    if (v != map.end())
+        return v->second;
+
+    auto layout = get_inline_layout();
+
+    if (layout == nullptr)
+        return nullptr;
+
+    for (const auto& f : layout->fields) {
+        if (f.id == id)
+            return materialize_inline_field(f);
+    }
+
+    return nullptr;
+}
+
+void tracker_component::for_each_unmapped(const std::function<void (const shared_tracker_element&)>& fn) const {
+    auto layout = get_inline_layout();
+
+    if (layout == nullptr)
+        return;
+
+    for (const auto& f : layout->fields)
+        fn(materialize_inline_field(f));
+}
+
 shared_tracker_element tracker_component::get_child_path(const std::string& in_path) {
     std::vector<std::string> tok = str_tokenize(in_path, "/");
     return get_child_path(tok);
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <string>
 #include <stdexcept>
 
@@ -34,10 +35,88 @@
 
 #include "globalregistry.h"
 #include "trackedelement.h"
+#include "trackedstringpool.h"
 #include "entrytracker.h"
 #include "kis_mutex.h"
 #include "json/json.h"
 
+// Inline storage for a scalar tracked field.
+//
+// A tracker_inline<TE> holds only the raw value of the tracker element type TE, 
+// instead of a shared, heap allocated element and a map entry.  It presents the
+// subset of the element interface used by the proxy macros, so a component field
+// can be switched from std::shared_ptr<TE> to tracker_inline<TE> without changing
+// its __Proxy accessors.
+//
+// Inline fields are registered with register_field like any other field, and are
+// materialized as standalone TE elements only when the component is serialized or
+// walked by a path lookup; they are never stored in the component map.  See
+// tracker_component::get_inline_layout()
+template<typename TE>
+class tracker_inline {
+public:
+    using element_type = TE;
+    using value_type = typename std::remove_reference<decltype(std::declval<TE&>().get())>::type;
+
+    tracker_inline() :
+        value{} { }
+
+    value_type& get() {
+        return value;
+    }
+
+    const value_type& get() const {
+        return value;
+    }
+
+    void set(const value_type& in) {
+        value = in;
+    }
+
+    // Mimic dereferencing the shared element so that (*cvar) and cvar-> work
+    // in the proxy macros
+    tracker_inline<TE>& operator*() {
+        return *this;
+    }
+
+    tracker_inline<TE> *operator->() {
+        return this;
+    }
+
+    tracker_inline<TE>& operator+=(const value_type& rhs) {
+        value += rhs;
+        return *this;
+    }
+
+    tracker_inline<TE>& operator-=(const value_type& rhs) {
+        value -= rhs;
+        return *this;
+    }
+
+    tracker_inline<TE>& operator|=(const value_type& rhs) {
+        value |= rhs;
+        return *this;
+    }
+
+    tracker_inline<TE>& operator&=(const value_type& rhs) {
+        value &= rhs;
+        return *this;
+    }
+
+protected:
+    value_type value;
+};
+
+template<typename T, typename TE> 
+T get_tracker_value(const tracker_inline<TE>& i) {
+    return (T) i.get();
+}
+
+template<typename T, typename TE> 
+void set_tracker_value(tracker_inline<TE>& i, const T& v) {
+    i.set(static_cast<typename tracker_inline<TE>::value_type>(v));
+}
+
 
 // Complex trackable unit based on trackertype dataunion.
 //
@@ -67,7 +146,7 @@ class tracker_component : public tracker_element_map {
 // class variable <cvar>
 #define __Proxy(name, ptype, itype, rtype, cvar) \
     virtual shared_tracker_element get_tracker_##name() const { \
-        return (std::shared_ptr<tracker_element>) cvar; \
+        return proxy_tracker_element(cvar); \
     } \
     virtual rtype get_##name() const { \
         return (rtype) get_tracker_value<ptype>(cvar); \
@@ -81,7 +160,7 @@ class tracker_component : public tracker_element_map {
 #define __ProxyM(name, ptype, itype, rtype, cvar, mvar) \
     virtual shared_tracker_element get_tracker_##name() { \
         kis_lock_guard<kis_mutex> lk(mvar, __func__); \
-        return (std::shared_ptr<tracker_element>) cvar; \
+        return proxy_tracker_element(cvar); \
     } \
     virtual rtype get_##name() { \
         kis_lock_guard<kis_mutex> lk(mvar, __func__); \
@@ -104,7 +183,7 @@ class tracker_component : public tracker_element_map {
 // calling the callback function
 #define __ProxyL(name, ptype, itype, rtype, cvar, lambda) \
     virtual shared_tracker_element get_tracker_##name() { \
-        return (std::shared_ptr<tracker_element>) cvar; \
+        return proxy_tracker_element(cvar); \
     } \
     virtual rtype get_##name() const { \
         return (rtype) get_tracker_value<ptype>(cvar); \
@@ -117,6 +196,29 @@ class tracker_component : public tracker_element_map {
         cvar->set((ptype) in); \
     }
 
+// Proxy for a string field stored as a pooled element (see trackedstringpool.h).
+// The pooled element is shared with every other record holding the same value and
+// must never be written to, so set_<name> swaps in the pooled element for the new value.
+// The field id is the same for every instance of the class, so the pool is looked up
+// once instead of going through the pool registry lock on every change
+#define __ProxyInterned(name, cvar) \
+    virtual shared_tracker_element get_tracker_##name() const { \
+        return cvar; \
+    } \
+    virtual std::string get_##name() const { \
+        return cvar->get(); \
+    } \
+    virtual void set_##name(const std::string& in) { \
+        if (cvar->get() == in) \
+            return; \
+        static const auto field_pool = tracker_string_pool::get_field_pool(cvar->get_id()); \
+        if (field_pool->get_field_id() == cvar->get_id()) \
+            cvar = field_pool->intern(in); \
+        else \
+            cvar = tracker_string_pool::get_field_pool(cvar->get_id())->intern(in); \
+        insert(cvar); \
+    }
+
 // Proxy, connected to a dynamic element.  Getting or setting the dynamic element
 // creates it. 
 #define __ProxyDynamic(name, ptype, itype, rtype, cvar, id) \
@@ -695,6 +797,18 @@ class tracker_component : public tracker_element_map {
 #define __ImportId(f, b) \
     f = b->f
 
+// Import an inline field value from a builder instance
+#define __ImportInline(f, b) \
+    f = b->f
+
+// Declare the inline field layout for a component class; every class which 
+// registers tracker_inline fields must declare its own layout
+#define __InlineLayout \
+    virtual tracker_component::inline_layout *get_inline_layout() const override { \
+        static tracker_component::inline_layout layout; \
+        return &layout; \
+    }
+
     class registered_field {
         // We use negative IDs to indicate dynamic assignment, since this exists for every field
         // in every tracked element we actually do benefit from squeezing the boolean out
@@ -725,6 +839,29 @@ class tracker_component : public tracker_element_map {
             shared_tracker_element *assign;
     };
 
+public:
+    // Inline field record; the field lives at a fixed offset from the component, and
+    // is converted to and from a standalone element by the type-specific functions
+    struct inline_field {
+        int id;
+        ptrdiff_t offset;
+        shared_tracker_element (*materialize)(int id, const void *src);
+        void (*import)(const shared_tracker_element& e, void *dest);
+    };
+
+    // Per-class table of inline fields.  The table is filled by the first instance
+    // to register its fields and sealed when that instance reserves them; once
+    // sealed it is never modified and is read without locking.
+    class inline_layout {
+    public:
+        inline_layout() :
+            sealed{false} { }
+
+        std::atomic<bool> sealed;
+        kis_mutex mutex;
+        std::vector<inline_field> fields;
+    };
+
 
 public:
     tracker_component() :
@@ -777,7 +914,66 @@ public:
     shared_tracker_element get_child_path(const std::string& in_path);
     shared_tracker_element get_child_path(const std::vector<std::string>& in_path);
 
+    // Find a sub-element, materializing a copy of an inline field if needed
+    virtual shared_tracker_element get_sub(int id) override;
+
+    // Materialize a copy of each inline field for the serializers
+    virtual void for_each_unmapped(const std::function<void (const shared_tracker_element&)>& fn) const override;
+
 protected:
+    // Inline field layout of the class, or nullptr if it has no inline fields; 
+    // classes using inline fields declare their layout with __InlineLayout
+    virtual inline_layout *get_inline_layout() const {
+        return nullptr;
+    }
+
+    shared_tracker_element materialize_inline_field(const inline_field& f) const {
+        return f.materialize(f.id, reinterpret_cast<const char *>(this) + f.offset);
+    }
+
+    // Used by the proxy macros to return the tracked element for a field
+    shared_tracker_element proxy_tracker_element(const shared_tracker_element& e) const {
+        return e;
+    }
+
+    // Inline fields return a copy of their current value; changing it does not
+    // alter the field
+    template<typename TE>
+    shared_tracker_element proxy_tracker_element(const tracker_inline<TE>& i) const {
+        auto layout = get_inline_layout();
+        auto offset = reinterpret_cast<const char *>(&i) - reinterpret_cast<const char *>(this);
+
+        if (layout != nullptr) {
+            for (const auto& f : layout->fields) {
+                if (f.offset == offset)
+                    return materialize_inline_field(f);
+            }
+        }
+
+        throw std::runtime_error("inline field accessed before registration");
+    }
+
+    template<typename TE>
+    static shared_tracker_element materialize_inline(int id, const void *src) {
+        auto e = std::make_shared<TE>(id);
+        e->set(static_cast<const tracker_inline<TE> *>(src)->get());
+        return e;
+    }
+
+    template<typename TE>
+    static void import_inline(const shared_tracker_element& e, void *dest) {
+        auto i = static_cast<tracker_inline<TE> *>(dest);
+
+        if (e->get_type() == TE::static_type()) {
+            i->set(std::static_pointer_cast<TE>(e)->get());
+        } else {
+            TE c(0);
+            c.coercive_set(e);
+            i->set(c.get());
+        }
+    }
+
+
     // Register a field via the entrytracker, using standard entrytracker build methods.
     // This field will be automatically assigned or created during the reservefields 
     // stage.
@@ -826,6 +1022,36 @@ protected:
         return id;
     }
 
+    // Register a field stored inline in the component instead of as a tracked element.
+    // The class must declare its layout with __InlineLayout.
+    //
+    // Inline fields are only visible as elements through the copies made for serializers,
+    // path lookups, and get_tracker_* proxies, so they should only be used for scalar
+    // values which are read and written through their proxies.
+    template<typename TE>
+    int register_field(const std::string& in_name, const std::string& in_desc,
+            tracker_inline<TE> *in_dest) {
+        int id = 
+            Globalreg::globalreg->entrytracker->register_field(in_name, 
+                    tracker_element_factory<TE>(), in_desc);
+
+        auto layout = get_inline_layout();
+
+        if (layout == nullptr)
+            throw std::runtime_error(fmt::format("inline field {} registered in a component "
+                        "with no inline layout", in_name));
+
+        if (!layout->sealed) {
+            add_inline_field(layout, inline_field{id, 
+                    reinterpret_cast<const char *>(in_dest) - reinterpret_cast<const char *>(this),
+                    &materialize_inline<TE>, &import_inline<TE>});
+        }
+
+        return id;
+    }
+
+    void add_inline_field(inline_layout *layout, const inline_field& f);
+
     // Register field types and get a field ID.  Called during record creation, prior to 
     // assigning an existing trackerelement tree or creating a new one
     virtual void register_fields() { }
@@ -140,6 +140,10 @@ void tracker_element_string::coercive_set(const shared_tracker_element& e) {
 }
 
 bool tracker_element_string::less_than(const tracker_element_string& rhs) const {
+    // Pooled strings of the same value are the same element
+    if (this == &rhs)
+        return false;
+
     return doj::alphanum_comp(value, rhs.value) < 0;
 }
 
@@ -1301,7 +1301,8 @@ public:
     tracker_element_map(const tracker_element_map *p) :
         tracker_element_core_map<std::unordered_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>(p) { }
 
-    shared_tracker_element get_sub(int id) {
+    // Virtual so that components can provide fields which are not stored in the map
+    virtual shared_tracker_element get_sub(int id) {
         auto v = map.find(id);
 
         if (v == map.end())
@@ -1312,14 +1313,14 @@ public:
 
     template<typename T>
     std::shared_ptr<T> get_sub_as(int id) {
-        auto v = map.find(id);
-
-        if (v == map.end())
-            return NULL;
-
-        return std::static_pointer_cast<T>(v->second);
+        return std::static_pointer_cast<T>(get_sub(id));
     }
 
+    // Visit fields which belong to the map but are not stored in it, such as the inline
+    // fields of a component.  Each visit yields a new copy of the field, so serializers
+    // can emit them alongside the map contents without modifying the map.
+    virtual void for_each_unmapped(const std::function<void (const shared_tracker_element&)>& fn) const { }
+
     std::pair<iterator, bool> insert(shared_tracker_element e) {
         if (e == NULL) 
             throw std::runtime_error("Attempted to insert null tracker_element with no ID");
@@ -0,0 +1,217 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <functional>
+#include <map>
+
+#include "configfile.h"
+#include "entrytracker.h"
+#include "globalregistry.h"
+#include "trackedstringpool.h"
+
+tracker_string_pool::tracker_string_pool(const std::string& in_name, int in_field_id,
+        size_t in_max_entries, unsigned int in_shards) :
+    name{in_name},
+    field_id{in_field_id},
+    max_entries{in_max_entries},
+    max_shard_entries{0},
+    lookups{0},
+    hits{0},
+    overflows{0},
+    evictions{0},
+    entries{0},
+    bytes{0} {
+
+    if (max_entries == 0)
+        return;
+
+    // Don't make shards smaller than is useful for small pools
+    if (in_shards == 0)
+        in_shards = 1;
+
+    while (in_shards > 1 && max_entries / in_shards < 64)
+        in_shards /= 2;
+
+    max_shard_entries = (max_entries + in_shards - 1) / in_shards;
+
+    for (unsigned int s = 0; s < in_shards; s++) {
+        auto shard = std::unique_ptr<pool_shard>(new pool_shard());
+        shard->mutex.set_name(fmt::format("tracker_string_pool {} shard", name));
+        shards.push_back(std::move(shard));
+    }
+}
+
+static kis_mutex& string_pool_registry_mutex() {
+    static kis_mutex mutex{"tracker_string_pool registry"};
+    return mutex;
+}
+
+static std::map<int, std::shared_ptr<tracker_string_pool>>& string_pool_registry() {
+    static std::map<int, std::shared_ptr<tracker_string_pool>> registry;
+    return registry;
+}
+
+std::shared_ptr<tracker_string_pool> tracker_string_pool::get_field_pool(int in_field_id) {
+    kis_lock_guard<kis_mutex> lk(string_pool_registry_mutex(), "tracker_string_pool get_field_pool");
+
+    auto& registry = string_pool_registry();
+
+    auto k = registry.find(in_field_id);
+    if (k != registry.end())
+        return k->second;
+
+    auto name = Globalreg::globalreg->entrytracker->get_field_name(in_field_id);
+
+    size_t max_entries = 65536;
+    if (Globalreg::globalreg->kismet_config != nullptr)
+        max_entries = 
+            Globalreg::globalreg->kismet_config->fetch_opt_as<size_t>("string_pool_max_entries",
+                    max_entries);
+
+    auto pool = std::make_shared<tracker_string_pool>(name, in_field_id, max_entries);
+    registry[in_field_id] = pool;
+
+    return pool;
+}
+
+std::shared_ptr<tracker_element_vector> tracker_string_pool::get_pool_stats() {
+    auto entrytracker = Globalreg::globalreg->entrytracker;
+
+    auto pool_id =
+        entrytracker->register_field("kismet.string_pool",
+                tracker_element_factory<tracker_element_map>(),
+                "string pool");
+    auto name_id =
+        entrytracker->register_field("kismet.string_pool.name",
+                tracker_element_factory<tracker_element_string>(),
+                "field pooled by this pool");
+    auto max_id =
+        entrytracker->register_field("kismet.string_pool.max_entries",
+                tracker_element_factory<tracker_element_uint64>(),
+                "maximum number of distinct values pooled");
+    auto entries_id =
+        entrytracker->register_field("kismet.string_pool.entries",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of distinct values pooled");
+    auto bytes_id =
+        entrytracker->register_field("kismet.string_pool.bytes",
+                tracker_element_factory<tracker_element_uint64>(),
+                "total length of pooled values");
+    auto lookups_id =
+        entrytracker->register_field("kismet.string_pool.lookups",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of values looked up in the pool");
+    auto hits_id =
+        entrytracker->register_field("kismet.string_pool.hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of lookups which found an existing value");
+    auto overflows_id =
+        entrytracker->register_field("kismet.string_pool.overflows",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of values not pooled because the pool was full");
+    auto evictions_id =
+        entrytracker->register_field("kismet.string_pool.evictions",
+                tracker_element_factory<tracker_element_uint64>(),
+                "number of values dropped from the pool once no longer in use");
+
+    auto ret = std::make_shared<tracker_element_vector>();
+
+    kis_lock_guard<kis_mutex> lk(string_pool_registry_mutex(), "tracker_string_pool get_pool_stats");
+
+    for (const auto& p : string_pool_registry()) {
+        auto pool = p.second;
+        auto m = std::make_shared<tracker_element_map>(pool_id);
+
+        m->insert(std::make_shared<tracker_element_string>(name_id, pool->get_name()));
+        m->insert(std::make_shared<tracker_element_uint64>(max_id, pool->get_max_entries()));
+        m->insert(std::make_shared<tracker_element_uint64>(entries_id, pool->get_entries()));
+        m->insert(std::make_shared<tracker_element_uint64>(bytes_id, pool->get_bytes()));
+        m->insert(std::make_shared<tracker_element_uint64>(lookups_id, pool->get_lookups()));
+        m->insert(std::make_shared<tracker_element_uint64>(hits_id, pool->get_hits()));
+        m->insert(std::make_shared<tracker_element_uint64>(overflows_id, pool->get_overflows()));
+        m->insert(std::make_shared<tracker_element_uint64>(evictions_id, pool->get_evictions()));
+
+        ret->push_back(m);
+    }
+
+    return ret;
+}
+
+std::shared_ptr<tracker_element_string> tracker_string_pool::intern(const std::string& in_str) {
+    if (max_entries == 0)
+        return std::make_shared<tracker_element_string>(field_id, in_str);
+
+    lookups++;
+
+    auto& shard = shards[std::hash<std::string>{}(in_str) % shards.size()];
+
+    kis_lock_guard<kis_mutex> lk(shard->mutex, "tracker_string_pool intern");
+
+    auto k = shard->strings.find(in_str);
+    if (k != shard->strings.end()) {
+        hits++;
+        return k->second;
+    }
+
+    auto e = std::make_shared<tracker_element_string>(field_id, in_str);
+
+    // Sweeping a full shard of values which are all still in use is wasted work, so
+    // back off for a while when a sweep comes up empty
+    if (shard->strings.size() >= max_shard_entries) {
+        if (shard->sweep_backoff > 0) {
+            shard->sweep_backoff--;
+        } else if (evict_unused(shard.get()) == 0) {
+            shard->sweep_backoff = max_shard_entries / 4;
+        }
+    }
+
+    if (shard->strings.size() >= max_shard_entries) {
+        overflows++;
+        return e;
+    }
+
+    shard->strings.emplace(in_str, e);
+    entries++;
+    bytes += in_str.length();
+
+    return e;
+}
+
+size_t tracker_string_pool::evict_unused(pool_shard *shard) {
+    size_t evicted = 0;
+
+    for (auto i = shard->strings.begin(); i != shard->strings.end(); ) {
+        // Only the pool holds it; new records can't pick it up without going through
+        // intern, which holds the shard lock
+        if (i->second.use_count() == 1) {
+            bytes -= i->first.length();
+            i = shard->strings.erase(i);
+            evicted++;
+        } else {
+            ++i;
+        }
+    }
+
+    entries -= evicted;
+    evictions += evicted;
+
+    return evicted;
+}
+
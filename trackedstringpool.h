@@ -0,0 +1,131 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __TRACKEDSTRINGPOOL_H__
+#define __TRACKEDSTRINGPOOL_H__
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kis_mutex.h"
+#include "trackedelement.h"
+
+// Interned string elements
+//
+// Many tracked strings repeat across thousands of devices - device types, phy names,
+// manufacturers, encryption descriptions, and common SSIDs.  A string pool hands out
+// one shared, immutable tracker_element_string per distinct value, so identical values
+// cost one allocation instead of one per device, and comparing two pooled elements of
+// the same value is a pointer comparison.
+//
+// Pooled elements are shared between every record holding the value and MUST NOT be
+// modified; records change value by swapping in the pooled element for the new value
+// (see __ProxyInterned in trackedcomponent.h).
+//
+// Pools are per field, so the pooled elements carry the id of the field they are 
+// stored as.  The number of distinct values in a pool is capped.  When a shard of the
+// pool fills, values no longer held by any record are evicted; if every value is still
+// in use, new values get private elements, which keeps a flood of unique strings (such
+// as random probed SSIDs) from growing the pool forever.
+class tracker_string_pool {
+public:
+    tracker_string_pool(const std::string& in_name, int in_field_id, 
+            size_t in_max_entries, unsigned int in_shards = 16);
+
+    // Get the shared pool for a field, creating it on first use
+    static std::shared_ptr<tracker_string_pool> get_field_pool(int in_field_id);
+
+    // Statistics for all field pools, for the status endpoints
+    static std::shared_ptr<tracker_element_vector> get_pool_stats();
+
+    // Get the pooled element for a string value
+    std::shared_ptr<tracker_element_string> intern(const std::string& in_str);
+
+    const std::string& get_name() const {
+        return name;
+    }
+
+    int get_field_id() const {
+        return field_id;
+    }
+
+    size_t get_max_entries() const {
+        return max_entries;
+    }
+
+    uint64_t get_lookups() const {
+        return lookups;
+    }
+
+    uint64_t get_hits() const {
+        return hits;
+    }
+
+    // Values which could not be pooled because the pool was full
+    uint64_t get_overflows() const {
+        return overflows;
+    }
+
+    // Values dropped from the pool because no record held them any longer
+    uint64_t get_evictions() const {
+        return evictions;
+    }
+
+    size_t get_entries() const {
+        return entries;
+    }
+
+    // Total length of the pooled strings
+    size_t get_bytes() const {
+        return bytes;
+    }
+
+protected:
+    struct pool_shard {
+        kis_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<tracker_element_string>> strings;
+
+        // Inserts to skip before trying to evict again after a sweep found nothing to evict
+        size_t sweep_backoff = 0;
+    };
+
+    // Drop values only held by the pool; must be called with the shard locked
+    size_t evict_unused(pool_shard *shard);
+
+    std::string name;
+    int field_id;
+    size_t max_entries;
+    size_t max_shard_entries;
+
+    std::vector<std::unique_ptr<pool_shard>> shards;
+
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> overflows;
+    std::atomic<uint64_t> evictions;
+    std::atomic<size_t> entries;
+    std::atomic<size_t> bytes;
+};
+
+#endif
+